@@ -1,4 +1,6 @@
 ﻿#include <CodeGen.h>
+#include <ModuleCache.h>
+#include <Serialization.h>
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -18,6 +20,10 @@
 #pragma warning(pop)
 #endif // _MSC_VER
 
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+
 using namespace NatsuLib;
 using namespace NatsuLang::Compiler;
 
@@ -97,15 +103,125 @@ int main(int argc, char* argv[])
 			auto argIter = argv + 1;
 			const auto argEnd = argv + argc;
 			auto includeImported = false;
+			auto syntaxOnly = false;
+			CompileOptions compileOptions;
+			auto emitBitcode = false;
+			auto ltoLink = false;
+			// 全程序优化时总是保留程序入口
+			std::vector<nString> exportedSymbols{ u8"main"_nv };
+			auto fullMerge = false;
 			auto isSourceFile = true;
+			auto metadataFlags = NatsuLang::Serialization::BinaryMetadataFlags::None;
+			const char* cacheDirectory = nullptr;
+			// 默认的模块缓存大小上限为 256 MiB
+			nuLong cacheSize = 256 * 1024 * 1024;
 			for (; argIter < argEnd; ++argIter)
 			{
+				if (nStrView{ *argIter } == u8"-cache"_nv && argIter + 1 < argEnd)
+				{
+					cacheDirectory = *++argIter;
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-cache-size"_nv && argIter + 1 < argEnd)
+				{
+					cacheSize = static_cast<nuLong>(std::strtoull(*++argIter, nullptr, 10)) * 1024 * 1024;
+					continue;
+				}
+
 				if (nStrView{ *argIter } == u8"-i"_nv)
 				{
 					includeImported = true;
 					continue;
 				}
 
+				if (nStrView{ *argIter } == u8"-g"_nv)
+				{
+					compileOptions.EmitDebugInfo = true;
+					continue;
+				}
+
+				if (std::strncmp(*argIter, "-O", 2) == 0)
+				{
+					// 仅支持 -O0 至 -O3
+					const auto level = *argIter + 2;
+					if (level[0] < '0' || level[0] > '3' || level[1])
+					{
+						logger.LogErr(u8"无效的优化级别 {0}，仅支持 -O0 至 -O3"_nv, nStrView{ *argIter });
+						return EXIT_FAILURE;
+					}
+
+					compileOptions.OptLevel = static_cast<nuInt>(level[0] - '0');
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-fexceptions"_nv)
+				{
+					compileOptions.EnableExceptions = true;
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-fprofile-generate"_nv)
+				{
+					compileOptions.Profile = ProfileMode::Instrument;
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-fprofile-use"_nv)
+				{
+					if (argIter + 1 == argEnd)
+					{
+						logger.LogErr(u8"-fprofile-use 需要指定 profile 数据文件"_nv);
+						return EXIT_FAILURE;
+					}
+
+					compileOptions.Profile = ProfileMode::Use;
+					compileOptions.ProfilePath = *++argIter;
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-flto"_nv)
+				{
+					emitBitcode = true;
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-flto-link"_nv)
+				{
+					ltoLink = true;
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-export"_nv && argIter + 1 < argEnd)
+				{
+					exportedSymbols.emplace_back(*++argIter);
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-fsyntax-only"_nv)
+				{
+					syntaxOnly = true;
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-fmerge-full"_nv)
+				{
+					fullMerge = true;
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-fmetadata-varint"_nv)
+				{
+					metadataFlags = metadataFlags | NatsuLang::Serialization::BinaryMetadataFlags::CompactIntegers;
+					continue;
+				}
+
+				if (nStrView{ *argIter } == u8"-fmetadata-compress"_nv)
+				{
+					metadataFlags = metadataFlags | NatsuLang::Serialization::BinaryMetadataFlags::Compressed;
+					continue;
+				}
+
 				if (nStrView{ *argIter } == u8"-m"_nv)
 				{
 					isSourceFile = false;
@@ -115,12 +231,57 @@ int main(int argc, char* argv[])
 				(isSourceFile ? sourceFiles : metadataFiles).emplace_back(*argIter);
 			}
 
-			if (!sourceFiles.empty())
+			if (ltoLink)
 			{
-				for (const auto& uri : sourceFiles)
+				std::error_code ec;
+				llvm::raw_fd_ostream output{ "LinkedModule.obj", ec, llvm::sys::fs::F_None };
+
+				if (ec)
 				{
-					std::string outputName{ uri.GetPath().cbegin(), uri.GetPath().cend() };
-					outputName += ".obj";
+					logger.LogErr(u8"目标文件无法打开，错误为：{0}"_nv, ec.message());
+					return EXIT_FAILURE;
+				}
+
+				// 此时输入的文件均为由 -flto 输出的 bitcode
+				if (compiler.LinkModules(from(sourceFiles), from(metadataFiles), from(exportedSymbols), output, compileOptions))
+				{
+					logger.LogMsg(u8"链接的目标文件已存储到文件 LinkedModule.obj");
+				}
+			}
+			else if (!sourceFiles.empty())
+			{
+				std::optional<ModuleCache> cache;
+				// 模块缓存不保存 bitcode
+				if (cacheDirectory && !syntaxOnly && !emitBitcode)
+				{
+					cache.emplace(cacheDirectory, cacheSize);
+				}
+
+				std::vector<nString> metadataPaths;
+				for (const auto& metadataFile : metadataFiles)
+				{
+					metadataPaths.emplace_back(metadataFile.GetPath());
+				}
+
+				// 剖析数据改变时生成的代码也会改变
+				std::vector<nString> otherInputs;
+				if (compileOptions.Profile == ProfileMode::Use)
+				{
+					otherInputs.emplace_back(compileOptions.ProfilePath);
+				}
+
+				// 影响输出的选项均应参与计算
+				const auto options = natUtil::FormatString(u8"{0} {1} {2} -O{3} {4} {5} {6}"_nv, includeImported ? u8"-i"_nv : u8""_nv, compileOptions.EmitDebugInfo ? u8"-g"_nv : u8""_nv,
+					static_cast<nuShort>(metadataFlags), compileOptions.OptLevel, static_cast<nuInt>(compileOptions.Profile), compileOptions.EnableExceptions ? u8"-fexceptions"_nv : u8""_nv,
+					nStrView{ compiler.GetTargetTriple().data(), compiler.GetTargetTriple().size() });
+
+				const auto compileSource = [&](Uri const& uri)
+				{
+					const auto objectPath = uri.GetPath() + u8".obj"_nv;
+					const auto metadataPath = uri.GetPath() + u8".meta"_nv;
+					const auto bitcodePath = uri.GetPath() + u8".bc"_nv;
+
+					const std::string outputName{ objectPath.cbegin(), objectPath.cend() };
 
 					std::error_code ec;
 					llvm::raw_fd_ostream output{ outputName, ec, llvm::sys::fs::F_None };
@@ -128,37 +289,130 @@ int main(int argc, char* argv[])
 					if (ec)
 					{
 						logger.LogErr(u8"目标文件无法打开，错误为：{0}"_nv, ec.message());
-						return EXIT_FAILURE;
+						return false;
 					}
 
-					const auto metadata = make_ref<natFileStream>(uri.GetPath() + u8".meta"_nv, false, true);
+					const auto metadata = make_ref<natFileStream>(metadataPath, false, true);
 
-					compiler.Compile(uri, from(metadataFiles), output);
+					std::optional<llvm::raw_fd_ostream> bitcodeOutput;
+					if (emitBitcode)
+					{
+						bitcodeOutput.emplace(std::string{ bitcodePath.cbegin(), bitcodePath.cend() }, ec, llvm::sys::fs::F_None);
+						if (ec)
+						{
+							logger.LogErr(u8"bitcode 文件无法打开，错误为：{0}"_nv, ec.message());
+							return false;
+						}
+					}
+
+					compiler.Compile(uri, from(metadataFiles), output, compileOptions, bitcodeOutput ? &*bitcodeOutput : nullptr);
+
+					compiler.CreateMetadata(metadata, includeImported, metadataFlags);
+					return true;
+				};
+
+				// 同一编译器实例中先前编译的源码文件会影响之后的输出，因此参与计算缓存键
+				std::vector<nString> precedingSources;
+				// 命中缓存而跳过编译的源码文件没有在 Sema 中留下声明，之后的源码文件未命中时需要先重新编译这些文件
+				std::vector<Uri> skippedSources;
+
+				for (const auto& uri : sourceFiles)
+				{
+					if (syntaxOnly)
+					{
+						compiler.CheckSyntax(uri, from(metadataFiles));
+						continue;
+					}
+
+					const auto objectPath = uri.GetPath() + u8".obj"_nv;
+					const auto metadataPath = uri.GetPath() + u8".meta"_nv;
+
+					nString cacheKey;
+					if (cache)
+					{
+						cacheKey = cache->ComputeKey(uri.GetPath(), precedingSources, metadataPaths, otherInputs, options);
+						precedingSources.emplace_back(uri.GetPath());
+						if (!cacheKey.IsEmpty() && cache->Restore(cacheKey, objectPath, metadataPath))
+						{
+							logger.LogMsg(u8"文件 \"{0}\" 命中模块缓存，跳过编译"_nv, uri.GetUnderlyingString());
+							skippedSources.emplace_back(uri);
+							continue;
+						}
+					}
+
+					// 输出与命中缓存时恢复的内容相同
+					for (const auto& skippedSource : skippedSources)
+					{
+						if (!compileSource(skippedSource))
+						{
+							return EXIT_FAILURE;
+						}
+					}
+					skippedSources.clear();
 
-					compiler.CreateMetadata(metadata, includeImported);
+					if (!compileSource(uri))
+					{
+						return EXIT_FAILURE;
+					}
+
+					// 输出文件已关闭，编译失败时不应缓存
+					if (cache && !cacheKey.IsEmpty() && !compiler.IsErrored())
+					{
+						cache->Store(cacheKey, objectPath, metadataPath);
+					}
 				}
 			}
-			else
+			else if (fullMerge)
 			{
-				compiler.LoadMetadata(from(metadataFiles), false);
+				// 合并时需要保持元数据中声明的顺序，因此立即加载
+				compiler.LoadMetadata(from(metadataFiles), false, false);
 
 				const auto metadata = make_ref<natFileStream>(u8"MergedMetadata.meta"_nv, false, true);
 				// 没有源文件时总是输出所有元数据
-				compiler.CreateMetadata(metadata, true);
+				compiler.CreateMetadata(metadata, true, metadataFlags);
 				logger.LogMsg(u8"合并的元数据已存储到文件 MergedMetadata.meta");
 			}
+			else
+			{
+				// 仅在元数据层面合并，不加载任何声明
+				NatsuLang::Serialization::BinaryMetadataBundleWriter bundle{ make_ref<natFileStream>(u8"MergedMetadata.meta"_nv, false, true) };
+				std::size_t memberCount = 0;
+				for (const auto& metadataFile : metadataFiles)
+				{
+					const auto input = make_ref<natFileStream>(metadataFile.GetPath(), true, false);
+					memberCount += bundle.AddMetadata(*input);
+				}
+				bundle.FinishWriting();
+				logger.LogMsg(u8"合并的元数据包已存储到文件 MergedMetadata.meta，共 {0} 个成员"_nv, memberCount);
+			}
 		}
 		else
 		{
-			console.WriteLine(u8"Aki 版本 0.1\n"
+			console.WriteLine(u8"Aki 版本 {1}\n"
 				"NatsuLang 的 AOT 编译器\n"
 				"请将欲编译的源码文件作为第一个命令行参数传入\n"
 				"若有需要导入的元数据文件请在 -m 开关之后的参数传入\n"
 				"开关 -i 表示输出的元数据文件将会包含导入的元数据，若无源码文件输入则此开关无效，所有元数据将会合并输出\n"
+				"无源码文件输入时，元数据将被原样合并为元数据包，内容相同的元数据只保留一份\n"
+				"开关 -fmerge-full 表示合并时将加载所有元数据并重新序列化为单个元数据，而非合并为元数据包\n"
+				"开关 -g 表示为源码文件中定义的函数及局部变量生成调试信息\n"
+				"开关 -O0 至 -O3 表示优化等级，默认为 -O0，即不进行优化\n"
+				"开关 -fexceptions 表示启用异常处理，此时才能使用 try 及 throw，生成的程序需要链接 C++ ABI 运行时（libsupc++ 或 libc++abi）\n"
+				"开关 -fprofile-generate 表示插入剖析计数器，生成的程序需要链接 LLVM 的剖析运行时库，运行后将输出 .profraw 文件\n"
+				"开关 -fprofile-use 之后的参数为由 llvm-profdata 合并得到的 .profdata 文件，将按其中的剖析数据进行优化\n"
+				"开关 -flto 表示在目标文件及元数据之外额外输出供链接时优化使用的 bitcode 文件（.bc），此时不使用模块缓存\n"
+				"开关 -flto-link 表示将输入的文件作为 bitcode 合并，内部化未导出的符号并进行全程序优化，输出单个目标文件 LinkedModule.obj\n"
+				"\t此时 -m 开关之后的元数据文件中导出的声明对应的符号将被保留\n"
+				"开关 -export 之后的参数为链接时额外需要保留的符号，可以多次指定，main 总是被保留\n"
+				"开关 -fsyntax-only 表示仅对源码文件进行完整检查（包括所有函数体），不生成目标文件及元数据\n"
+				"开关 -fmetadata-varint 表示输出的元数据中的整数将以变长编码存储\n"
+				"开关 -fmetadata-compress 表示输出的元数据将按块压缩存储，导入时将自动解压\n"
+				"开关 -cache 之后的参数为模块缓存目录，输入文件及编译器版本未改变时将直接使用缓存的目标文件及元数据\n"
+				"开关 -cache-size 之后的参数为模块缓存的大小上限（以 MiB 为单位），默认为 256，超出时将淘汰最久未使用的缓存项\n"
 				"例如：\n"
 				"\t{0} file:///example.nat -m file:///library.meta\n"
 				"其中 \"file:///example.nat\" 是将要编译的源码文件路径，"
-				"\"file:///library.meta\" 是将要导入的元数据文件，使用标准 uri 形式表示"_nv, argv[0]);
+				"\"file:///library.meta\" 是将要导入的元数据文件，使用标准 uri 形式表示"_nv, argv[0], AotCompilerVersion);
 		}
 
 		console.ReadLine();
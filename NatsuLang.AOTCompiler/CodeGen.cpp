@@ -10,12 +10,27 @@
 
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Host.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/TargetRegistry.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/IR/CFG.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 
 #ifdef _MSC_VER
 #pragma warning(pop)
@@ -23,6 +38,13 @@
 
 #include <Sema/DefaultActions.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <thread>
+
 using namespace NatsuLib;
 using namespace NatsuLang;
 using namespace Compiler;
@@ -241,6 +263,61 @@ namespace
 
 		return qualifiedName;
 	}
+
+	// 由扩展精度浮点数的位模式直接构造 APFloat，不经过 double 转换以免损失精度，假定宿主为小端序
+	llvm::APFloat MakeWideAPFloat(nWideFloat value)
+	{
+		std::uint64_t words[2]{};
+		static_assert(sizeof(nWideFloat) <= sizeof words, "nWideFloat is wider than expected.");
+		std::memcpy(words, &value, sizeof value);
+
+#ifdef __SIZEOF_FLOAT128__
+		return { llvm::APFloat::IEEEquad(), llvm::APInt{ 128, words } };
+#else
+		// nWideFloat 为 long double，其格式取决于宿主
+		constexpr auto digits = std::numeric_limits<nWideFloat>::digits;
+		if constexpr (digits == 64)
+		{
+			return { llvm::APFloat::x87DoubleExtended(), llvm::APInt{ 80, words } };
+		}
+		else if constexpr (digits == 113)
+		{
+			return { llvm::APFloat::IEEEquad(), llvm::APInt{ 128, words } };
+		}
+		else
+		{
+			static_assert(digits == std::numeric_limits<nDouble>::digits, "Unsupported long double format.");
+			return llvm::APFloat{ static_cast<nDouble>(value) };
+		}
+#endif
+	}
+
+	// 按 AotAstConsumer::HandleTopLevelDecl 命名符号的方式收集声明上下文中的函数及全局变量的符号名称
+	void CollectSymbolNames(Declaration::DeclContext* dc, llvm::StringSet<>& names)
+	{
+		for (const auto& decl : dc->GetDecls())
+		{
+			if (decl->GetAttributeCount(typeid(BuiltinAttribute)))
+			{
+				continue;
+			}
+
+			if (const auto funcDecl = decl.Cast<Declaration::FunctionDecl>())
+			{
+				const auto name = GetQualifiedName(funcDecl);
+				names.insert(llvm::StringRef{ name.data(), name.size() });
+			}
+			else if (const auto varDecl = decl.Cast<Declaration::VarDecl>(); varDecl && !HasAnyFlags(varDecl->GetStorageClass(), Specifier::StorageClass::Const))
+			{
+				const auto name = GetQualifiedName(varDecl);
+				names.insert(llvm::StringRef{ name.data(), name.size() });
+			}
+			else if (const auto childDc = Declaration::Decl::CastToDeclContext(decl.Get()))
+			{
+				CollectSymbolNames(childDc, names);
+			}
+		}
+	}
 }
 
 AotCompiler::AotDiagIdMap::AotDiagIdMap(natRefPointer<TextReader<StringType::Utf8>> const& reader)
@@ -377,6 +454,11 @@ nBool AotCompiler::AotAstConsumer::HandleTopLevelDecl(Linq<Valued<Declaration::D
 		return false;
 	}
 
+	if (m_Compiler.m_SyntaxOnly)
+	{
+		return true;
+	}
+
 	auto declVec = decls.select([](Declaration::DeclPtr decl)
 	{
 		return std::pair<Declaration::DeclPtr, llvm::Value*>(std::move(decl), nullptr);
@@ -444,13 +526,33 @@ nBool AotCompiler::AotAstConsumer::HandleTopLevelDecl(Linq<Valued<Declaration::D
 				Expression::Expr::EvalResult evalResult;
 				if (initializer->Evaluate(evalResult, m_Compiler.m_AstContext))
 				{
-					if (evalResult.Result.index() == 0)
+					switch (evalResult.Result.index())
 					{
+					case 0:
 						initValue = llvm::ConstantInt::get(varType, std::get<0>(evalResult.Result));
+						break;
+					case 1:
+						initValue = llvm::ConstantFP::get(varType, std::get<1>(evalResult.Result));
+						break;
+					case 2:
+					{
+						const auto value = std::get<2>(evalResult.Result);
+						const std::uint64_t words[] { static_cast<std::uint64_t>(value), static_cast<std::uint64_t>(value >> 32 >> 32) };
+						initValue = llvm::ConstantInt::get(varType, llvm::APInt{ 128, words });
+						break;
 					}
-					else
+					case 3:
 					{
-						initValue = llvm::ConstantFP::get(varType, std::get<1>(evalResult.Result));
+						assert(varType->isFloatingPointTy());
+						auto value = MakeWideAPFloat(std::get<3>(evalResult.Result));
+						bool losesInfo;
+						value.convert(varType->getFltSemantics(), llvm::APFloat::rmNearestTiesToEven, &losesInfo);
+						initValue = llvm::ConstantFP::get(m_Compiler.m_LLVMContext, value);
+						break;
+					}
+					default:
+						assert(!"Invalid result");
+						break;
 					}
 				}
 			}
@@ -481,6 +583,12 @@ nBool AotCompiler::AotAstConsumer::HandleTopLevelDecl(Linq<Valued<Declaration::D
 			{
 			case Specifier::StorageClass::None:
 			{
+				// 函数体可能被延迟分析，生成定义前需要确保其已被分析
+				if (!m_Compiler.m_Parser.ResolveFunctionBody(funcDecl) || m_Compiler.m_DiagConsumer->IsErrored())
+				{
+					return false;
+				}
+
 				AotStmtVisitor visitor{ m_Compiler, funcDecl, llvm::dyn_cast<llvm::Function>(decl.second) };
 				visitor.StartVisit();
 				visitor.EndVisit();
@@ -503,9 +611,9 @@ nBool AotCompiler::AotAstConsumer::HandleTopLevelDecl(Linq<Valued<Declaration::D
 
 AotCompiler::AotStmtVisitor::AotStmtVisitor(AotCompiler& compiler, natRefPointer<Declaration::FunctionDecl> funcDecl, llvm::Function* funcValue)
 	: m_Compiler{ compiler }, m_CurrentFunction{ std::move(funcDecl) }, m_CurrentFunctionValue{ funcValue },
-	  m_This{}, m_LastVisitedValue{}, m_RequiredLValue{}, m_CurrentLexicalScope{},
+	  m_This{}, m_LastVisitedValue{}, m_RequiredLValue{}, m_CurrentSwitch{}, m_CurrentLexicalScope{},
 	  m_ReturnBlock{ llvm::BasicBlock::Create(compiler.m_LLVMContext, "Return"), m_CleanupStack.begin(), true },
-	  m_ReturnValue{}
+	  m_ReturnValue{}, m_CachedLandingPad{}, m_ResumeBlock{}, m_ExceptionSlot{}, m_SelectorSlot{}, m_EmittingEHCleanup{}, m_DebugScope{}
 {
 	auto argIter = m_CurrentFunctionValue->arg_begin();
 	const auto argEnd = m_CurrentFunctionValue->arg_end();
@@ -520,6 +628,28 @@ AotCompiler::AotStmtVisitor::AotStmtVisitor(AotCompiler& compiler, natRefPointer
 	const auto block = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "Entry", m_CurrentFunctionValue);
 	m_Compiler.m_IRBuilder.SetInsertPoint(block);
 
+	// 来自元数据的函数无法取得位置，不为其生成调试信息
+	if (const auto diBuilder = m_Compiler.m_DIBuilder.get())
+	{
+		if (const auto line = m_Compiler.getLineAndColumn(m_CurrentFunction->GetLocation()).first)
+		{
+			const auto name = m_CurrentFunction->GetName();
+#if LLVM_VERSION_MAJOR == 6 || LLVM_VERSION_MAJOR == 7
+			m_DebugScope = diBuilder->createFunction(m_Compiler.m_DIFile, llvm::StringRef{ name.data(), name.size() }, m_CurrentFunctionValue->getName(),
+				m_Compiler.m_DIFile, line, m_Compiler.getDebugFunctionType(m_CurrentFunction), false, true, line, llvm::DINode::FlagPrototyped);
+#elif LLVM_VERSION_MAJOR == 8
+			m_DebugScope = diBuilder->createFunction(m_Compiler.m_DIFile, llvm::StringRef{ name.data(), name.size() }, m_CurrentFunctionValue->getName(),
+				m_Compiler.m_DIFile, line, m_Compiler.getDebugFunctionType(m_CurrentFunction), line, llvm::DINode::FlagPrototyped, llvm::DISubprogram::SPFlagDefinition);
+#else
+#error "unsupported LLVM version"
+#endif
+			m_CurrentFunctionValue->setSubprogram(m_DebugScope);
+			EmitDebugLocation(m_CurrentFunction->GetLocation());
+		}
+	}
+
+	// this 占用第 1 个参数序号
+	auto argNo = m_This ? 1u : 0u;
 	for (; argIter != argEnd && paramIter != paramEnd; ++argIter, static_cast<void>(++paramIter))
 	{
 		llvm::IRBuilder<> entryIRBuilder{
@@ -529,6 +659,7 @@ AotCompiler::AotStmtVisitor::AotStmtVisitor(AotCompiler& compiler, natRefPointer
 		m_Compiler.m_IRBuilder.CreateStore(&*argIter, arg);
 
 		m_DeclMap.emplace(*paramIter, arg);
+		EmitDebugVarDecl(*paramIter, arg, ++argNo);
 	}
 
 	const auto retType = m_CurrentFunction->GetValueType().UnsafeCast<Type::FunctionType>()->GetResultType();
@@ -541,6 +672,8 @@ AotCompiler::AotStmtVisitor::AotStmtVisitor(AotCompiler& compiler, natRefPointer
 
 AotCompiler::AotStmtVisitor::~AotStmtVisitor()
 {
+	// 调试位置不能带入其他函数
+	m_Compiler.m_IRBuilder.SetCurrentDebugLocation(llvm::DebugLoc{});
 }
 
 void AotCompiler::AotStmtVisitor::VisitInitListExpr(natRefPointer<Expression::InitListExpr> const& expr)
@@ -559,12 +692,93 @@ void AotCompiler::AotStmtVisitor::VisitBreakStmt(natRefPointer<Statement::BreakS
 
 void AotCompiler::AotStmtVisitor::VisitCatchStmt(natRefPointer<Statement::CatchStmt> const& stmt)
 {
-	nat_Throw(AotCompilerException, u8"此功能尚未实现"_nv);
+	nat_Throw(AotCompilerException, u8"catch 语句只能作为 try 语句的一部分生成"_nv);
 }
 
+// 使用基于表的异常处理，try 块内可能抛出异常的调用将以 invoke 指令生成，其着陆场将跳转至本语句的分派块
+// 正常执行的路径上不存在额外的指令
 void AotCompiler::AotStmtVisitor::VisitTryStmt(natRefPointer<Statement::TryStmt> const& stmt)
 {
-	nat_Throw(AotCompilerException, u8"此功能尚未实现"_nv);
+	if (!m_Compiler.m_EnableExceptions)
+	{
+		nat_Throw(AotCompilerException, u8"未启用异常处理，无法使用 try 语句，请使用 -fexceptions 开关编译"_nv);
+	}
+
+	const auto tryEnd = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "try.end");
+	const auto dispatchBlock = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "catch.dispatch");
+
+	std::vector<std::pair<natRefPointer<Statement::CatchStmt>, llvm::BasicBlock*>> catchStmts;
+	std::vector<TryScope::Handler> handlers;
+	for (const auto& handler : stmt->GetHandlers())
+	{
+		auto catchStmt = handler.UnsafeCast<Statement::CatchStmt>();
+		const auto exDecl = catchStmt->GetExceptionDecl();
+		const auto handlerBlock = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "catch");
+		handlers.emplace_back(exDecl ? m_Compiler.getTypeInfo(exDecl->GetValueType()) : nullptr, handlerBlock);
+		catchStmts.emplace_back(std::move(catchStmt), handlerBlock);
+	}
+
+	m_TryStack.emplace_back(dispatchBlock, GetCleanupStackTop(), std::move(handlers));
+	m_CachedLandingPad = nullptr;
+
+	Visit(stmt->GetTryBlock());
+
+	const auto tryScope = std::move(m_TryStack.back());
+	m_TryStack.pop_back();
+	m_CachedLandingPad = nullptr;
+
+	EmitBranch(tryEnd);
+
+	if (dispatchBlock->use_empty())
+	{
+		// try 块中不存在可能抛出异常的调用，处理器不可能被执行
+		delete dispatchBlock;
+		for (const auto& catchStmt : catchStmts)
+		{
+			delete catchStmt.second;
+		}
+
+		EmitBlock(tryEnd, true);
+		return;
+	}
+
+	EmitBlock(dispatchBlock);
+	const auto selector = m_Compiler.m_IRBuilder.CreateLoad(getSelectorSlot(), "sel");
+	const auto typeIdFor = m_Compiler.getEHRuntimeFunction(EHRuntimeFunction::TypeIdFor);
+	const auto int8PtrType = llvm::Type::getInt8PtrTy(m_Compiler.m_LLVMContext);
+
+	auto hasCatchAll = false;
+	for (const auto& [typeInfo, handlerBlock] : tryScope.GetHandlers())
+	{
+		if (!typeInfo)
+		{
+			m_Compiler.m_IRBuilder.CreateBr(handlerBlock);
+			m_Compiler.m_IRBuilder.ClearInsertionPoint();
+			hasCatchAll = true;
+			break;
+		}
+
+		const auto typeId = m_Compiler.m_IRBuilder.CreateCall(typeIdFor, llvm::ConstantExpr::getBitCast(typeInfo, int8PtrType), "typeid");
+		const auto matches = m_Compiler.m_IRBuilder.CreateICmpEQ(selector, typeId, "matches");
+		const auto nextBlock = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "catch.fallthrough");
+		m_Compiler.m_IRBuilder.CreateCondBr(matches, handlerBlock, nextBlock);
+		EmitBlock(nextBlock);
+	}
+
+	if (!hasCatchAll)
+	{
+		// 没有匹配的处理器，继续向外层展开
+		EmitUnwind(tryScope.GetCleanupIterator());
+	}
+
+	for (const auto& [catchStmt, handlerBlock] : catchStmts)
+	{
+		EmitBlock(handlerBlock);
+		EmitCatchHandler(catchStmt);
+		EmitBranch(tryEnd);
+	}
+
+	EmitBlock(tryEnd, true);
 }
 
 void AotCompiler::AotStmtVisitor::VisitCompoundStmt(natRefPointer<Statement::CompoundStmt> const& stmt)
@@ -789,7 +1003,41 @@ void AotCompiler::AotStmtVisitor::VisitThisExpr(natRefPointer<Expression::ThisEx
 
 void AotCompiler::AotStmtVisitor::VisitThrowExpr(natRefPointer<Expression::ThrowExpr> const& expr)
 {
-	nat_Throw(AotCompilerException, u8"此功能尚未实现"_nv);
+	if (!m_Compiler.m_EnableExceptions)
+	{
+		nat_Throw(AotCompilerException, u8"未启用异常处理，无法使用 throw 表达式，请使用 -fexceptions 开关编译"_nv);
+	}
+
+	if (const auto operand = expr->GetOperand())
+	{
+		const auto type = Type::Type::GetUnderlyingType(operand->GetExprType());
+		const auto valueType = m_Compiler.getCorrespondingType(type);
+		const auto typeInfo = m_Compiler.m_AstContext.GetTypeInfo(type);
+		const auto int8PtrType = llvm::Type::getInt8PtrTy(m_Compiler.m_LLVMContext);
+
+		EvaluateRValue(operand);
+		const auto value = m_LastVisitedValue;
+
+		// 异常对象的存储由运行时分配，并在最后一个处理器结束时释放
+		const auto exceptionSizeType = m_Compiler.m_Module->getDataLayout().getIntPtrType(m_Compiler.m_LLVMContext);
+		const auto exception = m_Compiler.m_IRBuilder.CreateCall(m_Compiler.getEHRuntimeFunction(EHRuntimeFunction::AllocateException),
+			llvm::ConstantInt::get(exceptionSizeType, typeInfo.Size), "exception");
+		m_Compiler.m_IRBuilder.CreateStore(value, m_Compiler.m_IRBuilder.CreateBitCast(exception, valueType->getPointerTo()));
+
+		// 前端保证操作数的类型不具有析构函数，按位复制得到的异常对象无需析构
+		EmitCallOrInvoke(m_Compiler.getEHRuntimeFunction(EHRuntimeFunction::Throw),
+			{ exception, llvm::ConstantExpr::getBitCast(m_Compiler.getTypeInfo(type), int8PtrType), llvm::ConstantPointerNull::get(int8PtrType) });
+	}
+	else
+	{
+		EmitCallOrInvoke(m_Compiler.getEHRuntimeFunction(EHRuntimeFunction::Rethrow), {});
+	}
+
+	m_Compiler.m_IRBuilder.CreateUnreachable();
+
+	// throw 之后的代码不可达，但仍需要插入点以生成后续的代码
+	EmitBlock(llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "throw.cont"));
+	setLastVisitedResult(nullptr);
 }
 
 void AotCompiler::AotStmtVisitor::VisitCallExpr(natRefPointer<Expression::CallExpr> const& expr)
@@ -840,7 +1088,7 @@ void AotCompiler::AotStmtVisitor::VisitCallExpr(natRefPointer<Expression::CallEx
 		}
 	}
 
-	const auto callInst = m_Compiler.m_IRBuilder.CreateCall(callee, args);
+	auto callSite = EmitCallOrInvoke(callee, args);
 
 	if (m_LastVisitedDecl)
 	{
@@ -848,16 +1096,16 @@ void AotCompiler::AotStmtVisitor::VisitCallExpr(natRefPointer<Expression::CallEx
 		const auto query = m_LastVisitedDecl->GetAttributes<CallingConventionAttribute>();
 		if (!query.empty())
 		{
-			callInst->setCallingConv(CallingConventionAttribute::ToLLVMCallingConv(query.first()->GetCallingConvention()));
+			callSite.setCallingConv(CallingConventionAttribute::ToLLVMCallingConv(query.first()->GetCallingConvention()));
 		}
 	}
 
 	if (!calleeType->getReturnType()->isVoidTy())
 	{
-		callInst->setName("ret");
+		callSite->setName("ret");
 	}
 
-	setLastVisitedResult(callInst);
+	setLastVisitedResult(callSite.getInstruction());
 }
 
 void AotCompiler::AotStmtVisitor::VisitMemberCallExpr(natRefPointer<Expression::MemberCallExpr> const& expr)
@@ -916,7 +1164,7 @@ void AotCompiler::AotStmtVisitor::VisitMemberCallExpr(natRefPointer<Expression::
 		}
 	}
 
-	const auto callInst = m_Compiler.m_IRBuilder.CreateCall(callee, args);
+	auto callSite = EmitCallOrInvoke(callee, args);
 
 	if (m_LastVisitedDecl)
 	{
@@ -924,16 +1172,16 @@ void AotCompiler::AotStmtVisitor::VisitMemberCallExpr(natRefPointer<Expression::
 		const auto query = m_LastVisitedDecl->GetAttributes<CallingConventionAttribute>();
 		if (!query.empty())
 		{
-			callInst->setCallingConv(CallingConventionAttribute::ToLLVMCallingConv(query.first()->GetCallingConvention()));
+			callSite.setCallingConv(CallingConventionAttribute::ToLLVMCallingConv(query.first()->GetCallingConvention()));
 		}
 	}
 
 	if (!callee->getReturnType()->isVoidTy())
 	{
-		callInst->setName("ret");
+		callSite->setName("ret");
 	}
 
-	setLastVisitedResult(callInst);
+	setLastVisitedResult(callSite.getInstruction());
 }
 
 void AotCompiler::AotStmtVisitor::VisitCastExpr(natRefPointer<Expression::CastExpr> const& expr)
@@ -1331,17 +1579,72 @@ void AotCompiler::AotStmtVisitor::VisitSwitchCase(natRefPointer<Statement::Switc
 
 void AotCompiler::AotStmtVisitor::VisitCaseStmt(natRefPointer<Statement::CaseStmt> const& stmt)
 {
-	nat_Throw(AotCompilerException, u8"此功能尚未实现"_nv);
+	assert(m_CurrentSwitch && "case not in a switch statement");
+
+	// 以 128 位求值后截断到条件的宽度，以免 128 位的 case 值被截断为 64 位
+	nuWideInteger value;
+	if (!stmt->GetExpr()->EvaluateAsWideInt(value, m_Compiler.m_AstContext))
+	{
+		nat_Throw(AotCompilerException, u8"case 的值无法求值为常量"_nv);
+	}
+
+	// 上一分支未跳出时将会直接落入本分支
+	const auto caseBlock = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "switch.case");
+	EmitBlock(caseBlock);
+
+	const auto condType = llvm::cast<llvm::IntegerType>(m_CurrentSwitch->getCondition()->getType());
+	const std::uint64_t words[] { static_cast<std::uint64_t>(value), static_cast<std::uint64_t>(value >> 32 >> 32) };
+	m_CurrentSwitch->addCase(llvm::ConstantInt::get(condType->getContext(), llvm::APInt{ 128, words }.zextOrTrunc(condType->getBitWidth())), caseBlock);
+
+	Visit(stmt->GetSubStmt());
 }
 
 void AotCompiler::AotStmtVisitor::VisitDefaultStmt(natRefPointer<Statement::DefaultStmt> const& stmt)
 {
-	nat_Throw(AotCompilerException, u8"此功能尚未实现"_nv);
+	assert(m_CurrentSwitch && "default not in a switch statement");
+
+	const auto defaultBlock = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "switch.default");
+	EmitBlock(defaultBlock);
+
+	m_CurrentSwitch->setDefaultDest(defaultBlock);
+
+	Visit(stmt->GetSubStmt());
 }
 
+// 生成 llvm 的 switch 指令，由 llvm 根据 case 的分布选择跳转表、位测试或二分查找
+// 分支代码按源码顺序生成，以实现 fallthrough 语义
 void AotCompiler::AotStmtVisitor::VisitSwitchStmt(natRefPointer<Statement::SwitchStmt> const& stmt)
 {
-	nat_Throw(AotCompilerException, u8"此功能尚未实现"_nv);
+	EvaluateRValue(stmt->GetCond());
+	const auto condValue = m_LastVisitedValue;
+
+	const auto switchEnd = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "switch.end");
+
+	// 未匹配任何 case 时的目标，若存在 default 语句将会被替换
+	const auto switchInst = m_Compiler.m_IRBuilder.CreateSwitch(condValue, switchEnd);
+	m_Compiler.m_IRBuilder.ClearInsertionPoint();
+
+	const auto prevSwitch = m_CurrentSwitch;
+	m_CurrentSwitch = switchInst;
+
+	// switch 内的 continue 作用于外层的循环
+	auto continueDest = m_BreakContinueStack.empty() ? JumpDest{ nullptr, GetCleanupStackTop() } : m_BreakContinueStack.back().second;
+	m_BreakContinueStack.emplace_back(JumpDest{ switchEnd, GetCleanupStackTop(), true }, std::move(continueDest));
+
+	{
+		const auto body = stmt->GetBody();
+		LexicalScope scope{ *this, { body->GetStartLoc(), body->GetEndLoc() } };
+		if (body->GetType() == Statement::Stmt::CompoundStmtClass)
+		{
+			scope.SetAlreadyCleaned();
+		}
+		Visit(body);
+	}
+
+	m_BreakContinueStack.pop_back();
+	m_CurrentSwitch = prevSwitch;
+
+	EmitBlock(switchEnd, true);
 }
 
 void AotCompiler::AotStmtVisitor::VisitWhileStmt(natRefPointer<Statement::WhileStmt> const& stmt)
@@ -1400,6 +1703,59 @@ void AotCompiler::AotStmtVisitor::VisitNullPointerLiteral(natRefPointer<Expressi
 	setLastVisitedResult(llvm::Constant::getNullValue(llvm::PointerType::get(llvm::IntegerType::getInt8Ty(m_Compiler.m_LLVMContext), 0)));
 }
 
+void AotCompiler::AotStmtVisitor::Visit(Statement::StmtPtr const& stmt)
+{
+	if (!m_DebugScope)
+	{
+		StmtVisitor::Visit(stmt);
+		return;
+	}
+
+	// 子表达式的位置仅作用于其自身生成的指令，返回后恢复外层的位置
+	const auto outerLoc = m_Compiler.m_IRBuilder.getCurrentDebugLocation();
+	EmitDebugLocation(stmt->GetStartLoc());
+	StmtVisitor::Visit(stmt);
+	m_Compiler.m_IRBuilder.SetCurrentDebugLocation(outerLoc);
+}
+
+void AotCompiler::AotStmtVisitor::EmitDebugLocation(SourceLocation loc)
+{
+	if (!m_DebugScope)
+	{
+		return;
+	}
+
+	const auto [line, column] = m_Compiler.getLineAndColumn(loc);
+	if (line)
+	{
+		m_Compiler.m_IRBuilder.SetCurrentDebugLocation(llvm::DebugLoc::get(line, column, m_DebugScope));
+	}
+}
+
+void AotCompiler::AotStmtVisitor::EmitDebugVarDecl(natRefPointer<Declaration::VarDecl> const& decl, llvm::Value* storage, unsigned argNo)
+{
+	if (!m_DebugScope)
+	{
+		return;
+	}
+
+	const auto [line, column] = m_Compiler.getLineAndColumn(decl->GetLocation());
+	if (!line)
+	{
+		return;
+	}
+
+	const auto diBuilder = m_Compiler.m_DIBuilder.get();
+	const auto name = decl->GetName();
+	const llvm::StringRef nameRef{ name.data(), name.size() };
+	const auto type = m_Compiler.getDebugType(decl->GetValueType());
+
+	const auto var = argNo ?
+		diBuilder->createParameterVariable(m_DebugScope, nameRef, argNo, m_Compiler.m_DIFile, line, type) :
+		diBuilder->createAutoVariable(m_DebugScope, nameRef, m_Compiler.m_DIFile, line, type);
+	diBuilder->insertDeclare(storage, var, diBuilder->createExpression(), llvm::DebugLoc::get(line, column, m_DebugScope), m_Compiler.m_IRBuilder.GetInsertBlock());
+}
+
 void AotCompiler::AotStmtVisitor::StartVisit()
 {
 	const auto body = m_CurrentFunction->GetBody();
@@ -1991,6 +2347,7 @@ llvm::Value* AotCompiler::AotStmtVisitor::EmitAutoVarAlloc(natRefPointer<Declara
 	storage->setAlignment(static_cast<unsigned>(typeInfo.Align));
 
 	m_DeclMap.emplace(decl, storage);
+	EmitDebugVarDecl(decl, storage);
 
 	return storage;
 }
@@ -2097,7 +2454,8 @@ void AotCompiler::AotStmtVisitor::EmitAutoVarInit(Type::TypePtr const& varType,
 			}
 
 			// 构造函数返回类型永远是 void
-			m_Compiler.m_IRBuilder.CreateCall(constructorValue, args);
+			// 此时对象的析构函数尚未加入清理栈，构造函数抛出异常时不会析构未构造完成的对象
+			EmitCallOrInvoke(constructorValue, args);
 		}
 		else if (const auto stringLiteral = initializer.Cast<Expression::StringLiteral>())
 		{
@@ -2182,6 +2540,7 @@ void AotCompiler::AotStmtVisitor::EmitStaticVarDecl(natRefPointer<Declaration::V
 	nat_Throw(NotImplementedException);
 }
 
+// 析构函数被视为不会抛出异常，因此总是生成普通的 call 指令
 void AotCompiler::AotStmtVisitor::EmitDestructorCall(natRefPointer<Declaration::DestructorDecl> const& destructor, llvm::Value* addr)
 {
 	EmitFunctionAddr(destructor);
@@ -2189,6 +2548,83 @@ void AotCompiler::AotStmtVisitor::EmitDestructorCall(natRefPointer<Declaration::
 	m_Compiler.m_IRBuilder.CreateCall(func, addr);
 }
 
+llvm::CallSite AotCompiler::AotStmtVisitor::EmitCallOrInvoke(llvm::Value* callee, llvm::ArrayRef<llvm::Value*> args, llvm::Twine const& name)
+{
+	const auto invokeDest = getInvokeDest();
+	if (!invokeDest)
+	{
+		return m_Compiler.m_IRBuilder.CreateCall(callee, args, name);
+	}
+
+	const auto contBlock = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "invoke.cont");
+	const auto invokeInst = m_Compiler.m_IRBuilder.CreateInvoke(callee, contBlock, invokeDest, args, name);
+	EmitBlock(contBlock);
+
+	return invokeInst;
+}
+
+void AotCompiler::AotStmtVisitor::EmitUnwind(CleanupIterator const& begin)
+{
+	const auto innerTryScope = m_TryStack.empty() ? nullptr : &m_TryStack.back();
+	const auto end = innerTryScope ? innerTryScope->GetCleanupIterator() : m_CleanupStack.cend();
+	assert(CleanupEncloses(end, begin));
+
+	{
+		const auto scope = make_scope([this, oldValue = std::exchange(m_EmittingEHCleanup, true)]
+		{
+			m_EmittingEHCleanup = oldValue;
+		});
+
+		// 清理代码只执行不弹出，正常路径上的清理仍由所在的范围负责
+		for (auto iter = begin; iter != end; ++iter)
+		{
+			if ((*iter)->IsEHCleanup())
+			{
+				(*iter)->Emit(*this);
+			}
+		}
+	}
+
+	m_Compiler.m_IRBuilder.CreateBr(innerTryScope ? innerTryScope->GetDispatchBlock() : getResumeBlock());
+	m_Compiler.m_IRBuilder.ClearInsertionPoint();
+}
+
+void AotCompiler::AotStmtVisitor::EmitCatchHandler(natRefPointer<Statement::CatchStmt> const& catchStmt)
+{
+	LexicalScope scope{ *this, { catchStmt->GetStartLoc(), catchStmt->GetEndLoc() } };
+
+	const auto exception = m_Compiler.m_IRBuilder.CreateLoad(getExceptionSlot(), "exn");
+	const auto exceptionObject = m_Compiler.m_IRBuilder.CreateCall(m_Compiler.getEHRuntimeFunction(EHRuntimeFunction::BeginCatch), exception, "exn.obj");
+
+	// 无论正常离开还是由于异常离开处理器都需要结束捕获，此时若异常对象不再被引用将会被析构及释放
+	PushCleanupStack(make_ref<SpecialCleanup>([](AotStmtVisitor& visitor)
+	{
+		auto& compiler = visitor.GetCompiler();
+		if (compiler.m_IRBuilder.GetInsertBlock())
+		{
+			compiler.m_IRBuilder.CreateCall(compiler.getEHRuntimeFunction(EHRuntimeFunction::EndCatch));
+		}
+	}));
+
+	if (const auto exDecl = catchStmt->GetExceptionDecl())
+	{
+		// 异常对象的生存期覆盖整个处理器，因此直接将异常变量绑定到异常对象上而不进行复制
+		const auto valueType = m_Compiler.getCorrespondingType(Type::Type::GetUnderlyingType(exDecl->GetValueType()));
+		const auto varName = exDecl->GetName();
+		m_DeclMap.emplace(exDecl, m_Compiler.m_IRBuilder.CreateBitCast(exceptionObject, valueType->getPointerTo(), std::string(varName.cbegin(), varName.cend())));
+	}
+
+	const auto handlerBlock = catchStmt->GetHandlerBlcok();
+	if (const auto compoundStmt = handlerBlock.Cast<Statement::CompoundStmt>())
+	{
+		EmitCompoundStmtWithoutScope(compoundStmt);
+	}
+	else
+	{
+		Visit(handlerBlock);
+	}
+}
+
 void AotCompiler::AotStmtVisitor::EvaluateRValue(Expression::ExprPtr const& expr)
 {
 	assert(expr);
@@ -2421,10 +2857,12 @@ nBool AotCompiler::AotStmtVisitor::IsCleanupStackEmpty() const noexcept
 void AotCompiler::AotStmtVisitor::PushCleanupStack(natRefPointer<ICleanup> cleanup)
 {
 	m_CleanupStack.emplace_front(std::move(cleanup));
+	m_CachedLandingPad = nullptr;
 }
 
 AotCompiler::AotStmtVisitor::CleanupIterator AotCompiler::AotStmtVisitor::InsertCleanupStack(CleanupIterator const& pos, natRefPointer<ICleanup> cleanup)
 {
+	m_CachedLandingPad = nullptr;
 	return m_CleanupStack.emplace(pos, std::move(cleanup));
 }
 
@@ -2438,6 +2876,7 @@ void AotCompiler::AotStmtVisitor::PopCleanupStack(CleanupIterator const& iter, n
 		if (popStack)
 		{
 			i = m_CleanupStack.erase(i);
+			m_CachedLandingPad = nullptr;
 		}
 		else
 		{
@@ -2457,6 +2896,14 @@ bool AotCompiler::AotStmtVisitor::CleanupEncloses(CleanupIterator const& a, Clea
 	return b != m_CleanupStack.cend() && std::distance(m_CleanupStack.cbegin(), a) > std::distance(m_CleanupStack.cbegin(), b);
 }
 
+nBool AotCompiler::AotStmtVisitor::HasEHCleanup(CleanupIterator const& begin, CleanupIterator const& end) const noexcept
+{
+	return std::any_of(begin, end, [](natRefPointer<ICleanup> const& cleanup)
+	{
+		return cleanup->IsEHCleanup();
+	});
+}
+
 AotCompiler::AotStmtVisitor::LexicalScope* AotCompiler::AotStmtVisitor::LookupLexicalScopeAfter(CleanupIterator const& iter)
 {
 	auto cur = m_CurrentLexicalScope;
@@ -2474,94 +2921,307 @@ void AotCompiler::AotStmtVisitor::setLastVisitedResult(llvm::Value* lastVisitedV
 	m_LastVisitedDecl = std::move(lastVisitedDecl);
 }
 
-AotCompiler::AotCompiler(natRefPointer<TextReader<StringType::Utf8>> const& diagIdMapFile, natLog& logger)
-	: m_TargetTriple{ llvm::sys::getDefaultTargetTriple() }, m_TargetMachine{}, m_IRBuilder{ m_LLVMContext },
-	m_DiagConsumer{ make_ref<AotDiagConsumer>(*this) },
-	m_Diag{ make_ref<AotDiagIdMap>(diagIdMapFile), m_DiagConsumer },
-	m_Logger{ logger },
-	m_SourceManager{ m_Diag, m_FileManager },
-	m_Preprocessor{ m_Diag, m_SourceManager },
-	m_Consumer{ make_ref<AotAstConsumer>(*this) },
-	m_Sema{ m_Preprocessor, m_AstContext, m_Consumer },
-	m_Parser{ m_Preprocessor, m_Sema }
+llvm::BasicBlock* AotCompiler::AotStmtVisitor::getInvokeDest()
 {
-	llvm::InitializeAllTargetInfos();
-	llvm::InitializeAllTargets();
-	llvm::InitializeAllTargetMCs();
-	llvm::InitializeAllAsmParsers();
-	llvm::InitializeAllAsmPrinters();
-
-	std::string error;
-	const auto target = llvm::TargetRegistry::lookupTarget(m_TargetTriple, error);
-	if (!target)
+	// 未启用异常处理时假定异常不会穿过本函数，不生成着陆场，也不引用个性函数
+	// 展开时执行的清理代码中的调用不会再次进入着陆场，若此时抛出异常将由运行时终止程序
+	if (!m_Compiler.m_EnableExceptions || m_EmittingEHCleanup)
 	{
-		nat_Throw(AotCompilerException, u8"初始化错误：无法查找目标：{0}"_nv, error);
+		return nullptr;
 	}
 
-	const llvm::TargetOptions opt;
-	const llvm::Optional<llvm::Reloc::Model> RM{};
-
-	m_TargetMachine = target->createTargetMachine(m_TargetTriple, "generic", "", opt, RM, llvm::None, llvm::CodeGenOpt::Default);
+	// 既不会被捕获也无需清理的异常可以直接穿过本函数，此时生成普通的调用
+	if (m_TryStack.empty() && !HasEHCleanup(m_CleanupStack.cbegin(), m_CleanupStack.cend()))
+	{
+		return nullptr;
+	}
 
-	const auto dataLayout = m_TargetMachine->createDataLayout();
-	m_AstContext.SetTargetInfo(TargetInfo{ dataLayout.isBigEndian() ?
-		Environment::Endianness::BigEndian :
-		Environment::Endianness::LittleEndian,
-		dataLayout.getPointerSize(),
-		dataLayout.getPointerABIAlignment(0) });
-	m_AstContext.UseDefaultClassLayoutBuilder();
+	if (!m_CachedLandingPad)
+	{
+		m_CachedLandingPad = emitLandingPad();
+	}
 
-	prewarm();
+	return m_CachedLandingPad;
 }
 
-AotCompiler::~AotCompiler()
+llvm::BasicBlock* AotCompiler::AotStmtVisitor::emitLandingPad()
 {
-}
+	auto& irBuilder = m_Compiler.m_IRBuilder;
+	const auto scope = make_scope([this, insertPoint = irBuilder.saveIP(), lastVisitedValue = m_LastVisitedValue, lastVisitedDecl = m_LastVisitedDecl]
+	{
+		m_Compiler.m_IRBuilder.restoreIP(insertPoint);
+		setLastVisitedResult(lastVisitedValue, lastVisitedDecl);
+	});
 
-void AotCompiler::LoadMetadata(Linq<Valued<Uri>> const& metadata, nBool shouldCodeGen)
-{
-	auto& vfs = m_SourceManager.GetFileManager().GetVFS();
+	if (!m_CurrentFunctionValue->hasPersonalityFn())
+	{
+		m_CurrentFunctionValue->setPersonalityFn(m_Compiler.getEHRuntimeFunction(EHRuntimeFunction::Personality));
+	}
 
-	Serialization::Deserializer deserializer{ m_Parser };
+	const auto int8PtrType = llvm::Type::getInt8PtrTy(m_Compiler.m_LLVMContext);
+	const auto landingPadBlock = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "lpad", m_CurrentFunctionValue);
+	irBuilder.SetInsertPoint(landingPadBlock);
 
-	for (const auto& meta : metadata)
+	const auto landingPad = irBuilder.CreateLandingPad(llvm::StructType::get(int8PtrType, llvm::Type::getInt32Ty(m_Compiler.m_LLVMContext)), 0);
+
+	// 由内向外加入所有 try 语句的处理器，遇到捕获所有异常的处理器时外层的处理器不可能被执行
+	auto hasCatchAll = false;
+	for (auto iter = m_TryStack.crbegin(); iter != m_TryStack.crend() && !hasCatchAll; ++iter)
 	{
-		Metadata metadata;
-		const auto request = vfs.CreateRequest(meta);
-		if (!request)
+		for (const auto& handler : iter->GetHandlers())
 		{
-			nat_Throw(AotCompilerException, u8"无法创建对元数据文件 \"{0}\" 的请求", meta.GetUnderlyingString());
+			if (!handler.first)
+			{
+				landingPad->addClause(llvm::ConstantPointerNull::get(int8PtrType));
+				hasCatchAll = true;
+				break;
+			}
+
+			landingPad->addClause(llvm::ConstantExpr::getBitCast(handler.first, int8PtrType));
 		}
-		const auto response = request->GetResponse();
-		if (!response)
+	}
+
+	if (!hasCatchAll && HasEHCleanup(m_CleanupStack.cbegin(), m_CleanupStack.cend()))
+	{
+		landingPad->setCleanup(true);
+	}
+
+	irBuilder.CreateStore(irBuilder.CreateExtractValue(landingPad, 0), getExceptionSlot());
+	irBuilder.CreateStore(irBuilder.CreateExtractValue(landingPad, 1), getSelectorSlot());
+
+	EmitUnwind(GetCleanupStackTop());
+
+	return landingPadBlock;
+}
+
+llvm::BasicBlock* AotCompiler::AotStmtVisitor::getResumeBlock()
+{
+	if (m_ResumeBlock)
+	{
+		return m_ResumeBlock;
+	}
+
+	auto& irBuilder = m_Compiler.m_IRBuilder;
+	const auto scope = make_scope([&irBuilder, insertPoint = irBuilder.saveIP()]
+	{
+		irBuilder.restoreIP(insertPoint);
+	});
+
+	m_ResumeBlock = llvm::BasicBlock::Create(m_Compiler.m_LLVMContext, "eh.resume", m_CurrentFunctionValue);
+	irBuilder.SetInsertPoint(m_ResumeBlock);
+
+	const auto exception = irBuilder.CreateLoad(getExceptionSlot(), "exn");
+	const auto selector = irBuilder.CreateLoad(getSelectorSlot(), "sel");
+	const auto landingPadType = llvm::StructType::get(exception->getType(), selector->getType());
+	const auto landingPadValue = irBuilder.CreateInsertValue(irBuilder.CreateInsertValue(llvm::UndefValue::get(landingPadType), exception, 0), selector, 1);
+	irBuilder.CreateResume(landingPadValue);
+
+	return m_ResumeBlock;
+}
+
+llvm::Value* AotCompiler::AotStmtVisitor::getExceptionSlot()
+{
+	if (!m_ExceptionSlot)
+	{
+		llvm::IRBuilder<> entryIRBuilder{
+			&m_CurrentFunctionValue->getEntryBlock(), m_CurrentFunctionValue->getEntryBlock().begin()
+		};
+		m_ExceptionSlot = entryIRBuilder.CreateAlloca(llvm::Type::getInt8PtrTy(m_Compiler.m_LLVMContext), nullptr, "exn.slot");
+	}
+
+	return m_ExceptionSlot;
+}
+
+llvm::Value* AotCompiler::AotStmtVisitor::getSelectorSlot()
+{
+	if (!m_SelectorSlot)
+	{
+		llvm::IRBuilder<> entryIRBuilder{
+			&m_CurrentFunctionValue->getEntryBlock(), m_CurrentFunctionValue->getEntryBlock().begin()
+		};
+		m_SelectorSlot = entryIRBuilder.CreateAlloca(llvm::Type::getInt32Ty(m_Compiler.m_LLVMContext), nullptr, "ehselector.slot");
+	}
+
+	return m_SelectorSlot;
+}
+
+AotCompiler::AotCompiler(natRefPointer<TextReader<StringType::Utf8>> const& diagIdMapFile, natLog& logger)
+	: m_TargetTriple{ llvm::sys::getDefaultTargetTriple() }, m_TargetMachine{}, m_IRBuilder{ m_LLVMContext },
+	m_DiagConsumer{ make_ref<AotDiagConsumer>(*this) },
+	m_Diag{ make_ref<AotDiagIdMap>(diagIdMapFile), m_DiagConsumer },
+	m_Logger{ logger },
+	m_SourceManager{ m_Diag, m_FileManager },
+	m_Preprocessor{ m_Diag, m_SourceManager },
+	m_Consumer{ make_ref<AotAstConsumer>(*this) },
+	m_Sema{ m_Preprocessor, m_AstContext, m_Consumer },
+	m_Parser{ m_Preprocessor, m_Sema },
+	m_DICompileUnit{}, m_DIFile{},
+	m_EnableExceptions{ false }, m_SyntaxOnly{ false }
+{
+	llvm::InitializeAllTargetInfos();
+	llvm::InitializeAllTargets();
+	llvm::InitializeAllTargetMCs();
+	llvm::InitializeAllAsmParsers();
+	llvm::InitializeAllAsmPrinters();
+
+	std::string error;
+	const auto target = llvm::TargetRegistry::lookupTarget(m_TargetTriple, error);
+	if (!target)
+	{
+		nat_Throw(AotCompilerException, u8"初始化错误：无法查找目标：{0}"_nv, error);
+	}
+
+	const llvm::TargetOptions opt;
+	const llvm::Optional<llvm::Reloc::Model> RM{};
+
+	m_TargetMachine = target->createTargetMachine(m_TargetTriple, "generic", "", opt, RM, llvm::None, llvm::CodeGenOpt::Default);
+
+	const auto dataLayout = m_TargetMachine->createDataLayout();
+	m_AstContext.SetTargetInfo(TargetInfo{ dataLayout.isBigEndian() ?
+		Environment::Endianness::BigEndian :
+		Environment::Endianness::LittleEndian,
+		dataLayout.getPointerSize(),
+		dataLayout.getPointerABIAlignment(0) });
+	m_AstContext.UseDefaultClassLayoutBuilder();
+
+	prewarm();
+}
+
+AotCompiler::~AotCompiler()
+{
+}
+
+void AotCompiler::LoadMetadata(Linq<Valued<Uri>> const& metadata, nBool shouldCodeGen, nBool loadLazily)
+{
+	auto& vfs = m_SourceManager.GetFileManager().GetVFS();
+
+	const auto openMetadata = [&vfs](Uri const& meta)
+	{
+		const auto request = vfs.CreateRequest(meta);
+		if (!request)
+		{
+			nat_Throw(AotCompilerException, u8"无法创建对元数据文件 \"{0}\" 的请求", meta.GetUnderlyingString());
+		}
+		const auto response = request->GetResponse();
+		if (!response)
 		{
 			nat_Throw(AotCompilerException, u8"无法获得对元数据文件 \"{0}\" 的请求的响应", meta.GetUnderlyingString());
 		}
-		const auto metaStream = response->GetResponseStream();
+		auto metaStream = response->GetResponseStream();
 		if (!metaStream)
 		{
 			nat_Throw(AotCompilerException, u8"无法打开元数据文件 \"{0}\" 的流", meta.GetUnderlyingString());
 		}
 
-		auto reader = make_ref<Serialization::BinarySerializationArchiveReader>(make_ref<natBinaryReader>(metaStream, Environment::Endianness::LittleEndian));
+		return metaStream;
+	};
+
+	// 元数据包中的每个成员都作为独立的元数据加载
+	std::vector<std::pair<natRefPointer<natStream>, Serialization::BinaryMetadataBundleMember>> metaStreams;
+	for (const auto& meta : metadata)
+	{
+		auto metaStream = openMetadata(meta);
+		const auto members = Serialization::ReadBinaryMetadataBundle(*metaStream);
+		if (!members)
+		{
+			metaStreams.emplace_back(std::move(metaStream), Serialization::BinaryMetadataBundleMember{ 0, std::numeric_limits<nLen>::max() });
+			continue;
+		}
+
+		for (std::size_t i = 0; i < members->size(); ++i)
+		{
+			// 各成员可能在不同的线程中被读取，因此不能共享同一个流
+			metaStreams.emplace_back(i == 0 ? metaStream : openMetadata(meta), (*members)[i]);
+		}
+	}
+
+	// 各元数据文件的读取、解压及表的解析互不相关，可以并行进行，之后的反序列化需要访问 Sema，仍然按顺序在当前线程进行
+	std::vector<natRefPointer<Serialization::BinarySerializationArchiveReader>> readers(metaStreams.size());
+	std::vector<std::exception_ptr> exceptions(metaStreams.size());
+	std::atomic<std::size_t> nextIndex{};
+	const auto decodeArchives = [&]
+	{
+		for (auto i = nextIndex++; i < metaStreams.size(); i = nextIndex++)
+		{
+			try
+			{
+				const auto& [metaStream, member] = metaStreams[i];
+				auto reader = make_ref<Serialization::BinarySerializationArchiveReader>(make_ref<natBinaryReader>(metaStream, Environment::Endianness::LittleEndian), member.Offset, member.Size);
+				if (!loadLazily)
+				{
+					// 立即加载时将会读取所有内容，提前读入内存以免反序列化时访问流
+					reader->Preload();
+				}
+				readers[i] = std::move(reader);
+			}
+			catch (...)
+			{
+				exceptions[i] = std::current_exception();
+			}
+		}
+	};
+
+	const auto threadCount = std::min<std::size_t>(metaStreams.size(), std::max(std::thread::hardware_concurrency(), 1u));
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+	for (std::size_t i = 1; i < threadCount; ++i)
+	{
+		threads.emplace_back(decodeArchives);
+	}
+	decodeArchives();
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	Serialization::Deserializer deserializer{ m_Parser };
+
+	for (std::size_t i = 0; i < readers.size(); ++i)
+	{
+		if (exceptions[i])
+		{
+			std::rethrow_exception(exceptions[i]);
+		}
+
+		auto& reader = readers[i];
+		if (loadLazily)
+		{
+			// 声明将在首次被查找时才从元数据中加载
+			m_Sema.AddExternalDeclSource(make_ref<Serialization::LazyMetadataSource>(m_Parser, std::move(reader), shouldCodeGen));
+			continue;
+		}
+
 		const auto size = deserializer.StartDeserialize(std::move(reader));
 		std::vector<ASTNodePtr> ast;
 		ast.reserve(size);
-		for (std::size_t i = 0; i < size; ++i)
+		for (std::size_t j = 0; j < size; ++j)
 		{
 			ast.emplace_back(deserializer.Deserialize());
 		}
 		deserializer.EndDeserialize();
+		Metadata metadata;
 		metadata.AddDecls(ast);
 		m_Sema.LoadMetadata(metadata, shouldCodeGen);
 	}
+
+	// 所有元数据均已加载，仍未回填的引用不会再有机会被解析
+	deserializer.Finish();
 }
 
-void AotCompiler::CreateMetadata(natRefPointer<natStream> const& metadataStream, nBool includeImported)
+void AotCompiler::CreateMetadata(natRefPointer<natStream> const& metadataStream, nBool includeImported, Serialization::BinaryMetadataFlags flags)
 {
-	assert(metadataStream && metadataStream->CanWrite() && metadataStream->CanSeek());
+	assert(metadataStream && metadataStream->CanWrite());
+
+	// 元数据将包含函数体，因此需要分析所有被延迟的函数体
+	m_Parser.ResolveAllFunctionBodies();
+
+	if (includeImported)
+	{
+		// 包含导入的声明时需要先加载所有尚未被使用的声明
+		m_Sema.LoadAllExternalDecls();
+	}
 
-	auto writer = make_ref<Serialization::BinarySerializationArchiveWriter>(make_ref<natBinaryWriter>(metadataStream, Environment::Endianness::LittleEndian));
+	auto writer = make_ref<Serialization::BinarySerializationArchiveWriter>(make_ref<natBinaryWriter>(metadataStream, Environment::Endianness::LittleEndian), flags);
 	Serialization::Serializer serializer{ m_Sema };
 	serializer.StartSerialize(std::move(writer));
 	//const auto metadata = m_Sema.CreateMetadata(includeImported);
@@ -2579,54 +3239,293 @@ void AotCompiler::CreateMetadata(natRefPointer<natStream> const& metadataStream,
 	serializer.EndSerialize();
 }
 
-void AotCompiler::Compile(Uri const& uri, Linq<Valued<Uri>> const& metadata, llvm::raw_pwrite_stream& objectStream)
+void AotCompiler::Compile(Uri const& uri, Linq<Valued<Uri>> const& metadata, llvm::raw_pwrite_stream& objectStream, CompileOptions const& options, llvm::raw_ostream* bitcodeStream)
 {
-	m_Module = std::make_unique<llvm::Module>(llvm::StringRef(uri.GetPath().begin(), uri.GetPath().size()), m_LLVMContext);
+	const llvm::StringRef path{ uri.GetPath().begin(), uri.GetPath().size() };
+	m_Module = std::make_unique<llvm::Module>(path, m_LLVMContext);
 	m_Module->setTargetTriple(m_TargetTriple);
 	m_Module->setDataLayout(m_TargetMachine->createDataLayout());
 
-	LoadMetadata(metadata);
+	const auto debugInfoScope = make_scope([this]
+	{
+		m_DebugTypeMap.clear();
+		m_DebugLoweredTypes.clear();
+		m_DIFile = nullptr;
+		m_DICompileUnit = nullptr;
+		m_DIBuilder.reset();
+		m_EnableExceptions = false;
+	});
 
-	const auto fileId = m_SourceManager.GetFileID(uri);
-	const auto [succeed, content] = m_SourceManager.GetFileContent(fileId);
-	if (!succeed)
+	m_EnableExceptions = options.EnableExceptions;
+
+	if (options.EmitDebugInfo)
 	{
-		nat_Throw(AotCompilerException, u8"无法取得文件 \"{0}\" 的内容"_nv, uri.GetUnderlyingString());
+		m_DIBuilder = std::make_unique<llvm::DIBuilder>(*m_Module);
+		m_DIFile = m_DIBuilder->createFile(llvm::sys::path::filename(path), llvm::sys::path::parent_path(path));
+		// NatsuLang 没有对应的 DWARF 语言代码，使用 C++ 以便调试器按 C++ 的方式显示类型及名称
+		m_DICompileUnit = m_DIBuilder->createCompileUnit(llvm::dwarf::DW_LANG_C_plus_plus, m_DIFile,
+			std::string("Aki ") + AotCompilerVersion, options.OptLevel > 0, "", 0);
+
+		m_Module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+		if (llvm::Triple{ m_TargetTriple }.isKnownWindowsMSVCEnvironment())
+		{
+			m_Module->addModuleFlag(llvm::Module::Warning, "CodeView", 1);
+		}
+		else
+		{
+			m_Module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+		}
 	}
 
-	auto lexer = make_ref<Lex::Lexer>(fileId, content, m_Preprocessor);
-	m_Preprocessor.SetLexer(std::move(lexer));
-	m_Parser.ConsumeToken();
-	ParseAST(m_Parser);
-	if (m_DiagConsumer->IsErrored() || (EndParsingAST(m_Parser), m_DiagConsumer->IsErrored()))
+	LoadMetadata(metadata);
+
+	if (!parseSourceFile(uri))
 	{
 		m_Logger.LogErr(u8"编译文件 \"{0}\" 失败"_nv, uri.GetUnderlyingString());
 		return;
 	}
 
+	if (m_DIBuilder)
+	{
+		m_DIBuilder->finalize();
+	}
+
 	std::string buffer;
 	llvm::raw_string_ostream os{ buffer };
 	m_Module->print(os, nullptr);
 	m_Logger.LogMsg(u8"编译成功，生成的 IR:\n{0}"_nv, buffer);
 
+	const auto shouldOptimize = options.OptLevel || options.Profile != ProfileMode::None;
+
+	if (bitcodeStream)
+	{
+		// bitcode 由未优化的模块的副本生成，仅进行链接前的优化，目标文件仍由原模块进行完整的优化，不受影响
+#if LLVM_VERSION_MAJOR == 6
+		const auto bitcodeModule = llvm::CloneModule(m_Module.get());
+#elif LLVM_VERSION_MAJOR == 7 || LLVM_VERSION_MAJOR == 8
+		const auto bitcodeModule = llvm::CloneModule(*m_Module);
+#else
+#error "unsupported LLVM version"
+#endif
+
+		if (shouldOptimize)
+		{
+			optimizeModule(*bitcodeModule, options, true);
+		}
+
+#if LLVM_VERSION_MAJOR == 6
+		llvm::WriteBitcodeToFile(bitcodeModule.get(), *bitcodeStream);
+#elif LLVM_VERSION_MAJOR == 7 || LLVM_VERSION_MAJOR == 8
+		llvm::WriteBitcodeToFile(*bitcodeModule, *bitcodeStream);
+#else
+#error "unsupported LLVM version"
+#endif
+		bitcodeStream->flush();
+	}
+
+	if (shouldOptimize)
+	{
+		optimizeModule(*m_Module, options, false);
+	}
+
+	emitObjectFile(objectStream);
+
+	m_Module.reset();
+}
+
+nBool AotCompiler::LinkModules(Linq<Valued<Uri>> const& bitcodeFiles, Linq<Valued<Uri>> const& metadata, Linq<Valued<nString>> const& exportedSymbols, llvm::raw_pwrite_stream& objectStream, CompileOptions const& options)
+{
+	m_Module = std::make_unique<llvm::Module>("LinkedModule", m_LLVMContext);
+	m_Module->setTargetTriple(m_TargetTriple);
+	m_Module->setDataLayout(m_TargetMachine->createDataLayout());
+
+	const auto moduleScope = make_scope([this]
+	{
+		m_Module.reset();
+	});
+
+	llvm::Linker linker{ *m_Module };
+	for (const auto& uri : bitcodeFiles)
+	{
+		const auto path = uri.GetPath();
+		llvm::SMDiagnostic diag;
+		auto module = llvm::parseIRFile(llvm::StringRef{ path.begin(), path.size() }, diag, m_LLVMContext);
+		if (!module)
+		{
+			m_Logger.LogErr(u8"无法读取 bitcode 文件 \"{0}\"，错误为：{1}"_nv, uri.GetUnderlyingString(), diag.getMessage().str());
+			return false;
+		}
+
+		// 具体的错误信息由 LLVM 报告
+		if (linker.linkInModule(std::move(module)))
+		{
+			m_Logger.LogErr(u8"链接 bitcode 文件 \"{0}\" 失败"_nv, uri.GetUnderlyingString());
+			return false;
+		}
+	}
+
+	// 元数据中导出的声明可能被其他模块引用，对应的符号必须保留
+	LoadMetadata(metadata, false, false);
+	llvm::StringSet<> exported;
+	CollectSymbolNames(m_AstContext.GetTranslationUnit().Get(), exported);
+	if (exported.empty())
+	{
+		m_Logger.LogWarn(u8"未导入任何导出声明的元数据，除额外指定的符号外所有符号都将被内部化"_nv);
+	}
+
+	for (const auto& symbol : exportedSymbols)
+	{
+		exported.insert(llvm::StringRef{ symbol.data(), symbol.size() });
+	}
+
+	// 所有模块均已合并，未导出的符号不会再被引用，内部化之后即可在全程序范围内内联或移除
+	llvm::internalizeModule(*m_Module, [&exported](llvm::GlobalValue const& value)
+	{
+		return exported.count(value.getName()) != 0;
+	});
+
+	llvm::PassManagerBuilder builder;
+	populatePassManagerBuilder(builder, options.OptLevel ? std::min<nuInt>(options.OptLevel, 3) : 2);
+
+	llvm::legacy::PassManager passManager;
+	passManager.add(llvm::createTargetTransformInfoWrapperPass(m_TargetMachine->getTargetIRAnalysis()));
+	builder.populateLTOPassManager(passManager);
+	passManager.run(*m_Module);
+
+	emitObjectFile(objectStream);
+
+	return true;
+}
+
+nBool AotCompiler::IsErrored() const noexcept
+{
+	return m_DiagConsumer->IsErrored();
+}
+
+std::string const& AotCompiler::GetTargetTriple() const noexcept
+{
+	return m_TargetTriple;
+}
+
+nBool AotCompiler::CheckSyntax(Uri const& uri, Linq<Valued<Uri>> const& metadata)
+{
+	m_SyntaxOnly = true;
+	const auto syntaxOnlyScope = make_scope([this]
+	{
+		m_SyntaxOnly = false;
+	});
+
+	LoadMetadata(metadata, false);
+
+	if (!parseSourceFile(uri) || (m_Parser.ResolveAllFunctionBodies(), m_DiagConsumer->IsErrored()))
+	{
+		m_Logger.LogErr(u8"检查文件 \"{0}\" 失败"_nv, uri.GetUnderlyingString());
+		return false;
+	}
+
+	m_Logger.LogMsg(u8"文件 \"{0}\" 检查通过"_nv, uri.GetUnderlyingString());
+	return true;
+}
+
+void AotCompiler::populatePassManagerBuilder(llvm::PassManagerBuilder& builder, nuInt optLevel)
+{
+	builder.OptLevel = optLevel;
+	builder.SizeLevel = 0;
+	// builder 负责释放 Inliner 及 LibraryInfo
+	builder.Inliner = llvm::createFunctionInliningPass(optLevel, 0, false);
+	builder.LibraryInfo = new llvm::TargetLibraryInfoImpl(llvm::Triple{ m_TargetTriple });
+	builder.LoopVectorize = optLevel > 1;
+	builder.SLPVectorize = optLevel > 1;
+	m_TargetMachine->adjustPassManager(builder);
+}
+
+void AotCompiler::optimizeModule(llvm::Module& module, CompileOptions const& options, nBool prepareForLTO)
+{
+	// PassManagerBuilder 在优化等级为 0 时不会添加剖析相关的 Pass，因此使用剖析时至少进行 1 级优化
+	const auto optLevel = std::min<nuInt>(options.Profile == ProfileMode::None ? options.OptLevel : std::max<nuInt>(options.OptLevel, 1), 3);
+
+	llvm::PassManagerBuilder builder;
+	populatePassManagerBuilder(builder, optLevel);
+	// 链接时将再次进行优化，此处跳过向量化等会妨碍跨模块优化的变换
+	builder.PrepareForLTO = prepareForLTO;
+
+	const std::string profilePath{ options.ProfilePath.cbegin(), options.ProfilePath.cend() };
+	switch (options.Profile)
+	{
+	case ProfileMode::Instrument:
+		builder.EnablePGOInstrGen = true;
+		builder.PGOInstrGen = profilePath;
+		break;
+	case ProfileMode::Use:
+		// 剖析数据无法读取时 LLVM 将直接终止程序，因此预先检查
+		if (!llvm::sys::fs::exists(profilePath))
+		{
+			nat_Throw(AotCompilerException, u8"无法找到剖析数据文件 \"{0}\""_nv, options.ProfilePath);
+		}
+		builder.PGOInstrUse = profilePath;
+		break;
+	case ProfileMode::None:
+	default:
+		break;
+	}
+
+	llvm::legacy::FunctionPassManager functionPassManager{ &module };
+	llvm::legacy::PassManager modulePassManager;
+	functionPassManager.add(llvm::createTargetTransformInfoWrapperPass(m_TargetMachine->getTargetIRAnalysis()));
+	modulePassManager.add(llvm::createTargetTransformInfoWrapperPass(m_TargetMachine->getTargetIRAnalysis()));
+
+	builder.populateFunctionPassManager(functionPassManager);
+	builder.populateModulePassManager(modulePassManager);
+
+	functionPassManager.doInitialization();
+	for (auto& function : module)
+	{
+		functionPassManager.run(function);
+	}
+	functionPassManager.doFinalization();
+
+	modulePassManager.run(module);
+}
+
+void AotCompiler::emitObjectFile(llvm::raw_pwrite_stream& objectStream)
+{
 	llvm::legacy::PassManager passManager;
 #if LLVM_VERSION_MAJOR == 6
 	m_TargetMachine->addPassesToEmitFile(passManager, objectStream, llvm::TargetMachine::CGFT_ObjectFile);
 #elif LLVM_VERSION_MAJOR == 7 || LLVM_VERSION_MAJOR == 8
 	m_TargetMachine->addPassesToEmitFile(passManager, objectStream, nullptr, llvm::TargetMachine::CGFT_ObjectFile);
 #else
-#error TODO
+#error "unsupported LLVM version"
 #endif
 	passManager.run(*m_Module);
 	objectStream.flush();
+}
 
-	m_Module.reset();
+nBool AotCompiler::parseSourceFile(Uri const& uri)
+{
+	const auto fileId = m_SourceManager.GetFileID(uri);
+	const auto [succeed, content] = m_SourceManager.GetFileContent(fileId);
+	if (!succeed)
+	{
+		nat_Throw(AotCompilerException, u8"无法取得文件 \"{0}\" 的内容"_nv, uri.GetUnderlyingString());
+	}
+
+	auto lexer = make_ref<Lex::Lexer>(fileId, content, m_Preprocessor);
+	m_Preprocessor.SetLexer(std::move(lexer));
+	m_Parser.ConsumeToken();
+	ParseAST(m_Parser);
+	return !m_DiagConsumer->IsErrored() && (EndParsingAST(m_Parser), !m_DiagConsumer->IsErrored());
 }
 
 AotCompiler::AotStmtVisitor::ICleanup::~ICleanup()
 {
 }
 
+nBool AotCompiler::AotStmtVisitor::ICleanup::IsEHCleanup() const noexcept
+{
+	return true;
+}
+
 AotCompiler::AotStmtVisitor::DestructorCleanup::DestructorCleanup(natRefPointer<Declaration::DestructorDecl> destructor, llvm::Value* addr)
 	: m_Destructor{ std::move(destructor) }, m_Addr{ addr }
 {
@@ -2697,6 +3596,12 @@ void AotCompiler::AotStmtVisitor::AnchorCleanup::Emit(AotStmtVisitor& visitor)
 	visitor.EmitBlock(m_Block);
 }
 
+// 锚点仅用于连接正常路径上的清理代码
+nBool AotCompiler::AotStmtVisitor::AnchorCleanup::IsEHCleanup() const noexcept
+{
+	return false;
+}
+
 llvm::BasicBlock* AotCompiler::AotStmtVisitor::AnchorCleanup::GetBlock() const noexcept
 {
 	return m_Block;
@@ -2870,16 +3775,117 @@ llvm::GlobalVariable* AotCompiler::getStringLiteralValue(nStrView literalContent
 	return iter->second;
 }
 
-llvm::Type* AotCompiler::getCorrespondingType(Type::TypePtr const& type)
+// 异常处理依赖于 Itanium C++ ABI 的运行时（libsupc++ 或 libc++abi），链接时需要提供
+llvm::Constant* AotCompiler::getEHRuntimeFunction(EHRuntimeFunction func)
+{
+	const auto voidType = llvm::Type::getVoidTy(m_LLVMContext);
+	const auto int8PtrType = llvm::Type::getInt8PtrTy(m_LLVMContext);
+
+	llvm::Constant* result;
+	switch (func)
+	{
+	case EHRuntimeFunction::AllocateException:
+		// void* __cxa_allocate_exception(std::size_t thrown_size)
+		result = m_Module->getOrInsertFunction("__cxa_allocate_exception", llvm::FunctionType::get(int8PtrType, { m_Module->getDataLayout().getIntPtrType(m_LLVMContext) }, false));
+		if (const auto function = llvm::dyn_cast<llvm::Function>(result))
+		{
+			function->setDoesNotThrow();
+		}
+		break;
+	case EHRuntimeFunction::Throw:
+		// void __cxa_throw(void* thrown_exception, std::type_info* tinfo, void (*dest)(void*))
+		result = m_Module->getOrInsertFunction("__cxa_throw", llvm::FunctionType::get(voidType, { int8PtrType, int8PtrType, int8PtrType }, false));
+		if (const auto function = llvm::dyn_cast<llvm::Function>(result))
+		{
+			function->setDoesNotReturn();
+		}
+		break;
+	case EHRuntimeFunction::Rethrow:
+		// void __cxa_rethrow()
+		result = m_Module->getOrInsertFunction("__cxa_rethrow", llvm::FunctionType::get(voidType, false));
+		if (const auto function = llvm::dyn_cast<llvm::Function>(result))
+		{
+			function->setDoesNotReturn();
+		}
+		break;
+	case EHRuntimeFunction::BeginCatch:
+		// void* __cxa_begin_catch(void* exceptionObject)
+		result = m_Module->getOrInsertFunction("__cxa_begin_catch", llvm::FunctionType::get(int8PtrType, { int8PtrType }, false));
+		if (const auto function = llvm::dyn_cast<llvm::Function>(result))
+		{
+			function->setDoesNotThrow();
+		}
+		break;
+	case EHRuntimeFunction::EndCatch:
+		// void __cxa_end_catch()
+		result = m_Module->getOrInsertFunction("__cxa_end_catch", llvm::FunctionType::get(voidType, false));
+		break;
+	case EHRuntimeFunction::Personality:
+		result = m_Module->getOrInsertFunction("__gxx_personality_v0", llvm::FunctionType::get(llvm::Type::getInt32Ty(m_LLVMContext), true));
+		break;
+	case EHRuntimeFunction::TypeIdFor:
+		result = llvm::Intrinsic::getDeclaration(m_Module.get(), llvm::Intrinsic::eh_typeid_for);
+		break;
+	default:
+		assert(!"Invalid EHRuntimeFunction");
+		nat_Throw(AotCompilerException, u8"无效的异常处理运行时函数"_nv);
+	}
+
+	return result;
+}
+
+// 类型信息的布局与 C++ 的 __cxxabiv1::__class_type_info 一致，由 C++ 运行时按类型信息是否相同进行匹配
+// 类型信息以 linkonce_odr 链接，不同模块中对同一类型生成的类型信息将在链接时合并
+llvm::Constant* AotCompiler::getTypeInfo(Type::TypePtr const& type)
 {
 	const auto underlyingType = Type::Type::GetUnderlyingType(type);
 
-	const auto iter = m_TypeMap.find(underlyingType);
-	if (iter != m_TypeMap.cend())
+	const auto iter = m_TypeInfoMap.find(underlyingType);
+	if (iter != m_TypeInfoMap.cend())
+	{
+		return iter->second;
+	}
+
+	const auto int8PtrType = llvm::Type::getInt8PtrTy(m_LLVMContext);
+	const auto typeName = m_Sema.GetTypeName(underlyingType);
+	const std::string typeNameStr(typeName.cbegin(), typeName.cend());
+
+	const auto nameValue = llvm::ConstantDataArray::getString(m_LLVMContext, typeNameStr);
+	const auto nameGlobal = new llvm::GlobalVariable(*m_Module, nameValue->getType(), true, llvm::GlobalValue::LinkOnceODRLinkage, nameValue, "NatsuLang.TypeName." + typeNameStr);
+
+	// 虚表的前两项为 offset-to-top 及 RTTI 指针，类型信息中的虚表指针指向其后
+	const auto vtable = m_Module->getOrInsertGlobal("_ZTVN10__cxxabiv117__class_type_infoE", int8PtrType);
+	const auto vtablePtr = llvm::ConstantExpr::getBitCast(llvm::ConstantExpr::getInBoundsGetElementPtr(int8PtrType, vtable,
+		llvm::ConstantInt::get(llvm::Type::getInt64Ty(m_LLVMContext), 2)), int8PtrType);
+
+	const auto typeInfoValue = llvm::ConstantStruct::getAnon({ vtablePtr, llvm::ConstantExpr::getBitCast(nameGlobal, int8PtrType) });
+	const auto typeInfoGlobal = new llvm::GlobalVariable(*m_Module, typeInfoValue->getType(), true, llvm::GlobalValue::LinkOnceODRLinkage, typeInfoValue, "NatsuLang.TypeInfo." + typeNameStr);
+
+	m_TypeInfoMap.emplace(underlyingType, typeInfoGlobal);
+
+	return typeInfoGlobal;
+}
+
+// 同一类型仅转换一次，类型的别名也会被缓存
+llvm::Type* AotCompiler::getCorrespondingType(Type::TypePtr const& type)
+{
+	if (const auto iter = m_TypeMap.find(type.Get()); iter != m_TypeMap.end())
 	{
 		return iter->second;
 	}
 
+	const auto underlyingType = Type::Type::GetUnderlyingType(type);
+
+	if (underlyingType.Get() != type.Get())
+	{
+		if (const auto iter = m_TypeMap.find(underlyingType.Get()); iter != m_TypeMap.end())
+		{
+			const auto ret = iter->second;
+			cacheCorrespondingType(type, ret);
+			return ret;
+		}
+	}
+
 	llvm::Type* ret;
 	const auto typeClass = underlyingType->GetType();
 
@@ -2955,9 +3961,12 @@ llvm::Type* AotCompiler::getCorrespondingType(Type::TypePtr const& type)
 		break;
 	}
 	case Type::Type::Class:
-		return getCorrespondingType(underlyingType.UnsafeCast<Type::ClassType>()->GetDecl());
+		// 类的结构体类型会先于其字段被声明，因此递归引用自身的类不会导致无限递归
+		ret = getCorrespondingType(underlyingType.UnsafeCast<Type::ClassType>()->GetDecl());
+		break;
 	case Type::Type::Enum:
-		return getCorrespondingType(underlyingType.UnsafeCast<Type::EnumType>()->GetDecl().UnsafeCast<Declaration::EnumDecl>()->GetUnderlyingType());
+		ret = getCorrespondingType(underlyingType.UnsafeCast<Type::EnumType>()->GetDecl().UnsafeCast<Declaration::EnumDecl>()->GetUnderlyingType());
+		break;
 	default:
 		assert(!"Invalid type");
 		[[fallthrough]];
@@ -2967,14 +3976,18 @@ llvm::Type* AotCompiler::getCorrespondingType(Type::TypePtr const& type)
 		nat_Throw(AotCompilerException, u8"错误的类型"_nv);
 	}
 
-	m_TypeMap.emplace(type, ret);
+	cacheCorrespondingType(underlyingType, ret);
+	if (underlyingType.Get() != type.Get())
+	{
+		cacheCorrespondingType(type, ret);
+	}
+
 	return ret;
 }
 
 llvm::Type* AotCompiler::getCorrespondingType(Declaration::DeclPtr const& decl)
 {
-	const auto iter = m_DeclTypeMap.find(decl);
-	if (iter != m_DeclTypeMap.cend())
+	if (const auto iter = m_DeclTypeMap.find(decl.Get()); iter != m_DeclTypeMap.end())
 	{
 		return iter->second;
 	}
@@ -3015,10 +4028,26 @@ llvm::Type* AotCompiler::getCorrespondingType(Declaration::DeclPtr const& decl)
 		nat_Throw(AotCompilerException, u8"不能为此声明确定类型"_nv);
 	}
 
-	m_DeclTypeMap.emplace(decl, ret);
+	cacheCorrespondingType(decl, ret);
 	return ret;
 }
 
+void AotCompiler::cacheCorrespondingType(Type::TypePtr const& type, llvm::Type* llvmType)
+{
+	if (m_TypeMap.try_emplace(type.Get(), llvmType).second)
+	{
+		m_LoweredTypes.emplace_back(type);
+	}
+}
+
+void AotCompiler::cacheCorrespondingType(Declaration::DeclPtr const& decl, llvm::Type* llvmType)
+{
+	if (m_DeclTypeMap.try_emplace(decl.Get(), llvmType).second)
+	{
+		m_LoweredDecls.emplace_back(decl);
+	}
+}
+
 llvm::Type* AotCompiler::buildFunctionType(Type::TypePtr const& resultType, Linq<Valued<Type::TypePtr>> const& params, nBool hasVarArg)
 {
 	const auto args{ params.select([this](Type::TypePtr const& paramType)
@@ -3058,7 +4087,7 @@ llvm::Type* AotCompiler::buildClassType(natRefPointer<Declaration::ClassDecl> co
 {
 	const auto className = classDecl->GetName();
 	const auto structType = llvm::StructType::create(m_LLVMContext, llvm::StringRef{ className.data(), className.size() });
-	m_DeclTypeMap.emplace(classDecl, structType);
+	cacheCorrespondingType(classDecl, structType);
 
 	const auto& classLayout = m_AstContext.GetClassLayout(classDecl);
 	std::vector<llvm::Type*> fieldTypes(classLayout.FieldOffsets.size());
@@ -3079,10 +4108,224 @@ llvm::Type* AotCompiler::buildClassType(natRefPointer<Declaration::ClassDecl> co
 		}
 	}
 
-	structType->setBody(fieldTypes);
+	// padding 已显式插入，紧凑布局的类不能再由 LLVM 按自然对齐插入 padding
+	structType->setBody(fieldTypes, classLayout.Policy == ClassLayoutPolicy::Packed);
 	return structType;
 }
 
+std::pair<unsigned, unsigned> AotCompiler::getLineAndColumn(SourceLocation loc) const noexcept
+{
+	const auto lexer = m_Preprocessor.GetLexer();
+	if (!lexer)
+	{
+		return {};
+	}
+
+	// 词法分析器的行号从 0 开始，调试信息的行号及列号从 1 开始，0 表示未知
+	const auto [line, range] = lexer->GetLine(loc);
+	if (!range.IsValid())
+	{
+		return {};
+	}
+
+	return { static_cast<unsigned>(line + 1), static_cast<unsigned>(loc.GetPos() - range.GetBegin().GetPos() + 1) };
+}
+
+llvm::DIType* AotCompiler::getDebugType(Type::TypePtr const& type)
+{
+	assert(m_DIBuilder);
+
+	const auto underlyingType = Type::Type::GetUnderlyingType(type);
+	if (const auto iter = m_DebugTypeMap.find(underlyingType.Get()); iter != m_DebugTypeMap.end())
+	{
+		return iter->second;
+	}
+
+	llvm::DIType* ret;
+
+	switch (underlyingType->GetType())
+	{
+	case Type::Type::Builtin:
+	{
+		const auto builtinType = underlyingType.UnsafeCast<Type::BuiltinType>();
+		const auto builtinClass = builtinType->GetBuiltinClass();
+		if (builtinClass == Type::BuiltinType::Void)
+		{
+			// void 以空类型表示
+			ret = nullptr;
+			break;
+		}
+
+		if (builtinClass == Type::BuiltinType::Null)
+		{
+			ret = m_DIBuilder->createNullPtrType();
+			break;
+		}
+
+		unsigned encoding;
+		if (builtinClass == Type::BuiltinType::Bool)
+		{
+			encoding = llvm::dwarf::DW_ATE_boolean;
+		}
+		else if (builtinClass == Type::BuiltinType::Char)
+		{
+			encoding = llvm::dwarf::DW_ATE_unsigned_char;
+		}
+		else if (builtinType->IsFloatingType())
+		{
+			encoding = llvm::dwarf::DW_ATE_float;
+		}
+		else
+		{
+			encoding = builtinType->IsSigned() ? llvm::dwarf::DW_ATE_signed : llvm::dwarf::DW_ATE_unsigned;
+		}
+
+		ret = m_DIBuilder->createBasicType(builtinType->GetName(), static_cast<std::uint64_t>(m_AstContext.GetTypeInfo(builtinType).Size * 8), encoding);
+		break;
+	}
+	case Type::Type::Pointer:
+	{
+		const auto pointeeType = underlyingType.UnsafeCast<Type::PointerType>()->GetPointeeType();
+		ret = m_DIBuilder->createPointerType(getDebugType(pointeeType), static_cast<std::uint64_t>(m_AstContext.GetTypeInfo(underlyingType).Size * 8));
+		break;
+	}
+	case Type::Type::Array:
+	{
+		const auto arrayType = underlyingType.UnsafeCast<Type::ArrayType>();
+		const auto typeInfo = m_AstContext.GetTypeInfo(arrayType);
+		llvm::Metadata* const subscripts[] = { m_DIBuilder->getOrCreateSubrange(0, static_cast<std::int64_t>(arrayType->GetSize())) };
+		ret = m_DIBuilder->createArrayType(static_cast<std::uint64_t>(typeInfo.Size * 8), static_cast<std::uint32_t>(typeInfo.Align * 8),
+			getDebugType(arrayType->GetElementType()), m_DIBuilder->getOrCreateArray(subscripts));
+		break;
+	}
+	case Type::Type::Function:
+	{
+		const auto functionType = underlyingType.UnsafeCast<Type::FunctionType>();
+		std::vector<llvm::Metadata*> types{ getDebugType(functionType->GetResultType()) };
+		for (const auto& paramType : functionType->GetParameterTypes())
+		{
+			types.emplace_back(getDebugType(paramType));
+		}
+
+		ret = m_DIBuilder->createSubroutineType(m_DIBuilder->getOrCreateTypeArray(types));
+		break;
+	}
+	case Type::Type::Class:
+		// 由 buildDebugClassType 负责缓存
+		return buildDebugClassType(underlyingType.UnsafeCast<Type::ClassType>());
+	case Type::Type::Enum:
+	{
+		const auto enumDecl = underlyingType.UnsafeCast<Type::EnumType>()->GetDecl().UnsafeCast<Declaration::EnumDecl>();
+		const auto enumUnderlyingType = enumDecl->GetUnderlyingType();
+		const auto builtinUnderlyingType = Type::Type::GetUnderlyingType(enumUnderlyingType).Cast<Type::BuiltinType>();
+		const auto isUnsigned = builtinUnderlyingType && !builtinUnderlyingType->IsSigned();
+		const auto typeInfo = m_AstContext.GetTypeInfo(enumUnderlyingType);
+
+		std::vector<llvm::Metadata*> enumerators;
+		for (const auto& enumerator : enumDecl->GetEnumerators())
+		{
+			const auto enumeratorName = enumerator->GetName();
+#if LLVM_VERSION_MAJOR == 6
+			static_cast<void>(isUnsigned);
+			enumerators.emplace_back(m_DIBuilder->createEnumerator(llvm::StringRef{ enumeratorName.data(), enumeratorName.size() },
+				static_cast<std::int64_t>(enumerator->GetValue())));
+#elif LLVM_VERSION_MAJOR == 7 || LLVM_VERSION_MAJOR == 8
+			enumerators.emplace_back(m_DIBuilder->createEnumerator(llvm::StringRef{ enumeratorName.data(), enumeratorName.size() },
+				static_cast<std::int64_t>(enumerator->GetValue()), isUnsigned));
+#else
+#error "unsupported LLVM version"
+#endif
+		}
+
+		const auto enumName = enumDecl->GetName();
+		ret = m_DIBuilder->createEnumerationType(m_DIFile, llvm::StringRef{ enumName.data(), enumName.size() }, m_DIFile,
+			getLineAndColumn(enumDecl->GetLocation()).first, static_cast<std::uint64_t>(typeInfo.Size * 8), static_cast<std::uint32_t>(typeInfo.Align * 8),
+			m_DIBuilder->getOrCreateArray(enumerators), getDebugType(enumUnderlyingType));
+		break;
+	}
+	default:
+		assert(!"Invalid type");
+		[[fallthrough]];
+	case Type::Type::Paren:
+	case Type::Type::Auto:
+		assert(!"Should never happen, check NatsuLang::Type::Type::GetUnderlyingType");
+		nat_Throw(AotCompilerException, u8"错误的类型"_nv);
+	}
+
+	cacheDebugType(underlyingType, ret);
+	return ret;
+}
+
+void AotCompiler::cacheDebugType(Type::TypePtr const& type, llvm::DIType* debugType)
+{
+	if (m_DebugTypeMap.try_emplace(type.Get(), debugType).second)
+	{
+		m_DebugLoweredTypes.emplace_back(type);
+	}
+}
+
+llvm::DISubroutineType* AotCompiler::getDebugFunctionType(natRefPointer<Declaration::FunctionDecl> const& funcDecl)
+{
+	assert(m_DIBuilder);
+
+	const auto functionType = funcDecl->GetValueType().UnsafeCast<Type::FunctionType>();
+	std::vector<llvm::Metadata*> types{ getDebugType(functionType->GetResultType()) };
+
+	if (funcDecl.Cast<Declaration::MethodDecl>())
+	{
+		const auto classDecl = dynamic_cast<Declaration::ClassDecl*>(Declaration::Decl::CastFromDeclContext(funcDecl->GetContext()));
+		assert(classDecl);
+		types.emplace_back(m_DIBuilder->createObjectPointerType(getDebugType(classDecl->GetTypeForDecl())));
+	}
+
+	for (const auto& paramType : functionType->GetParameterTypes())
+	{
+		types.emplace_back(getDebugType(paramType));
+	}
+
+	return m_DIBuilder->createSubroutineType(m_DIBuilder->getOrCreateTypeArray(types));
+}
+
+llvm::DIType* AotCompiler::buildDebugClassType(natRefPointer<Type::ClassType> const& classType)
+{
+	const auto classDecl = classType->GetDecl().UnsafeCast<Declaration::ClassDecl>();
+	const auto className = classDecl->GetName();
+	const llvm::StringRef name{ className.data(), className.size() };
+	const auto line = getLineAndColumn(classDecl->GetLocation()).first;
+	const auto& classLayout = m_AstContext.GetClassLayout(classDecl);
+
+	// 先缓存前向声明，递归引用自身的类不会导致无限递归
+	const auto forwardDecl = m_DIBuilder->createReplaceableCompositeType(llvm::dwarf::DW_TAG_structure_type, name, m_DIFile, m_DIFile, line);
+	cacheDebugType(classType, forwardDecl);
+
+	std::vector<llvm::Metadata*> members;
+	for (const auto& [field, offset] : classLayout.FieldOffsets)
+	{
+		// padding 不需要调试信息
+		if (!field)
+		{
+			continue;
+		}
+
+		const auto fieldName = field->GetName();
+		const auto fieldType = field->GetValueType();
+		const auto fieldTypeInfo = m_AstContext.GetTypeInfo(fieldType);
+		// 紧凑布局的字段不满足其类型的对齐，以 0 表示未指定对齐
+		const auto fieldAlign = classLayout.Policy == ClassLayoutPolicy::Packed ? 0 : fieldTypeInfo.Align * 8;
+		members.emplace_back(m_DIBuilder->createMemberType(forwardDecl, llvm::StringRef{ fieldName.data(), fieldName.size() }, m_DIFile,
+			getLineAndColumn(field->GetLocation()).first, static_cast<std::uint64_t>(fieldTypeInfo.Size * 8), static_cast<std::uint32_t>(fieldAlign),
+			static_cast<std::uint64_t>(offset * 8), llvm::DINode::FlagZero, getDebugType(fieldType)));
+	}
+
+	const auto ret = m_DIBuilder->createStructType(m_DIFile, name, m_DIFile, line, static_cast<std::uint64_t>(classLayout.Size * 8),
+		static_cast<std::uint32_t>(classLayout.Align * 8), llvm::DINode::FlagZero, nullptr, m_DIBuilder->getOrCreateArray(members));
+	forwardDecl->replaceAllUsesWith(ret);
+	llvm::MDNode::deleteTemporary(forwardDecl);
+	m_DebugTypeMap[classType.Get()] = ret;
+
+	return ret;
+}
+
 natRefPointer<Type::ArrayType> AotCompiler::flattenArray(natRefPointer<Type::ArrayType> arrayType)
 {
 	// 也可能是本来元素类型就是 nullptr，这里不考虑这个情况，但是这是可能的错误点
@@ -15,8 +15,11 @@
 #pragma warning(disable : 4141 4146 4244 4267 4291 4624 4996)
 #endif // _MSC_VER
 
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/CallSite.h>
 #include <llvm/Target/TargetMachine.h>
 
 #ifdef _MSC_VER
@@ -26,6 +29,12 @@
 namespace llvm
 {
 	class raw_pwrite_stream;
+	class PassManagerBuilder;
+}
+
+namespace NatsuLang::Serialization
+{
+	enum class BinaryMetadataFlags : nuShort;
 }
 
 using namespace NatsuLib::StringLiterals;
@@ -34,6 +43,32 @@ namespace NatsuLang::Compiler
 {
 	DeclareException(AotCompilerException, NatsuLib::natException, u8"Exception generated by AotCompiler"_nv);
 
+	// 编译器版本，不同版本的编译器的输出不会共享模块缓存
+	constexpr char AotCompilerVersion[] = "0.1";
+
+	enum class ProfileMode
+	{
+		None,
+		// 插入剖析计数器，生成的程序需要链接 LLVM 的剖析运行时库，运行时将输出 .profraw 文件
+		Instrument,
+		// 读取由 llvm-profdata 合并得到的 .profdata 文件，为分支附加权重并为函数附加入口计数
+		Use,
+	};
+
+	struct CompileOptions
+	{
+		// 仅对源码文件中定义的函数及其局部变量生成调试信息
+		nBool EmitDebugInfo = false;
+		// 0 至 3，为 0 时不进行优化
+		nuInt OptLevel = 0;
+		ProfileMode Profile = ProfileMode::None;
+		// 插桩时为 .profraw 文件的输出路径，为空时由剖析运行时决定；使用剖析数据时为 .profdata 文件的路径
+		nString ProfilePath;
+		// 生成异常处理代码，生成的程序需要链接 C++ ABI 运行时（libsupc++ 或 libc++abi）
+		// 未启用时不生成着陆场，源码中不能使用 try 及 throw
+		nBool EnableExceptions = false;
+	};
+
 	class AotCompiler final
 	{
 		class AotDiagIdMap final
@@ -98,6 +133,9 @@ namespace NatsuLang::Compiler
 				virtual ~ICleanup();
 
 				virtual void Emit(AotStmtVisitor& visitor) = 0;
+
+				///	@brief	是否需要在异常展开时执行
+				virtual nBool IsEHCleanup() const noexcept;
 			};
 
 			class DestructorCleanup
@@ -139,6 +177,7 @@ namespace NatsuLang::Compiler
 				~AnchorCleanup();
 
 				void Emit(AotStmtVisitor& visitor) override;
+				nBool IsEHCleanup() const noexcept override;
 
 				llvm::BasicBlock* GetBlock() const noexcept;
 
@@ -226,6 +265,39 @@ namespace NatsuLang::Compiler
 				nBool m_AfterLexicalScope;
 			};
 
+			// 用于存储 try 语句的异常处理信息
+			class TryScope
+			{
+			public:
+				// 类型信息为 nullptr 的处理器将捕获所有异常
+				using Handler = std::pair<llvm::Constant*, llvm::BasicBlock*>;
+
+				TryScope(llvm::BasicBlock* dispatchBlock, CleanupIterator cleanupIterator, std::vector<Handler> handlers)
+					: m_DispatchBlock{ dispatchBlock }, m_CleanupIterator{ std::move(cleanupIterator) }, m_Handlers{ std::move(handlers) }
+				{
+				}
+
+				llvm::BasicBlock* GetDispatchBlock() const noexcept
+				{
+					return m_DispatchBlock;
+				}
+
+				CleanupIterator GetCleanupIterator() const noexcept
+				{
+					return m_CleanupIterator;
+				}
+
+				std::vector<Handler> const& GetHandlers() const noexcept
+				{
+					return m_Handlers;
+				}
+
+			private:
+				llvm::BasicBlock* m_DispatchBlock;
+				CleanupIterator m_CleanupIterator;
+				std::vector<Handler> m_Handlers;
+			};
+
 		public:
 			AotStmtVisitor(AotCompiler& compiler, NatsuLib::natRefPointer<Declaration::FunctionDecl> funcDecl, llvm::Function* funcValue);
 			~AotStmtVisitor();
@@ -328,6 +400,13 @@ namespace NatsuLang::Compiler
 
 			void EmitDestructorCall(NatsuLib::natRefPointer<Declaration::DestructorDecl> const& destructor, llvm::Value* addr);
 
+			///	@brief	生成函数调用
+			///	@remark	仅当调用抛出的异常需要被捕获或在展开时需要执行清理时才会生成 invoke 指令，否则生成普通的 call 指令
+			llvm::CallSite EmitCallOrInvoke(llvm::Value* callee, llvm::ArrayRef<llvm::Value*> args, llvm::Twine const& name = "");
+			///	@brief	执行从 begin 至最内层 try 语句之间的异常清理，并跳转至该 try 语句的分派块，若不存在则继续展开
+			void EmitUnwind(CleanupIterator const& begin);
+			void EmitCatchHandler(NatsuLib::natRefPointer<Statement::CatchStmt> const& catchStmt);
+
 			void EvaluateRValue(Expression::ExprPtr const& expr);
 			void EvaluateLValue(Expression::ExprPtr const& expr);
 			void EvaluateAsBoolRValue(Expression::ExprPtr const& expr);
@@ -341,9 +420,19 @@ namespace NatsuLang::Compiler
 			CleanupIterator InsertCleanupStack(CleanupIterator const& pos, NatsuLib::natRefPointer<ICleanup> cleanup);
 			void PopCleanupStack(CleanupIterator const& iter, nBool popStack = true);
 			bool CleanupEncloses(CleanupIterator const& a, CleanupIterator const& b) const noexcept;
+			nBool HasEHCleanup(CleanupIterator const& begin, CleanupIterator const& end) const noexcept;
 
 			LexicalScope* LookupLexicalScopeAfter(CleanupIterator const& iter);
 
+			void Visit(Statement::StmtPtr const& stmt);
+
+			///	@brief	将之后生成的指令的调试位置设为 loc
+			///	@remark	未生成调试信息或无法确定 loc 所在的行时不做任何操作
+			void EmitDebugLocation(SourceLocation loc);
+			///	@brief	为变量生成调试信息描述符并声明其存储
+			///	@param	argNo	参数序号，从 1 开始，为 0 时表示局部变量
+			void EmitDebugVarDecl(NatsuLib::natRefPointer<Declaration::VarDecl> const& decl, llvm::Value* storage, unsigned argNo = 0);
+
 		private:
 			AotCompiler& m_Compiler;
 			NatsuLib::natRefPointer<Declaration::FunctionDecl> m_CurrentFunction;
@@ -355,21 +444,83 @@ namespace NatsuLang::Compiler
 			Declaration::DeclPtr m_LastVisitedDecl;
 			nBool m_RequiredLValue;
 			std::vector<std::pair<JumpDest, JumpDest>> m_BreakContinueStack;
+			llvm::SwitchInst* m_CurrentSwitch;
 			CleanupStack m_CleanupStack;
 			LexicalScope* m_CurrentLexicalScope;
 			JumpDest m_ReturnBlock;
 			llvm::Value* m_ReturnValue;
 
+			std::vector<TryScope> m_TryStack;
+			// 清理栈及 try 栈未改变时可以复用上次生成的着陆场
+			llvm::BasicBlock* m_CachedLandingPad;
+			llvm::BasicBlock* m_ResumeBlock;
+			llvm::Value* m_ExceptionSlot;
+			llvm::Value* m_SelectorSlot;
+			nBool m_EmittingEHCleanup;
+			// 未生成调试信息时为 nullptr
+			llvm::DISubprogram* m_DebugScope;
+
 			void setLastVisitedResult(llvm::Value* lastVisitedValue, Declaration::DeclPtr lastVisitedDecl = nullptr);
+
+			llvm::BasicBlock* getInvokeDest();
+			llvm::BasicBlock* emitLandingPad();
+			llvm::BasicBlock* getResumeBlock();
+			llvm::Value* getExceptionSlot();
+			llvm::Value* getSelectorSlot();
+		};
+
+		// 异常处理所需的 Itanium C++ ABI 运行时函数
+		enum class EHRuntimeFunction
+		{
+			AllocateException,
+			Throw,
+			Rethrow,
+			BeginCatch,
+			EndCatch,
+			Personality,
+			TypeIdFor,
 		};
 
 	public:
 		AotCompiler(NatsuLib::natRefPointer<NatsuLib::TextReader<NatsuLib::StringType::Utf8>> const& diagIdMapFile, NatsuLib::natLog& logger);
 		~AotCompiler();
 
-		void LoadMetadata(NatsuLib::Linq<NatsuLib::Valued<NatsuLib::Uri>> const& metadata, nBool shouldCodeGen = true);
-		void CreateMetadata(NatsuLib::natRefPointer<NatsuLib::natStream> const& metadataStream, nBool includeImported = false);
-		void Compile(NatsuLib::Uri const& uri, NatsuLib::Linq<NatsuLib::Valued<NatsuLib::Uri>> const& metadata, llvm::raw_pwrite_stream& objectStream);
+		///	@brief	加载元数据
+		///	@param	metadata		元数据文件
+		///	@param	shouldCodeGen	是否为加载的声明生成代码
+		///	@param	loadLazily		是否仅在声明首次被查找时才加载，否则将立即加载所有声明
+		void LoadMetadata(NatsuLib::Linq<NatsuLib::Valued<NatsuLib::Uri>> const& metadata, nBool shouldCodeGen = true, nBool loadLazily = true);
+		///	@brief	创建元数据
+		///	@param	metadataStream	输出元数据的流，可以不可定位
+		///	@param	includeImported	是否包含导入的声明
+		///	@param	flags			元数据的存储方式，如是否使用变长整数及是否压缩
+		void CreateMetadata(NatsuLib::natRefPointer<NatsuLib::natStream> const& metadataStream, nBool includeImported = false, Serialization::BinaryMetadataFlags flags = {});
+		///	@brief	编译源码文件并输出目标文件
+		///	@param	uri				源码文件
+		///	@param	metadata		需要导入的元数据文件
+		///	@param	objectStream	输出目标文件的流
+		///	@param	options			调试信息、优化及剖析的选项
+		///	@param	bitcodeStream	若不为 nullptr，将额外输出供 LinkModules 使用的 bitcode
+		void Compile(NatsuLib::Uri const& uri, NatsuLib::Linq<NatsuLib::Valued<NatsuLib::Uri>> const& metadata, llvm::raw_pwrite_stream& objectStream, CompileOptions const& options = {}, llvm::raw_ostream* bitcodeStream = nullptr);
+		///	@brief	合并由 Compile 输出的 bitcode，进行全程序优化并输出单个目标文件
+		///	@param	bitcodeFiles	bitcode 文件
+		///	@param	metadata		bitcode 对应的元数据文件，其中导出的声明对应的符号将被保留
+		///	@param	exportedSymbols	额外需要保留的符号，其余符号将被内部化，可能被内联或移除
+		///	@param	objectStream	输出目标文件的流
+		///	@param	options			优化选项，仅使用其中的优化等级，为 0 时以 2 级进行优化
+		///	@return	是否成功
+		nBool LinkModules(NatsuLib::Linq<NatsuLib::Valued<NatsuLib::Uri>> const& bitcodeFiles, NatsuLib::Linq<NatsuLib::Valued<NatsuLib::Uri>> const& metadata, NatsuLib::Linq<NatsuLib::Valued<nString>> const& exportedSymbols,
+			llvm::raw_pwrite_stream& objectStream, CompileOptions const& options = {});
+
+		///	@brief	仅对源码文件进行完整的语法及语义检查，包括所有被延迟分析的函数体，不生成代码
+		///	@return	检查是否通过
+		nBool CheckSyntax(NatsuLib::Uri const& uri, NatsuLib::Linq<NatsuLib::Valued<NatsuLib::Uri>> const& metadata);
+
+		///	@brief	是否已报告过错误
+		nBool IsErrored() const noexcept;
+
+		///	@brief	生成代码的目标三元组
+		std::string const& GetTargetTriple() const noexcept;
 
 	private:
 		llvm::llvm_shutdown_obj m_LLVMShutdown;
@@ -391,12 +542,28 @@ namespace NatsuLang::Compiler
 		Semantic::Sema m_Sema;
 		Syntax::Parser m_Parser;
 
-		std::unordered_map<Type::TypePtr, llvm::Type*> m_TypeMap;
-		std::unordered_map<Declaration::DeclPtr, llvm::Type*> m_DeclTypeMap;
+		// 以地址为键，查找时无需计算类型的哈希，m_LoweredTypes 及 m_LoweredDecls 保证作为键的对象存活
+		llvm::DenseMap<const Type::Type*, llvm::Type*> m_TypeMap;
+		llvm::DenseMap<const Declaration::Decl*, llvm::Type*> m_DeclTypeMap;
+		std::vector<Type::TypePtr> m_LoweredTypes;
+		std::vector<Declaration::DeclPtr> m_LoweredDecls;
 		std::unordered_map<NatsuLib::natRefPointer<Declaration::FunctionDecl>, llvm::Function*> m_FunctionMap;
 		std::unordered_map<NatsuLib::natRefPointer<Declaration::VarDecl>, llvm::GlobalVariable*> m_GlobalVariableMap;
 
 		std::unordered_map<nString, llvm::GlobalVariable*> m_StringLiteralPool;
+		std::unordered_map<Type::TypePtr, llvm::GlobalVariable*> m_TypeInfoMap;
+
+		// 仅在生成调试信息时存在
+		std::unique_ptr<llvm::DIBuilder> m_DIBuilder;
+		llvm::DICompileUnit* m_DICompileUnit;
+		llvm::DIFile* m_DIFile;
+		// 与 m_TypeMap 相同以地址为键，m_DebugLoweredTypes 保证作为键的对象存活
+		llvm::DenseMap<const Type::Type*, llvm::DIType*> m_DebugTypeMap;
+		std::vector<Type::TypePtr> m_DebugLoweredTypes;
+
+		// 仅在编译期间有效
+		nBool m_EnableExceptions;
+		nBool m_SyntaxOnly;
 
 		template <typename T>
 		void registerNativeType(nStrView name)
@@ -422,11 +589,21 @@ namespace NatsuLang::Compiler
 			m_Sema.ActOnAliasDeclaration(m_Sema.GetCurrentScope(), {}, m_Preprocessor.FindIdentifierInfo(name, dummy), {}, m_AstContext.GetBuiltinType(builtinClass));
 		}
 		void prewarm();
+		nBool parseSourceFile(NatsuLib::Uri const& uri);
+		void populatePassManagerBuilder(llvm::PassManagerBuilder& builder, nuInt optLevel);
+		void optimizeModule(llvm::Module& module, CompileOptions const& options, nBool prepareForLTO);
+		void emitObjectFile(llvm::raw_pwrite_stream& objectStream);
 
 		llvm::GlobalVariable* getStringLiteralValue(nStrView literalContent, nStrView literalName = "String");
 
+		llvm::Constant* getEHRuntimeFunction(EHRuntimeFunction func);
+		///	@brief	获得用于抛出及捕获指定类型的异常的类型信息
+		llvm::Constant* getTypeInfo(Type::TypePtr const& type);
+
 		llvm::Type* getCorrespondingType(Type::TypePtr const& type);
 		llvm::Type* getCorrespondingType(Declaration::DeclPtr const& decl);
+		void cacheCorrespondingType(Type::TypePtr const& type, llvm::Type* llvmType);
+		void cacheCorrespondingType(Declaration::DeclPtr const& decl, llvm::Type* llvmType);
 
 		llvm::Type* buildFunctionType(Type::TypePtr const& resultType, NatsuLib::Linq<NatsuLib::Valued<Type::TypePtr>> const& params, nBool hasVarArg = false);
 		llvm::Type* buildFunctionTypeWithParamDecl(Type::TypePtr const& resultType, NatsuLib::Linq<NatsuLib::Valued<NatsuLib::natRefPointer<Declaration::ParmVarDecl>>> const& params, nBool hasVarArg = false);
@@ -435,6 +612,14 @@ namespace NatsuLang::Compiler
 
 		llvm::Type* buildClassType(NatsuLib::natRefPointer<Declaration::ClassDecl> const& classDecl);
 
+		///	@brief	获得位置对应的行号及列号，均从 1 开始
+		///	@return	无法确定位置时返回 { 0, 0 }
+		std::pair<unsigned, unsigned> getLineAndColumn(SourceLocation loc) const noexcept;
+		llvm::DIType* getDebugType(Type::TypePtr const& type);
+		void cacheDebugType(Type::TypePtr const& type, llvm::DIType* debugType);
+		llvm::DISubroutineType* getDebugFunctionType(NatsuLib::natRefPointer<Declaration::FunctionDecl> const& funcDecl);
+		llvm::DIType* buildDebugClassType(NatsuLib::natRefPointer<Type::ClassType> const& classType);
+
 		NatsuLib::natRefPointer<Type::ArrayType> flattenArray(NatsuLib::natRefPointer<Type::ArrayType> arrayType);
 		static NatsuLib::natRefPointer<Declaration::DestructorDecl> findDestructor(NatsuLib::natRefPointer<Declaration::ClassDecl> const& classDecl);
 	};
@@ -0,0 +1,348 @@
+﻿#include "ModuleCache.h"
+#include "CodeGen.h"
+#include "Serialization.h"
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4141 4146 4244 4267 4291 4624 4996)
+#endif // _MSC_VER
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif // _MSC_VER
+
+#include <algorithm>
+
+using namespace NatsuLib;
+using namespace NatsuLang;
+using namespace Compiler;
+
+namespace
+{
+	// 缓存项的布局如下，所有数值均以小端序存储，字符串以长度（4 字节）及内容表示：
+	// 魔数（4 字节）、格式版本（4 字节）、编译器版本、键、内容的散列值、目标文件大小（8 字节）及内容、元数据大小（8 字节）及内容
+	constexpr nuInt ModuleCacheMagic = 0x4843434D; // "MCCH"
+	constexpr nuInt ModuleCacheVersion = 1;
+	constexpr char ModuleCacheEntryExtension[] = ".cache";
+	constexpr char ModuleCacheUsageStampExtension[] = ".used";
+
+	llvm::StringRef ToStringRef(nStrView str) noexcept
+	{
+		return { str.cbegin(), str.size() };
+	}
+
+	nString ToHexDigest(llvm::MD5& hash)
+	{
+		llvm::MD5::MD5Result result;
+		hash.final(result);
+		llvm::SmallString<32> digest;
+		llvm::MD5::stringifyResult(result, digest);
+		return nStrView{ digest.begin(), digest.end() };
+	}
+
+	void WriteLittleEndian(llvm::raw_ostream& stream, nuLong value, std::size_t width)
+	{
+		for (std::size_t i = 0; i < width; ++i)
+		{
+			stream << static_cast<char>(static_cast<nByte>(value >> (i * 8)));
+		}
+	}
+
+	void WriteString(llvm::raw_ostream& stream, llvm::StringRef str)
+	{
+		WriteLittleEndian(stream, str.size(), sizeof(nuInt));
+		stream << str;
+	}
+
+	// 以下读取函数在成功时会使 data 越过已读取的部分
+	nBool ReadLittleEndian(llvm::StringRef& data, nuLong& value, std::size_t width)
+	{
+		if (data.size() < width)
+		{
+			return false;
+		}
+
+		value = 0;
+		for (std::size_t i = 0; i < width; ++i)
+		{
+			value |= static_cast<nuLong>(static_cast<nByte>(data[i])) << (i * 8);
+		}
+
+		data = data.drop_front(width);
+		return true;
+	}
+
+	nBool ReadBytes(llvm::StringRef& data, llvm::StringRef& out, std::size_t width)
+	{
+		nuLong size;
+		if (!ReadLittleEndian(data, size, width) || data.size() < size)
+		{
+			return false;
+		}
+
+		out = data.substr(0, static_cast<std::size_t>(size));
+		data = data.drop_front(static_cast<std::size_t>(size));
+		return true;
+	}
+
+	nBool WriteFile(llvm::StringRef path, llvm::StringRef content)
+	{
+		std::error_code ec;
+		llvm::raw_fd_ostream stream{ path, ec, llvm::sys::fs::F_None };
+		if (ec)
+		{
+			return false;
+		}
+
+		stream << content;
+		stream.close();
+		return !stream.has_error();
+	}
+
+	void HashInteger(llvm::MD5& hash, nuLong value)
+	{
+		hash.update(llvm::ArrayRef<nByte>{ reinterpret_cast<const nByte*>(&value), sizeof value });
+	}
+
+	// 写入路径及内容的长度以区分不同的文件划分，若文件无法读取则返回 false
+	nBool HashFile(llvm::MD5& hash, nStrView path)
+	{
+		auto buffer = llvm::MemoryBuffer::getFile(ToStringRef(path));
+		if (!buffer)
+		{
+			return false;
+		}
+
+		const auto content = (*buffer)->getBuffer();
+		HashInteger(hash, path.size());
+		hash.update(ToStringRef(path));
+		HashInteger(hash, content.size());
+		hash.update(content);
+		return true;
+	}
+
+	// 写入文件数以免文件在不同的组之间移动时得到相同的键
+	nBool HashFiles(llvm::MD5& hash, std::vector<nString> const& files)
+	{
+		HashInteger(hash, files.size());
+		return std::all_of(files.cbegin(), files.cend(), [&hash](nString const& file)
+		{
+			return HashFile(hash, file);
+		});
+	}
+
+	// 缓存项被使用时重写此文件，以其修改时间作为缓存项的最近使用时间
+	std::string GetUsageStampPath(llvm::StringRef entryPath)
+	{
+		return (entryPath + ModuleCacheUsageStampExtension).str();
+	}
+}
+
+ModuleCache::ModuleCache(nString directory, nuLong maxSize)
+	: m_Directory{ std::move(directory) }, m_MaxSize{ maxSize }
+{
+	if (const auto ec = llvm::sys::fs::create_directories(ToStringRef(m_Directory)))
+	{
+		nat_Throw(AotCompilerException, u8"无法创建模块缓存目录 \"{0}\"，错误为：{1}"_nv, m_Directory, ec.message());
+	}
+}
+
+ModuleCache::~ModuleCache()
+{
+}
+
+nString ModuleCache::ComputeKey(nStrView sourceFile, std::vector<nString> const& precedingSources, std::vector<nString> const& loadedMetadata,
+	std::vector<nString> const& otherInputs, nStrView options) const
+{
+	llvm::MD5 hash;
+	hash.update(AotCompilerVersion);
+	hash.update(llvm::StringRef{ "\0", 1 });
+	// 元数据格式改变时，缓存的元数据也不再可用
+	HashInteger(hash, Serialization::BinaryMetadataVersion);
+	HashInteger(hash, options.size());
+	hash.update(ToStringRef(options));
+
+	if (!HashFile(hash, sourceFile) || !HashFiles(hash, precedingSources) || !HashFiles(hash, loadedMetadata) || !HashFiles(hash, otherInputs))
+	{
+		return {};
+	}
+
+	return ToHexDigest(hash);
+}
+
+nBool ModuleCache::Restore(nStrView key, nStrView objectPath, nStrView metadataPath)
+{
+	const auto entryPath = getEntryPath(key);
+	auto buffer = llvm::MemoryBuffer::getFile(ToStringRef(entryPath));
+	if (!buffer)
+	{
+		return false;
+	}
+
+	auto data = (*buffer)->getBuffer();
+	nuLong magic, version;
+	llvm::StringRef compilerVersion, entryKey, digest, objectContent, metadataContent;
+	auto valid = ReadLittleEndian(data, magic, sizeof(nuInt)) && magic == ModuleCacheMagic &&
+		ReadLittleEndian(data, version, sizeof(nuInt)) && version == ModuleCacheVersion &&
+		ReadBytes(data, compilerVersion, sizeof(nuInt)) && compilerVersion == AotCompilerVersion &&
+		ReadBytes(data, entryKey, sizeof(nuInt)) && entryKey == ToStringRef(key) &&
+		ReadBytes(data, digest, sizeof(nuInt)) &&
+		ReadBytes(data, objectContent, sizeof(nuLong)) &&
+		ReadBytes(data, metadataContent, sizeof(nuLong)) && data.empty();
+
+	if (valid)
+	{
+		llvm::MD5 hash;
+		hash.update(objectContent);
+		hash.update(metadataContent);
+		valid = ToStringRef(ToHexDigest(hash)) == digest;
+	}
+
+	if (!valid)
+	{
+		// 缓存项已损坏或由其他版本的编译器生成，删除后视为未命中
+		buffer->reset();
+		static_cast<void>(llvm::sys::fs::remove(ToStringRef(entryPath)));
+		static_cast<void>(llvm::sys::fs::remove(GetUsageStampPath(ToStringRef(entryPath))));
+		return false;
+	}
+
+	if (!WriteFile(ToStringRef(objectPath), objectContent) || !WriteFile(ToStringRef(metadataPath), metadataContent))
+	{
+		return false;
+	}
+
+	static_cast<void>(WriteFile(GetUsageStampPath(ToStringRef(entryPath)), {}));
+	return true;
+}
+
+void ModuleCache::Store(nStrView key, nStrView objectPath, nStrView metadataPath)
+{
+	auto objectBuffer = llvm::MemoryBuffer::getFile(ToStringRef(objectPath));
+	auto metadataBuffer = llvm::MemoryBuffer::getFile(ToStringRef(metadataPath));
+	if (!objectBuffer || !metadataBuffer)
+	{
+		return;
+	}
+
+	const auto objectContent = (*objectBuffer)->getBuffer();
+	const auto metadataContent = (*metadataBuffer)->getBuffer();
+
+	llvm::MD5 hash;
+	hash.update(objectContent);
+	hash.update(metadataContent);
+	const auto digest = ToHexDigest(hash);
+
+	// 先写入临时文件再重命名，避免留下不完整的缓存项
+	const auto entryPath = getEntryPath(key);
+	const auto tempPath = entryPath + u8".tmp"_nv;
+	{
+		std::error_code ec;
+		llvm::raw_fd_ostream stream{ ToStringRef(tempPath), ec, llvm::sys::fs::F_None };
+		if (ec)
+		{
+			return;
+		}
+
+		WriteLittleEndian(stream, ModuleCacheMagic, sizeof(nuInt));
+		WriteLittleEndian(stream, ModuleCacheVersion, sizeof(nuInt));
+		WriteString(stream, AotCompilerVersion);
+		WriteString(stream, ToStringRef(key));
+		WriteString(stream, ToStringRef(digest));
+		WriteLittleEndian(stream, objectContent.size(), sizeof(nuLong));
+		stream << objectContent;
+		WriteLittleEndian(stream, metadataContent.size(), sizeof(nuLong));
+		stream << metadataContent;
+		stream.close();
+
+		if (stream.has_error())
+		{
+			stream.clear_error();
+			static_cast<void>(llvm::sys::fs::remove(ToStringRef(tempPath)));
+			return;
+		}
+	}
+
+	if (llvm::sys::fs::rename(ToStringRef(tempPath), ToStringRef(entryPath)))
+	{
+		static_cast<void>(llvm::sys::fs::remove(ToStringRef(tempPath)));
+		return;
+	}
+
+	evict();
+}
+
+nString ModuleCache::getEntryPath(nStrView key) const
+{
+	llvm::SmallString<128> path{ ToStringRef(m_Directory) };
+	llvm::sys::path::append(path, ToStringRef(key) + ModuleCacheEntryExtension);
+	return nStrView{ path.begin(), path.end() };
+}
+
+void ModuleCache::evict()
+{
+	struct EntryInfo
+	{
+		std::string Path;
+		nuLong Size;
+		llvm::sys::TimePoint<> LastUsed;
+	};
+
+	std::vector<EntryInfo> entries;
+	nuLong totalSize{};
+
+	std::error_code ec;
+	for (llvm::sys::fs::directory_iterator iter{ ToStringRef(m_Directory), ec }, end; iter != end && !ec; iter.increment(ec))
+	{
+		if (llvm::sys::path::extension(iter->path()) != ModuleCacheEntryExtension)
+		{
+			continue;
+		}
+
+		llvm::sys::fs::file_status status;
+		if (llvm::sys::fs::status(iter->path(), status))
+		{
+			continue;
+		}
+
+		auto lastUsed = status.getLastModificationTime();
+		if (llvm::sys::fs::file_status usageStatus; !llvm::sys::fs::status(GetUsageStampPath(iter->path()), usageStatus))
+		{
+			lastUsed = std::max(lastUsed, usageStatus.getLastModificationTime());
+		}
+
+		entries.push_back({ iter->path(), status.getSize(), lastUsed });
+		totalSize += status.getSize();
+	}
+
+	if (totalSize <= m_MaxSize)
+	{
+		return;
+	}
+
+	std::sort(entries.begin(), entries.end(), [](EntryInfo const& a, EntryInfo const& b)
+	{
+		return a.LastUsed < b.LastUsed;
+	});
+
+	for (const auto& entry : entries)
+	{
+		if (totalSize <= m_MaxSize)
+		{
+			break;
+		}
+
+		if (!llvm::sys::fs::remove(entry.Path))
+		{
+			static_cast<void>(llvm::sys::fs::remove(GetUsageStampPath(entry.Path)));
+			totalSize -= entry.Size;
+		}
+	}
+}
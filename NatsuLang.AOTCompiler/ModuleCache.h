@@ -0,0 +1,44 @@
+﻿#pragma once
+#include <natString.h>
+#include <vector>
+
+namespace NatsuLang::Compiler
+{
+	///	@brief	预编译模块缓存
+	///	@remark	缓存项以所有输入文件的路径及内容、影响输出的编译选项及编译器版本的散列值为键，保存编译得到的目标文件与元数据，
+	///			命中时直接恢复输出，不再进行分析、反序列化元数据及生成代码。
+	///			缓存项记录了完整的键及内容的散列值，不匹配时视为失效并删除；缓存总大小超出上限时按最近使用时间淘汰
+	class ModuleCache final
+	{
+	public:
+		///	@param	directory	缓存目录，不存在时将会被创建
+		///	@param	maxSize		缓存总大小的上限，以字节为单位
+		ModuleCache(nString directory, nuLong maxSize);
+		~ModuleCache();
+
+		///	@brief	计算缓存键
+		///	@remark	同一编译器实例先前编译的源码文件及加载的元数据会留在 Sema 中并影响之后的输出，因此也需要参与计算
+		///	@param	sourceFile			将要编译的源码文件的路径
+		///	@param	precedingSources	同一编译器实例中先前编译的源码文件的路径，顺序是有意义的
+		///	@param	loadedMetadata		已加载及编译时将要加载的元数据文件的路径，顺序是有意义的
+		///	@param	otherInputs			其他影响输出的文件的路径，例如剖析数据
+		///	@param	options				影响输出的编译选项，包括目标三元组
+		///	@return	缓存键，若有输入文件无法读取则返回空字符串，此时不应使用缓存
+		nString ComputeKey(nStrView sourceFile, std::vector<nString> const& precedingSources, std::vector<nString> const& loadedMetadata,
+			std::vector<nString> const& otherInputs, nStrView options) const;
+
+		///	@brief	尝试从缓存中恢复输出
+		///	@return	是否命中，未命中时不会写入任何输出
+		nBool Restore(nStrView key, nStrView objectPath, nStrView metadataPath);
+
+		///	@brief	将输出存入缓存，并在超出大小上限时淘汰最久未使用的缓存项
+		void Store(nStrView key, nStrView objectPath, nStrView metadataPath);
+
+	private:
+		nString m_Directory;
+		nuLong m_MaxSize;
+
+		nString getEntryPath(nStrView key) const;
+		void evict();
+	};
+}
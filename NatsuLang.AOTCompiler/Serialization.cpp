@@ -6,6 +6,25 @@
 #include "AST/ASTContext.h"
 #include "Parse/Parser.h"
 
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4141 4146 4244 4267 4291 4624 4996)
+#endif // _MSC_VER
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Compression.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MD5.h>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif // _MSC_VER
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
 using namespace NatsuLib;
 using namespace NatsuLang;
 using namespace Serialization;
@@ -48,12 +67,59 @@ namespace
 		return name;
 	}
 
+	// 文件尾包含字符串表的偏移、索引的偏移、数组元素数量表的偏移、块表的偏移及魔数
+	constexpr nLen BinaryMetadataTrailerSize = sizeof(nuLong) + sizeof(nuLong) + sizeof(nuLong) + sizeof(nuLong) + sizeof(nuInt);
+
+	constexpr nLen BinaryMetadataBundleHeaderSize = sizeof(nuInt) + sizeof(nuShort) + sizeof(nuShort);
+	// 文件尾包含成员表的偏移及魔数
+	constexpr nLen BinaryMetadataBundleTrailerSize = sizeof(nuLong) + sizeof(nuInt);
+	constexpr std::size_t BinaryMetadataBundleDigestSize = 16;
+
+	// 变长整数每字节存储 7 位，最高位表示之后是否还有字节，64 位整数最多需要 10 字节
+	constexpr std::size_t MaxVarIntSize = 10;
+
+	// 元数据中的定长数值总是以小端序存储，与运行平台的端序无关
+	void EncodeLittleEndian(nuLong value, std::size_t width, nData buffer)
+	{
+		assert(width <= sizeof(nuLong));
+		for (std::size_t i = 0; i < width; ++i)
+		{
+			buffer[i] = static_cast<nByte>(value >> (i * 8));
+		}
+	}
+
+	nuLong DecodeLittleEndian(ncData buffer, std::size_t width)
+	{
+		assert(width <= sizeof(nuLong));
+		nuLong value = 0;
+		for (std::size_t i = 0; i < width; ++i)
+		{
+			value |= static_cast<nuLong>(buffer[i]) << (i * 8);
+		}
+
+		return value;
+	}
+
+	nBool ReadLittleEndian(natStream& stream, nuLong& value, std::size_t width)
+	{
+		assert(width <= sizeof(nuLong));
+		nByte buffer[sizeof(nuLong)];
+		value = 0;
+		if (stream.ReadBytes(buffer, width) != width)
+		{
+			return false;
+		}
+
+		value = DecodeLittleEndian(buffer, width);
+		return true;
+	}
+
 	class UnresolvedId
 		: public natRefObjImpl<UnresolvedId, ASTNode>
 	{
 	public:
-		explicit UnresolvedId(nString name)
-			: m_Name{ std::move(name) }
+		explicit UnresolvedId(nString name, nuLong declId = 0)
+			: m_Name{ std::move(name) }, m_DeclId{ declId }
 		{
 		}
 
@@ -62,14 +128,166 @@ namespace
 			return m_Name;
 		}
 
+		// 引用的声明在同一元数据中的序号，为 0 时只能通过名称解析
+		nuLong GetDeclId() const noexcept
+		{
+			return m_DeclId;
+		}
+
 	private:
 		nString m_Name;
+		nuLong m_DeclId;
 	};
 }
 
-BinarySerializationArchiveReader::BinarySerializationArchiveReader(natRefPointer<natBinaryReader> reader)
-	: m_Reader{ std::move(reader) }
+BinarySerializationArchiveReader::BinarySerializationArchiveReader(natRefPointer<natBinaryReader> reader, nLen offset, nLen size)
+	: m_Reader{ std::move(reader) }, m_BaseOffset{ offset }, m_Size{}, m_Flags{ BinaryMetadataFlags::None }, m_ContentOffset{},
+	  m_CurrentBlock{ std::numeric_limits<std::size_t>::max() }, m_Preloaded{ false }, m_Position{}
 {
+	const auto stream = m_Reader->GetUnderlyingStream();
+	if (!stream->CanSeek())
+	{
+		nat_Throw(SerializationException, u8"Stream should be seekable."_nv);
+	}
+
+	const auto streamSize = stream->GetSize();
+	if (m_BaseOffset > streamSize)
+	{
+		ThrowInvalidData();
+	}
+
+	m_Size = std::min(size, streamSize - m_BaseOffset);
+	stream->SetPositionFromBegin(m_BaseOffset);
+
+	nuLong magic, version, flags;
+	if (!ReadLittleEndian(*stream, magic, sizeof(nuInt)) || magic != BinaryMetadataMagic)
+	{
+		nat_Throw(SerializationException, u8"Not a metadata archive."_nv);
+	}
+
+	if (!ReadLittleEndian(*stream, version, sizeof(nuShort)) || version != BinaryMetadataVersion)
+	{
+		nat_Throw(SerializationException, u8"Unsupported metadata version {0}."_nv, version);
+	}
+
+	if (!ReadLittleEndian(*stream, flags, sizeof(nuShort)))
+	{
+		ThrowInvalidData();
+	}
+
+	const auto knownFlags = static_cast<nuLong>(BinaryMetadataFlags::CompactIntegers | BinaryMetadataFlags::Compressed);
+	if (flags & ~knownFlags)
+	{
+		nat_Throw(SerializationException, u8"Unsupported metadata flags {0}."_nv, flags);
+	}
+
+	m_Flags = static_cast<BinaryMetadataFlags>(flags);
+
+	m_ContentOffset = stream->GetPosition() - m_BaseOffset;
+	if (m_Size < m_ContentOffset + BinaryMetadataTrailerSize)
+	{
+		ThrowInvalidData();
+	}
+
+	nuLong stringTableOffset, indexOffset, arrayTableOffset, blockTableOffset, trailerMagic;
+	stream->SetPositionFromBegin(m_BaseOffset + m_Size - BinaryMetadataTrailerSize);
+	if (!ReadLittleEndian(*stream, stringTableOffset, sizeof(nuLong)) ||
+		!ReadLittleEndian(*stream, indexOffset, sizeof(nuLong)) ||
+		!ReadLittleEndian(*stream, arrayTableOffset, sizeof(nuLong)) ||
+		!ReadLittleEndian(*stream, blockTableOffset, sizeof(nuLong)) ||
+		!ReadLittleEndian(*stream, trailerMagic, sizeof(nuInt)) ||
+		trailerMagic != BinaryMetadataMagic)
+	{
+		ThrowInvalidData();
+	}
+
+	nuLong count;
+	if (HasAllFlags(m_Flags, BinaryMetadataFlags::Compressed))
+	{
+		// 块表总是以未压缩的定长形式存储
+		stream->SetPositionFromBegin(m_BaseOffset + blockTableOffset);
+		if (!ReadLittleEndian(*stream, count, sizeof(nuInt)))
+		{
+			ThrowInvalidData();
+		}
+
+		m_BlockOffsets.reserve(static_cast<std::size_t>(count));
+		for (nuLong i = 0; i < count; ++i)
+		{
+			nuLong offset;
+			if (!ReadLittleEndian(*stream, offset, sizeof(nuLong)) || offset >= m_Size)
+			{
+				ThrowInvalidData();
+			}
+
+			m_BlockOffsets.emplace_back(offset);
+		}
+	}
+
+	seek(stringTableOffset);
+	if (!readInteger(count, sizeof(nuInt)))
+	{
+		ThrowInvalidData();
+	}
+
+	m_Strings.reserve(static_cast<std::size_t>(count));
+	for (nuLong i = 0; i < count; ++i)
+	{
+		nuLong length;
+		if (!readInteger(length, sizeof(nuInt)))
+		{
+			ThrowInvalidData();
+		}
+
+		nString str;
+		str.Resize(static_cast<std::size_t>(length));
+		if (!readBytes(reinterpret_cast<nData>(str.data()), length))
+		{
+			ThrowInvalidData();
+		}
+
+		m_Strings.emplace_back(std::move(str));
+	}
+
+	seek(indexOffset);
+	if (!readInteger(count, sizeof(nuInt)))
+	{
+		ThrowInvalidData();
+	}
+
+	m_Index.reserve(static_cast<std::size_t>(count));
+	for (nuLong i = 0; i < count; ++i)
+	{
+		nuLong nameId, offset;
+		if (!readInteger(nameId, sizeof(nuInt)) ||
+			!readInteger(offset, sizeof(nuLong)) ||
+			nameId >= m_Strings.size())
+		{
+			ThrowInvalidData();
+		}
+
+		m_Index.emplace(m_Strings[static_cast<std::size_t>(nameId)], offset);
+	}
+
+	seek(arrayTableOffset);
+	if (!readInteger(count, sizeof(nuInt)))
+	{
+		ThrowInvalidData();
+	}
+
+	m_ArrayElementCounts.reserve(static_cast<std::size_t>(count));
+	for (nuLong i = 0; i < count; ++i)
+	{
+		nuLong elementCount;
+		if (!readInteger(elementCount, sizeof(nuInt)))
+		{
+			ThrowInvalidData();
+		}
+
+		m_ArrayElementCounts.emplace_back(static_cast<nuInt>(elementCount));
+	}
+
+	seek(m_ContentOffset);
 }
 
 BinarySerializationArchiveReader::~BinarySerializationArchiveReader()
@@ -83,136 +301,801 @@ nBool BinarySerializationArchiveReader::ReadSourceLocation(nStrView key, SourceL
 
 nBool BinarySerializationArchiveReader::ReadString(nStrView key, nString& out)
 {
-	const auto size = m_Reader->ReadPod<nuInt>();
-	out.Resize(size);
-	return m_Reader->GetUnderlyingStream()->ReadBytes(reinterpret_cast<nData>(out.data()), size) == size;
+	nuLong id;
+	if (!readInteger(id, sizeof(nuInt)) || id >= m_Strings.size())
+	{
+		return false;
+	}
+
+	out = m_Strings[static_cast<std::size_t>(id)];
+	return true;
 }
 
 nBool BinarySerializationArchiveReader::ReadInteger(nStrView key, nuLong& out, std::size_t widthHint)
 {
-	// TODO: 注意端序
-	out = 0;
-	return m_Reader->GetUnderlyingStream()->ReadBytes(reinterpret_cast<nData>(&out), widthHint);
+	return readInteger(out, widthHint);
 }
 
 nBool BinarySerializationArchiveReader::ReadFloat(nStrView key, nDouble& out, std::size_t widthHint)
 {
 	out = 0;
+	nuLong bits;
 	if (widthHint == sizeof(nFloat))
 	{
+		if (!readFixedInteger(bits, sizeof(nFloat)))
+		{
+			return false;
+		}
+
+		const auto narrowBits = static_cast<nuInt>(bits);
 		nFloat value;
-		const auto ret = m_Reader->GetUnderlyingStream()->ReadBytes(reinterpret_cast<nData>(&value), sizeof(nFloat));
+		std::memcpy(&value, &narrowBits, sizeof(nFloat));
 		out = static_cast<nDouble>(value);
-		return ret;
+		return true;
 	}
 
 	assert(widthHint == sizeof(nDouble));
-	return m_Reader->GetUnderlyingStream()->ReadBytes(reinterpret_cast<nData>(&out), sizeof(nDouble));
+	if (!readFixedInteger(bits, sizeof(nDouble)))
+	{
+		return false;
+	}
+
+	std::memcpy(&out, &bits, sizeof(nDouble));
+	return true;
 }
 
 nBool BinarySerializationArchiveReader::StartReadingEntry(nStrView key, nBool isArray)
 {
 	if (isArray)
 	{
-		const auto count = m_Reader->ReadPod<nuInt>();
-		m_EntryElementCount.emplace_back(true, static_cast<std::size_t>(count));
+		nuLong arrayId;
+		if (!readInteger(arrayId, sizeof(nuInt)) || arrayId >= m_ArrayElementCounts.size())
+		{
+			return false;
+		}
+
+		m_EntryElementCount.emplace_back(true, m_ArrayElementCounts[static_cast<std::size_t>(arrayId)]);
 	}
 	else
 	{
 		m_EntryElementCount.emplace_back(false, 1);
 	}
 
-	return true;
+	return true;
+}
+
+nBool BinarySerializationArchiveReader::NextReadingElement()
+{
+	return true;
+}
+
+std::size_t BinarySerializationArchiveReader::GetEntryElementCount()
+{
+	const auto& back = m_EntryElementCount.back();
+	return back.second;
+}
+
+void BinarySerializationArchiveReader::EndReadingEntry()
+{
+	m_EntryElementCount.pop_back();
+}
+
+nBool BinarySerializationArchiveReader::ReadIndexedEntry(nStrView name, std::function<void()> const& callback)
+{
+	const auto range = m_Index.equal_range(nString{ name });
+	if (range.first == range.second)
+	{
+		return false;
+	}
+
+	const auto scope = make_scope([this, position = m_Position, entryElementCount = std::move(m_EntryElementCount)]() mutable
+	{
+		seek(position);
+		m_EntryElementCount = std::move(entryElementCount);
+	});
+
+	for (auto iter = range.first; iter != range.second; ++iter)
+	{
+		m_EntryElementCount.clear();
+		seek(iter->second);
+		callback();
+	}
+
+	return true;
+}
+
+nBool BinarySerializationArchiveReader::EnumerateIndexedNames(std::function<void(nStrView)> const& callback)
+{
+	// 同名的索引项在 unordered_multimap 中总是相邻
+	for (auto iter = m_Index.cbegin(); iter != m_Index.cend(); iter = m_Index.equal_range(iter->first).second)
+	{
+		callback(iter->first);
+	}
+
+	return true;
+}
+
+void BinarySerializationArchiveReader::Preload()
+{
+	if (m_Preloaded)
+	{
+		return;
+	}
+
+	const auto stream = m_Reader->GetUnderlyingStream();
+	std::vector<nByte> content;
+	if (HasAllFlags(m_Flags, BinaryMetadataFlags::Compressed))
+	{
+		const auto blockCount = m_BlockOffsets.size();
+		content.reserve(blockCount * BinaryMetadataChunkSize);
+		for (std::size_t i = 0; i < blockCount; ++i)
+		{
+			// 除最后一块外各块总是填满的，否则偏移与块无法对应
+			if (!loadBlock(i) || (i + 1 < blockCount && m_Block.size() != BinaryMetadataChunkSize))
+			{
+				ThrowInvalidData();
+			}
+
+			content.insert(content.end(), m_Block.cbegin(), m_Block.cend());
+		}
+
+		m_Block = {};
+		m_CompressedBlock = {};
+		m_CurrentBlock = std::numeric_limits<std::size_t>::max();
+	}
+	else
+	{
+		content.resize(static_cast<std::size_t>(m_Size - BinaryMetadataTrailerSize - m_ContentOffset));
+		stream->SetPositionFromBegin(m_BaseOffset + m_ContentOffset);
+		if (stream->ReadBytes(content.data(), content.size()) != content.size())
+		{
+			ThrowInvalidData();
+		}
+	}
+
+	m_Content = std::move(content);
+	m_Preloaded = true;
+}
+
+nBool BinarySerializationArchiveReader::readBytes(nData data, nLen size)
+{
+	if (m_Preloaded)
+	{
+		if (m_Position < m_ContentOffset || m_Position - m_ContentOffset + size > m_Content.size())
+		{
+			return false;
+		}
+
+		std::memcpy(data, m_Content.data() + (m_Position - m_ContentOffset), static_cast<std::size_t>(size));
+		m_Position += size;
+		return true;
+	}
+
+	if (!HasAllFlags(m_Flags, BinaryMetadataFlags::Compressed))
+	{
+		if (m_Reader->GetUnderlyingStream()->ReadBytes(data, size) != size)
+		{
+			return false;
+		}
+
+		m_Position += size;
+		return true;
+	}
+
+	if (m_Position < m_ContentOffset)
+	{
+		return false;
+	}
+
+	while (size)
+	{
+		const auto offset = m_Position - m_ContentOffset;
+		if (!loadBlock(static_cast<std::size_t>(offset / BinaryMetadataChunkSize)))
+		{
+			return false;
+		}
+
+		const auto offsetInBlock = static_cast<std::size_t>(offset % BinaryMetadataChunkSize);
+		if (offsetInBlock >= m_Block.size())
+		{
+			return false;
+		}
+
+		const auto readSize = std::min(static_cast<std::size_t>(size), m_Block.size() - offsetInBlock);
+		std::memcpy(data, m_Block.data() + offsetInBlock, readSize);
+		data += readSize;
+		size -= readSize;
+		m_Position += readSize;
+	}
+
+	return true;
+}
+
+nBool BinarySerializationArchiveReader::readFixedInteger(nuLong& value, std::size_t width)
+{
+	assert(width <= sizeof(nuLong));
+	nByte buffer[sizeof(nuLong)];
+	value = 0;
+	if (!readBytes(buffer, width))
+	{
+		return false;
+	}
+
+	value = DecodeLittleEndian(buffer, width);
+	return true;
+}
+
+nBool BinarySerializationArchiveReader::readInteger(nuLong& value, std::size_t width)
+{
+	if (!HasAllFlags(m_Flags, BinaryMetadataFlags::CompactIntegers))
+	{
+		return readFixedInteger(value, width);
+	}
+
+	value = 0;
+	for (std::size_t i = 0; i < MaxVarIntSize; ++i)
+	{
+		nByte byte;
+		if (!readBytes(&byte, 1))
+		{
+			return false;
+		}
+
+		value |= static_cast<nuLong>(byte & 0x7F) << (i * 7);
+		if (!(byte & 0x80))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void BinarySerializationArchiveReader::seek(nLen position)
+{
+	m_Position = position;
+	if (!m_Preloaded && !HasAllFlags(m_Flags, BinaryMetadataFlags::Compressed))
+	{
+		m_Reader->GetUnderlyingStream()->SetPositionFromBegin(m_BaseOffset + position);
+	}
+}
+
+nBool BinarySerializationArchiveReader::loadBlock(std::size_t index)
+{
+	if (index == m_CurrentBlock)
+	{
+		return true;
+	}
+
+	m_CurrentBlock = std::numeric_limits<std::size_t>::max();
+	if (index >= m_BlockOffsets.size())
+	{
+		return false;
+	}
+
+	const auto stream = m_Reader->GetUnderlyingStream();
+	stream->SetPositionFromBegin(m_BaseOffset + m_BlockOffsets[index]);
+
+	nuLong rawSize, storedSize;
+	if (!ReadLittleEndian(*stream, rawSize, sizeof(nuInt)) ||
+		!ReadLittleEndian(*stream, storedSize, sizeof(nuInt)) ||
+		rawSize > BinaryMetadataChunkSize || storedSize > rawSize)
+	{
+		return false;
+	}
+
+	m_Block.resize(static_cast<std::size_t>(rawSize));
+	if (storedSize == rawSize)
+	{
+		// 无法压缩的块直接存储
+		if (stream->ReadBytes(m_Block.data(), rawSize) != rawSize)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if (!llvm::zlib::isAvailable())
+		{
+			nat_Throw(SerializationException, u8"Cannot read compressed metadata since zlib is not available."_nv);
+		}
+
+		m_CompressedBlock.resize(static_cast<std::size_t>(storedSize));
+		if (stream->ReadBytes(m_CompressedBlock.data(), storedSize) != storedSize)
+		{
+			return false;
+		}
+
+		auto uncompressedSize = static_cast<std::size_t>(rawSize);
+		if (auto error = llvm::zlib::uncompress(llvm::StringRef{ reinterpret_cast<const char*>(m_CompressedBlock.data()), m_CompressedBlock.size() },
+			reinterpret_cast<char*>(m_Block.data()), uncompressedSize))
+		{
+			llvm::consumeError(std::move(error));
+			return false;
+		}
+
+		if (uncompressedSize != rawSize)
+		{
+			return false;
+		}
+	}
+
+	m_CurrentBlock = index;
+	return true;
+}
+
+BinarySerializationArchiveWriter::BinarySerializationArchiveWriter(natRefPointer<natBinaryWriter> writer, BinaryMetadataFlags flags)
+	: m_Writer{ std::move(writer) }, m_Flags{ flags }, m_Position{}, m_StreamPosition{}, m_Finished{ false }
+{
+	if (!m_Writer->GetUnderlyingStream()->CanWrite())
+	{
+		nat_Throw(SerializationException, u8"Stream should be writable."_nv);
+	}
+
+	m_Buffer.reserve(BinaryMetadataChunkSize);
+
+	// 文件头不参与压缩
+	writeRawInteger(BinaryMetadataMagic, sizeof(nuInt));
+	writeRawInteger(BinaryMetadataVersion, sizeof(nuShort));
+	writeRawInteger(static_cast<nuShort>(m_Flags), sizeof(nuShort));
+	m_Position = m_StreamPosition;
+}
+
+BinarySerializationArchiveWriter::~BinarySerializationArchiveWriter()
+{
+}
+
+void BinarySerializationArchiveWriter::WriteSourceLocation(nStrView key, SourceLocation const& value)
+{
+	nat_Throw(NotImplementedException);
+}
+
+void BinarySerializationArchiveWriter::WriteString(nStrView key, nStrView value)
+{
+	writeInteger(getStringId(value), sizeof(nuInt));
+}
+
+void BinarySerializationArchiveWriter::WriteInteger(nStrView key, nuLong value, std::size_t widthHint)
+{
+	writeInteger(value, widthHint);
+}
+
+void BinarySerializationArchiveWriter::WriteFloat(nStrView key, nDouble value, std::size_t widthHint)
+{
+	if (widthHint == sizeof(nFloat))
+	{
+		const auto realValue = static_cast<nFloat>(value);
+		nuInt bits;
+		std::memcpy(&bits, &realValue, sizeof(nFloat));
+		writeFixedInteger(bits, sizeof(nFloat));
+	}
+	else
+	{
+		assert(widthHint == sizeof(nDouble));
+		nuLong bits;
+		std::memcpy(&bits, &value, sizeof(nDouble));
+		writeFixedInteger(bits, sizeof(nDouble));
+	}
+}
+
+void BinarySerializationArchiveWriter::StartWritingEntry(nStrView key, nBool isArray)
+{
+	if (isArray)
+	{
+		// 元素数量在数组写入完成后才能确定，此处仅写入数组的序号，数量将记录在数组元素数量表中
+		const auto arrayId = m_ArrayElementCounts.size();
+		m_ArrayElementCounts.emplace_back(0);
+		m_EntryElementCount.emplace_back(true, arrayId);
+		writeInteger(arrayId, sizeof(nuInt));
+	}
+	else
+	{
+		m_EntryElementCount.emplace_back(false, std::size_t{});
+	}
+}
+
+void BinarySerializationArchiveWriter::NextWritingElement()
+{
+	const auto& back = m_EntryElementCount.back();
+	if (back.first)
+	{
+		++m_ArrayElementCounts[back.second];
+	}
+}
+
+void BinarySerializationArchiveWriter::EndWritingEntry()
+{
+	m_EntryElementCount.pop_back();
+}
+
+void BinarySerializationArchiveWriter::MarkIndexEntry(nStrView name)
+{
+	m_Index.emplace_back(getStringId(name), m_Position);
+}
+
+void BinarySerializationArchiveWriter::FinishWriting()
+{
+	if (m_Finished)
+	{
+		return;
+	}
+
+	assert(m_EntryElementCount.empty());
+
+	const auto stringTableOffset = m_Position;
+	writeInteger(m_Strings.size(), sizeof(nuInt));
+	for (const auto& str : m_Strings)
+	{
+		writeInteger(str.size(), sizeof(nuInt));
+		writeBytes(reinterpret_cast<ncData>(str.data()), str.size());
+	}
+
+	const auto indexOffset = m_Position;
+	writeInteger(m_Index.size(), sizeof(nuInt));
+	for (const auto& entry : m_Index)
+	{
+		writeInteger(entry.first, sizeof(nuInt));
+		writeInteger(entry.second, sizeof(nuLong));
+	}
+
+	const auto arrayTableOffset = m_Position;
+	writeInteger(m_ArrayElementCounts.size(), sizeof(nuInt));
+	for (const auto count : m_ArrayElementCounts)
+	{
+		writeInteger(count, sizeof(nuInt));
+	}
+
+	flush();
+
+	// 块表及文件尾总是以未压缩的定长形式存储
+	nuLong blockTableOffset = 0;
+	if (HasAllFlags(m_Flags, BinaryMetadataFlags::Compressed))
+	{
+		blockTableOffset = m_StreamPosition;
+		writeRawInteger(m_BlockOffsets.size(), sizeof(nuInt));
+		for (const auto offset : m_BlockOffsets)
+		{
+			writeRawInteger(offset, sizeof(nuLong));
+		}
+	}
+
+	writeRawInteger(stringTableOffset, sizeof(nuLong));
+	writeRawInteger(indexOffset, sizeof(nuLong));
+	writeRawInteger(arrayTableOffset, sizeof(nuLong));
+	writeRawInteger(blockTableOffset, sizeof(nuLong));
+	writeRawInteger(BinaryMetadataMagic, sizeof(nuInt));
+
+	m_Finished = true;
+}
+
+nuInt BinarySerializationArchiveWriter::getStringId(nStrView str)
+{
+	nString key{ str };
+	if (const auto iter = m_StringIdMap.find(key); iter != m_StringIdMap.end())
+	{
+		return iter->second;
+	}
+
+	const auto id = static_cast<nuInt>(m_Strings.size());
+	m_Strings.emplace_back(key);
+	m_StringIdMap.emplace(std::move(key), id);
+	return id;
+}
+
+void BinarySerializationArchiveWriter::writeBytes(ncData data, nLen size)
+{
+	m_Position += size;
+
+	// 总是填满缓冲后再输出，以便读取时可以由偏移直接计算所在的块
+	while (size)
+	{
+		const auto writeSize = std::min(static_cast<std::size_t>(size), BinaryMetadataChunkSize - m_Buffer.size());
+		m_Buffer.insert(m_Buffer.end(), data, data + writeSize);
+		data += writeSize;
+		size -= writeSize;
+
+		if (m_Buffer.size() == BinaryMetadataChunkSize)
+		{
+			flush();
+		}
+	}
+}
+
+void BinarySerializationArchiveWriter::writeFixedInteger(nuLong value, std::size_t width)
+{
+	nByte buffer[sizeof(nuLong)];
+	EncodeLittleEndian(value, width, buffer);
+	writeBytes(buffer, width);
+}
+
+void BinarySerializationArchiveWriter::writeInteger(nuLong value, std::size_t width)
+{
+	if (!HasAllFlags(m_Flags, BinaryMetadataFlags::CompactIntegers))
+	{
+		writeFixedInteger(value, width);
+		return;
+	}
+
+	// 与定长形式相同，只保留指定宽度内的位，读取时亦不进行符号扩展
+	if (width < sizeof(nuLong))
+	{
+		value &= (nuLong{ 1 } << (width * 8)) - 1;
+	}
+
+	nByte buffer[MaxVarIntSize];
+	std::size_t size = 0;
+	do
+	{
+		auto byte = static_cast<nByte>(value & 0x7F);
+		value >>= 7;
+		if (value)
+		{
+			byte |= 0x80;
+		}
+		buffer[size++] = byte;
+	} while (value);
+
+	writeBytes(buffer, size);
+}
+
+void BinarySerializationArchiveWriter::writeRaw(ncData data, nLen size)
+{
+	if (m_Writer->GetUnderlyingStream()->WriteBytes(data, size) != size)
+	{
+		nat_Throw(SerializationException, u8"Cannot write to the stream."_nv);
+	}
+
+	m_StreamPosition += size;
+}
+
+void BinarySerializationArchiveWriter::writeRawInteger(nuLong value, std::size_t width)
+{
+	nByte buffer[sizeof(nuLong)];
+	EncodeLittleEndian(value, width, buffer);
+	writeRaw(buffer, width);
+}
+
+void BinarySerializationArchiveWriter::flush()
+{
+	if (m_Buffer.empty())
+	{
+		return;
+	}
+
+	if (!HasAllFlags(m_Flags, BinaryMetadataFlags::Compressed))
+	{
+		writeRaw(m_Buffer.data(), m_Buffer.size());
+		m_Buffer.clear();
+		return;
+	}
+
+	llvm::SmallVector<char, 0> compressed;
+	auto isCompressed = false;
+	// zlib 不可用或压缩后没有变小时直接存储
+	if (llvm::zlib::isAvailable())
+	{
+		if (auto error = llvm::zlib::compress(llvm::StringRef{ reinterpret_cast<const char*>(m_Buffer.data()), m_Buffer.size() },
+			compressed, llvm::zlib::BestSpeedCompression))
+		{
+			llvm::consumeError(std::move(error));
+		}
+		else
+		{
+			isCompressed = compressed.size() < m_Buffer.size();
+		}
+	}
+
+	m_BlockOffsets.emplace_back(m_StreamPosition);
+	writeRawInteger(m_Buffer.size(), sizeof(nuInt));
+	if (isCompressed)
+	{
+		writeRawInteger(compressed.size(), sizeof(nuInt));
+		writeRaw(reinterpret_cast<ncData>(compressed.data()), compressed.size());
+	}
+	else
+	{
+		writeRawInteger(m_Buffer.size(), sizeof(nuInt));
+		writeRaw(m_Buffer.data(), m_Buffer.size());
+	}
+
+	m_Buffer.clear();
+}
+
+std::optional<std::vector<BinaryMetadataBundleMember>> Serialization::ReadBinaryMetadataBundle(natStream& stream)
+{
+	const auto scope = make_scope([&stream, position = stream.GetPosition()]
+	{
+		stream.SetPositionFromBegin(position);
+	});
+
+	const auto size = stream.GetSize();
+	nuLong magic, version;
+	stream.SetPositionFromBegin(0);
+	if (size < BinaryMetadataBundleHeaderSize + BinaryMetadataBundleTrailerSize ||
+		!ReadLittleEndian(stream, magic, sizeof(nuInt)) || magic != BinaryMetadataBundleMagic)
+	{
+		return {};
+	}
+
+	if (!ReadLittleEndian(stream, version, sizeof(nuShort)) || version != BinaryMetadataBundleVersion)
+	{
+		nat_Throw(SerializationException, u8"Unsupported metadata bundle version {0}."_nv, version);
+	}
+
+	nuLong memberTableOffset, trailerMagic, count;
+	stream.SetPositionFromBegin(size - BinaryMetadataBundleTrailerSize);
+	if (!ReadLittleEndian(stream, memberTableOffset, sizeof(nuLong)) ||
+		!ReadLittleEndian(stream, trailerMagic, sizeof(nuInt)) ||
+		trailerMagic != BinaryMetadataBundleMagic ||
+		memberTableOffset > size - BinaryMetadataBundleTrailerSize)
+	{
+		ThrowInvalidData();
+	}
+
+	stream.SetPositionFromBegin(memberTableOffset);
+	if (!ReadLittleEndian(stream, count, sizeof(nuInt)))
+	{
+		ThrowInvalidData();
+	}
+
+	std::vector<BinaryMetadataBundleMember> members;
+	members.reserve(static_cast<std::size_t>(count));
+	for (nuLong i = 0; i < count; ++i)
+	{
+		nuLong offset, memberSize;
+		nByte digest[BinaryMetadataBundleDigestSize];
+		if (!ReadLittleEndian(stream, offset, sizeof(nuLong)) ||
+			!ReadLittleEndian(stream, memberSize, sizeof(nuLong)) ||
+			stream.ReadBytes(digest, sizeof digest) != sizeof digest ||
+			offset < BinaryMetadataBundleHeaderSize || offset > memberTableOffset || memberSize > memberTableOffset - offset)
+		{
+			ThrowInvalidData();
+		}
+
+		members.push_back({ offset, memberSize });
+	}
+
+	return members;
 }
 
-nBool BinarySerializationArchiveReader::NextReadingElement()
+BinaryMetadataBundleWriter::BinaryMetadataBundleWriter(natRefPointer<natStream> stream)
+	: m_Stream{ std::move(stream) }, m_Position{}, m_Finished{ false }
 {
-	return true;
-}
+	if (!m_Stream->CanWrite())
+	{
+		nat_Throw(SerializationException, u8"Stream should be writable."_nv);
+	}
 
-std::size_t BinarySerializationArchiveReader::GetEntryElementCount()
-{
-	const auto& back = m_EntryElementCount.back();
-	return back.second;
+	writeInteger(BinaryMetadataBundleMagic, sizeof(nuInt));
+	writeInteger(BinaryMetadataBundleVersion, sizeof(nuShort));
+	// 保留
+	writeInteger(0, sizeof(nuShort));
 }
 
-void BinarySerializationArchiveReader::EndReadingEntry()
+BinaryMetadataBundleWriter::~BinaryMetadataBundleWriter()
 {
-	m_EntryElementCount.pop_back();
 }
 
-BinarySerializationArchiveWriter::BinarySerializationArchiveWriter(natRefPointer<natBinaryWriter> writer)
-	: m_Writer{ std::move(writer) }
+std::size_t BinaryMetadataBundleWriter::AddMetadata(natStream& stream)
 {
-	if (!m_Writer->GetUnderlyingStream()->CanSeek())
+	if (!stream.CanSeek())
 	{
 		nat_Throw(SerializationException, u8"Stream should be seekable."_nv);
 	}
-}
 
-BinarySerializationArchiveWriter::~BinarySerializationArchiveWriter()
-{
-}
+	if (const auto members = ReadBinaryMetadataBundle(stream))
+	{
+		std::size_t count = 0;
+		for (const auto& member : members.value())
+		{
+			count += addMember(stream, member);
+		}
 
-void BinarySerializationArchiveWriter::WriteSourceLocation(nStrView key, SourceLocation const& value)
-{
-	nat_Throw(NotImplementedException);
-}
+		return count;
+	}
 
-void BinarySerializationArchiveWriter::WriteString(nStrView key, nStrView value)
-{
-	const auto size = value.size();
-	m_Writer->WritePod(static_cast<nuInt>(size));
-	m_Writer->GetUnderlyingStream()->WriteBytes(reinterpret_cast<ncData>(value.data()), size);
+	return addMember(stream, { 0, stream.GetSize() });
 }
 
-void BinarySerializationArchiveWriter::WriteInteger(nStrView key, nuLong value, std::size_t widthHint)
+void BinaryMetadataBundleWriter::FinishWriting()
 {
-	// TODO: 注意端序
-	m_Writer->GetUnderlyingStream()->WriteBytes(reinterpret_cast<ncData>(&value), widthHint);
+	if (m_Finished)
+	{
+		return;
+	}
+
+	const auto memberTableOffset = m_Position;
+	writeInteger(m_Members.size(), sizeof(nuInt));
+	for (const auto& member : m_Members)
+	{
+		writeInteger(member.first.Offset, sizeof(nuLong));
+		writeInteger(member.first.Size, sizeof(nuLong));
+		write(member.second.data(), member.second.size());
+	}
+
+	writeInteger(memberTableOffset, sizeof(nuLong));
+	writeInteger(BinaryMetadataBundleMagic, sizeof(nuInt));
+
+	m_Finished = true;
 }
 
-void BinarySerializationArchiveWriter::WriteFloat(nStrView key, nDouble value, std::size_t widthHint)
+nBool BinaryMetadataBundleWriter::addMember(natStream& stream, BinaryMetadataBundleMember const& member)
 {
-	// TODO: 注意端序
-	if (widthHint == sizeof(nFloat))
+	nuLong magic, version;
+	stream.SetPositionFromBegin(member.Offset);
+	if (member.Size < sizeof(nuInt) + sizeof(nuShort) ||
+		!ReadLittleEndian(stream, magic, sizeof(nuInt)) || magic != BinaryMetadataMagic ||
+		!ReadLittleEndian(stream, version, sizeof(nuShort)))
 	{
-		const auto realValue = static_cast<nFloat>(value);
-		m_Writer->GetUnderlyingStream()->WriteBytes(reinterpret_cast<ncData>(&realValue), sizeof(nFloat));
+		nat_Throw(SerializationException, u8"Not a metadata archive."_nv);
 	}
-	else
+
+	if (version != BinaryMetadataVersion)
 	{
-		assert(widthHint == sizeof(nDouble));
-		m_Writer->GetUnderlyingStream()->WriteBytes(reinterpret_cast<ncData>(&value), sizeof(nDouble));
+		nat_Throw(SerializationException, u8"Unsupported metadata version {0}."_nv, version);
 	}
-}
 
-void BinarySerializationArchiveWriter::StartWritingEntry(nStrView key, nBool isArray)
-{
-	m_EntryElementCount.emplace_back(isArray, m_Writer->GetUnderlyingStream()->GetPosition(), std::size_t{});
-	if (isArray)
+	std::vector<nByte> buffer(BinaryMetadataChunkSize);
+	const auto forEachChunk = [&](auto&& callback)
 	{
-		m_Writer->WritePod(nuInt{});
+		stream.SetPositionFromBegin(member.Offset);
+		for (auto remainedSize = member.Size; remainedSize;)
+		{
+			const auto readSize = static_cast<std::size_t>(std::min<nLen>(remainedSize, buffer.size()));
+			if (stream.ReadBytes(buffer.data(), readSize) != readSize)
+			{
+				ThrowInvalidData();
+			}
+
+			callback(readSize);
+			remainedSize -= readSize;
+		}
+	};
+
+	// 先计算摘要，输出的流可能不可定位，因此确定不是重复的元数据之后才写入
+	llvm::MD5 hash;
+	forEachChunk([&](std::size_t size)
+	{
+		hash.update(llvm::ArrayRef<nByte>{ buffer.data(), size });
+	});
+
+	llvm::MD5::MD5Result result;
+	hash.final(result);
+	std::array<nByte, BinaryMetadataBundleDigestSize> digest;
+	for (std::size_t i = 0; i < digest.size(); ++i)
+	{
+		digest[i] = result[i];
 	}
-}
 
-void BinarySerializationArchiveWriter::NextWritingElement()
-{
-	++std::get<2>(m_EntryElementCount.back());
+	if (!m_Digests.emplace(digest).second)
+	{
+		return false;
+	}
+
+	m_Members.emplace_back(BinaryMetadataBundleMember{ m_Position, member.Size }, digest);
+	forEachChunk([&](std::size_t size)
+	{
+		write(buffer.data(), size);
+	});
+
+	return true;
 }
 
-void BinarySerializationArchiveWriter::EndWritingEntry()
+void BinaryMetadataBundleWriter::write(ncData data, nLen size)
 {
-	const auto& back = m_EntryElementCount.back();
-	if (std::get<0>(back))
+	if (m_Stream->WriteBytes(data, size) != size)
 	{
-		const auto pos = m_Writer->GetUnderlyingStream()->GetPosition();
-		m_Writer->GetUnderlyingStream()->SetPositionFromBegin(std::get<1>(back));
-		m_Writer->WritePod(static_cast<nuInt>(std::get<2>(back)));
-		m_Writer->GetUnderlyingStream()->SetPositionFromBegin(pos);
+		nat_Throw(SerializationException, u8"Cannot write to the stream."_nv);
 	}
 
-	m_EntryElementCount.pop_back();
+	m_Position += size;
+}
+
+void BinaryMetadataBundleWriter::writeInteger(nuLong value, std::size_t width)
+{
+	nByte buffer[sizeof(nuLong)];
+	EncodeLittleEndian(value, width, buffer);
+	write(buffer, width);
 }
 
 Deserializer::Deserializer(Syntax::Parser& parser,
@@ -252,9 +1135,14 @@ Deserializer::Deserializer(Syntax::Parser& parser,
 	}
 }
 
+// 析构函数可能在其他反序列化错误引发的展开过程中被调用，因此不能抛出异常，未能回填的引用由 Finish 报告
 Deserializer::~Deserializer()
 {
-	if (!m_UnresolvedDeclFixers.empty())
+}
+
+void Deserializer::Finish()
+{
+	if (!m_UnresolvedDeclFixers.empty() || hasPendingFixers())
 	{
 		ThrowInvalidData();
 	}
@@ -264,6 +1152,8 @@ std::size_t Deserializer::StartDeserialize(natRefPointer<ISerializationArchiveRe
 {
 	m_Archive = std::move(archive);
 	m_IsImporting = isImporting;
+	// 声明的序号仅在同一元数据中有意义
+	resetDeclIds();
 	m_Sema.PushScope(Semantic::ScopeFlags::DeclarableScope);
 	m_PseudoTranslationUnit = make_ref<Declaration::TranslationUnitDecl>(m_Sema.GetASTContext());
 	// 假装属于真正的翻译单元，不会真的加进去
@@ -281,6 +1171,52 @@ void Deserializer::EndDeserialize()
 	m_Sema.PopScope();
 	m_PseudoTranslationUnit->RemoveAllDecl();
 	m_PseudoTranslationUnit.Reset();
+
+	// 所有对同一元数据中声明的引用都应已被回填
+	if (hasPendingFixers())
+	{
+		resetDeclIds();
+		ThrowInvalidData();
+	}
+}
+
+void Deserializer::StartLazyDeserialize(natRefPointer<ISerializationArchiveReader> archive, nBool isImporting)
+{
+	m_Archive = std::move(archive);
+	m_IsImporting = isImporting;
+	resetDeclIds();
+	// 按需加载可能发生在分析源码的任意时刻，因此不压入 Sema 的作用域，仅在加载时临时切换
+	m_LazyScope = make_ref<Semantic::Scope>(m_Sema.GetTranslationUnitScope(), Semantic::ScopeFlags::DeclarableScope);
+	m_PseudoTranslationUnit = make_ref<Declaration::TranslationUnitDecl>(m_Sema.GetASTContext());
+	m_PseudoTranslationUnit->SetContext(m_Sema.GetASTContext().GetTranslationUnit().Get());
+}
+
+void Deserializer::EndLazyDeserialize()
+{
+	m_PseudoTranslationUnit->RemoveAllDecl();
+	m_PseudoTranslationUnit.Reset();
+	m_LazyScope.Reset();
+}
+
+std::vector<ASTNodePtr> Deserializer::DeserializeIndexed(nStrView name)
+{
+	assert(m_LazyScope && "Lazy deserialization not started.");
+
+	const auto recoveryScope = make_scope([this, curScope = m_Sema.GetCurrentScope(), curDeclContext = m_Sema.GetDeclContext()]() mutable
+	{
+		m_Sema.SetDeclContext(std::move(curDeclContext));
+		m_Sema.SetCurrentScope(std::move(curScope));
+	});
+	m_Sema.SetCurrentScope(m_LazyScope);
+	m_Sema.SetDeclContext(m_PseudoTranslationUnit);
+
+	std::vector<ASTNodePtr> result;
+	m_Archive->ReadIndexedEntry(name, [this, &result]
+	{
+		result.emplace_back(Deserialize());
+	});
+
+	return result;
 }
 
 ASTNodePtr Deserializer::Deserialize()
@@ -349,7 +1285,9 @@ ASTNodePtr Deserializer::DeserializeDecl()
 		if (type >= Declaration::Decl::FirstNamed && type <= Declaration::Decl::LastNamed)
 		{
 			nString name;
-			if (!m_Archive->ReadString(u8"Name"_nv, name))
+			// 与 Serializer::getDeclId 的返回类型一致，固定宽度编码时读取的字节数取决于此类型
+			nuInt declId;
+			if (!m_Archive->ReadString(u8"Name"_nv, name) || !m_Archive->ReadNumType(u8"Id"_nv, declId))
 			{
 				ThrowInvalidData();
 			}
@@ -373,7 +1311,7 @@ ASTNodePtr Deserializer::DeserializeDecl()
 
 				if (const auto& unresolved = aliasAs.Cast<UnresolvedId>())
 				{
-					m_UnresolvedDeclFixers[unresolved->GetName()].emplace(ret, [ret](natRefPointer<Declaration::NamedDecl> decl)
+					addDeclFixer(unresolved, ret, [ret](natRefPointer<Declaration::NamedDecl> decl)
 					{
 						if (const auto tag = decl.Cast<Declaration::TypeDecl>())
 						{
@@ -386,7 +1324,7 @@ ASTNodePtr Deserializer::DeserializeDecl()
 					});
 				}
 
-				tryResolve(ret);
+				tryResolve(ret, declId);
 				for (auto attr : attributes)
 				{
 					ret->AttachAttribute(std::move(attr));
@@ -398,6 +1336,7 @@ ASTNodePtr Deserializer::DeserializeDecl()
 			case Declaration::Decl::Module:
 			{
 				auto module = m_Sema.ActOnModuleDecl(m_Sema.GetCurrentScope(), {}, std::move(id));
+				tryResolve(module, declId);
 				{
 					Syntax::Parser::ParseScope moduleScope{
 						&m_Parser, Semantic::ScopeFlags::DeclarableScope | Semantic::ScopeFlags::ModuleScope
@@ -419,7 +1358,6 @@ ASTNodePtr Deserializer::DeserializeDecl()
 					m_Sema.ActOnFinishModule();
 				}
 
-				tryResolve(module);
 				for (auto attr : attributes)
 				{
 					module->AttachAttribute(std::move(attr));
@@ -446,6 +1384,9 @@ ASTNodePtr Deserializer::DeserializeDecl()
 					tagDecl->SetTypeForDecl(make_ref<Type::EnumType>(tagDecl));
 				}
 
+				// 尽早登记，使成员中对此类型的引用可以直接通过序号解析
+				tryResolve(tagDecl, declId);
+
 				{
 					auto flag = Semantic::ScopeFlags::DeclarableScope;
 					if (type == Declaration::Decl::Class)
@@ -488,12 +1429,13 @@ ASTNodePtr Deserializer::DeserializeDecl()
 					{
 						ThrowInvalidData();
 					}
+					m_Archive->EndReadingEntry();
 
 					assert(type == Declaration::Decl::Enum);
 					auto enumDecl = tagDecl.UnsafeCast<Declaration::EnumDecl>();
 					if (const auto& unresolved = underlyingType.Cast<UnresolvedId>())
 					{
-						m_UnresolvedDeclFixers[unresolved->GetName()].emplace(
+						addDeclFixer(unresolved,
 							enumDecl, [enumDecl](natRefPointer<Declaration::NamedDecl> const& decl)
 							{
 								enumDecl->SetUnderlyingType(decl.Cast<Declaration::TypeDecl>()->GetTypeForDecl());
@@ -505,7 +1447,6 @@ ASTNodePtr Deserializer::DeserializeDecl()
 					}
 				}
 
-				tryResolve(tagDecl);
 				for (auto attr : attributes)
 				{
 					tagDecl->AttachAttribute(std::move(attr));
@@ -537,7 +1478,7 @@ ASTNodePtr Deserializer::DeserializeDecl()
 						auto fieldDecl = make_ref<Declaration::FieldDecl>(Declaration::Decl::Field, dc, SourceLocation{},
 						                                                  SourceLocation{}, std::move(id), std::move(valueType));
 						m_Sema.PushOnScopeChains(fieldDecl, m_Sema.GetCurrentScope());
-						tryResolve(fieldDecl);
+						tryResolve(fieldDecl, declId);
 						for (auto attr : attributes)
 						{
 							fieldDecl->AttachAttribute(std::move(attr));
@@ -554,7 +1495,7 @@ ASTNodePtr Deserializer::DeserializeDecl()
 						const auto enumeratorDecl = make_ref<Declaration::EnumConstantDecl>(dc, SourceLocation{}, std::move(id),
 						                                                                    std::move(valueType), nullptr, value);
 						m_Sema.PushOnScopeChains(enumeratorDecl, m_Sema.GetCurrentScope());
-						tryResolve(enumeratorDecl);
+						tryResolve(enumeratorDecl, declId);
 						for (auto attr : attributes)
 						{
 							enumeratorDecl->AttachAttribute(std::move(attr));
@@ -748,7 +1689,7 @@ ASTNodePtr Deserializer::DeserializeDecl()
 							}
 
 							m_Sema.PushOnScopeChains(decl, m_Sema.GetCurrentScope(), addToContext);
-							tryResolve(decl);
+							tryResolve(decl, declId);
 							for (auto attr : attributes)
 							{
 								decl->AttachAttribute(std::move(attr));
@@ -895,10 +1836,12 @@ ASTNodePtr Deserializer::DeserializeType()
 			ThrowInvalidData();
 		}
 
+		m_Archive->EndReadingEntry();
+
 		if (const auto unresolved = pointeeType.Cast<UnresolvedId>())
 		{
 			auto retType = m_Sema.GetASTContext().GetPointerType(getUnresolvedType(unresolved->GetName()));
-			m_UnresolvedDeclFixers[unresolved->GetName()].emplace(
+			addDeclFixer(unresolved,
 				retType, [this, retType](natRefPointer<Declaration::NamedDecl> const& decl)
 				{
 					m_Sema.GetASTContext().EraseType(retType);
@@ -909,7 +1852,6 @@ ASTNodePtr Deserializer::DeserializeType()
 			return retType;
 		}
 
-		m_Archive->EndReadingEntry();
 		return m_Sema.GetASTContext().GetPointerType(std::move(pointeeType));
 	}
 	case Type::Type::Array:
@@ -930,7 +1872,7 @@ ASTNodePtr Deserializer::DeserializeType()
 		if (const auto unresolved = elementType.Cast<UnresolvedId>())
 		{
 			auto retType = m_Sema.GetASTContext().GetArrayType(getUnresolvedType(unresolved->GetName()), arraySize);
-			m_UnresolvedDeclFixers[unresolved->GetName()].emplace(
+			addDeclFixer(unresolved,
 				retType, [this, retType](natRefPointer<Declaration::NamedDecl> const& decl)
 				{
 					m_Sema.GetASTContext().EraseType(retType);
@@ -992,10 +1934,12 @@ ASTNodePtr Deserializer::DeserializeType()
 			ThrowInvalidData();
 		}
 
+		m_Archive->EndReadingEntry();
+
 		if (const auto unresolved = innerType.Cast<UnresolvedId>())
 		{
 			auto retType = m_Sema.GetASTContext().GetParenType(getUnresolvedType(unresolved->GetName()));
-			m_UnresolvedDeclFixers[unresolved->GetName()].emplace(
+			addDeclFixer(unresolved,
 				retType, [this, retType](natRefPointer<Declaration::NamedDecl> const& decl)
 				{
 					m_Sema.GetASTContext().EraseType(retType);
@@ -1006,25 +1950,40 @@ ASTNodePtr Deserializer::DeserializeType()
 			return retType;
 		}
 
-		m_Archive->EndReadingEntry();
 		return m_Sema.GetASTContext().GetParenType(std::move(innerType));
 	}
 	case Type::Type::Class:
 	case Type::Type::Enum:
 	{
+		nuInt tagDeclId;
 		nString tagDeclName;
-		if (!m_Archive->ReadString(u8"TagDecl"_nv, tagDeclName))
+		if (!m_Archive->ReadNumType(u8"TagDeclId"_nv, tagDeclId) || !m_Archive->ReadString(u8"TagDecl"_nv, tagDeclName))
+		{
+			ThrowInvalidData();
+		}
+
+		// 引用同一元数据中已读取的声明时直接通过序号获得，无需解析名称
+		if (const auto declared = getDeclById(tagDeclId))
 		{
+			if (const auto tagDecl = declared.Cast<Declaration::TagDecl>())
+			{
+				return tagDecl->GetTypeForDecl();
+			}
+
 			ThrowInvalidData();
 		}
 
-		const auto tagDecl = parseQualifiedName(tagDeclName).Cast<Declaration::TagDecl>();
-		if (!tagDecl)
+		// 引用其他元数据中的声明时只能通过名称查找，按需加载时名称查找也将触发对应声明的加载
+		// 否则为对同一元数据中之后的声明的引用，待其被读取后回填
+		if (!tagDeclId || m_LazyScope)
 		{
-			return make_ref<UnresolvedId>(std::move(tagDeclName));
+			if (const auto tagDecl = parseQualifiedName(tagDeclName).Cast<Declaration::TagDecl>())
+			{
+				return tagDecl->GetTypeForDecl();
+			}
 		}
 
-		return tagDecl->GetTypeForDecl();
+		return make_ref<UnresolvedId>(std::move(tagDeclName), tagDeclId);
 	}
 	case Type::Type::Auto:
 	{
@@ -1038,10 +1997,12 @@ ASTNodePtr Deserializer::DeserializeType()
 			ThrowInvalidData();
 		}
 
+		m_Archive->EndReadingEntry();
+
 		if (const auto unresolved = deducedAsType.Cast<UnresolvedId>())
 		{
 			auto retType = m_Sema.GetASTContext().GetAutoType(getUnresolvedType(unresolved->GetName()));
-			m_UnresolvedDeclFixers[unresolved->GetName()].emplace(
+			addDeclFixer(unresolved,
 				retType, [this, retType](natRefPointer<Declaration::NamedDecl> const& decl)
 				{
 					m_Sema.GetASTContext().EraseType(retType);
@@ -1052,7 +2013,6 @@ ASTNodePtr Deserializer::DeserializeType()
 			return retType;
 		}
 
-		m_Archive->EndReadingEntry();
 		return m_Sema.GetASTContext().GetAutoType(std::move(deducedAsType));
 	}
 	case Type::Type::Unresolved:
@@ -1090,11 +2050,14 @@ Identifier::IdPtr Deserializer::getId(nStrView name) const
 
 natRefPointer<Declaration::NamedDecl> Deserializer::parseQualifiedName(nStrView name)
 {
+	// 按需加载时可能正处于源码的分析过程中，需要同时恢复当前的 Token
 	const auto scope = make_scope(
-		[this, oldLexer = m_Parser.GetPreprocessor().GetLexer(), diagEnabled = m_Sema.GetDiagnosticsEngine().IsDiagEnabled()
+		[this, oldLexer = m_Parser.GetPreprocessor().GetLexer(), oldToken = m_Parser.GetCurrentToken(),
+			diagEnabled = m_Sema.GetDiagnosticsEngine().IsDiagEnabled()
 		]() mutable
 		{
 			m_Parser.GetPreprocessor().SetLexer(std::move(oldLexer));
+			m_Parser.SetCurrentToken(std::move(oldToken));
 			m_Sema.GetDiagnosticsEngine().EnableDiag(diagEnabled);
 		});
 
@@ -1143,8 +2106,70 @@ natRefPointer<Type::UnresolvedType> Deserializer::getUnresolvedType(nStrView nam
 	return m_Sema.GetASTContext().GetUnresolvedType({ token });
 }
 
-void Deserializer::tryResolve(natRefPointer<Declaration::NamedDecl> const& namedDecl)
+natRefPointer<Declaration::NamedDecl> Deserializer::getDeclById(nuLong declId) const noexcept
+{
+	if (!declId || declId > m_DeclById.size())
+	{
+		return nullptr;
+	}
+
+	return m_DeclById[static_cast<std::size_t>(declId - 1)];
+}
+
+nBool Deserializer::hasPendingFixers() const noexcept
+{
+	return std::any_of(m_PendingDeclFixers.cbegin(), m_PendingDeclFixers.cend(), [](std::vector<DeclFixer> const& fixers)
+	{
+		return !fixers.empty();
+	});
+}
+
+void Deserializer::resetDeclIds()
+{
+	m_DeclById.clear();
+	m_PendingDeclFixers.clear();
+}
+
+void Deserializer::addDeclFixer(ASTNodePtr const& unresolved, ASTNodePtr const& node, DeclFixer fixer)
+{
+	const auto unresolvedId = unresolved.UnsafeCast<UnresolvedId>();
+	if (const auto declId = unresolvedId->GetDeclId())
+	{
+		if (declId > m_PendingDeclFixers.size())
+		{
+			m_PendingDeclFixers.resize(static_cast<std::size_t>(declId));
+		}
+
+		m_PendingDeclFixers[static_cast<std::size_t>(declId - 1)].emplace_back(std::move(fixer));
+		return;
+	}
+
+	m_UnresolvedDeclFixers[unresolvedId->GetName()].emplace(node, std::move(fixer));
+}
+
+void Deserializer::tryResolve(natRefPointer<Declaration::NamedDecl> const& namedDecl, nuLong declId)
 {
+	if (declId)
+	{
+		const auto index = static_cast<std::size_t>(declId - 1);
+		if (index >= m_DeclById.size())
+		{
+			m_DeclById.resize(index + 1);
+		}
+
+		m_DeclById[index] = namedDecl;
+
+		if (index < m_PendingDeclFixers.size())
+		{
+			const auto fixers = std::move(m_PendingDeclFixers[index]);
+			m_PendingDeclFixers[index].clear();
+			for (const auto& fixer : fixers)
+			{
+				fixer(namedDecl);
+			}
+		}
+	}
+
 	if (const auto iter = m_UnresolvedDeclFixers.find(GetQualifiedName(namedDecl)); iter != m_UnresolvedDeclFixers.end())
 	{
 		for (const auto& fixer : iter->second)
@@ -1156,6 +2181,73 @@ void Deserializer::tryResolve(natRefPointer<Declaration::NamedDecl> const& named
 	}
 }
 
+LazyMetadataSource::LazyMetadataSource(Syntax::Parser& parser, natRefPointer<ISerializationArchiveReader> archive,
+                                       nBool feedAstConsumer)
+	: m_Sema{ parser.GetSema() }, m_Archive{ std::move(archive) }, m_Deserializer{ parser },
+	  m_FeedAstConsumer{ feedAstConsumer }, m_AllLoaded{ false }
+{
+	m_Deserializer.StartLazyDeserialize(m_Archive);
+}
+
+LazyMetadataSource::~LazyMetadataSource()
+{
+	m_Deserializer.EndLazyDeserialize();
+}
+
+void LazyMetadataSource::LoadDecls(Identifier::IdPtr const& id)
+{
+	if (!m_AllLoaded)
+	{
+		load(id->GetName());
+	}
+}
+
+void LazyMetadataSource::LoadAllDecls()
+{
+	if (m_AllLoaded)
+	{
+		return;
+	}
+
+	std::vector<nString> names;
+	m_Archive->EnumerateIndexedNames([&names](nStrView name)
+	{
+		// 模块成员的索引项名称为限定名称，将随所属的模块一同加载
+		if (std::find(name.cbegin(), name.cend(), '.') == name.cend())
+		{
+			names.emplace_back(name);
+		}
+	});
+
+	for (const auto& name : names)
+	{
+		load(name);
+	}
+
+	m_AllLoaded = true;
+}
+
+void LazyMetadataSource::load(nStrView name)
+{
+	if (!m_LoadedNames.emplace(name).second)
+	{
+		return;
+	}
+
+	const auto nodes = m_Deserializer.DeserializeIndexed(name);
+
+	Metadata metadata;
+	// 同名模块可能已由其他元数据加载，此时成员已合并到现有的模块中，不需要再次加入翻译单元
+	metadata.AddDecls(from(nodes).select([](ASTNodePtr const& node)
+	{
+		return node.Cast<Declaration::Decl>();
+	}).where([this](Declaration::DeclPtr const& decl)
+	{
+		return decl && !m_Sema.IsImported(decl);
+	}));
+	m_Sema.LoadMetadata(metadata, m_FeedAstConsumer);
+}
+
 Serializer::Serializer(Semantic::Sema& sema,
                        natRefPointer<Misc::TextProvider<Statement::Stmt::StmtType>> stmtTypeMap,
                        natRefPointer<Misc::TextProvider<Declaration::Decl::DeclType>> declTypeMap,
@@ -1173,22 +2265,59 @@ void Serializer::StartSerialize(natRefPointer<ISerializationArchiveWriter> archi
 {
 	m_Archive = std::move(archive);
 	m_IsExporting = isExporting;
+	m_DeclIds.clear();
+	m_DeclWritten.clear();
 	m_Archive->StartWritingEntry(u8"Content"_nv, true);
 }
 
 void Serializer::EndSerialize()
 {
 	m_Archive->EndWritingEntry();
+
+	// 被引用的同一元数据中的声明必须都已写入，否则导入时将无法回填
+	if (const auto iter = std::find(m_DeclWritten.cbegin(), m_DeclWritten.cend(), false); iter != m_DeclWritten.cend())
+	{
+		const auto declId = static_cast<nuInt>(iter - m_DeclWritten.cbegin() + 1);
+		const auto decl = std::find_if(m_DeclIds.cbegin(), m_DeclIds.cend(), [declId](auto const& pair)
+		{
+			return pair.second == declId;
+		});
+		assert(decl != m_DeclIds.cend());
+		nat_Throw(SerializationException, u8"Referenced declaration \"{0}\" is not serialized."_nv, GetQualifiedName(decl->first));
+	}
+
+	m_Archive->FinishWriting();
 }
 
 void Serializer::VisitCatchStmt(natRefPointer<Statement::CatchStmt> const& stmt)
 {
-	nat_Throw(NotImplementedException);
+	VisitStmt(stmt);
+	const auto exDecl = stmt->GetExceptionDecl();
+	m_Archive->WriteBool(u8"IsCatchAll"_nv, !exDecl);
+	if (exDecl)
+	{
+		m_Archive->StartWritingEntry(u8"ExceptionDecl"_nv);
+		DeclVisitor::Visit(exDecl);
+		m_Archive->EndWritingEntry();
+	}
+	m_Archive->StartWritingEntry(u8"HandlerBlock"_nv);
+	StmtVisitor::Visit(stmt->GetHandlerBlcok());
+	m_Archive->EndWritingEntry();
 }
 
 void Serializer::VisitTryStmt(natRefPointer<Statement::TryStmt> const& stmt)
 {
-	nat_Throw(NotImplementedException);
+	VisitStmt(stmt);
+	m_Archive->StartWritingEntry(u8"TryBlock"_nv);
+	StmtVisitor::Visit(stmt->GetTryBlock());
+	m_Archive->EndWritingEntry();
+	m_Archive->StartWritingEntry(u8"Handlers"_nv, true);
+	for (const auto& handler : stmt->GetHandlers())
+	{
+		StmtVisitor::Visit(handler);
+		m_Archive->NextWritingElement();
+	}
+	m_Archive->EndWritingEntry();
 }
 
 void Serializer::VisitCompoundStmt(natRefPointer<Statement::CompoundStmt> const& stmt)
@@ -1297,7 +2426,15 @@ void Serializer::VisitThisExpr(natRefPointer<Expression::ThisExpr> const& expr)
 
 void Serializer::VisitThrowExpr(natRefPointer<Expression::ThrowExpr> const& expr)
 {
-	nat_Throw(NotImplementedException);
+	VisitExpr(expr);
+	const auto operand = expr->GetOperand();
+	m_Archive->WriteBool(u8"IsRethrow"_nv, !operand);
+	if (operand)
+	{
+		m_Archive->StartWritingEntry(u8"Operand"_nv);
+		StmtVisitor::Visit(operand);
+		m_Archive->EndWritingEntry();
+	}
 }
 
 void Serializer::VisitCallExpr(natRefPointer<Expression::CallExpr> const& expr)
@@ -1462,17 +2599,33 @@ void Serializer::VisitSwitchCase(natRefPointer<Statement::SwitchCase> const& stm
 
 void Serializer::VisitCaseStmt(natRefPointer<Statement::CaseStmt> const& stmt)
 {
-	nat_Throw(NotImplementedException);
+	VisitStmt(stmt);
+	m_Archive->StartWritingEntry(u8"Expr"_nv);
+	StmtVisitor::Visit(stmt->GetExpr());
+	m_Archive->EndWritingEntry();
+	m_Archive->StartWritingEntry(u8"SubStmt"_nv);
+	StmtVisitor::Visit(stmt->GetSubStmt());
+	m_Archive->EndWritingEntry();
 }
 
 void Serializer::VisitDefaultStmt(natRefPointer<Statement::DefaultStmt> const& stmt)
 {
-	nat_Throw(NotImplementedException);
+	VisitStmt(stmt);
+	m_Archive->StartWritingEntry(u8"SubStmt"_nv);
+	StmtVisitor::Visit(stmt->GetSubStmt());
+	m_Archive->EndWritingEntry();
 }
 
+// case 列表可由语句体重建，因此不单独写入
 void Serializer::VisitSwitchStmt(natRefPointer<Statement::SwitchStmt> const& stmt)
 {
-	nat_Throw(NotImplementedException);
+	VisitStmt(stmt);
+	m_Archive->StartWritingEntry(u8"Cond"_nv);
+	StmtVisitor::Visit(stmt->GetCond());
+	m_Archive->EndWritingEntry();
+	m_Archive->StartWritingEntry(u8"Body"_nv);
+	StmtVisitor::Visit(stmt->GetBody());
+	m_Archive->EndWritingEntry();
 }
 
 void Serializer::VisitWhileStmt(natRefPointer<Statement::WhileStmt> const& stmt)
@@ -1514,6 +2667,9 @@ void Serializer::VisitNamedDecl(natRefPointer<Declaration::NamedDecl> const& dec
 {
 	VisitDecl(decl);
 	m_Archive->WriteString(u8"Name"_nv, decl->GetName());
+	const auto declId = getDeclId(decl);
+	m_DeclWritten[declId - 1] = true;
+	m_Archive->WriteNumType(u8"Id"_nv, declId);
 }
 
 void Serializer::VisitAliasDecl(natRefPointer<Declaration::AliasDecl> const& decl)
@@ -1554,6 +2710,7 @@ void Serializer::VisitModuleDecl(natRefPointer<Declaration::ModuleDecl> const& d
 	m_Archive->StartWritingEntry(u8"Members"_nv, true);
 	for (const auto& d : decl->GetDecls())
 	{
+		markIndexEntry(d);
 		DeclVisitor::Visit(d);
 		m_Archive->NextWritingElement();
 	}
@@ -1675,6 +2832,7 @@ void Serializer::VisitDecl(Declaration::DeclPtr const& decl)
 
 void Serializer::Visit(Declaration::DeclPtr const& decl)
 {
+	markIndexEntry(decl);
 	DeclVisitor::Visit(decl);
 	m_Archive->NextWritingElement();
 }
@@ -1729,7 +2887,10 @@ void Serializer::VisitParenType(natRefPointer<Type::ParenType> const& type)
 void Serializer::VisitTagType(natRefPointer<Type::TagType> const& type)
 {
 	VisitType(type);
-	m_Archive->WriteString(u8"TagDecl"_nv, GetQualifiedName(type->GetDecl()));
+	const auto tagDecl = type->GetDecl();
+	// 名称总是被写入，以便在按需加载时查找尚未加载的声明
+	m_Archive->WriteNumType(u8"TagDeclId"_nv, isInCurrentMetadata(tagDecl) ? getDeclId(tagDecl) : nuInt{});
+	m_Archive->WriteString(u8"TagDecl"_nv, GetQualifiedName(tagDecl));
 }
 
 void Serializer::VisitDeducedType(natRefPointer<Type::DeducedType> const& type)
@@ -1784,3 +2945,48 @@ void Serializer::SerializeCompilerAction(natRefPointer<ICompilerAction> const& a
 
 	m_Archive->WriteString(u8"Name"_nv, qualifiedName);
 }
+
+void Serializer::markIndexEntry(Declaration::DeclPtr const& decl)
+{
+	// 为模块及顶层的具名声明建立索引，以便导入时直接定位
+	if (const auto namedDecl = decl.Cast<Declaration::NamedDecl>())
+	{
+		m_Archive->MarkIndexEntry(GetQualifiedName(namedDecl));
+	}
+}
+
+nuInt Serializer::getDeclId(natRefPointer<Declaration::NamedDecl> const& decl)
+{
+	const auto [iter, inserted] = m_DeclIds.emplace(decl, static_cast<nuInt>(m_DeclIds.size() + 1));
+	if (inserted)
+	{
+		m_DeclWritten.emplace_back(false);
+	}
+
+	return iter->second;
+}
+
+nBool Serializer::isInCurrentMetadata(natRefPointer<Declaration::NamedDecl> const& decl) const
+{
+	// 顶层声明未被标记为导入时即属于正在写入的元数据，导出时函数内部的声明不会被写入
+	Declaration::DeclPtr topLevelDecl = decl;
+	auto parent = decl->GetContext();
+	while (parent)
+	{
+		const auto parentDecl = Declaration::Decl::CastFromDeclContext(parent);
+		if (dynamic_cast<Declaration::TranslationUnitDecl*>(parentDecl))
+		{
+			break;
+		}
+
+		if (m_IsExporting && dynamic_cast<Declaration::FunctionDecl*>(parentDecl))
+		{
+			return false;
+		}
+
+		topLevelDecl = parentDecl->ForkRef();
+		parent = parentDecl->GetContext();
+	}
+
+	return !m_Sema.IsImported(topLevelDecl);
+}
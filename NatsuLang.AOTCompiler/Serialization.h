@@ -11,15 +11,53 @@
 
 #include <natBinary.h>
 
+#include <array>
+#include <limits>
+#include <optional>
+#include <set>
+
 namespace NatsuLang::Serialization
 {
 	DeclareException(SerializationException, NatsuLib::natException, u8"Exception generated in serialization.");
 
+	// 二进制元数据的布局如下，所有定长数值均以小端序存储：
+	// 文件头：魔数（4 字节）、版本（2 字节）、标志（2 字节）
+	// 内容：各元素依次排列，字符串以字符串表中的序号（4 字节）表示，数组以其在数组元素数量表中的序号（4 字节）开始
+	// 字符串表：字符串数量（4 字节），之后为各字符串的长度（4 字节）及内容
+	// 索引：索引项数量（4 字节），之后为各索引项名称的序号（4 字节）及对应元素的偏移（8 字节）
+	// 数组元素数量表：数组数量（4 字节），之后为各数组的元素数量（4 字节）
+	// 块表：仅在压缩时存在，块数量（4 字节），之后为各块在文件中的偏移（8 字节）
+	// 文件尾：字符串表的偏移（8 字节）、索引的偏移（8 字节）、数组元素数量表的偏移（8 字节）、块表的偏移（8 字节）、魔数（4 字节）
+	// 所有需要在写入内容后才能确定的信息均位于内容之后，因此写入时无需回溯，可以输出到不可定位的流
+	// 设置 CompactIntegers 标志时，内容至数组元素数量表中的整数（浮点数除外）以 LEB128 变长编码存储
+	// 设置 Compressed 标志时，文件头之后至块表之前的部分被划分为大小为 BinaryMetadataChunkSize 的块（最后一块可以较小），
+	// 每块由原始大小（4 字节）、存储大小（4 字节）及数据组成，两者相等时数据未被压缩，否则为 zlib 压缩后的数据
+	// 除块表外，所有偏移均为未压缩时的偏移
+	// 具名声明带有在同一元数据中唯一的序号（从 1 开始），对同一元数据中声明的引用同时记录其序号，0 表示引用的声明不在此元数据中
+	constexpr nuInt BinaryMetadataMagic = 0x4154454D; // "META"
+	constexpr nuShort BinaryMetadataVersion = 5;
+	// 写入时缓冲的内容的最大大小，缓冲满后即输出到流，压缩时亦为块的大小
+	constexpr std::size_t BinaryMetadataChunkSize = 0x10000;
+
+	enum class BinaryMetadataFlags : nuShort
+	{
+		None = 0x00,
+
+		CompactIntegers = 0x01,
+		Compressed = 0x02,
+	};
+
+	MAKE_ENUM_CLASS_BITMASK_TYPE(BinaryMetadataFlags);
+
 	class BinarySerializationArchiveReader
 		: public NatsuLib::natRefObjImpl<BinarySerializationArchiveReader, ISerializationArchiveReader>
 	{
 	public:
-		explicit BinarySerializationArchiveReader(NatsuLib::natRefPointer<NatsuLib::natBinaryReader> reader);
+		///	@brief	从流中读取元数据
+		///	@param	reader	读取器，其流必须可以定位
+		///	@param	offset	元数据在流中的起始位置，用于读取元数据包中的成员
+		///	@param	size	元数据的大小，超出流的部分将被忽略
+		explicit BinarySerializationArchiveReader(NatsuLib::natRefPointer<NatsuLib::natBinaryReader> reader, nLen offset = 0, nLen size = std::numeric_limits<nLen>::max());
 		~BinarySerializationArchiveReader();
 
 		nBool ReadSourceLocation(nStrView key, SourceLocation& out) override;
@@ -30,17 +68,46 @@ namespace NatsuLang::Serialization
 		nBool NextReadingElement() override;
 		std::size_t GetEntryElementCount() override;
 		void EndReadingEntry() override;
+		nBool ReadIndexedEntry(nStrView name, std::function<void()> const& callback) override;
+		nBool EnumerateIndexedNames(std::function<void(nStrView)> const& callback) override;
+
+		///	@brief	将内容一次性读入内存，压缩时将同时解压所有块，之后的读取将不再访问流
+		///	@remark	不访问除此读取器及其流以外的状态，可以在其他线程中调用以并行解码多个元数据
+		void Preload();
 
 	private:
 		NatsuLib::natRefPointer<NatsuLib::natBinaryReader> m_Reader;
+		nLen m_BaseOffset;
+		nLen m_Size;
 		std::vector<std::pair<nBool, std::size_t>> m_EntryElementCount;
+		std::vector<nString> m_Strings;
+		std::unordered_multimap<nString, nLen> m_Index;
+		std::vector<nuInt> m_ArrayElementCounts;
+		BinaryMetadataFlags m_Flags;
+		nLen m_ContentOffset;
+		// 各块在文件中的偏移，仅在压缩时使用
+		std::vector<nuLong> m_BlockOffsets;
+		std::vector<nByte> m_Block;
+		std::vector<nByte> m_CompressedBlock;
+		std::size_t m_CurrentBlock;
+		// 预先读入的自 m_ContentOffset 开始的未压缩的内容
+		std::vector<nByte> m_Content;
+		nBool m_Preloaded;
+		// 未压缩时的偏移
+		nLen m_Position;
+
+		nBool readBytes(nData data, nLen size);
+		nBool readFixedInteger(nuLong& value, std::size_t width);
+		nBool readInteger(nuLong& value, std::size_t width);
+		void seek(nLen position);
+		nBool loadBlock(std::size_t index);
 	};
 
 	class BinarySerializationArchiveWriter
 		: public NatsuLib::natRefObjImpl<BinarySerializationArchiveWriter, ISerializationArchiveWriter>
 	{
 	public:
-		explicit BinarySerializationArchiveWriter(NatsuLib::natRefPointer<NatsuLib::natBinaryWriter> writer);
+		explicit BinarySerializationArchiveWriter(NatsuLib::natRefPointer<NatsuLib::natBinaryWriter> writer, BinaryMetadataFlags flags = BinaryMetadataFlags::None);
 		~BinarySerializationArchiveWriter();
 
 		void WriteSourceLocation(nStrView key, SourceLocation const& value) override;
@@ -50,10 +117,80 @@ namespace NatsuLang::Serialization
 		void StartWritingEntry(nStrView key, nBool isArray) override;
 		void NextWritingElement() override;
 		void EndWritingEntry() override;
+		void MarkIndexEntry(nStrView name) override;
+		void FinishWriting() override;
 
 	private:
 		NatsuLib::natRefPointer<NatsuLib::natBinaryWriter> m_Writer;
-		std::vector<std::tuple<nBool, nLen, std::size_t>> m_EntryElementCount;
+		// 正在写入的条目是否为数组及数组的序号
+		std::vector<std::pair<nBool, std::size_t>> m_EntryElementCount;
+		std::vector<nString> m_Strings;
+		std::unordered_map<nString, nuInt> m_StringIdMap;
+		std::vector<std::pair<nuInt, nLen>> m_Index;
+		std::vector<nuInt> m_ArrayElementCounts;
+		BinaryMetadataFlags m_Flags;
+		// 尚未输出到流的内容，大小不超过 BinaryMetadataChunkSize
+		std::vector<nByte> m_Buffer;
+		// 已输出的各块在文件中的偏移，仅在压缩时使用
+		std::vector<nuLong> m_BlockOffsets;
+		// 已写入的未压缩时的总字节数，包括缓冲中的内容
+		nLen m_Position;
+		// 已实际输出到流的字节数
+		nLen m_StreamPosition;
+		nBool m_Finished;
+
+		nuInt getStringId(nStrView str);
+		void writeBytes(ncData data, nLen size);
+		void writeFixedInteger(nuLong value, std::size_t width);
+		void writeInteger(nuLong value, std::size_t width);
+		void writeRaw(ncData data, nLen size);
+		void writeRawInteger(nuLong value, std::size_t width);
+		void flush();
+	};
+
+	// 元数据包由多个完整的二进制元数据依次排列而成，用于在不经过语义分析的情况下合并元数据，布局如下：
+	// 文件头：魔数（4 字节）、版本（2 字节）、保留（2 字节）
+	// 成员：各元数据的原始内容
+	// 成员表：成员数量（4 字节），之后为各成员的偏移（8 字节）、大小（8 字节）及内容的 MD5（16 字节）
+	// 文件尾：成员表的偏移（8 字节）、魔数（4 字节）
+	// 各成员中声明的序号、字符串表等仍然仅在成员内部有效，导入时每个成员作为独立的元数据加载
+	constexpr nuInt BinaryMetadataBundleMagic = 0x4C444E42; // "BNDL"
+	constexpr nuShort BinaryMetadataBundleVersion = 1;
+
+	struct BinaryMetadataBundleMember
+	{
+		nLen Offset;
+		nLen Size;
+	};
+
+	///	@brief	若流的内容为元数据包则读取其成员表，不改变流的位置
+	///	@return	各成员在流中的位置，若不是元数据包则返回空
+	std::optional<std::vector<BinaryMetadataBundleMember>> ReadBinaryMetadataBundle(NatsuLib::natStream& stream);
+
+	///	@brief	以流式方式将多个元数据合并为元数据包
+	///	@remark	成员的内容被原样复制，不进行解码，内容相同的元数据只保留一份，输出的流可以不可定位
+	class BinaryMetadataBundleWriter
+	{
+	public:
+		explicit BinaryMetadataBundleWriter(NatsuLib::natRefPointer<NatsuLib::natStream> stream);
+		~BinaryMetadataBundleWriter();
+
+		///	@brief	添加元数据，若为元数据包则添加其所有成员
+		///	@param	stream	元数据所在的流，必须可以定位
+		///	@return	实际写入的成员数量，与已写入的成员内容相同的元数据将被跳过
+		std::size_t AddMetadata(NatsuLib::natStream& stream);
+		void FinishWriting();
+
+	private:
+		NatsuLib::natRefPointer<NatsuLib::natStream> m_Stream;
+		nLen m_Position;
+		std::vector<std::pair<BinaryMetadataBundleMember, std::array<nByte, 16>>> m_Members;
+		std::set<std::array<nByte, 16>> m_Digests;
+		nBool m_Finished;
+
+		nBool addMember(NatsuLib::natStream& stream, BinaryMetadataBundleMember const& member);
+		void write(ncData data, nLen size);
+		void writeInteger(nuLong value, std::size_t width);
 	};
 
 	class Deserializer
@@ -67,6 +204,17 @@ namespace NatsuLang::Serialization
 
 		std::size_t StartDeserialize(NatsuLib::natRefPointer<ISerializationArchiveReader> archive, nBool isImporting = true);
 		void EndDeserialize();
+		///	@brief	检查是否仍有引用了其他元数据中的声明但未能回填的节点，若有则抛出异常
+		///	@remark	应在所有元数据均已反序列化之后调用，析构函数不会报告此错误
+		void Finish();
+
+		///	@brief	开始按需反序列化，此时不会读取任何内容，之后可通过 DeserializeIndexed 按名称读取顶层元素
+		///	@remark	存档必须支持索引，反序列化得到的声明不会被加入 Sema 的当前作用域
+		void StartLazyDeserialize(NatsuLib::natRefPointer<ISerializationArchiveReader> archive, nBool isImporting = true);
+		void EndLazyDeserialize();
+
+		///	@brief	读取索引中具有指定名称的所有顶层元素，仅可在 StartLazyDeserialize 与 EndLazyDeserialize 之间调用
+		std::vector<ASTNodePtr> DeserializeIndexed(nStrView name);
 
 		ASTNodePtr Deserialize();
 		ASTNodePtr DeserializeDecl();
@@ -78,20 +226,57 @@ namespace NatsuLang::Serialization
 		Syntax::Parser& m_Parser;
 		Semantic::Sema& m_Sema;
 		NatsuLib::natRefPointer<Declaration::TranslationUnitDecl> m_PseudoTranslationUnit;
+		NatsuLib::natRefPointer<Semantic::Scope> m_LazyScope;
 		NatsuLib::natRefPointer<ISerializationArchiveReader> m_Archive;
 		std::unordered_map<nString, Statement::Stmt::StmtType> m_StmtTypeMap;
 		std::unordered_map<nString, Declaration::Decl::DeclType> m_DeclTypeMap;
 		std::unordered_map<nString, Type::Type::TypeClass> m_TypeClassMap;
 
-		std::unordered_map<nString, std::unordered_map<ASTNodePtr, std::function<void(NatsuLib::natRefPointer<Declaration::NamedDecl> const&)>>> m_UnresolvedDeclFixers;
+		using DeclFixer = std::function<void(NatsuLib::natRefPointer<Declaration::NamedDecl> const&)>;
+
+		// 以声明的序号为下标，序号在每个元数据中从 1 开始分配
+		std::vector<NatsuLib::natRefPointer<Declaration::NamedDecl>> m_DeclById;
+		// 对尚未读取的同一元数据中的声明的引用，将在声明被读取后回填
+		std::vector<std::vector<DeclFixer>> m_PendingDeclFixers;
+		// 无法通过序号解析的引用，以限定名称为键
+		std::unordered_map<nString, std::unordered_map<ASTNodePtr, DeclFixer>> m_UnresolvedDeclFixers;
 
 		nBool m_IsImporting;
 
 		Identifier::IdPtr getId(nStrView name) const;
 		NatsuLib::natRefPointer<Declaration::NamedDecl> parseQualifiedName(nStrView name);
 		NatsuLib::natRefPointer<Type::UnresolvedType> getUnresolvedType(nStrView name);
+		NatsuLib::natRefPointer<Declaration::NamedDecl> getDeclById(nuLong declId) const noexcept;
+		nBool hasPendingFixers() const noexcept;
+		void resetDeclIds();
 
-		void tryResolve(NatsuLib::natRefPointer<Declaration::NamedDecl> const& namedDecl);
+		void addDeclFixer(ASTNodePtr const& unresolved, ASTNodePtr const& node, DeclFixer fixer);
+		void tryResolve(NatsuLib::natRefPointer<Declaration::NamedDecl> const& namedDecl, nuLong declId);
+	};
+
+	///	@brief	按需从元数据中加载声明的外部声明来源
+	///	@remark	仅在名称查找首次到达翻译单元时才反序列化对应名称的顶层声明及其成员
+	class LazyMetadataSource
+		: public NatsuLib::natRefObjImpl<LazyMetadataSource, Semantic::IExternalDeclSource>
+	{
+	public:
+		LazyMetadataSource(Syntax::Parser& parser, NatsuLib::natRefPointer<ISerializationArchiveReader> archive,
+		                   nBool feedAstConsumer = true);
+		~LazyMetadataSource();
+
+		void LoadDecls(Identifier::IdPtr const& id) override;
+		void LoadAllDecls() override;
+
+	private:
+		Semantic::Sema& m_Sema;
+		NatsuLib::natRefPointer<ISerializationArchiveReader> m_Archive;
+		Deserializer m_Deserializer;
+		nBool m_FeedAstConsumer;
+		nBool m_AllLoaded;
+		// 已加载或正在加载的名称，同时用于阻止声明间相互引用导致的重复加载
+		std::unordered_set<nString> m_LoadedNames;
+
+		void load(nStrView name);
 	};
 
 	class Serializer
@@ -188,5 +373,13 @@ namespace NatsuLang::Serialization
 		NatsuLib::natRefPointer<Misc::TextProvider<Type::Type::TypeClass>> m_TypeClassMap;
 
 		nBool m_IsExporting;
+
+		// 声明的序号从 1 开始分配，被引用或被写入时分配
+		std::unordered_map<NatsuLib::natRefPointer<Declaration::NamedDecl>, nuInt> m_DeclIds;
+		std::vector<nBool> m_DeclWritten;
+
+		void markIndexEntry(Declaration::DeclPtr const& decl);
+		nuInt getDeclId(NatsuLib::natRefPointer<Declaration::NamedDecl> const& decl);
+		nBool isInCurrentMetadata(NatsuLib::natRefPointer<Declaration::NamedDecl> const& decl) const;
 	};
 }
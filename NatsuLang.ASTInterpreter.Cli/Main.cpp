@@ -61,12 +61,80 @@ void PrintException(natLog& logger, std::exception const& e)
 	}
 }
 
+void PrintProfile(natLog& logger, Interpreter& theInterpreter)
+{
+	constexpr std::size_t maxReportedItemCount = 10;
+
+	auto& profiler = theInterpreter.GetProfiler();
+	profiler.WriteCollapsedStacks(make_ref<natFileStream>(u8"Profile.folded"_nv, false, true));
+	logger.LogMsg(u8"已将调用栈写入 Profile.folded"_nv);
+
+	std::vector<std::pair<natRefPointer<Declaration::FunctionDecl>, Interpreter::InterpreterProfiler::FunctionRecord>> functions(profiler.GetFunctionRecords().cbegin(), profiler.GetFunctionRecords().cend());
+	std::sort(functions.begin(), functions.end(), [](auto const& a, auto const& b)
+	{
+		return a.second.ExclusiveTime > b.second.ExclusiveTime;
+	});
+
+	logger.LogMsg(u8"函数\t调用次数\t包含时间(us)\t独占时间(us)\t分配次数\t分配字节数"_nv);
+	for (std::size_t i = 0; i < std::min(functions.size(), maxReportedItemCount); ++i)
+	{
+		const auto& [func, record] = functions[i];
+		logger.LogMsg(u8"{0}\t{1}\t{2}\t{3}\t{4}\t{5}"_nv, func ? func->GetName() : u8"(顶层)"_nv, record.CallCount,
+			std::chrono::duration_cast<std::chrono::microseconds>(record.InclusiveTime).count(),
+			std::chrono::duration_cast<std::chrono::microseconds>(record.ExclusiveTime).count(),
+			record.AllocationCount, record.AllocatedSize);
+	}
+
+	std::vector<std::pair<SourceLocation, Interpreter::InterpreterProfiler::StatementRecord>> statements(profiler.GetStatementRecords().cbegin(), profiler.GetStatementRecords().cend());
+	std::sort(statements.begin(), statements.end(), [](auto const& a, auto const& b)
+	{
+		return a.second.Time > b.second.Time;
+	});
+
+	logger.LogMsg(u8"语句位置\t执行次数\t时间(us)"_nv);
+	for (std::size_t i = 0; i < std::min(statements.size(), maxReportedItemCount); ++i)
+	{
+		const auto& [loc, record] = statements[i];
+		const auto time = std::chrono::duration_cast<std::chrono::microseconds>(record.Time).count();
+		if (!loc.IsValid())
+		{
+			logger.LogMsg(u8"(未知)\t{0}\t{1}"_nv, record.ExecutionCount, time);
+			continue;
+		}
+
+		auto& sourceManager = theInterpreter.GetSourceManager();
+		const auto content = sourceManager.GetFileContent(loc.GetFileID()).second;
+		const auto line = std::count(content.begin(), loc.GetPos(), '\n') + 1;
+		logger.LogMsg(u8"{0}:{1}\t{2}\t{3}"_nv, sourceManager.FindFileUri(loc.GetFileID()), line, record.ExecutionCount, time);
+	}
+
+	NatsuLang_AllocatorStatistics allocatorStatistics;
+	NatsuLang_GetAllocatorStatistics(&allocatorStatistics);
+	logger.LogMsg(u8"堆分配次数\t释放次数\t存活字节数\t峰值字节数\t页数\t大块分配次数"_nv);
+	logger.LogMsg(u8"{0}\t{1}\t{2}\t{3}\t{4}\t{5}"_nv, allocatorStatistics.AllocationCount, allocatorStatistics.DeallocationCount,
+		allocatorStatistics.LiveBytes, allocatorStatistics.PeakLiveBytes, allocatorStatistics.PageCount, allocatorStatistics.LargeAllocationCount);
+}
+
 int main(int argc, char* argv[])
 {
-	if (argc > 2)
+	const char* sourceFile{};
+	auto profile = false;
+
+	for (auto argIter = argv + 1; argIter != argv + argc; ++argIter)
 	{
-		// TODO: 打印用法
-		return 0;
+		if (nStrView{ *argIter } == u8"--profile"_nv)
+		{
+			profile = true;
+			continue;
+		}
+
+		if (sourceFile)
+		{
+			// TODO: 打印用法
+			return 0;
+		}
+
+		sourceFile = *argIter;
 	}
 
 	natConsole console;
@@ -93,9 +161,11 @@ int main(int argc, char* argv[])
 			return nullptr;
 		});
 
+	theInterpreter.GetProfiler().SetEnabled(profile);
+
 	try
 	{
-		if (argc == 1)
+		if (!sourceFile)
 		{
 			// REPL 模式
 
@@ -122,7 +192,12 @@ int main(int argc, char* argv[])
 		else
 		{
 			// Interpreter 模式
-			theInterpreter.Run(Uri{ argv[1] });
+			theInterpreter.Run(Uri{ sourceFile });
+		}
+
+		if (profile)
+		{
+			PrintProfile(logger, theInterpreter);
 		}
 	}
 	catch (natException& e)
@@ -30,7 +30,29 @@ void Interpreter::InterpreterASTConsumer::HandleTranslationUnit(ASTContext& cont
 		nat_Throw(InterpreterException, u8"找到了名为 Main 的方法，但需要一个函数"_nv);
 	}
 
+	// 与 CodeGen 相同，存在错误时不执行
+	if (!m_Interpreter.m_Parser.ResolveFunctionBody(mainDecl) || m_Interpreter.m_DiagConsumer->HasError())
+	{
+		m_Interpreter.m_DiagConsumer->Reset();
+		nat_Throw(InterpreterException, u8"无法分析 Main 函数的函数体"_nv);
+	}
+
+	const auto profiling = m_Interpreter.m_Profiler.IsEnabled();
+	if (profiling)
+	{
+		m_Interpreter.m_Profiler.EnterFunction(mainDecl);
+	}
+
+	const auto profilerScope = make_scope([this, profiling]
+	{
+		if (profiling)
+		{
+			m_Interpreter.m_Profiler.LeaveFunction();
+		}
+	});
+
 	m_Interpreter.m_Visitor.Visit(mainDecl->GetBody());
+	m_Interpreter.checkUncaughtException();
 }
 
 nBool Interpreter::InterpreterASTConsumer::HandleTopLevelDecl(Linq<Valued<Declaration::DeclPtr>> const& decls)
@@ -24,10 +24,14 @@ Type::TypePtr Interpreter::InterpreterDeclStorage::ArrayElementAccessor::GetElem
 	return m_ElementType;
 }
 
+std::size_t Interpreter::InterpreterDeclStorage::ArrayElementAccessor::GetElementSize() const noexcept
+{
+	return m_ElementSize;
+}
+
 natRefPointer<Interpreter::InterpreterDeclStorage::MemoryLocationDecl> Interpreter::InterpreterDeclStorage::ArrayElementAccessor::GetElementDecl(std::size_t i) const
 {
-	Lex::Token dummy;
-	return make_ref<MemoryLocationDecl>(m_ElementType, m_Storage + m_ElementSize * i, m_DeclStorage.m_Interpreter.m_Preprocessor.FindIdentifierInfo(natUtil::FormatString(u8"[{0}]"_nv, i), dummy));
+	return make_ref<MemoryLocationDecl>(m_ElementType, GetElementStorage(i));
 }
 
 nData Interpreter::InterpreterDeclStorage::ArrayElementAccessor::GetStorage() const noexcept
@@ -35,35 +39,37 @@ nData Interpreter::InterpreterDeclStorage::ArrayElementAccessor::GetStorage() co
 	return m_Storage;
 }
 
+nData Interpreter::InterpreterDeclStorage::ArrayElementAccessor::GetElementStorage(std::size_t i) const noexcept
+{
+	assert(i < m_ArrayElementCount);
+	return m_Storage + m_ElementSize * i;
+}
+
+void Interpreter::InterpreterDeclStorage::ArrayElementAccessor::CopyFrom(ArrayElementAccessor const& other) const noexcept
+{
+	assert(m_ElementSize == other.m_ElementSize && m_ArrayElementCount == other.m_ArrayElementCount);
+	std::memmove(m_Storage, other.m_Storage, m_ElementSize * m_ArrayElementCount);
+}
+
 Interpreter::InterpreterDeclStorage::MemberAccessor::MemberAccessor(InterpreterDeclStorage& declStorage,
 																	natRefPointer<Declaration::ClassDecl>
 																	classDecl, nData storage)
-	: m_DeclStorage{ declStorage }, m_ClassDecl{ std::move(classDecl) }, m_Storage{ storage }
+	: m_DeclStorage{ declStorage }, m_ClassDecl{ std::move(classDecl) },
+	  m_Layout{ m_DeclStorage.m_Interpreter.m_AstContext.GetClassLayout(m_ClassDecl) }, m_Storage{ storage }
 {
-	auto&& layout = m_DeclStorage.m_Interpreter.m_AstContext.GetClassLayout(m_ClassDecl);
-
-	auto offsetIter = layout.FieldOffsets.cbegin();
-	const auto offsetEnd = layout.FieldOffsets.cend();
-
-	for (; offsetIter != offsetEnd; ++offsetIter)
-	{
-		if (!offsetIter->first)
-		{
-			continue;
-		}
-
-		m_FieldOffsets.emplace(offsetIter->first, offsetIter->second);
-	}
 }
 
 std::size_t Interpreter::InterpreterDeclStorage::MemberAccessor::GetFieldCount() const noexcept
 {
-	return m_FieldOffsets.size();
+	return m_Layout.FieldIndices.size();
 }
 
 Linq<Valued<natRefPointer<Declaration::FieldDecl>>> Interpreter::InterpreterDeclStorage::MemberAccessor::GetFields() const noexcept
 {
-	return from(m_FieldOffsets).select([](std::pair<natRefPointer<Declaration::FieldDecl>, std::size_t> const& pair)
+	return from(m_Layout.FieldOffsets).where([](std::pair<natRefPointer<Declaration::FieldDecl>, std::size_t> const& pair) -> nBool
+	{
+		return pair.first;
+	}).select([](std::pair<natRefPointer<Declaration::FieldDecl>, std::size_t> const& pair)
 	{
 		return pair.first;
 	});
@@ -72,47 +78,90 @@ Linq<Valued<natRefPointer<Declaration::FieldDecl>>> Interpreter::InterpreterDecl
 natRefPointer<Interpreter::InterpreterDeclStorage::MemoryLocationDecl> Interpreter::InterpreterDeclStorage::MemberAccessor::GetMemberDecl
 	(natRefPointer<Declaration::FieldDecl> const& fieldDecl) const
 {
-	const auto iter = m_FieldOffsets.find(fieldDecl);
-	if (iter == m_FieldOffsets.end())
+	const auto fieldInfo = m_Layout.GetFieldInfo(fieldDecl);
+	if (!fieldInfo)
 	{
 		return nullptr;
 	}
 
-	const auto offset = iter->second;
+	const auto offset = fieldInfo->second;
 	return make_ref<MemoryLocationDecl>(fieldDecl->GetValueType(), m_Storage + offset, fieldDecl->GetIdentifierInfo());
 }
 
-Interpreter::InterpreterDeclStorage::PointerAccessor::PointerAccessor(nData storage)
-	: m_Storage{ storage }
+nData Interpreter::InterpreterDeclStorage::MemberAccessor::GetStorage() const noexcept
+{
+	return m_Storage;
+}
+
+Interpreter::InterpreterDeclStorage::PointerAccessor::PointerAccessor(InterpreterDeclStorage& declStorage,
+																	  natRefPointer<Type::PointerType> const& pointerType, nData storage)
+	: m_DeclStorage{ declStorage }, m_PointeeType{ Type::Type::GetUnderlyingType(pointerType->GetPointeeType()) }, m_Storage{ storage }
+{
+}
+
+Interpreter::InterpreterDeclStorage::PointerHandle Interpreter::InterpreterDeclStorage::PointerAccessor::GetHandle() const noexcept
+{
+	// 紧凑布局的类中的指针可能未对齐
+	nuLong value;
+	std::memcpy(&value, m_Storage, sizeof value);
+	return PointerHandle{ value };
+}
+
+void Interpreter::InterpreterDeclStorage::PointerAccessor::SetHandle(PointerHandle handle) noexcept
+{
+	const auto value = handle.GetValue();
+	std::memcpy(m_Storage, &value, sizeof value);
+}
+
+nBool Interpreter::InterpreterDeclStorage::PointerAccessor::IsNull() const noexcept
 {
+	return GetHandle().IsNull();
 }
 
-natRefPointer<Declaration::VarDecl> Interpreter::InterpreterDeclStorage::PointerAccessor::GetReferencedDecl() const noexcept
+Type::TypePtr Interpreter::InterpreterDeclStorage::PointerAccessor::GetPointeeType() const noexcept
 {
-	return natRefPointer<Declaration::VarDecl>{ *reinterpret_cast<Declaration::VarDecl**>(m_Storage) };
+	return m_PointeeType;
 }
 
-void Interpreter::InterpreterDeclStorage::PointerAccessor::SetReferencedDecl(natRefPointer<Declaration::VarDecl> const& value) noexcept
+natRefPointer<Interpreter::InterpreterDeclStorage::MemoryLocationDecl> Interpreter::InterpreterDeclStorage::PointerAccessor::GetReferencedDecl() const
 {
-	// FIXME: 未受引用计数保护的引用
-	*reinterpret_cast<Declaration::VarDecl**>(m_Storage) = value.Get();
+	const auto storage = m_DeclStorage.ResolvePointerHandle(GetHandle(), m_DeclStorage.m_Interpreter.m_AstContext.GetTypeInfo(m_PointeeType).Size);
+	if (!storage)
+	{
+		return nullptr;
+	}
+
+	return make_ref<MemoryLocationDecl>(m_PointeeType, storage);
+}
+
+void Interpreter::InterpreterDeclStorage::PointerAccessor::SetReferencedDecl(natRefPointer<Declaration::ValueDecl> const& decl)
+{
+	if (!decl)
+	{
+		SetHandle({});
+		return;
+	}
+
+	SetReferencedStorage(m_DeclStorage.GetOrAddDecl(decl).second);
+}
+
+void Interpreter::InterpreterDeclStorage::PointerAccessor::SetReferencedStorage(nData storage)
+{
+	SetHandle(storage ? m_DeclStorage.MakePointerHandle(storage) : PointerHandle{});
 }
 
 void Interpreter::InterpreterDeclStorage::StorageDeleter::operator()(nData data) const noexcept
 {
-#ifdef _MSC_VER
-#	ifdef NDEBUG
-	_aligned_free(data);
-#	else
-	_aligned_free_dbg(data);
-#	endif
-#else
-	std::free(data);
-#endif
+	if (DeclStorage && RegionSlot)
+	{
+		DeclStorage->UnregisterRegion(RegionSlot);
+	}
+
+	NatsuLang_Deallocate(data, Size);
 }
 
 Interpreter::InterpreterDeclStorage::InterpreterDeclStorage(Interpreter& interpreter)
-	: m_Interpreter{ interpreter }
+	: m_Interpreter{ interpreter }, m_StorageRegions(1)
 {
 	PushStorage();
 }
@@ -157,26 +206,26 @@ std::pair<nBool, nData> Interpreter::InterpreterDeclStorage::GetOrAddDecl(natRef
 		}
 	}
 
-	const auto storagePointer =
-#ifdef _MSC_VER
-#	ifdef NDEBUG
-		static_cast<nData>(_aligned_malloc(typeInfo.Size, typeInfo.Align));
-#	else
-		static_cast<nData>(_aligned_malloc_dbg(typeInfo.Size, typeInfo.Align, __FILE__, __LINE__));
-#	endif
-#else
-		static_cast<nData>(aligned_alloc(typeInfo.Align, typeInfo.Size));
-#endif
+	// 局部变量的存储频繁地分配及释放，由运行时的池化分配器分配，其返回的存储至少按 16 字节对齐
+	assert(typeInfo.Align <= 16);
+	const auto storagePointer = static_cast<nData>(NatsuLang_Allocate(typeInfo.Size));
 
 	if (storagePointer)
 	{
 		assert(topAvailableForCreateStorageIndex != std::numeric_limits<std::size_t>::max());
 		const auto storageIter = std::next(m_DeclStorage.begin(), topAvailableForCreateStorageIndex);
 
-		const auto[iter, succeed] = storageIter->second->try_emplace(std::move(decl), std::unique_ptr<nByte[], StorageDeleter>{ storagePointer });
+		// 大部分存储不会被取地址，存储区域在首次取地址时才注册
+		std::unique_ptr<nByte[], StorageDeleter> storage{ storagePointer, StorageDeleter{ this, 0, typeInfo.Size } };
+		const auto[iter, succeed] = storageIter->second->try_emplace(std::move(decl), std::move(storage));
 
 		if (succeed)
 		{
+			if (m_Interpreter.m_Profiler.IsEnabled())
+			{
+				m_Interpreter.m_Profiler.RecordAllocation(typeInfo.Size);
+			}
+
 			std::memset(iter->second.get(), 0, typeInfo.Size);
 			return { true, iter->second.get() };
 		}
@@ -289,3 +338,168 @@ natRefPointer<Declaration::ValueDecl> Interpreter::InterpreterDeclStorage::Creat
 {
 	return make_ref<Declaration::ValueDecl>(Declaration::Decl::Var, nullptr, loc, nullptr, type);
 }
+
+nuInt Interpreter::InterpreterDeclStorage::RegisterRegion(nData base, std::size_t size)
+{
+	nuInt slot;
+	if (!m_FreeRegionSlots.empty())
+	{
+		slot = m_FreeRegionSlots.back();
+		m_FreeRegionSlots.pop_back();
+	}
+	else if (!m_RetiredRegionSlots.empty() && (m_RetiredRegionSlots.size() >= MaxRetiredRegionSlots || m_StorageRegions.size() > PointerHandle::SlotMask))
+	{
+		// 重新使用最早弃用的槽位，避免长时间运行的循环使槽位的表无限增长
+		slot = m_RetiredRegionSlots.front();
+		m_RetiredRegionSlots.pop_front();
+		m_StorageRegions[slot].Generation = 0;
+	}
+	else
+	{
+		if (m_StorageRegions.size() > PointerHandle::SlotMask)
+		{
+			nat_Throw(InterpreterException, u8"存储区域过多"_nv);
+		}
+
+		slot = static_cast<nuInt>(m_StorageRegions.size());
+		m_StorageRegions.push_back({});
+	}
+
+	auto& region = m_StorageRegions[slot];
+	region.Base = base;
+	region.Size = size;
+	region.InUse = true;
+	m_RegionSlotsByBase.insert_or_assign(reinterpret_cast<std::uintptr_t>(base), slot);
+
+	return slot;
+}
+
+void Interpreter::InterpreterDeclStorage::UnregisterRegion(nuInt slot) noexcept
+{
+	assert(slot && slot < m_StorageRegions.size());
+	auto& region = m_StorageRegions[slot];
+	assert(region.InUse);
+
+	m_RegionSlotsByBase.erase(reinterpret_cast<std::uintptr_t>(region.Base));
+	region.Base = nullptr;
+	region.Size = 0;
+	region.InUse = false;
+	// 使仍指向此区域的指针失效
+	++region.Generation;
+	// 代数用尽的槽位暂不重用，否则代数回绕后刚失效的指针将再次通过检查
+	if (region.Generation <= PointerHandle::GenerationMask)
+	{
+		m_FreeRegionSlots.push_back(slot);
+	}
+	else
+	{
+		m_RetiredRegionSlots.push_back(slot);
+	}
+}
+
+Interpreter::InterpreterDeclStorage::PointerHandle Interpreter::InterpreterDeclStorage::MakePointerHandle(nData storage)
+{
+	const auto address = reinterpret_cast<std::uintptr_t>(storage);
+
+	nuInt slot{};
+	nuInt pastEndSlot{};
+	if (auto iter = m_RegionSlotsByBase.upper_bound(address); iter != m_RegionSlotsByBase.cbegin())
+	{
+		--iter;
+		const auto offset = static_cast<std::size_t>(address - iter->first);
+		const auto size = m_StorageRegions[iter->second].Size;
+		if (offset < size)
+		{
+			slot = iter->second;
+		}
+		else if (offset == size)
+		{
+			pastEndSlot = iter->second;
+		}
+	}
+
+	// 位于已注册区域末尾之后的位置可能是尚未注册的另一存储的起始位置，此时优先引用该存储
+	if (!slot && !(slot = registerOwningRegion(address)))
+	{
+		slot = pastEndSlot;
+	}
+
+	if (!slot)
+	{
+		nat_Throw(InterpreterException, u8"无法获取该对象的地址"_nv);
+	}
+
+	const auto& region = m_StorageRegions[slot];
+	const auto offset = static_cast<std::size_t>(address - reinterpret_cast<std::uintptr_t>(region.Base));
+	// 过大的对象仍可正常使用，仅在偏移无法被指针表示时拒绝取地址
+	if (offset > PointerHandle::OffsetMask)
+	{
+		nat_Throw(InterpreterException, u8"对象过大，无法被指针引用"_nv);
+	}
+
+	return { slot, region.Generation, offset };
+}
+
+nData Interpreter::InterpreterDeclStorage::ResolvePointerHandle(PointerHandle handle, std::size_t accessSize) const
+{
+	if (handle.IsNull())
+	{
+		return nullptr;
+	}
+
+	const auto slot = handle.GetSlot();
+	if (slot >= m_StorageRegions.size())
+	{
+		nat_Throw(InterpreterException, u8"无效的指针"_nv);
+	}
+
+	const auto& region = m_StorageRegions[slot];
+	if (!region.InUse || (region.Generation & PointerHandle::GenerationMask) != handle.GetGeneration())
+	{
+		nat_Throw(InterpreterException, u8"指针引用的对象已被销毁"_nv);
+	}
+
+	const auto offset = handle.GetOffset();
+	if (offset + accessSize > region.Size)
+	{
+		nat_Throw(InterpreterException, u8"通过指针的访问越界"_nv);
+	}
+
+	return region.Base + offset;
+}
+
+nuInt Interpreter::InterpreterDeclStorage::registerOwningRegion(std::uintptr_t address)
+{
+	// 允许引用存储末尾之后的位置，但包含此地址的存储优先
+	std::unique_ptr<nByte[], StorageDeleter>* pastEndStorage{};
+	for (auto& curStorage : m_DeclStorage)
+	{
+		for (auto& item : *curStorage.second)
+		{
+			auto& storage = item.second;
+			if (storage.get_deleter().RegionSlot)
+			{
+				continue;
+			}
+
+			const auto base = reinterpret_cast<std::uintptr_t>(storage.get());
+			const auto size = storage.get_deleter().Size;
+			if (address >= base && address - base <= size)
+			{
+				if (address - base < size)
+				{
+					return storage.get_deleter().RegionSlot = RegisterRegion(storage.get(), size);
+				}
+
+				pastEndStorage = &storage;
+			}
+		}
+	}
+
+	if (pastEndStorage)
+	{
+		return pastEndStorage->get_deleter().RegionSlot = RegisterRegion(pastEndStorage->get(), pastEndStorage->get_deleter().Size);
+	}
+
+	return 0;
+}
@@ -1,4 +1,10 @@
 ﻿#include "Interpreter.h"
+#include <cstdio>
+#include <limits>
+
+#if defined(__SIZEOF_FLOAT128__) && defined(NATSULANG_HAS_QUADMATH)
+#include <quadmath.h>
+#endif
 
 using namespace NatsuLib;
 using namespace NatsuLang;
@@ -6,6 +12,12 @@ using namespace NatsuLang::Detail;
 
 namespace
 {
+	// 临时对象没有名称，数组元素及通过指针访问的对象没有名称但仍然可以被修改
+	nBool IsModifiable(natRefPointer<Declaration::ValueDecl> const& decl) noexcept
+	{
+		return decl->GetIdentifierInfo() || decl.Cast<Interpreter::InterpreterDeclStorage::MemoryLocationDecl>();
+	}
+
 	template <typename T>
 	nString ToString(T const& value)
 	{
@@ -59,7 +71,13 @@ namespace
 		}
 		else if constexpr (std::is_same_v<T, Interpreter::InterpreterDeclStorage::PointerAccessor>)
 		{
-			return natUtil::FormatString("Referenced decl : ({0})", value.GetReferencedDecl().Get());
+			const auto handle = value.GetHandle();
+			if (handle.IsNull())
+			{
+				return u8"null"_nv;
+			}
+
+			return natUtil::FormatString("Pointer : (region {0}, generation {1}, offset {2})", handle.GetSlot(), handle.GetGeneration(), handle.GetOffset());
 		}
 		else if constexpr (std::is_same_v<T, nChar>)
 		{
@@ -69,6 +87,50 @@ namespace
 		{
 			return value ? u8"true"_nv : u8"false"_nv;
 		}
+		else if constexpr (std::is_same_v<T, nInt128> || std::is_same_v<T, nuInt128>)
+		{
+			// natUtil::FormatString 不支持 128 位整数，需要手动转换
+			nuInt128 absValue = static_cast<nuInt128>(value);
+			auto isNegative = false;
+			if constexpr (std::is_same_v<T, nInt128>)
+			{
+				if (value < 0)
+				{
+					isNegative = true;
+					absValue = nuInt128{} - absValue;
+				}
+			}
+
+			char buffer[48]{};
+			auto pos = sizeof buffer - 1;
+			do
+			{
+				buffer[--pos] = static_cast<char>('0' + static_cast<nuInt>(absValue % 10));
+				absValue /= 10;
+			} while (absValue);
+
+			if (isNegative)
+			{
+				buffer[--pos] = '-';
+			}
+
+			return nStrView{ buffer + pos };
+		}
+		else if constexpr (std::is_same_v<T, nLongDouble> || std::is_same_v<T, nFloat128>)
+		{
+			// std::to_string 使用 %Lf，只保留 6 位小数，此处以能往返的最短精度输出
+			char buffer[128]{};
+#if defined(__SIZEOF_FLOAT128__) && defined(NATSULANG_HAS_QUADMATH)
+			if constexpr (std::is_same_v<T, nFloat128> && !std::is_same_v<nFloat128, nLongDouble>)
+			{
+				// 113 位有效数字需要 36 位十进制数字才能无损往返
+				quadmath_snprintf(buffer, sizeof buffer, "%.*Qg", 36, value);
+				return nStrView{ buffer };
+			}
+#endif
+			std::snprintf(buffer, sizeof buffer, "%.*Lg", std::numeric_limits<nLongDouble>::max_digits10, static_cast<nLongDouble>(value));
+			return nStrView{ buffer };
+		}
 		else
 		{
 			return natUtil::FormatString("{0}", value);
@@ -106,6 +168,17 @@ Expression::ExprPtr Interpreter::InterpreterExprVisitor::GetLastVisitedExpr() co
 	return m_LastVisitedExpr;
 }
 
+void Interpreter::InterpreterExprVisitor::Visit(natRefPointer<Statement::Stmt> const& stmt)
+{
+	// 已抛出异常时不再对后续的操作数求值
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
+	StmtVisitor::Visit(stmt);
+}
+
 void Interpreter::InterpreterExprVisitor::VisitStmt(natRefPointer<Statement::Stmt> const& stmt)
 {
 	nat_Throw(InterpreterException, u8"此表达式无法被访问"_nv);
@@ -206,6 +279,11 @@ void Interpreter::InterpreterExprVisitor::VisitNullPointerLiteral(natRefPointer<
 void Interpreter::InterpreterExprVisitor::VisitArraySubscriptExpr(natRefPointer<Expression::ArraySubscriptExpr> const& expr)
 {
 	Visit(expr->GetLeftOperand());
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
 	const auto baseOperand = m_LastVisitedExpr.Cast<Expression::DeclRefExpr>();
 	natRefPointer<Declaration::ValueDecl> baseDecl;
 	natRefPointer<Type::ArrayType> baseType;
@@ -221,11 +299,16 @@ void Interpreter::InterpreterExprVisitor::VisitArraySubscriptExpr(natRefPointer<
 	}
 
 	Visit(expr->GetRightOperand());
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
 	nuLong indexValue;
 	if (!Evaluate(m_LastVisitedExpr, [&indexValue](auto value)
 	{
 		indexValue = value;
-	}, Expected<nShort, nuShort, nInt, nuInt, nLong, nuLong>))
+	}, Expected<nShort, nuShort, nInt, nuInt, nLong, nuLong, nInt128, nuInt128>))
 	{
 		nat_Throw(InterpreterException, u8"下标操作数无法被计算为有效的整数值"_nv);
 	}
@@ -235,13 +318,11 @@ void Interpreter::InterpreterExprVisitor::VisitArraySubscriptExpr(natRefPointer<
 		nat_Throw(InterpreterException, u8"下标越界"_nv);
 	}
 
-	if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(baseDecl, [this, indexValue, &expr](InterpreterDeclStorage::ArrayElementAccessor const& accessor)
-	{
-		m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, accessor.GetElementDecl(indexValue), SourceLocation{}, expr->GetExprType(), Expression::ValueCategory::LValue);
-	}, Expected<InterpreterDeclStorage::ArrayElementAccessor>))
-	{
-		nat_Throw(InterpreterException, u8"无法访问存储"_nv);
-	}
+	// 由元素大小及下标直接计算元素的存储
+	const auto elementType = baseType->GetElementType();
+	const auto baseStorage = m_Interpreter.m_DeclStorage.GetOrAddDecl(baseDecl, baseType).second;
+	const auto elementStorage = baseStorage + m_Interpreter.m_AstContext.GetTypeInfo(elementType).Size * static_cast<std::size_t>(indexValue);
+	m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, make_ref<InterpreterDeclStorage::MemoryLocationDecl>(elementType, elementStorage), SourceLocation{}, expr->GetExprType(), Expression::ValueCategory::LValue);
 }
 
 void Interpreter::InterpreterExprVisitor::VisitConstructExpr(natRefPointer<Expression::ConstructExpr> const& expr)
@@ -264,14 +345,82 @@ void Interpreter::InterpreterExprVisitor::VisitThisExpr(natRefPointer<Expression
 	nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
 }
 
+// 抛出异常仅设置解释器的异常状态，由各访问者在返回路径上传播
 void Interpreter::InterpreterExprVisitor::VisitThrowExpr(natRefPointer<Expression::ThrowExpr> const& expr)
 {
-	nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
+	m_LastVisitedExpr = nullptr;
+
+	const auto operand = expr->GetOperand();
+	if (!operand)
+	{
+		if (m_Interpreter.m_HandlingExceptions.empty())
+		{
+			nat_Throw(InterpreterException, u8"不存在正在处理的异常，无法重新抛出"_nv);
+		}
+
+		m_Interpreter.m_ThrownException = m_Interpreter.m_HandlingExceptions.back();
+		m_Interpreter.m_ExceptionThrown = true;
+		return;
+	}
+
+	auto type = Type::Type::GetUnderlyingType(operand->GetExprType());
+	const auto objectSize = m_Interpreter.m_AstContext.GetTypeInfo(type).Size;
+	std::shared_ptr<nByte[]> objectStorage{ new nByte[objectSize] };
+	const auto objectDecl = make_ref<InterpreterDeclStorage::MemoryLocationDecl>(type, objectStorage.get());
+
+	if (!Evaluate(operand, [this, &objectDecl, objectSize](auto&& value)
+	{
+		using ValueType = std::remove_cv_t<std::remove_reference_t<decltype(value)>>;
+
+		if constexpr (std::is_same_v<ValueType, InterpreterDeclStorage::MemberAccessor>)
+		{
+			// 前端保证类不具有析构函数，解释器中的对象均可按字节复制
+			std::memcpy(objectDecl->GetMemoryLocation(), value.GetStorage(), objectSize);
+		}
+		else if constexpr (std::is_same_v<ValueType, InterpreterDeclStorage::PointerAccessor>)
+		{
+			if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(objectDecl, [handle = value.GetHandle()](InterpreterDeclStorage::PointerAccessor& storage)
+			{
+				storage.SetHandle(handle);
+			}, Expected<InterpreterDeclStorage::PointerAccessor>))
+			{
+				nat_Throw(InterpreterException, u8"无法访问存储"_nv);
+			}
+		}
+		else
+		{
+			if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(objectDecl, [value](auto& storage)
+			{
+				storage = value;
+			}, Expected<ValueType>))
+			{
+				nat_Throw(InterpreterException, u8"无法访问存储"_nv);
+			}
+		}
+	}, Excepted<nStrView, InterpreterDeclStorage::ArrayElementAccessor>))
+	{
+		nat_Throw(InterpreterException, u8"无法对操作数求值"_nv);
+	}
+
+	// 对操作数求值时抛出了异常，传播该异常
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
+	const auto typeId = m_Interpreter.getExceptionTypeId(type);
+	m_Interpreter.m_ThrownException = { typeId, std::move(type), std::move(objectStorage) };
+	m_Interpreter.m_ExceptionThrown = true;
 }
 
 void Interpreter::InterpreterExprVisitor::VisitCallExpr(natRefPointer<Expression::CallExpr> const& expr)
 {
 	Visit(expr->GetCallee());
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
 	const auto callee = m_LastVisitedExpr.Cast<Expression::DeclRefExpr>();
 	if (!callee)
 	{
@@ -280,9 +429,28 @@ void Interpreter::InterpreterExprVisitor::VisitCallExpr(natRefPointer<Expression
 
 	if (const auto calleeDecl = callee->GetDecl().Cast<Declaration::FunctionDecl>())
 	{
-		if (!calleeDecl->GetBody())
+		// 通过 RegisterFunction 注册的函数没有函数体
+		const auto nativeFuncIter = m_Interpreter.m_FunctionMap.find(calleeDecl);
+		if (nativeFuncIter == m_Interpreter.m_FunctionMap.end())
 		{
-			nat_Throw(InterpreterException, u8"该函数无函数体，调用了声明为 extern 的函数？"_nv);
+			// 需要在解析前判断，解析后缓存的函数体将被移除
+			const auto hasPendingBody = m_Interpreter.m_Parser.HasPendingFunctionBody(calleeDecl);
+			if (!m_Interpreter.m_Parser.ResolveFunctionBody(calleeDecl))
+			{
+				if (hasPendingBody)
+				{
+					nat_Throw(InterpreterException, u8"无法分析函数 {0} 被延迟的函数体"_nv, calleeDecl->GetName());
+				}
+
+				nat_Throw(InterpreterException, u8"该函数无函数体，调用了声明为 extern 的函数？"_nv);
+			}
+
+			// 延迟分析的函数体中的错误在此时才被报告，即使分析得到了函数体也不能执行
+			if (hasPendingBody && m_Interpreter.m_DiagConsumer->HasError())
+			{
+				m_Interpreter.m_DiagConsumer->Reset();
+				nat_Throw(InterpreterException, u8"函数 {0} 的函数体存在错误"_nv, calleeDecl->GetName());
+			}
 		}
 
 		const auto args = expr->GetArgs();
@@ -324,12 +492,32 @@ void Interpreter::InterpreterExprVisitor::VisitCallExpr(natRefPointer<Expression
 			}
 		}
 
+		// 对实参求值时抛出了异常，不进行调用
+		if (m_Interpreter.m_ExceptionThrown)
+		{
+			return;
+		}
+
 		m_Interpreter.m_DeclStorage.SetTopStorageFlag(DeclStorageLevelFlag::AvailableForCreateStorage | DeclStorageLevelFlag::AvailableForLookup);
 
-		const auto iter = m_Interpreter.m_FunctionMap.find(calleeDecl);
-		if (iter != m_Interpreter.m_FunctionMap.end())
+		// 实参在调用者中求值，不计入被调用者
+		const auto profiling = m_Interpreter.m_Profiler.IsEnabled();
+		if (profiling)
+		{
+			m_Interpreter.m_Profiler.EnterFunction(calleeDecl);
+		}
+
+		const auto profilerScope = make_scope([this, profiling]
 		{
-			auto decl = iter->second({ params.begin(), params.end() });
+			if (profiling)
+			{
+				m_Interpreter.m_Profiler.LeaveFunction();
+			}
+		});
+
+		if (nativeFuncIter != m_Interpreter.m_FunctionMap.end())
+		{
+			auto decl = nativeFuncIter->second({ params.begin(), params.end() });
 			auto declType = decl->GetValueType();
 			m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(decl), SourceLocation{}, std::move(declType), Expression::ValueCategory::LValue);
 		}
@@ -338,7 +526,8 @@ void Interpreter::InterpreterExprVisitor::VisitCallExpr(natRefPointer<Expression
 			InterpreterStmtVisitor stmtVisitor{ m_Interpreter };
 			stmtVisitor.Visit(calleeDecl->GetBody());
 			m_LastVisitedExpr = stmtVisitor.GetReturnedExpr();
-			if (!m_LastVisitedExpr)
+			// 被调用者抛出的异常由调用者的访问者继续传播
+			if (!m_LastVisitedExpr && !m_Interpreter.m_ExceptionThrown)
 			{
 				const auto retType = static_cast<natRefPointer<Type::FunctionType>>(calleeDecl->GetValueType())->GetResultType().Cast<Type::BuiltinType>();
 				if (!retType || retType->GetBuiltinClass() != Type::BuiltinType::Void)
@@ -377,11 +566,11 @@ void Interpreter::InterpreterExprVisitor::VisitAsTypeExpr(natRefPointer<Expressi
 		if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(std::move(tempObjDef), [value](auto& storage)
 		{
 			storage = static_cast<std::remove_reference_t<decltype(storage)>>(value);
-		}, Expected<nBool, nShort, nuShort, nInt, nuInt, nLong, nuLong, nFloat, nDouble>))
+		}, Expected<nBool, nShort, nuShort, nInt, nuInt, nLong, nuLong, nInt128, nuInt128, nFloat, nDouble, nLongDouble, nFloat128>))
 		{
 			nat_Throw(InterpreterException, u8"无法创建临时对象的存储"_nv);
 		}
-	}, Expected<nBool, nShort, nuShort, nInt, nuInt, nLong, nuLong, nFloat, nDouble>))
+	}, Expected<nBool, nShort, nuShort, nInt, nuInt, nLong, nuLong, nInt128, nuInt128, nFloat, nDouble, nLongDouble, nFloat128>))
 	{
 		m_LastVisitedExpr = std::move(declRefExpr);
 		return;
@@ -403,11 +592,11 @@ void Interpreter::InterpreterExprVisitor::VisitImplicitCastExpr(natRefPointer<Ex
 		if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(std::move(tempObjDef), [value](auto& storage)
 		{
 			storage = static_cast<std::remove_reference_t<decltype(storage)>>(value);
-		}, Expected<nBool, nShort, nuShort, nInt, nuInt, nLong, nuLong, nFloat, nDouble>))
+		}, Expected<nBool, nShort, nuShort, nInt, nuInt, nLong, nuLong, nInt128, nuInt128, nFloat, nDouble, nLongDouble, nFloat128>))
 		{
 			nat_Throw(InterpreterException, u8"无法创建临时对象的存储"_nv);
 		}
-	}, Expected<nBool, nShort, nuShort, nInt, nuInt, nLong, nuLong, nFloat, nDouble>))
+	}, Expected<nBool, nShort, nuShort, nInt, nuInt, nLong, nuLong, nInt128, nuInt128, nFloat, nDouble, nLongDouble, nFloat128>))
 	{
 		m_LastVisitedExpr = std::move(declRefExpr);
 		return;
@@ -418,7 +607,36 @@ void Interpreter::InterpreterExprVisitor::VisitImplicitCastExpr(natRefPointer<Ex
 
 void Interpreter::InterpreterExprVisitor::VisitMemberExpr(natRefPointer<Expression::MemberExpr> const& expr)
 {
-	nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
+	// TODO: 支持访问方法
+	const auto fieldDecl = expr->GetMemberDecl().Cast<Declaration::FieldDecl>();
+	if (!fieldDecl)
+	{
+		nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
+	}
+
+	Visit(expr->GetBase());
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
+	const auto baseOperand = m_LastVisitedExpr.Cast<Expression::DeclRefExpr>();
+	if (!baseOperand)
+	{
+		nat_Throw(InterpreterException, u8"基础操作数无法被计算为有效的定义引用表达式"_nv);
+	}
+
+	// 成员直接引用对象的存储
+	natRefPointer<InterpreterDeclStorage::MemoryLocationDecl> memberDecl;
+	if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(baseOperand->GetDecl(), [&memberDecl, &fieldDecl](InterpreterDeclStorage::MemberAccessor& accessor)
+	{
+		memberDecl = accessor.GetMemberDecl(fieldDecl);
+	}, Expected<InterpreterDeclStorage::MemberAccessor>) || !memberDecl)
+	{
+		nat_Throw(InterpreterException, u8"无法访问成员"_nv);
+	}
+
+	m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(memberDecl), SourceLocation{}, expr->GetExprType(), Expression::ValueCategory::LValue);
 }
 
 void Interpreter::InterpreterExprVisitor::VisitParenExpr(natRefPointer<Expression::ParenExpr> const& expr)
@@ -434,6 +652,11 @@ void Interpreter::InterpreterExprVisitor::VisitStmtExpr(natRefPointer<Expression
 void Interpreter::InterpreterExprVisitor::VisitConditionalOperator(natRefPointer<Expression::ConditionalOperator> const& expr)
 {
 	Visit(expr->GetCondition());
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
 	const auto cond = std::move(m_LastVisitedExpr);
 
 	nBool condValue;
@@ -469,6 +692,10 @@ void Interpreter::InterpreterExprVisitor::VisitBinaryOperator(natRefPointer<Expr
 	const auto leftOperand = std::move(m_LastVisitedExpr);
 	Visit(expr->GetRightOperand());
 	auto rightOperand = std::move(m_LastVisitedExpr);
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
 
 	auto tempObjDecl = InterpreterDeclStorage::CreateTemporaryObjectDecl(expr->GetExprType());
 
@@ -537,7 +764,7 @@ void Interpreter::InterpreterExprVisitor::VisitBinaryOperator(natRefPointer<Expr
 					nat_Throw(InterpreterException, u8"无法创建临时对象的存储"_nv);
 				}
 			}, Expected<decltype(leftValue)>);
-		}, Excepted<nBool, nByte, nStrView, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
+		}, Excepted<nBool, nByte, nStrView, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
 		{
 			m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(tempObjDecl), SourceLocation{}, expr->GetExprType(), Expression::ValueCategory::LValue);
 			return;
@@ -594,7 +821,7 @@ void Interpreter::InterpreterExprVisitor::VisitBinaryOperator(natRefPointer<Expr
 					nat_Throw(InterpreterException, u8"无法创建临时对象的存储"_nv);
 				}
 			}, Expected<decltype(leftValue)>);
-		}, Excepted<nBool, nByte, nStrView, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
+		}, Excepted<nBool, nByte, nStrView, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
 		{
 			m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(tempObjDecl), SourceLocation{}, expr->GetExprType(), Expression::ValueCategory::LValue);
 			return;
@@ -613,7 +840,7 @@ void Interpreter::InterpreterExprVisitor::VisitBinaryOperator(natRefPointer<Expr
 					nat_Throw(InterpreterException, u8"无法创建临时对象的存储"_nv);
 				}
 			}, Expected<decltype(leftValue)>);
-		}, Excepted<nBool, nByte, nStrView, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
+		}, Excepted<nBool, nByte, nStrView, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
 		{
 			m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(tempObjDecl), SourceLocation{}, expr->GetExprType(), Expression::ValueCategory::LValue);
 			return;
@@ -746,7 +973,7 @@ void Interpreter::InterpreterExprVisitor::VisitBinaryOperator(natRefPointer<Expr
 					nat_Throw(InterpreterException, u8"无法创建临时对象的存储"_nv);
 				}
 			}, Expected<decltype(leftValue)>);
-		}, Excepted<nByte, nStrView, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
+		}, Excepted<nByte, nStrView, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
 		{
 			m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(tempObjDecl), SourceLocation{}, expr->GetExprType(), Expression::ValueCategory::LValue);
 			return;
@@ -765,7 +992,7 @@ void Interpreter::InterpreterExprVisitor::VisitBinaryOperator(natRefPointer<Expr
 					nat_Throw(InterpreterException, u8"无法创建临时对象的存储"_nv);
 				}
 			}, Expected<decltype(leftValue)>);
-		}, Excepted<nByte, nStrView, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
+		}, Excepted<nByte, nStrView, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
 		{
 			m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(tempObjDecl), SourceLocation{}, expr->GetExprType(), Expression::ValueCategory::LValue);
 			return;
@@ -784,7 +1011,7 @@ void Interpreter::InterpreterExprVisitor::VisitBinaryOperator(natRefPointer<Expr
 					nat_Throw(InterpreterException, u8"无法创建临时对象的存储"_nv);
 				}
 			}, Expected<decltype(leftValue)>);
-		}, Excepted<nByte, nStrView, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
+		}, Excepted<nByte, nStrView, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>) && evalSucceed)
 		{
 			m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(tempObjDecl), SourceLocation{}, expr->GetExprType(), Expression::ValueCategory::LValue);
 			return;
@@ -842,13 +1069,18 @@ void Interpreter::InterpreterExprVisitor::VisitCompoundAssignOperator(natRefPoin
 {
 	const auto opCode = expr->GetOpcode();
 	Visit(expr->GetLeftOperand());
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
 	const auto leftOperand = std::move(m_LastVisitedExpr);
 	const auto rightOperand = expr->GetRightOperand();
 
 	auto leftDeclExpr = leftOperand.Cast<Expression::DeclRefExpr>();
 
 	natRefPointer<Declaration::ValueDecl> decl;
-	if (!leftDeclExpr || !((decl = leftDeclExpr->GetDecl())) || !decl->GetIdentifierInfo())
+	if (!leftDeclExpr || !((decl = leftDeclExpr->GetDecl())) || !IsModifiable(decl))
 	{
 		nat_Throw(InterpreterException, u8"左操作数必须是对非临时对象的定义的引用"_nv);
 	}
@@ -858,6 +1090,40 @@ void Interpreter::InterpreterExprVisitor::VisitCompoundAssignOperator(natRefPoin
 	switch (opCode)
 	{
 	case Expression::BinaryOperationType::Assign:
+		// 指针的赋值仅复制句柄
+		if (Type::Type::GetUnderlyingType(decl->GetValueType())->GetType() == Type::Type::Pointer)
+		{
+			InterpreterDeclStorage::PointerHandle handle;
+			evalSucceed = Evaluate(rightOperand, [&handle](InterpreterDeclStorage::PointerAccessor& accessor)
+			{
+				handle = accessor.GetHandle();
+			}, Expected<InterpreterDeclStorage::PointerAccessor>);
+
+			if (m_Interpreter.m_ExceptionThrown)
+			{
+				return;
+			}
+
+			visitSucceed = m_Interpreter.m_DeclStorage.VisitDeclStorage(decl, [handle](InterpreterDeclStorage::PointerAccessor& accessor)
+			{
+				accessor.SetHandle(handle);
+			}, Expected<InterpreterDeclStorage::PointerAccessor>);
+			break;
+		}
+
+		// 数组的赋值整体复制存储
+		if (Type::Type::GetUnderlyingType(decl->GetValueType())->GetType() == Type::Type::Array)
+		{
+			visitSucceed = m_Interpreter.m_DeclStorage.VisitDeclStorage(decl, [this, &rightOperand, &evalSucceed](InterpreterDeclStorage::ArrayElementAccessor& storage)
+			{
+				evalSucceed = Evaluate(rightOperand, [&storage](InterpreterDeclStorage::ArrayElementAccessor& value)
+				{
+					storage.CopyFrom(value);
+				}, Expected<InterpreterDeclStorage::ArrayElementAccessor>);
+			}, Expected<InterpreterDeclStorage::ArrayElementAccessor>);
+			break;
+		}
+
 		visitSucceed = m_Interpreter.m_DeclStorage.VisitDeclStorage(decl, [this, &rightOperand, &evalSucceed](auto& storage)
 		{
 			evalSucceed = Evaluate(rightOperand, [&storage](auto value)
@@ -891,7 +1157,7 @@ void Interpreter::InterpreterExprVisitor::VisitCompoundAssignOperator(natRefPoin
 			{
 				storage %= value;
 			}, Expected<std::remove_reference_t<decltype(storage)>>);
-		}, Excepted<nBool, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
+		}, Excepted<nBool, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
 		break;
 	case Expression::BinaryOperationType::AddAssign:
 		visitSucceed = m_Interpreter.m_DeclStorage.VisitDeclStorage(decl, [this, &rightOperand, &evalSucceed](auto& storage)
@@ -918,7 +1184,7 @@ void Interpreter::InterpreterExprVisitor::VisitCompoundAssignOperator(natRefPoin
 			{
 				storage <<= value;
 			}, Expected<std::remove_reference_t<decltype(storage)>>);
-		}, Excepted<nBool, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
+		}, Excepted<nBool, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
 		break;
 	case Expression::BinaryOperationType::ShrAssign:
 		visitSucceed = m_Interpreter.m_DeclStorage.VisitDeclStorage(decl, [this, &rightOperand, &evalSucceed](auto& storage)
@@ -927,7 +1193,7 @@ void Interpreter::InterpreterExprVisitor::VisitCompoundAssignOperator(natRefPoin
 			{
 				storage >>= value;
 			}, Expected<std::remove_reference_t<decltype(storage)>>);
-		}, Excepted<nBool, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
+		}, Excepted<nBool, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
 		break;
 	case Expression::BinaryOperationType::AndAssign:
 		visitSucceed = m_Interpreter.m_DeclStorage.VisitDeclStorage(decl, [this, &rightOperand, &evalSucceed](auto& storage)
@@ -936,7 +1202,7 @@ void Interpreter::InterpreterExprVisitor::VisitCompoundAssignOperator(natRefPoin
 			{
 				storage &= value;
 			}, Expected<std::remove_reference_t<decltype(storage)>>);
-		}, Excepted<nBool, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
+		}, Excepted<nBool, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
 		break;
 	case Expression::BinaryOperationType::XorAssign:
 		visitSucceed = m_Interpreter.m_DeclStorage.VisitDeclStorage(decl, [this, &rightOperand, &evalSucceed](auto& storage)
@@ -945,7 +1211,7 @@ void Interpreter::InterpreterExprVisitor::VisitCompoundAssignOperator(natRefPoin
 			{
 				storage ^= value;
 			}, Expected<std::remove_reference_t<decltype(storage)>>);
-		}, Excepted<nBool, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
+		}, Excepted<nBool, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
 		break;
 	case Expression::BinaryOperationType::OrAssign:
 		visitSucceed = m_Interpreter.m_DeclStorage.VisitDeclStorage(decl, [this, &rightOperand, &evalSucceed](auto& storage)
@@ -954,7 +1220,7 @@ void Interpreter::InterpreterExprVisitor::VisitCompoundAssignOperator(natRefPoin
 			{
 				storage |= value;
 			}, Expected<std::remove_reference_t<decltype(storage)>>);
-		}, Excepted<nBool, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
+		}, Excepted<nBool, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>);
 		break;
 	case Expression::BinaryOperationType::Invalid:
 	default:
@@ -974,6 +1240,11 @@ void Interpreter::InterpreterExprVisitor::VisitUnaryOperator(natRefPointer<Expre
 {
 	const auto opCode = expr->GetOpcode();
 	Visit(expr->GetOperand());
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
 	const auto declExpr = m_LastVisitedExpr.Cast<Expression::DeclRefExpr>();
 
 	switch (opCode)
@@ -982,7 +1253,7 @@ void Interpreter::InterpreterExprVisitor::VisitUnaryOperator(natRefPointer<Expre
 		if (declExpr)
 		{
 			const auto decl = declExpr->GetDecl();
-			if (!decl->GetIdentifierInfo())
+			if (!IsModifiable(decl))
 			{
 				nat_Throw(InterpreterException, u8"不允许修改临时对象"_nv);
 			}
@@ -1010,7 +1281,7 @@ void Interpreter::InterpreterExprVisitor::VisitUnaryOperator(natRefPointer<Expre
 		if (declExpr)
 		{
 			const auto decl = declExpr->GetDecl();
-			if (!decl->GetIdentifierInfo())
+			if (!IsModifiable(decl))
 			{
 				nat_Throw(InterpreterException, u8"不允许修改临时对象"_nv);
 			}
@@ -1038,7 +1309,7 @@ void Interpreter::InterpreterExprVisitor::VisitUnaryOperator(natRefPointer<Expre
 		if (declExpr)
 		{
 			auto decl = declExpr->GetDecl();
-			if (!decl->GetIdentifierInfo())
+			if (!IsModifiable(decl))
 			{
 				nat_Throw(InterpreterException, u8"不允许修改临时对象"_nv);
 			}
@@ -1056,7 +1327,7 @@ void Interpreter::InterpreterExprVisitor::VisitUnaryOperator(natRefPointer<Expre
 		if (declExpr)
 		{
 			auto decl = declExpr->GetDecl();
-			if (!decl->GetIdentifierInfo())
+			if (!IsModifiable(decl))
 			{
 				nat_Throw(InterpreterException, u8"不允许修改临时对象"_nv);
 			}
@@ -1125,7 +1396,7 @@ void Interpreter::InterpreterExprVisitor::VisitUnaryOperator(natRefPointer<Expre
 			{
 				nat_Throw(InterpreterException, u8"无法对操作数求值"_nv);
 			}
-		}, Excepted<nStrView, nBool, nFloat, nDouble, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>))
+		}, Excepted<nStrView, nBool, nFloat, nDouble, nLongDouble, nFloat128, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>))
 		{
 			m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(tempObjDef), SourceLocation{}, std::move(type), Expression::ValueCategory::LValue);
 			return;
@@ -1170,7 +1441,8 @@ void Interpreter::InterpreterExprVisitor::VisitUnaryOperator(natRefPointer<Expre
 			nat_Throw(InterpreterException, u8"该表达式引用的是临时对象的定义"_nv);
 		}
 
-		if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(tempObjDef, [decl](InterpreterDeclStorage::PointerAccessor& accessor)
+		// 指针直接引用声明的存储，不持有声明
+		if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(tempObjDef, [&decl](InterpreterDeclStorage::PointerAccessor& accessor)
 		{
 			accessor.SetReferencedDecl(decl);
 		}, Expected<InterpreterDeclStorage::PointerAccessor>))
@@ -1191,6 +1463,11 @@ void Interpreter::InterpreterExprVisitor::VisitUnaryOperator(natRefPointer<Expre
 		if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(declExpr->GetDecl(), [this](InterpreterDeclStorage::PointerAccessor& accessor)
 		{
 			auto decl = accessor.GetReferencedDecl();
+			if (!decl)
+			{
+				nat_Throw(InterpreterException, u8"试图解引用空指针"_nv);
+			}
+
 			auto declType = decl->GetValueType();
 			m_LastVisitedExpr = make_ref<Expression::DeclRefExpr>(nullptr, std::move(decl), SourceLocation{}, std::move(declType), Expression::ValueCategory::LValue);
 		}, Expected<InterpreterDeclStorage::PointerAccessor>))
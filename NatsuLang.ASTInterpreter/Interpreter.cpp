@@ -10,11 +10,12 @@ Interpreter::Interpreter(natRefPointer<TextReader<StringType::Utf8>> const& diag
 	  m_Logger{ logger },
 	  m_SourceManager{ m_Diag, m_FileManager },
 	  m_Preprocessor{ m_Diag, m_SourceManager },
-	  m_AstContext{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } },
+	  // 指针以 64 位的句柄表示，参见 InterpreterDeclStorage::PointerHandle
+	  m_AstContext{ TargetInfo{ Environment::GetEndianness(), sizeof(nuLong), alignof(nuLong) } },
 	  m_Consumer{ make_ref<InterpreterASTConsumer>(*this) },
 	  m_Sema{ m_Preprocessor, m_AstContext, m_Consumer },
 	  m_Parser{ m_Preprocessor, m_Sema },
-	  m_Visitor{ *this }, m_DeclStorage{ *this }
+	  m_Visitor{ *this }, m_DeclStorage{ *this }, m_ExceptionThrown{ false }
 {
 	m_AstContext.UseDefaultClassLayoutBuilder();
 }
@@ -52,6 +53,7 @@ void Interpreter::Run(nStrView content)
 	m_Visitor.Visit(stmt);
 	m_Visitor.ResetReturnedExpr();
 	m_DeclStorage.GarbageCollect();
+	checkUncaughtException();
 }
 
 Interpreter::InterpreterDeclStorage& Interpreter::GetDeclStorage() noexcept
@@ -89,3 +91,30 @@ ASTContext& Interpreter::GetASTContext() noexcept
 {
 	return m_AstContext;
 }
+
+SourceManager& Interpreter::GetSourceManager() noexcept
+{
+	return m_SourceManager;
+}
+
+Interpreter::InterpreterProfiler& Interpreter::GetProfiler() noexcept
+{
+	return m_Profiler;
+}
+
+std::size_t Interpreter::getExceptionTypeId(Type::TypePtr const& type)
+{
+	return m_ExceptionTypeIds.try_emplace(type, m_ExceptionTypeIds.size()).first->second;
+}
+
+void Interpreter::checkUncaughtException()
+{
+	if (!m_ExceptionThrown)
+	{
+		return;
+	}
+
+	m_ExceptionThrown = false;
+	m_ThrownException = {};
+	nat_Throw(InterpreterException, u8"存在未被捕获的异常"_nv);
+}
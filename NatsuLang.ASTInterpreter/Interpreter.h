@@ -79,17 +79,17 @@ namespace NatsuLang
 	OP(UInt, nuInt)\
 	OP(ULong, nuLong)\
 	OP(ULongLong, nuLong)\
-	OP(UInt128, nuLong)\
+	OP(UInt128, nuInt128)\
 	OP(SByte, nSByte)\
 	OP(Short, nShort)\
 	OP(Int, nInt)\
 	OP(Long, nLong)\
 	OP(LongLong, nLong)\
-	OP(Int128, nLong)\
+	OP(Int128, nInt128)\
 	OP(Float, nFloat)\
 	OP(Double, nDouble)\
-	OP(LongDouble, nDouble)\
-	OP(Float128, nDouble)
+	OP(LongDouble, nLongDouble)\
+	OP(Float128, nFloat128)
 
 		template <Type::BuiltinType::BuiltinClass BuiltinClass>
 		struct BuiltinTypeMap;
@@ -236,8 +236,9 @@ namespace NatsuLang
 						case Type::BuiltinType::Double:
 							return Detail::InvokeIfSatisfied(m_Visitor, expr->GetValue(), ExpectedOrExcepted{});
 						case Type::BuiltinType::LongDouble:
+							return Detail::InvokeIfSatisfied(m_Visitor, static_cast<nLongDouble>(expr->GetValue()), ExpectedOrExcepted{});
 						case Type::BuiltinType::Float128:
-							break;
+							return Detail::InvokeIfSatisfied(m_Visitor, static_cast<nFloat128>(expr->GetValue()), ExpectedOrExcepted{});
 						default:
 							nat_Throw(InterpreterException, u8"浮点字面量不应具有此类型"_nv);
 						}
@@ -260,16 +261,18 @@ namespace NatsuLang
 							return Detail::InvokeIfSatisfied(m_Visitor, static_cast<nuInt>(expr->GetValue()), ExpectedOrExcepted{});
 						case Type::BuiltinType::ULong:
 						case Type::BuiltinType::ULongLong:
-						case Type::BuiltinType::UInt128:
 							return Detail::InvokeIfSatisfied(m_Visitor, expr->GetValue(), ExpectedOrExcepted{});
+						case Type::BuiltinType::UInt128:
+							return Detail::InvokeIfSatisfied(m_Visitor, static_cast<nuInt128>(expr->GetValue()), ExpectedOrExcepted{});
 						case Type::BuiltinType::Short:
 							return Detail::InvokeIfSatisfied(m_Visitor, static_cast<nShort>(expr->GetValue()), ExpectedOrExcepted{});
 						case Type::BuiltinType::Int:
 							return Detail::InvokeIfSatisfied(m_Visitor, static_cast<nInt>(expr->GetValue()), ExpectedOrExcepted{});
 						case Type::BuiltinType::Long:
 						case Type::BuiltinType::LongLong:
-						case Type::BuiltinType::Int128:
 							return Detail::InvokeIfSatisfied(m_Visitor, static_cast<nLong>(expr->GetValue()), ExpectedOrExcepted{});
+						case Type::BuiltinType::Int128:
+							return Detail::InvokeIfSatisfied(m_Visitor, static_cast<nInt128>(static_cast<nLong>(expr->GetValue())), ExpectedOrExcepted{});
 						default:
 							nat_Throw(InterpreterException, u8"整数字面量不应具有此类型"_nv);
 						}
@@ -296,19 +299,33 @@ namespace NatsuLang
 			void PrintExpr(NatsuLib::natRefPointer<Expression::Expr> const& expr);
 			Expression::ExprPtr GetLastVisitedExpr() const noexcept;
 
+			///	@brief	对表达式求值并以其值调用 visitor
+			///	@remark	若求值过程中抛出了异常则不会调用 visitor 且返回 true，调用者需检查解释器的异常状态
 			template <typename ValueVisitor, typename ExpectedOrExcepted = Detail::ExpectedTag<>>
 			[[nodiscard]] nBool Evaluate(NatsuLib::natRefPointer<Expression::Expr> const& expr, ValueVisitor&& visitor, ExpectedOrExcepted = {})
 			{
+				if (m_Interpreter.m_ExceptionThrown)
+				{
+					return true;
+				}
+
 				if (!expr)
 				{
 					return false;
 				}
 
 				Visit(expr);
+				if (m_Interpreter.m_ExceptionThrown)
+				{
+					return true;
+				}
+
 				InterpreterExprEvaluator<ValueVisitor, ExpectedOrExcepted> evaluator{ m_Interpreter, std::forward<ValueVisitor>(visitor) };
 				return evaluator.Visit(m_LastVisitedExpr);
 			}
 
+			void Visit(NatsuLib::natRefPointer<Statement::Stmt> const& stmt);
+
 			void VisitStmt(NatsuLib::natRefPointer<Statement::Stmt> const& stmt);
 			void VisitExpr(NatsuLib::natRefPointer<Expression::Expr> const& expr);
 
@@ -345,6 +362,70 @@ namespace NatsuLang
 			nBool m_ShouldPrint;
 		};
 
+		// switch 语句的分派表，在语句首次执行时构建并缓存
+		// case 值较为紧凑时使用直接索引的数组，否则使用哈希表，分派的开销与 case 的数量无关
+		class SwitchDispatchTable
+		{
+		public:
+			static constexpr std::size_t NoMatch = static_cast<std::size_t>(-1);
+
+			SwitchDispatchTable(NatsuLib::natRefPointer<Statement::SwitchStmt> const& stmt, ASTContext& context);
+			~SwitchDispatchTable();
+
+			///	@brief	获得语句体的直接子语句，分派的结果为其中的索引
+			std::vector<Statement::StmtPtr> const& GetBodyStmts() const noexcept;
+
+			///	@brief	查找条件值对应的语句
+			///	@param	value	条件的值，超出条件类型宽度的位将被忽略
+			///	@return	开始执行的子语句的索引，若未匹配任何 case 且不存在 default 则返回 NoMatch
+			std::size_t Lookup(nuWideInteger value) const noexcept;
+
+		private:
+			// 数组中的空位最多为 case 数量的此倍数，超过时将使用哈希表
+			static constexpr std::size_t MaxDenseRatio = 3;
+
+			struct KeyHash
+			{
+				std::size_t operator()(nuWideInteger value) const noexcept;
+			};
+
+			std::vector<Statement::StmtPtr> m_BodyStmts;
+			nBool m_IsSigned;
+			// 条件类型的位数，case 的值与条件的值均截断到此宽度后比较
+			std::size_t m_Width;
+			nuWideInteger m_MinKey;
+			std::vector<std::size_t> m_DenseTable;
+			std::unordered_map<nuWideInteger, std::size_t, KeyHash> m_SparseTable;
+			std::size_t m_DefaultIndex;
+
+			// 截断到条件的宽度，并将有符号的值映射到保持顺序的无符号值以便计算范围
+			nuWideInteger getKey(nuWideInteger value) const noexcept;
+		};
+
+		// try 语句的 catch 分派表，在首次有异常到达语句时构建并缓存
+		// 异常对象的类型在抛出时已映射为类型 ID，匹配时以类型 ID 直接索引，不需要逐个比较类型
+		class CatchDispatchTable
+		{
+		public:
+			static constexpr std::size_t NoMatch = static_cast<std::size_t>(-1);
+
+			CatchDispatchTable(NatsuLib::natRefPointer<Statement::TryStmt> const& stmt, Interpreter& interpreter);
+			~CatchDispatchTable();
+
+			std::vector<NatsuLib::natRefPointer<Statement::CatchStmt>> const& GetHandlers() const noexcept;
+
+			///	@brief	查找可处理指定类型的异常的处理器
+			///	@param	typeId	异常对象的类型 ID
+			///	@return	处理器的索引，若不存在可处理此异常的处理器则返回 NoMatch
+			std::size_t Lookup(std::size_t typeId) const noexcept;
+
+		private:
+			std::vector<NatsuLib::natRefPointer<Statement::CatchStmt>> m_Handlers;
+			// 以类型 ID 为索引，类型 ID 是连续分配的，因此数组的大小不会超过出现过的异常类型的数量
+			std::vector<std::size_t> m_TypeIdTable;
+			std::size_t m_CatchAllIndex;
+		};
+
 		class InterpreterStmtVisitor
 			: public StmtVisitor<InterpreterStmtVisitor>
 		{
@@ -381,6 +462,7 @@ namespace NatsuLang
 		private:
 			Interpreter& m_Interpreter;
 			nBool m_Returned;
+			nBool m_Broken;
 			Expression::ExprPtr m_ReturnedExpr;
 
 			void initVar(NatsuLib::natRefPointer<Declaration::VarDecl> const& var, Expression::ExprPtr const& initializer);
@@ -390,6 +472,64 @@ namespace NatsuLang
 		class InterpreterDeclStorage
 		{
 		public:
+			///	@brief	指针在存储中的表示
+			///	@remark	指针是 64 位的句柄，由存储区域的槽位、存储区域的代数及区域内的偏移组成，槽位 0 保留用于空指针
+			///			存储区域被释放时代数递增，解引用时通过比较代数检查指针是否已失效
+			class PointerHandle
+			{
+			public:
+				static constexpr std::size_t OffsetBits = 24;
+				static constexpr std::size_t GenerationBits = 16;
+				static constexpr std::size_t SlotBits = 24;
+
+				static constexpr nuLong OffsetMask = (nuLong{ 1 } << OffsetBits) - 1;
+				static constexpr nuLong GenerationMask = (nuLong{ 1 } << GenerationBits) - 1;
+				static constexpr nuLong SlotMask = (nuLong{ 1 } << SlotBits) - 1;
+
+				constexpr PointerHandle() noexcept
+					: m_Value{}
+				{
+				}
+
+				constexpr explicit PointerHandle(nuLong value) noexcept
+					: m_Value{ value }
+				{
+				}
+
+				constexpr PointerHandle(nuInt slot, nuInt generation, std::size_t offset) noexcept
+					: m_Value{ ((slot & SlotMask) << (GenerationBits + OffsetBits)) | ((generation & GenerationMask) << OffsetBits) | (offset & OffsetMask) }
+				{
+				}
+
+				[[nodiscard]] constexpr nBool IsNull() const noexcept
+				{
+					return !GetSlot();
+				}
+
+				[[nodiscard]] constexpr nuInt GetSlot() const noexcept
+				{
+					return static_cast<nuInt>(m_Value >> (GenerationBits + OffsetBits));
+				}
+
+				[[nodiscard]] constexpr nuInt GetGeneration() const noexcept
+				{
+					return static_cast<nuInt>((m_Value >> OffsetBits) & GenerationMask);
+				}
+
+				[[nodiscard]] constexpr std::size_t GetOffset() const noexcept
+				{
+					return static_cast<std::size_t>(m_Value & OffsetMask);
+				}
+
+				[[nodiscard]] constexpr nuLong GetValue() const noexcept
+				{
+					return m_Value;
+				}
+
+			private:
+				nuLong m_Value;
+			};
+
 			class MemoryLocationDecl
 				: public Declaration::VarDecl
 			{
@@ -434,9 +574,14 @@ namespace NatsuLang
 				}
 
 				Type::TypePtr GetElementType() const noexcept;
+				std::size_t GetElementSize() const noexcept;
 				NatsuLib::natRefPointer<MemoryLocationDecl> GetElementDecl(std::size_t i) const;
 
 				nData GetStorage() const noexcept;
+				nData GetElementStorage(std::size_t i) const noexcept;
+
+				// 解释器中的对象均可按字节复制，因此整体复制数组的存储
+				void CopyFrom(ArrayElementAccessor const& other) const noexcept;
 
 			private:
 				InterpreterDeclStorage& m_DeclStorage;
@@ -455,13 +600,13 @@ namespace NatsuLang
 				template <typename Callable, typename ExpectedOrExcepted = Detail::ExpectedTag<>>
 				[[nodiscard]] nBool VisitMember(NatsuLib::natRefPointer<Declaration::FieldDecl> const& fieldDecl, Callable&& visitor, ExpectedOrExcepted condition = {}) const
 				{
-					const auto iter = m_FieldOffsets.find(fieldDecl);
-					if (iter == m_FieldOffsets.end())
+					const auto fieldInfo = m_Layout.GetFieldInfo(fieldDecl);
+					if (!fieldInfo)
 					{
 						return false;
 					}
 
-					const auto offset = iter->second;
+					const auto offset = fieldInfo->second;
 					return m_DeclStorage.visitStorage(fieldDecl->GetValueType(), m_Storage + offset, std::forward<Callable>(visitor), condition);
 				}
 
@@ -470,10 +615,12 @@ namespace NatsuLang
 
 				NatsuLib::natRefPointer<MemoryLocationDecl> GetMemberDecl(NatsuLib::natRefPointer<Declaration::FieldDecl> const& fieldDecl) const;
 
+				nData GetStorage() const noexcept;
+
 			private:
 				InterpreterDeclStorage& m_DeclStorage;
 				NatsuLib::natRefPointer<Declaration::ClassDecl> m_ClassDecl;
-				std::unordered_map<NatsuLib::natRefPointer<Declaration::FieldDecl>, std::size_t> m_FieldOffsets;
+				ASTContext::ClassLayout const& m_Layout;
 				nData m_Storage;
 			};
 
@@ -481,21 +628,54 @@ namespace NatsuLang
 				: NatsuLib::nonmovable
 			{
 			public:
-				explicit PointerAccessor(nData storage);
+				PointerAccessor(InterpreterDeclStorage& declStorage, NatsuLib::natRefPointer<Type::PointerType> const& pointerType, nData storage);
+
+				PointerHandle GetHandle() const noexcept;
+				void SetHandle(PointerHandle handle) noexcept;
 
-				NatsuLib::natRefPointer<Declaration::VarDecl> GetReferencedDecl() const noexcept;
-				void SetReferencedDecl(NatsuLib::natRefPointer<Declaration::VarDecl> const& value) noexcept;
+				nBool IsNull() const noexcept;
+				Type::TypePtr GetPointeeType() const noexcept;
+
+				// 指针为空时返回 nullptr，指针已失效时抛出异常
+				NatsuLib::natRefPointer<MemoryLocationDecl> GetReferencedDecl() const;
+				void SetReferencedDecl(NatsuLib::natRefPointer<Declaration::ValueDecl> const& decl);
+				void SetReferencedStorage(nData storage);
 
 			private:
+				InterpreterDeclStorage& m_DeclStorage;
+				Type::TypePtr m_PointeeType;
 				nData m_Storage;
 			};
 
+			///	@brief	可被指针引用的存储区域
+			struct StorageRegion
+			{
+				nData Base;
+				std::size_t Size;
+				nuInt Generation;
+				nBool InUse;
+			};
+
 		private:
+			// 紧凑布局的类的字段可能未对齐，此时通过对齐的临时对象访问并写回
+			template <typename T, typename Callable, typename ExpectedOrExcepted>
+			static nBool visitBuiltinStorage(nData storage, Callable&& visitor, ExpectedOrExcepted condition)
+			{
+				if (reinterpret_cast<std::uintptr_t>(storage) % alignof(T))
+				{
+					T value;
+					std::memcpy(&value, storage, sizeof(T));
+					const auto result = Detail::InvokeIfSatisfied(std::forward<Callable>(visitor), value, condition);
+					std::memcpy(storage, &value, sizeof(T));
+					return result;
+				}
+
+				return Detail::InvokeIfSatisfied(std::forward<Callable>(visitor), reinterpret_cast<T&>(*storage), condition);
+			}
+
 			template <typename Callable, typename ExpectedOrExcepted>
 			nBool visitStorage(Type::TypePtr const& type, nData storage, Callable&& visitor, ExpectedOrExcepted condition)
 			{
-				auto& storageRef = *storage;
-
 				switch (type->GetType())
 				{
 				case Type::Type::Builtin:
@@ -508,16 +688,13 @@ namespace NatsuLang
 #define BUILTIN_TYPE(Id, Name)
 #define SIGNED_TYPE(Id, Name) \
 					case Type::BuiltinType::Id:\
-						return Detail::InvokeIfSatisfied(std::forward<Callable>(visitor),\
-							reinterpret_cast<typename Detail::BuiltinTypeMap<Type::BuiltinType::Id>::type&>(storageRef), condition);
+						return visitBuiltinStorage<typename Detail::BuiltinTypeMap<Type::BuiltinType::Id>::type>(storage, std::forward<Callable>(visitor), condition);
 #define UNSIGNED_TYPE(Id, Name) \
 					case Type::BuiltinType::Id:\
-						return Detail::InvokeIfSatisfied(std::forward<Callable>(visitor),\
-							reinterpret_cast<typename Detail::BuiltinTypeMap<Type::BuiltinType::Id>::type&>(storageRef), condition);
+						return visitBuiltinStorage<typename Detail::BuiltinTypeMap<Type::BuiltinType::Id>::type>(storage, std::forward<Callable>(visitor), condition);
 #define FLOATING_TYPE(Id, Name) \
 					case Type::BuiltinType::Id:\
-						return Detail::InvokeIfSatisfied(std::forward<Callable>(visitor),\
-							reinterpret_cast<typename Detail::BuiltinTypeMap<Type::BuiltinType::Id>::type&>(storageRef), condition);
+						return visitBuiltinStorage<typename Detail::BuiltinTypeMap<Type::BuiltinType::Id>::type>(storage, std::forward<Callable>(visitor), condition);
 #define PLACEHOLDER_TYPE(Id, Name)
 #include <Basic/BuiltinTypesDef.h>
 					default:
@@ -526,7 +703,7 @@ namespace NatsuLang
 				}
 				case Type::Type::Pointer:
 				{
-					PointerAccessor accessor{ storage };
+					PointerAccessor accessor{ *this, type, storage };
 					return Detail::InvokeIfSatisfied(std::forward<Callable>(visitor), accessor, condition);
 				}
 				case Type::Type::Array:
@@ -556,10 +733,25 @@ namespace NatsuLang
 				}
 			}
 
+			// 存储由运行时的分配器分配，释放时需要提供大小，并同时注销对应的存储区域
+			// 存储区域在存储首次被取地址时才注册，此前槽位为 0
 			struct StorageDeleter
 			{
-				constexpr StorageDeleter() noexcept = default;
+				constexpr StorageDeleter() noexcept
+					: DeclStorage{}, RegionSlot{}, Size{}
+				{
+				}
+
+				constexpr StorageDeleter(InterpreterDeclStorage* declStorage, nuInt regionSlot, std::size_t size) noexcept
+					: DeclStorage{ declStorage }, RegionSlot{ regionSlot }, Size{ size }
+				{
+				}
+
 				void operator()(nData data) const noexcept;
+
+				InterpreterDeclStorage* DeclStorage;
+				nuInt RegionSlot;
+				std::size_t Size;
 			};
 
 		public:
@@ -582,6 +774,14 @@ namespace NatsuLang
 
 			static NatsuLib::natRefPointer<Declaration::ValueDecl> CreateTemporaryObjectDecl(Type::TypePtr type, SourceLocation loc = {});
 
+			nuInt RegisterRegion(nData base, std::size_t size);
+			void UnregisterRegion(nuInt slot) noexcept;
+
+			// 存储所属的对象首次被引用时为其注册存储区域，存储不属于任何对象时抛出异常
+			PointerHandle MakePointerHandle(nData storage);
+			// 指针为空时返回 nullptr，指针已失效或访问越界时抛出异常
+			nData ResolvePointerHandle(PointerHandle handle, std::size_t accessSize) const;
+
 			template <typename Callable, typename ExpectedOrExcepted = Detail::ExpectedTag<>>
 			[[nodiscard]] nBool VisitDeclStorage(NatsuLib::natRefPointer<Declaration::ValueDecl> decl, Callable&& visitor, ExpectedOrExcepted condition = {})
 			{
@@ -607,8 +807,105 @@ namespace NatsuLang
 			}
 
 		private:
+			// 代数用尽的槽位累积到此数量后，最早弃用的槽位将从代数 0 开始重新使用
+			static constexpr std::size_t MaxRetiredRegionSlots = 1024;
+
 			Interpreter& m_Interpreter;
+
+			// 槽位 0 保留用于空指针，释放的槽位将被重用
+			std::vector<StorageRegion> m_StorageRegions;
+			std::vector<nuInt> m_FreeRegionSlots;
+			// 代数用尽的槽位，按弃用的顺序排列，仍指向其的指针需要在此槽位再经过完整的一轮代数后才可能误判为有效
+			std::deque<nuInt> m_RetiredRegionSlots;
+			// 仅包含已注册的存储区域，在取地址时用于由存储查找所属的存储区域，解引用不经过此表
+			std::map<std::uintptr_t, nuInt> m_RegionSlotsByBase;
+
+			// 析构时会注销存储区域，必须在存储区域的表之后声明
 			std::vector<std::pair<DeclStorageLevelFlag, std::unique_ptr<std::unordered_map<NatsuLib::natRefPointer<Declaration::ValueDecl>, std::unique_ptr<nByte[], StorageDeleter>>>>> m_DeclStorage;
+
+			// 在尚未注册存储区域的存储中查找包含此地址的存储并为其注册，未找到时返回 0
+			nuInt registerOwningRegion(std::uintptr_t address);
+		};
+
+		///	@brief	解释器的性能分析器，默认不启用
+		///	@remark	计时使用挂钟时间，递归调用的函数的包含时间仅在最外层调用结束时计入
+		class InterpreterProfiler
+		{
+		public:
+			struct FunctionRecord
+			{
+				std::size_t CallCount;
+				std::chrono::nanoseconds InclusiveTime;
+				std::chrono::nanoseconds ExclusiveTime;
+				std::size_t AllocationCount;
+				std::size_t AllocatedSize;
+				// 尚未返回的调用数
+				std::size_t ActiveCount;
+			};
+
+			struct StatementRecord
+			{
+				std::size_t ExecutionCount;
+				// 包含其子语句的时间
+				std::chrono::nanoseconds Time;
+			};
+
+			struct SourceLocationHash
+			{
+				std::size_t operator()(SourceLocation const& loc) const noexcept;
+			};
+
+			struct SourceLocationEqualTo
+			{
+				nBool operator()(SourceLocation const& a, SourceLocation const& b) const noexcept;
+			};
+
+			using FunctionRecordMap = std::unordered_map<NatsuLib::natRefPointer<Declaration::FunctionDecl>, FunctionRecord>;
+			using StatementRecordMap = std::unordered_map<SourceLocation, StatementRecord, SourceLocationHash, SourceLocationEqualTo>;
+
+			InterpreterProfiler();
+			~InterpreterProfiler();
+
+			void SetEnabled(nBool value) noexcept;
+			nBool IsEnabled() const noexcept;
+
+			void Reset();
+
+			void EnterFunction(NatsuLib::natRefPointer<Declaration::FunctionDecl> const& func);
+			void LeaveFunction();
+			void RecordAllocation(std::size_t size);
+			void RecordStatement(SourceLocation loc, std::chrono::nanoseconds time);
+
+			///	@brief	获得各函数的记录
+			///	@remark	键为 nullptr 的记录表示不属于任何函数的代码
+			FunctionRecordMap const& GetFunctionRecords() const noexcept;
+			StatementRecordMap const& GetStatementRecords() const noexcept;
+
+			///	@brief	以 flamegraph.pl 接受的折叠栈格式写出各调用栈的独占时间，单位为微秒
+			void WriteCollapsedStacks(NatsuLib::natRefPointer<NatsuLib::natStream> const& stream) const;
+
+		private:
+			// 调用上下文树的节点，根节点的索引为 0 且不对应任何函数
+			struct CallNode
+			{
+				NatsuLib::natRefPointer<Declaration::FunctionDecl> Function;
+				std::size_t Parent;
+				std::unordered_map<NatsuLib::natRefPointer<Declaration::FunctionDecl>, std::size_t> Children;
+				std::chrono::nanoseconds ExclusiveTime;
+			};
+
+			struct CallFrame
+			{
+				std::size_t Node;
+				std::chrono::steady_clock::time_point Start;
+				std::chrono::nanoseconds ChildrenTime;
+			};
+
+			nBool m_Enabled;
+			std::vector<CallNode> m_CallTree;
+			std::vector<CallFrame> m_CallStack;
+			FunctionRecordMap m_FunctionRecords;
+			StatementRecordMap m_StatementRecords;
 		};
 
 		Interpreter(NatsuLib::natRefPointer<NatsuLib::TextReader<NatsuLib::StringType::Utf8>> const& diagIdMapFile, NatsuLib::natLog& logger);
@@ -624,8 +921,19 @@ namespace NatsuLang
 		void RegisterFunction(nStrView name, Type::TypePtr resultType, std::initializer_list<Type::TypePtr> argTypes, Function const& func);
 
 		ASTContext& GetASTContext() noexcept;
+		SourceManager& GetSourceManager() noexcept;
+		InterpreterProfiler& GetProfiler() noexcept;
 
 	private:
+		// 异常对象，类型 ID 由 getExceptionTypeId 分配
+		struct ExceptionObject
+		{
+			std::size_t TypeId;
+			Type::TypePtr ObjectType;
+			// 重新抛出时将与正在处理的异常共享存储
+			std::shared_ptr<nByte[]> Storage;
+		};
+
 		NatsuLib::natRefPointer<InterpreterDiagConsumer> m_DiagConsumer;
 		Diag::DiagnosticsEngine m_Diag;
 		NatsuLib::natLog& m_Logger;
@@ -639,7 +947,21 @@ namespace NatsuLang
 		InterpreterStmtVisitor m_Visitor;
 
 		InterpreterDeclStorage m_DeclStorage;
+		InterpreterProfiler m_Profiler;
 
 		std::unordered_map<NatsuLib::natRefPointer<Declaration::FunctionDecl>, Function> m_FunctionMap;
+		std::unordered_map<NatsuLib::natRefPointer<Statement::SwitchStmt>, SwitchDispatchTable> m_SwitchDispatchTables;
+
+		// throw 不使用 C++ 异常实现，仅记录异常对象并设置此状态，各访问者在返回路径上检查此状态并停止执行，直到异常被 catch 处理
+		nBool m_ExceptionThrown;
+		ExceptionObject m_ThrownException;
+		// 正在被处理器处理的异常，用于支持 throw; 重新抛出
+		std::vector<ExceptionObject> m_HandlingExceptions;
+		std::unordered_map<Type::TypePtr, std::size_t, Type::TypeHash, Type::TypeEqualTo> m_ExceptionTypeIds;
+		std::unordered_map<NatsuLib::natRefPointer<Statement::TryStmt>, CatchDispatchTable> m_CatchDispatchTables;
+
+		std::size_t getExceptionTypeId(Type::TypePtr const& type);
+		// 若存在未被捕获的异常则清除异常状态并报告错误
+		void checkUncaughtException();
 	};
 }
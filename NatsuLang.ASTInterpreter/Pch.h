@@ -8,7 +8,17 @@
 #include <Sema/Sema.h>
 #include <Sema/Scope.h>
 
+#include <Allocator.h>
+
 #include <natStream.h>
 #include <natText.h>
 #include <natLog.h>
 #include <natConsole.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
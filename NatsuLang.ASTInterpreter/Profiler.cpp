@@ -0,0 +1,152 @@
+﻿#include "Interpreter.h"
+
+using namespace NatsuLib;
+using namespace NatsuLang;
+
+std::size_t Interpreter::InterpreterProfiler::SourceLocationHash::operator()(SourceLocation const& loc) const noexcept
+{
+	return std::hash<nStrView::const_iterator>{}(loc.GetPos()) ^ std::hash<nuInt>{}(loc.GetFileID());
+}
+
+nBool Interpreter::InterpreterProfiler::SourceLocationEqualTo::operator()(SourceLocation const& a, SourceLocation const& b) const noexcept
+{
+	return a.GetFileID() == b.GetFileID() && a.GetPos() == b.GetPos();
+}
+
+Interpreter::InterpreterProfiler::InterpreterProfiler()
+	: m_Enabled{ false }
+{
+	Reset();
+}
+
+Interpreter::InterpreterProfiler::~InterpreterProfiler()
+{
+}
+
+void Interpreter::InterpreterProfiler::SetEnabled(nBool value) noexcept
+{
+	m_Enabled = value;
+}
+
+nBool Interpreter::InterpreterProfiler::IsEnabled() const noexcept
+{
+	return m_Enabled;
+}
+
+void Interpreter::InterpreterProfiler::Reset()
+{
+	m_CallTree.clear();
+	m_CallTree.push_back(CallNode{ nullptr, 0, {}, {} });
+	m_CallStack.clear();
+	m_FunctionRecords.clear();
+	m_StatementRecords.clear();
+}
+
+void Interpreter::InterpreterProfiler::EnterFunction(natRefPointer<Declaration::FunctionDecl> const& func)
+{
+	const auto parent = m_CallStack.empty() ? 0 : m_CallStack.back().Node;
+	auto node = m_CallTree.size();
+	if (const auto [iter, inserted] = m_CallTree[parent].Children.emplace(func, node); !inserted)
+	{
+		node = iter->second;
+	}
+	else
+	{
+		m_CallTree.push_back(CallNode{ func, parent, {}, {} });
+	}
+
+	auto& record = m_FunctionRecords[func];
+	++record.CallCount;
+	++record.ActiveCount;
+
+	m_CallStack.push_back(CallFrame{ node, std::chrono::steady_clock::now(), {} });
+}
+
+void Interpreter::InterpreterProfiler::LeaveFunction()
+{
+	if (m_CallStack.empty())
+	{
+		return;
+	}
+
+	const auto frame = m_CallStack.back();
+	m_CallStack.pop_back();
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - frame.Start);
+	const auto exclusive = elapsed - frame.ChildrenTime;
+
+	auto& node = m_CallTree[frame.Node];
+	node.ExclusiveTime += exclusive;
+
+	auto& record = m_FunctionRecords[node.Function];
+	record.ExclusiveTime += exclusive;
+	if (!--record.ActiveCount)
+	{
+		record.InclusiveTime += elapsed;
+	}
+
+	if (!m_CallStack.empty())
+	{
+		m_CallStack.back().ChildrenTime += elapsed;
+	}
+}
+
+void Interpreter::InterpreterProfiler::RecordAllocation(std::size_t size)
+{
+	auto& record = m_FunctionRecords[m_CallStack.empty() ? nullptr : m_CallTree[m_CallStack.back().Node].Function];
+	++record.AllocationCount;
+	record.AllocatedSize += size;
+}
+
+void Interpreter::InterpreterProfiler::RecordStatement(SourceLocation loc, std::chrono::nanoseconds time)
+{
+	auto& record = m_StatementRecords[loc];
+	++record.ExecutionCount;
+	record.Time += time;
+}
+
+Interpreter::InterpreterProfiler::FunctionRecordMap const& Interpreter::InterpreterProfiler::GetFunctionRecords() const noexcept
+{
+	return m_FunctionRecords;
+}
+
+Interpreter::InterpreterProfiler::StatementRecordMap const& Interpreter::InterpreterProfiler::GetStatementRecords() const noexcept
+{
+	return m_StatementRecords;
+}
+
+void Interpreter::InterpreterProfiler::WriteCollapsedStacks(natRefPointer<natStream> const& stream) const
+{
+	std::vector<nStrView> names;
+	for (std::size_t i = 1; i < m_CallTree.size(); ++i)
+	{
+		const auto time = std::chrono::duration_cast<std::chrono::microseconds>(m_CallTree[i].ExclusiveTime).count();
+		if (time <= 0)
+		{
+			continue;
+		}
+
+		names.clear();
+		for (auto node = i; node; node = m_CallTree[node].Parent)
+		{
+			names.emplace_back(m_CallTree[node].Function->GetName());
+		}
+
+		nString line;
+		for (auto iter = names.crbegin(); iter != names.crend(); ++iter)
+		{
+			if (iter != names.crbegin())
+			{
+				line.Append(u8";"_nv);
+			}
+			line.Append(*iter);
+		}
+		line.Append(natUtil::FormatString(u8" {0}\n"_nv, time));
+
+		const auto size = line.GetSize();
+		if (stream->WriteBytes(reinterpret_cast<ncData>(line.data()), size) != size)
+		{
+			nat_Throw(InterpreterException, u8"无法写入性能分析结果"_nv);
+		}
+	}
+}
@@ -5,7 +5,7 @@ using namespace NatsuLang;
 using namespace NatsuLang::Detail;
 
 Interpreter::InterpreterStmtVisitor::InterpreterStmtVisitor(Interpreter& interpreter)
-	: m_Interpreter{ interpreter }, m_Returned{ false }
+	: m_Interpreter{ interpreter }, m_Returned{ false }, m_Broken{ false }
 {
 }
 
@@ -26,11 +26,23 @@ void Interpreter::InterpreterStmtVisitor::ResetReturnedExpr() noexcept
 
 void Interpreter::InterpreterStmtVisitor::Visit(natRefPointer<Statement::Stmt> const& stmt)
 {
-	if (m_Returned || m_ReturnedExpr)
+	if (m_Returned || m_ReturnedExpr || m_Broken || m_Interpreter.m_ExceptionThrown)
 	{
 		return;
 	}
 
+	if (m_Interpreter.m_Profiler.IsEnabled())
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const auto profilerScope = make_scope([this, &stmt, start]
+		{
+			m_Interpreter.m_Profiler.RecordStatement(stmt->GetStartLoc(), std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start));
+		});
+
+		StmtVisitor::Visit(stmt);
+		return;
+	}
+
 	StmtVisitor::Visit(stmt);
 }
 
@@ -45,26 +57,62 @@ void Interpreter::InterpreterStmtVisitor::VisitExpr(natRefPointer<Expression::Ex
 	visitor.PrintExpr(expr);
 }
 
-void Interpreter::InterpreterStmtVisitor::VisitBreakStmt(natRefPointer<Statement::BreakStmt> const& stmt)
+void Interpreter::InterpreterStmtVisitor::VisitBreakStmt(natRefPointer<Statement::BreakStmt> const& /*stmt*/)
 {
-	nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
+	// 由最近的循环或 switch 语句负责重置
+	m_Broken = true;
 }
 
+// 仅由 VisitTryStmt 在匹配到处理器后访问，此时正在处理的异常位于 m_HandlingExceptions 的顶部
 void Interpreter::InterpreterStmtVisitor::VisitCatchStmt(natRefPointer<Statement::CatchStmt> const& stmt)
 {
-	nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
+	if (m_Interpreter.m_HandlingExceptions.empty())
+	{
+		nat_Throw(InterpreterException, u8"catch 语句只能作为 try 语句的一部分执行"_nv);
+	}
+
+	if (const auto exDecl = stmt->GetExceptionDecl())
+	{
+		// 类型 ID 相同保证了类型一致
+		const auto& exception = m_Interpreter.m_HandlingExceptions.back();
+		const auto storage = m_Interpreter.m_DeclStorage.GetOrAddDecl(exDecl, exception.ObjectType).second;
+		std::memcpy(storage, exception.Storage.get(), m_Interpreter.m_AstContext.GetTypeInfo(exception.ObjectType).Size);
+	}
+
+	Visit(stmt->GetHandlerBlcok());
 }
 
 void Interpreter::InterpreterStmtVisitor::VisitTryStmt(natRefPointer<Statement::TryStmt> const& stmt)
 {
-	nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
+	Visit(stmt->GetTryBlock());
+	if (!m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
+	const auto& table = m_Interpreter.m_CatchDispatchTables.try_emplace(stmt, stmt, m_Interpreter).first->second;
+	const auto index = table.Lookup(m_Interpreter.m_ThrownException.TypeId);
+	if (index == CatchDispatchTable::NoMatch)
+	{
+		// 继续向外传播
+		return;
+	}
+
+	m_Interpreter.m_ExceptionThrown = false;
+	m_Interpreter.m_HandlingExceptions.emplace_back(std::move(m_Interpreter.m_ThrownException));
+	const auto scope = make_scope([this]
+	{
+		m_Interpreter.m_HandlingExceptions.pop_back();
+	});
+
+	Visit(table.GetHandlers()[index]);
 }
 
 void Interpreter::InterpreterStmtVisitor::VisitCompoundStmt(natRefPointer<Statement::CompoundStmt> const& stmt)
 {
 	for (auto&& item : stmt->GetChildrenStmt())
 	{
-		if (m_Returned)
+		if (m_Returned || m_Broken || m_Interpreter.m_ExceptionThrown)
 		{
 			return;
 		}
@@ -100,8 +148,14 @@ void Interpreter::InterpreterStmtVisitor::VisitDoStmt(natRefPointer<Statement::D
 	while (true)
 	{
 		Visit(stmt->GetBody());
-		if (m_Returned)
+		if (m_Returned || m_Interpreter.m_ExceptionThrown)
+		{
+			return;
+		}
+
+		if (m_Broken)
 		{
+			m_Broken = false;
 			return;
 		}
 
@@ -113,7 +167,7 @@ void Interpreter::InterpreterStmtVisitor::VisitDoStmt(natRefPointer<Statement::D
 			nat_Throw(InterpreterException, u8"条件表达式不能被计算为有效的 bool 值"_nv);
 		}
 
-		if (!shouldContinue)
+		if (m_Interpreter.m_ExceptionThrown || !shouldContinue)
 		{
 			return;
 		}
@@ -144,7 +198,7 @@ void Interpreter::InterpreterStmtVisitor::VisitForStmt(natRefPointer<Statement::
 			nat_Throw(InterpreterException, u8"条件表达式不能被计算为有效的 bool 值"_nv);
 		}
 
-		if (!shouldContinue)
+		if (m_Interpreter.m_ExceptionThrown || !shouldContinue)
 		{
 			return;
 		}
@@ -154,11 +208,17 @@ void Interpreter::InterpreterStmtVisitor::VisitForStmt(natRefPointer<Statement::
 			Visit(body);
 		}
 
-		if (m_Returned)
+		if (m_Returned || m_Interpreter.m_ExceptionThrown)
 		{
 			return;
 		}
 
+		if (m_Broken)
+		{
+			m_Broken = false;
+			return;
+		}
+
 		if (inc)
 		{
 			visitor.Visit(inc);
@@ -183,6 +243,11 @@ void Interpreter::InterpreterStmtVisitor::VisitIfStmt(natRefPointer<Statement::I
 		nat_Throw(InterpreterException, u8"条件表达式不能被计算为有效的 bool 值"_nv);
 	}
 
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
 	if (condition)
 	{
 		Visit(stmt->GetThen());
@@ -208,6 +273,11 @@ void Interpreter::InterpreterStmtVisitor::VisitReturnStmt(natRefPointer<Statemen
 	{
 		InterpreterExprVisitor visitor{ m_Interpreter };
 		visitor.Visit(retExpr);
+		if (m_Interpreter.m_ExceptionThrown)
+		{
+			return;
+		}
+
 		retExpr = visitor.GetLastVisitedExpr();
 		auto tempObjDecl = InterpreterDeclStorage::CreateTemporaryObjectDecl(retExpr->GetExprType());
 		// 禁止当前层创建存储，以保证返回值创建在上层
@@ -233,19 +303,48 @@ void Interpreter::InterpreterStmtVisitor::VisitReturnStmt(natRefPointer<Statemen
 	m_Returned = true;
 }
 
+// 标签本身没有作用，执行到此处时直接落入其子语句
 void Interpreter::InterpreterStmtVisitor::VisitCaseStmt(natRefPointer<Statement::CaseStmt> const& stmt)
 {
-	nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
+	Visit(stmt->GetSubStmt());
 }
 
 void Interpreter::InterpreterStmtVisitor::VisitDefaultStmt(natRefPointer<Statement::DefaultStmt> const& stmt)
 {
-	nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
+	Visit(stmt->GetSubStmt());
 }
 
 void Interpreter::InterpreterStmtVisitor::VisitSwitchStmt(natRefPointer<Statement::SwitchStmt> const& stmt)
 {
-	nat_Throw(InterpreterException, u8"此功能尚未实现"_nv);
+	InterpreterExprVisitor visitor{ m_Interpreter };
+	nuWideInteger condValue;
+	if (!visitor.Evaluate(stmt->GetCond(), [&condValue](auto value)
+	{
+		condValue = static_cast<nuWideInteger>(value);
+	}, Expected<nBool, nByte, nSByte, nShort, nuShort, nInt, nuInt, nLong, nuLong, nInt128, nuInt128>))
+	{
+		nat_Throw(InterpreterException, u8"条件表达式不能被计算为有效的整数值"_nv);
+	}
+
+	if (m_Interpreter.m_ExceptionThrown)
+	{
+		return;
+	}
+
+	const auto& table = m_Interpreter.m_SwitchDispatchTables.try_emplace(stmt, stmt, m_Interpreter.m_AstContext).first->second;
+	const auto& bodyStmts = table.GetBodyStmts();
+
+	// 从匹配的语句开始依次执行后续语句以实现 fallthrough 语义
+	for (auto i = table.Lookup(condValue); i < bodyStmts.size(); ++i)
+	{
+		Visit(bodyStmts[i]);
+		if (m_Returned || m_Broken || m_Interpreter.m_ExceptionThrown)
+		{
+			break;
+		}
+	}
+
+	m_Broken = false;
 }
 
 void Interpreter::InterpreterStmtVisitor::VisitWhileStmt(natRefPointer<Statement::WhileStmt> const& stmt)
@@ -263,16 +362,22 @@ void Interpreter::InterpreterStmtVisitor::VisitWhileStmt(natRefPointer<Statement
 			nat_Throw(InterpreterException, u8"条件表达式不能被计算为有效的 bool 值"_nv);
 		}
 
-		if (!shouldContinue)
+		if (m_Interpreter.m_ExceptionThrown || !shouldContinue)
 		{
 			return;
 		}
 
 		Visit(stmt->GetBody());
-		if (m_Returned)
+		if (m_Returned || m_Interpreter.m_ExceptionThrown)
 		{
 			return;
 		}
+
+		if (m_Broken)
+		{
+			m_Broken = false;
+			return;
+		}
 	}
 }
 
@@ -298,6 +403,34 @@ void Interpreter::InterpreterStmtVisitor::initVar(natRefPointer<Declaration::Var
 
 				InterpreterExprVisitor evaluator{ m_Interpreter };
 
+				if (Type::Type::GetUnderlyingType(accessor.GetElementType())->GetType() == Type::Type::Builtin)
+				{
+					// 内建类型的元素直接写入元素的存储，不为每个元素创建声明
+					for (std::size_t i = 0; initExprIter != initExprEnd; ++i, static_cast<void>(++initExprIter))
+					{
+						if (!evaluator.Evaluate(*initExprIter, [&accessor, i](auto value)
+						{
+							if (!accessor.VisitElement(i, [value](auto& element)
+							{
+								element = value;
+							}, Expected<decltype(value)>))
+							{
+								nat_Throw(InterpreterException, u8"无法访问数组元素 {0}"_nv, i);
+							}
+						}, Excepted<nStrView, InterpreterDeclStorage::ArrayElementAccessor, InterpreterDeclStorage::MemberAccessor, InterpreterDeclStorage::PointerAccessor>))
+						{
+							nat_Throw(InterpreterException, u8"无法对初始化器求值"_nv);
+						}
+
+						if (m_Interpreter.m_ExceptionThrown)
+						{
+							return;
+						}
+					}
+
+					return;
+				}
+
 				for (std::size_t i = 0; initExprIter != initExprEnd; ++i, static_cast<void>(++initExprIter))
 				{
 					initVar(accessor.GetElementDecl(i), *initExprIter);
@@ -344,6 +477,32 @@ void Interpreter::InterpreterStmtVisitor::initVar(natRefPointer<Declaration::Var
 			nat_Throw(InterpreterException, u8"无法创建声明的存储"_nv);
 		}
 	}
+	else if (varType->GetType() == Type::Type::Pointer)
+	{
+		// 复制指针仅复制句柄
+		InterpreterDeclStorage::PointerHandle handle;
+		InterpreterExprVisitor evaluator{ m_Interpreter };
+		if (!evaluator.Evaluate(initializer, [&handle](InterpreterDeclStorage::PointerAccessor& accessor)
+		{
+			handle = accessor.GetHandle();
+		}, Expected<InterpreterDeclStorage::PointerAccessor>))
+		{
+			nat_Throw(InterpreterException, u8"无法对初始化器求值"_nv);
+		}
+
+		if (m_Interpreter.m_ExceptionThrown)
+		{
+			return;
+		}
+
+		if (!m_Interpreter.m_DeclStorage.VisitDeclStorage(var, [handle](InterpreterDeclStorage::PointerAccessor& accessor)
+		{
+			accessor.SetHandle(handle);
+		}, Expected<InterpreterDeclStorage::PointerAccessor>))
+		{
+			nat_Throw(InterpreterException, u8"无法创建声明的存储"_nv);
+		}
+	}
 	else
 	{
 		auto succeed = false;
@@ -373,3 +532,179 @@ void Interpreter::InterpreterStmtVisitor::initVar(natRefPointer<Declaration::Var
 	}
 }
 
+
+Interpreter::SwitchDispatchTable::SwitchDispatchTable(natRefPointer<Statement::SwitchStmt> const& stmt, ASTContext& context)
+	: m_IsSigned{ false }, m_Width{ sizeof(nuWideInteger) * 8 }, m_MinKey{}, m_DefaultIndex{ NoMatch }
+{
+	auto condType = Type::Type::GetUnderlyingType(stmt->GetCond()->GetExprType());
+	if (const auto enumType = condType.Cast<Type::EnumType>())
+	{
+		condType = Type::Type::GetUnderlyingType(enumType->GetDecl().UnsafeCast<Declaration::EnumDecl>()->GetUnderlyingType());
+	}
+
+	if (const auto builtinType = condType.Cast<Type::BuiltinType>())
+	{
+		m_IsSigned = builtinType->IsSigned();
+	}
+
+	m_Width = std::min(m_Width, context.GetTypeInfo(condType).Size * 8);
+
+	const auto body = stmt->GetBody();
+	if (const auto compoundStmt = body.Cast<Statement::CompoundStmt>())
+	{
+		const auto children = compoundStmt->GetChildrenStmt();
+		m_BodyStmts.assign(children.begin(), children.end());
+	}
+	else
+	{
+		m_BodyStmts.emplace_back(body);
+	}
+
+	// Sema 保证了 case 及 default 只出现在语句体的直接子语句上，连续的标签会嵌套在前一标签的子语句中
+	std::vector<std::pair<nuWideInteger, std::size_t>> cases;
+	for (std::size_t i = 0; i < m_BodyStmts.size(); ++i)
+	{
+		auto curStmt = m_BodyStmts[i];
+		while (const auto switchCase = curStmt.Cast<Statement::SwitchCase>())
+		{
+			if (const auto caseStmt = switchCase.Cast<Statement::CaseStmt>())
+			{
+				nuWideInteger value;
+				if (!caseStmt->GetExpr()->EvaluateAsWideInt(value, context))
+				{
+					nat_Throw(InterpreterException, u8"case 的值无法求值为常量"_nv);
+				}
+
+				cases.emplace_back(getKey(value), i);
+			}
+			else
+			{
+				m_DefaultIndex = i;
+			}
+
+			curStmt = switchCase->GetSubStmt();
+		}
+	}
+
+	if (cases.empty())
+	{
+		return;
+	}
+
+	const auto [minIter, maxIter] = std::minmax_element(cases.cbegin(), cases.cend(), [](auto const& a, auto const& b)
+	{
+		return a.first < b.first;
+	});
+
+	m_MinKey = minIter->first;
+	const auto range = maxIter->first - m_MinKey;
+
+	if (range / MaxDenseRatio < cases.size())
+	{
+		m_DenseTable.assign(static_cast<std::size_t>(range) + 1, m_DefaultIndex);
+		for (const auto& [key, index] : cases)
+		{
+			m_DenseTable[static_cast<std::size_t>(key - m_MinKey)] = index;
+		}
+	}
+	else
+	{
+		m_SparseTable.reserve(cases.size());
+		for (const auto& [key, index] : cases)
+		{
+			m_SparseTable.emplace(key, index);
+		}
+	}
+}
+
+Interpreter::SwitchDispatchTable::~SwitchDispatchTable()
+{
+}
+
+std::vector<Statement::StmtPtr> const& Interpreter::SwitchDispatchTable::GetBodyStmts() const noexcept
+{
+	return m_BodyStmts;
+}
+
+std::size_t Interpreter::SwitchDispatchTable::Lookup(nuWideInteger value) const noexcept
+{
+	const auto key = getKey(value);
+
+	if (!m_DenseTable.empty())
+	{
+		// 小于最小值时无符号减法回绕，同样会超出范围
+		const auto offset = key - m_MinKey;
+		return offset < m_DenseTable.size() ? m_DenseTable[static_cast<std::size_t>(offset)] : m_DefaultIndex;
+	}
+
+	const auto iter = m_SparseTable.find(key);
+	return iter != m_SparseTable.cend() ? iter->second : m_DefaultIndex;
+}
+
+std::size_t Interpreter::SwitchDispatchTable::KeyHash::operator()(nuWideInteger value) const noexcept
+{
+	// 不支持 128 位整数时高位总是 0
+	return std::hash<nuLong>{}(static_cast<nuLong>(value) ^ static_cast<nuLong>(value >> 32 >> 32));
+}
+
+nuWideInteger Interpreter::SwitchDispatchTable::getKey(nuWideInteger value) const noexcept
+{
+	if (m_Width < sizeof(nuWideInteger) * 8)
+	{
+		value &= (nuWideInteger{ 1 } << m_Width) - 1;
+	}
+
+	return m_IsSigned ? value ^ (nuWideInteger{ 1 } << (m_Width - 1)) : value;
+}
+
+Interpreter::CatchDispatchTable::CatchDispatchTable(natRefPointer<Statement::TryStmt> const& stmt, Interpreter& interpreter)
+	: m_CatchAllIndex{ NoMatch }
+{
+	for (auto&& handler : stmt->GetHandlers())
+	{
+		auto catchStmt = handler.UnsafeCast<Statement::CatchStmt>();
+		const auto index = m_Handlers.size();
+
+		if (const auto exDecl = catchStmt->GetExceptionDecl())
+		{
+			const auto typeId = interpreter.getExceptionTypeId(Type::Type::GetUnderlyingType(exDecl->GetValueType()));
+			if (typeId >= m_TypeIdTable.size())
+			{
+				m_TypeIdTable.resize(typeId + 1, NoMatch);
+			}
+
+			// Sema 保证了同一 try 语句的处理器的类型不重复
+			m_TypeIdTable[typeId] = index;
+		}
+		else
+		{
+			m_CatchAllIndex = index;
+		}
+
+		m_Handlers.emplace_back(std::move(catchStmt));
+	}
+}
+
+Interpreter::CatchDispatchTable::~CatchDispatchTable()
+{
+}
+
+std::vector<natRefPointer<Statement::CatchStmt>> const& Interpreter::CatchDispatchTable::GetHandlers() const noexcept
+{
+	return m_Handlers;
+}
+
+std::size_t Interpreter::CatchDispatchTable::Lookup(std::size_t typeId) const noexcept
+{
+	if (typeId < m_TypeIdTable.size())
+	{
+		const auto index = m_TypeIdTable[typeId];
+		if (index != NoMatch)
+		{
+			return index;
+		}
+	}
+
+	// Sema 保证了 catch (...) 是最后一个处理器，因此仅在无类型匹配时使用
+	return m_CatchAllIndex;
+}
@@ -0,0 +1,246 @@
+﻿#include "Allocator.h"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+namespace
+{
+	// 大小类的粒度，同时也是块的对齐
+	constexpr std::size_t Granularity = 16;
+	constexpr std::size_t SizeClassCount = NatsuLang_MaxPooledSize / Granularity;
+	constexpr std::size_t PageSize = 64 * 1024;
+
+	static_assert(NatsuLang_MaxPooledSize % Granularity == 0, "NatsuLang_MaxPooledSize should be a multiple of Granularity.");
+	static_assert(PageSize >= NatsuLang_MaxPooledSize, "A page should contain at least one block of each size class.");
+
+	struct FreeBlock
+	{
+		FreeBlock* Next;
+	};
+
+	constexpr std::size_t GetSizeClass(std::size_t size) noexcept
+	{
+		return (size - 1) / Granularity;
+	}
+
+	constexpr std::size_t GetBlockSize(std::size_t sizeClass) noexcept
+	{
+		return (sizeClass + 1) * Granularity;
+	}
+
+	// 统计仅使用 relaxed 的原子操作，不会对分配及释放引入同步
+	struct Statistics
+	{
+		std::atomic<std::size_t> AllocationCount;
+		std::atomic<std::size_t> DeallocationCount;
+		std::atomic<std::size_t> LiveBytes;
+		std::atomic<std::size_t> PeakLiveBytes;
+		std::atomic<std::size_t> PageCount;
+		std::atomic<std::size_t> LargeAllocationCount;
+	};
+
+	Statistics g_Statistics{};
+
+	void RecordAllocation(std::size_t size) noexcept
+	{
+		g_Statistics.AllocationCount.fetch_add(1, std::memory_order_relaxed);
+		const auto liveBytes = g_Statistics.LiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		auto peakLiveBytes = g_Statistics.PeakLiveBytes.load(std::memory_order_relaxed);
+		while (liveBytes > peakLiveBytes && !g_Statistics.PeakLiveBytes.compare_exchange_weak(peakLiveBytes, liveBytes, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void RecordDeallocation(std::size_t size) noexcept
+	{
+		g_Statistics.DeallocationCount.fetch_add(1, std::memory_order_relaxed);
+		g_Statistics.LiveBytes.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	// 线程退出时其空闲链表中的块将归还至此处，以供其他线程重用
+	class CentralFreeList
+	{
+	public:
+		void Push(std::size_t sizeClass, FreeBlock* head, FreeBlock* tail) noexcept
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			tail->Next = m_FreeLists[sizeClass];
+			m_FreeLists[sizeClass] = head;
+		}
+
+		FreeBlock* PopAll(std::size_t sizeClass) noexcept
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			const auto head = m_FreeLists[sizeClass];
+			m_FreeLists[sizeClass] = nullptr;
+			return head;
+		}
+
+	private:
+		std::mutex m_Mutex;
+		std::array<FreeBlock*, SizeClassCount> m_FreeLists{};
+	};
+
+	// 线程局部对象的析构可能晚于静态对象，因此有意不销毁此对象
+	CentralFreeList& GetCentralFreeList()
+	{
+		static const auto centralFreeList = new CentralFreeList;
+		return *centralFreeList;
+	}
+
+	class ThreadCache
+	{
+	public:
+		ThreadCache() = default;
+		ThreadCache(ThreadCache const&) = delete;
+		ThreadCache& operator=(ThreadCache const&) = delete;
+
+		~ThreadCache()
+		{
+			for (std::size_t sizeClass = 0; sizeClass < SizeClassCount; ++sizeClass)
+			{
+				const auto head = m_FreeLists[sizeClass];
+				if (!head)
+				{
+					continue;
+				}
+
+				auto tail = head;
+				while (tail->Next)
+				{
+					tail = tail->Next;
+				}
+
+				GetCentralFreeList().Push(sizeClass, head, tail);
+			}
+		}
+
+		void* Allocate(std::size_t sizeClass) noexcept
+		{
+			auto& head = m_FreeLists[sizeClass];
+			if (!head && !refill(sizeClass))
+			{
+				return nullptr;
+			}
+
+			const auto block = head;
+			head = block->Next;
+			return block;
+		}
+
+		void Deallocate(void* ptr, std::size_t sizeClass) noexcept
+		{
+			const auto block = static_cast<FreeBlock*>(ptr);
+			block->Next = m_FreeLists[sizeClass];
+			m_FreeLists[sizeClass] = block;
+		}
+
+	private:
+		std::array<FreeBlock*, SizeClassCount> m_FreeLists{};
+
+		bool refill(std::size_t sizeClass) noexcept
+		{
+			// 优先重用已退出的线程归还的块
+			if (const auto head = GetCentralFreeList().PopAll(sizeClass))
+			{
+				m_FreeLists[sizeClass] = head;
+				return true;
+			}
+
+			// 系统分配器返回的存储按 max_align_t 对齐，块的大小均为 Granularity 的倍数，因此所有块都满足对齐要求
+			const auto page = static_cast<unsigned char*>(std::malloc(PageSize));
+			if (!page)
+			{
+				return false;
+			}
+
+			g_Statistics.PageCount.fetch_add(1, std::memory_order_relaxed);
+
+			// 将页切分为块并按地址顺序链接，使连续的分配得到相邻的存储
+			const auto blockSize = GetBlockSize(sizeClass);
+			FreeBlock* head = nullptr;
+			for (auto i = PageSize / blockSize; i > 0; --i)
+			{
+				const auto block = reinterpret_cast<FreeBlock*>(page + (i - 1) * blockSize);
+				block->Next = head;
+				head = block;
+			}
+
+			m_FreeLists[sizeClass] = head;
+			return true;
+		}
+	};
+
+	thread_local ThreadCache t_ThreadCache;
+}
+
+void* NatsuLang_Allocate(std::size_t size) noexcept
+{
+	if (!size)
+	{
+		size = 1;
+	}
+
+	if (size > NatsuLang_MaxPooledSize)
+	{
+		const auto result = std::malloc(size);
+		if (result)
+		{
+			g_Statistics.LargeAllocationCount.fetch_add(1, std::memory_order_relaxed);
+			RecordAllocation(size);
+		}
+
+		return result;
+	}
+
+	const auto sizeClass = GetSizeClass(size);
+	const auto result = t_ThreadCache.Allocate(sizeClass);
+	if (result)
+	{
+		RecordAllocation(GetBlockSize(sizeClass));
+	}
+
+	return result;
+}
+
+void NatsuLang_Deallocate(void* ptr, std::size_t size) noexcept
+{
+	if (!ptr)
+	{
+		return;
+	}
+
+	if (!size)
+	{
+		size = 1;
+	}
+
+	if (size > NatsuLang_MaxPooledSize)
+	{
+		std::free(ptr);
+		RecordDeallocation(size);
+		return;
+	}
+
+	const auto sizeClass = GetSizeClass(size);
+	t_ThreadCache.Deallocate(ptr, sizeClass);
+	RecordDeallocation(GetBlockSize(sizeClass));
+}
+
+void NatsuLang_GetAllocatorStatistics(NatsuLang_AllocatorStatistics* statistics) noexcept
+{
+	if (!statistics)
+	{
+		return;
+	}
+
+	statistics->AllocationCount = g_Statistics.AllocationCount.load(std::memory_order_relaxed);
+	statistics->DeallocationCount = g_Statistics.DeallocationCount.load(std::memory_order_relaxed);
+	statistics->LiveBytes = g_Statistics.LiveBytes.load(std::memory_order_relaxed);
+	statistics->PeakLiveBytes = g_Statistics.PeakLiveBytes.load(std::memory_order_relaxed);
+	statistics->PageCount = g_Statistics.PageCount.load(std::memory_order_relaxed);
+	statistics->PageBytes = statistics->PageCount * PageSize;
+	statistics->LargeAllocationCount = g_Statistics.LargeAllocationCount.load(std::memory_order_relaxed);
+}
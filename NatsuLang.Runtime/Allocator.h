@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include <cstddef>
+
+// NatsuLang 运行时的分配器，解释器中声明的存储由此分配器分配及释放
+// 以 C 链接导出，以便日后由 AOT 编译器生成的代码调用
+// 不大于 NatsuLang_MaxPooledSize 的分配按大小类从线程局部的空闲链表中分配，空闲链表为空时从新的页中切分出块，更大的分配直接使用系统分配器
+extern "C"
+{
+	enum : std::size_t
+	{
+		NatsuLang_MaxPooledSize = 1024,
+	};
+
+	struct NatsuLang_AllocatorStatistics
+	{
+		std::size_t AllocationCount;
+		std::size_t DeallocationCount;
+		// 当前尚未释放的字节数，按大小类向上取整
+		std::size_t LiveBytes;
+		std::size_t PeakLiveBytes;
+		// 为大小类分配的页数，页不会被归还给系统
+		std::size_t PageCount;
+		std::size_t PageBytes;
+		// 超过 NatsuLang_MaxPooledSize 而直接使用系统分配器的分配次数
+		std::size_t LargeAllocationCount;
+	};
+
+	///	@brief	分配存储
+	///	@param	size	要分配的字节数，为 0 时视为 1
+	///	@return	至少按 16 字节对齐的存储，分配失败时返回 nullptr
+	void* NatsuLang_Allocate(std::size_t size) noexcept;
+
+	///	@brief	释放由 NatsuLang_Allocate 分配的存储
+	///	@param	ptr		要释放的存储，为 nullptr 时不执行任何操作
+	///	@param	size	分配时指定的字节数
+	///	@remark	可以在分配存储的线程以外的线程释放，此时存储将被释放到当前线程的空闲链表中
+	void NatsuLang_Deallocate(void* ptr, std::size_t size) noexcept;
+
+	///	@brief	获得分配器的统计信息，供监控使用
+	///	@remark	各项统计为所有线程的总和，在其他线程正在分配时获得的各项数据之间可能不一致
+	void NatsuLang_GetAllocatorStatistics(NatsuLang_AllocatorStatistics* statistics) noexcept;
+}
@@ -0,0 +1,681 @@
+﻿#include "TestClasses.h"
+
+#include <Pch.h>
+#include <Interpreter.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <regex>
+#include <string>
+#include <thread>
+
+namespace
+{
+	// 诊断的文本不影响测试，使用空的诊断 ID 映射
+	natRefPointer<TextReader<StringType::Utf8>> OpenEmptyDiagIdMap()
+	{
+		const auto diagIdMapPath = std::filesystem::absolute("InterpreterTestDiagIdMap.txt");
+		{
+			std::ofstream diagIdMap{ diagIdMapPath, std::ios::binary | std::ios::trunc };
+		}
+
+		const auto diagIdMapPathString = diagIdMapPath.u8string();
+		return make_ref<natStreamReader<nStrView::UsingStringType>>(make_ref<natFileStream>(nStrView{ diagIdMapPathString.data(), diagIdMapPathString.data() + diagIdMapPathString.size() }, true, false));
+	}
+
+	// 将源码写入文件，返回其 Uri
+	nString WriteScript(nStrView name, nStrView code)
+	{
+		const auto sourcePath = std::filesystem::absolute(std::string{ name.cbegin(), name.cend() } + ".nat");
+		{
+			std::ofstream source{ sourcePath, std::ios::binary | std::ios::trunc };
+			source.write(code.data(), code.size());
+		}
+
+		const auto sourcePathString = sourcePath.generic_u8string();
+		return natUtil::FormatString(u8"file://{0}{1}"_nv, sourcePathString.front() == '/' ? u8""_nv : u8"/"_nv,
+			nStrView{ sourcePathString.data(), sourcePathString.data() + sourcePathString.size() });
+	}
+
+	// 将源码写入文件并由解释器执行其中的 Main 函数，返回 Report 依次报告的值
+	std::vector<nInt> RunScript(nStrView name, nStrView code)
+	{
+		const auto sourceUri = WriteScript(name, code);
+
+		natEventBus eventBus;
+		natLog logger{ eventBus };
+		Interpreter interpreter{ OpenEmptyDiagIdMap(), logger };
+
+		std::vector<nInt> reported;
+		interpreter.RegisterFunction(u8"Report"_nv,
+			interpreter.GetASTContext().GetBuiltinType(Type::BuiltinType::Void),
+			{ interpreter.GetASTContext().GetBuiltinType(Type::BuiltinType::Int) },
+			[&interpreter, &reported](std::vector<natRefPointer<Declaration::ValueDecl>> const& args) -> natRefPointer<Declaration::ValueDecl>
+			{
+				if (!interpreter.GetDeclStorage().VisitDeclStorage(args.at(0), [&reported](nInt value)
+				{
+					reported.emplace_back(value);
+				}, Detail::Expected<nInt>))
+				{
+					nat_Throw(InterpreterException, u8"无法访问参数"_nv);
+				}
+
+				return nullptr;
+			});
+
+		interpreter.Run(Uri{ sourceUri });
+		return reported;
+	}
+}
+
+TEST_CASE("Interpreter Exceptions", "[Interpreter]")
+{
+	SECTION("builtin and class typed exceptions")
+	{
+		constexpr char testCode[] =
+			u8R"(
+class Error
+{
+	def Code : int;
+	def Line : int;
+}
+
+def Fail : (code : int) -> void
+{
+	def error : Error;
+	error.Code = code;
+	error.Line = code * 10;
+	throw error;
+}
+
+def Rethrow : (value : int) -> void
+{
+	try
+	{
+		throw value;
+	}
+	catch (e : int)
+	{
+		Report(e);
+		throw;
+	}
+}
+
+def Main : () -> void
+{
+	try
+	{
+		Fail(7);
+	}
+	catch (e : int)
+	{
+		Report(-1);
+	}
+	catch (e : Error)
+	{
+		Report(e.Code);
+		Report(e.Line);
+	}
+
+	try
+	{
+		Rethrow(3);
+	}
+	catch (...)
+	{
+		Report(4);
+	}
+}
+)";
+
+		REQUIRE(RunScript(u8"InterpreterExceptions"_nv, testCode) == std::vector<nInt>{ 7, 70, 3, 4 });
+	}
+
+	SECTION("uncaught exception")
+	{
+		constexpr char testCode[] =
+			u8R"(
+def Main : () -> void
+{
+	try
+	{
+		throw 1;
+	}
+	catch (e : long)
+	{
+		Report(2);
+	}
+}
+)";
+
+		REQUIRE_THROWS_AS(RunScript(u8"InterpreterUncaughtException"_nv, testCode), InterpreterException);
+	}
+}
+
+TEST_CASE("Interpreter Lazy Function Bodies", "[Interpreter]")
+{
+	// 函数体在首次调用时才被分析，未被调用的函数体中的错误不会被报告
+	SECTION("bodies are parsed when first called")
+	{
+		constexpr char testCode[] =
+			u8R"(
+def Main : () -> void
+{
+	Report(Helper(20));
+	Report(Helper(30));
+}
+
+def Helper : (value : int) -> int
+{
+	return value + 1;
+}
+
+def Broken : () -> int
+{
+	return undefinedName;
+}
+)";
+
+		REQUIRE(RunScript(u8"InterpreterLazyBody"_nv, testCode) == std::vector<nInt>{ 21, 31 });
+	}
+
+	SECTION("erroneous body is rejected at call time")
+	{
+		constexpr char testCode[] =
+			u8R"(
+def Main : () -> void
+{
+	Report(Broken());
+}
+
+def Broken : () -> int
+{
+	return undefinedName;
+}
+)";
+
+		REQUIRE_THROWS_AS(RunScript(u8"InterpreterErroneousLazyBody"_nv, testCode), InterpreterException);
+	}
+}
+
+TEST_CASE("Interpreter Pointers", "[Interpreter]")
+{
+	SECTION("dereference of valid pointers")
+	{
+		constexpr char testCode[] =
+			u8R"(
+class Point
+{
+	def X : int;
+	def Y : int;
+}
+
+def unsafe Main : () -> void
+{
+	def value = 1;
+	def pValue = &value;
+	*pValue = 2;
+	Report(value);
+
+	def arr : int[4];
+	def pElem = &arr[3];
+	*pElem = 3;
+	Report(arr[3]);
+
+	def point : Point;
+	def pField = &point.Y;
+	*pField = 4;
+	Report(point.Y);
+}
+)";
+
+		REQUIRE(RunScript(u8"InterpreterValidPointers"_nv, testCode) == std::vector<nInt>{ 2, 3, 4 });
+	}
+
+	SECTION("dangling pointer")
+	{
+		constexpr char testCode[] =
+			u8R"(
+def unsafe Main : () -> void
+{
+	def p : int*;
+	{
+		def value = 1;
+		p = &value;
+	}
+	Report(*p);
+}
+)";
+
+		REQUIRE_THROWS_AS(RunScript(u8"InterpreterDanglingPointer"_nv, testCode), InterpreterException);
+	}
+
+	SECTION("dangling pointer after the generation of its region saturates")
+	{
+		// 循环中每次被取地址的局部变量反复使用同一槽位，次数超过代数所能表示的范围
+		constexpr char testCode[] =
+			u8R"(
+def unsafe Main : () -> void
+{
+	def p : int*;
+	def i = 0;
+	while (i < 70000)
+	{
+		def value = i;
+		def q = &value;
+		if (i == 0)
+		{
+			p = q;
+		}
+		i += 1;
+	}
+	Report(*p);
+}
+)";
+
+		REQUIRE_THROWS_AS(RunScript(u8"InterpreterGenerationSaturation"_nv, testCode), InterpreterException);
+	}
+
+	SECTION("objects larger than the pointer offset range")
+	{
+		// 无法被指针表示的对象仍可正常使用，仅在取地址时被拒绝
+		constexpr char largeObjectCode[] =
+			u8R"(
+def Main : () -> void
+{
+	def big : int[5000000];
+	big[4999999] = 5;
+	Report(big[4999999]);
+}
+)";
+
+		REQUIRE(RunScript(u8"InterpreterLargeObject"_nv, largeObjectCode) == std::vector<nInt>{ 5 });
+
+		constexpr char addressOfCode[] =
+			u8R"(
+def unsafe Main : () -> void
+{
+	def big : int[5000000];
+	def p = &big[4999999];
+}
+)";
+
+		REQUIRE_THROWS_AS(RunScript(u8"InterpreterLargeObjectAddress"_nv, addressOfCode), InterpreterException);
+	}
+
+	SECTION("out-of-bounds dereference")
+	{
+		// 语言中尚无指针运算，直接构造越界的指针
+		natEventBus eventBus;
+		natLog logger{ eventBus };
+		Interpreter interpreter{ OpenEmptyDiagIdMap(), logger };
+		auto& declStorage = interpreter.GetDeclStorage();
+
+		const auto intType = interpreter.GetASTContext().GetBuiltinType(Type::BuiltinType::Int);
+		const auto storage = declStorage.GetOrAddDecl(Interpreter::InterpreterDeclStorage::CreateTemporaryObjectDecl(intType), intType).second;
+
+		const auto handle = declStorage.MakePointerHandle(storage);
+		REQUIRE(declStorage.ResolvePointerHandle(handle, sizeof(nInt)) == storage);
+		REQUIRE_THROWS_AS(declStorage.ResolvePointerHandle(handle, sizeof(nLong)), InterpreterException);
+
+		// 允许引用对象末尾之后的位置，但不允许通过其访问
+		const auto pastEndHandle = declStorage.MakePointerHandle(storage + sizeof(nInt));
+		REQUIRE_THROWS_AS(declStorage.ResolvePointerHandle(pastEndHandle, sizeof(nInt)), InterpreterException);
+		REQUIRE_THROWS_AS(declStorage.MakePointerHandle(storage + sizeof(nInt) + 1), InterpreterException);
+	}
+}
+
+TEST_CASE("Interpreter Arrays", "[Interpreter]")
+{
+	SECTION("element access and array assignment")
+	{
+		constexpr char testCode[] =
+			u8R"(
+def Main : () -> void
+{
+	def a : int[4] = { 1, 2, 3, 4 };
+	def i = 2;
+	a[i] = 10;
+	++a[i];
+	a[0] += a[i];
+	Report(a[0]);
+	Report(a[2]);
+
+	def b : int[4];
+	b = a;
+	a[1] = 0;
+	Report(b[0] + b[1] + b[2] + b[3]);
+	Report(a[1]);
+
+	def m : int[3][3] = { { 1, 2, 3 }, { 4, 5, 6 }, { 7, 8, 9 } };
+	def sum = 0;
+	for (def r = 0; r < 3; ++r)
+	{
+		for (def c = 0; c < 3; ++c)
+		{
+			m[r][c] *= 2;
+			sum += m[r][c];
+		}
+	}
+	Report(sum);
+	++m[1][1];
+	Report(m[1][1]);
+}
+)";
+
+		REQUIRE(RunScript(u8"InterpreterArrays"_nv, testCode) == std::vector<nInt>{ 12, 11, 29, 0, 90, 11 });
+	}
+
+	SECTION("subscript out of range")
+	{
+		constexpr char testCode[] =
+			u8R"(
+def Main : () -> void
+{
+	def a : int[4];
+	def i = 4;
+	a[i] = 1;
+}
+)";
+
+		REQUIRE_THROWS_AS(RunScript(u8"InterpreterArraySubscriptOutOfRange"_nv, testCode), InterpreterException);
+	}
+}
+
+TEST_CASE("Interpreter Switch", "[Interpreter]")
+{
+	SECTION("dense and sparse case values")
+	{
+		constexpr char testCode[] =
+			u8R"(
+def Dense : (op : int) -> int
+{
+	switch (op)
+	{
+	case -1:
+		return 9;
+	case 0:
+		return 10;
+	case 1:
+		return 11;
+	case 2:
+		return 12;
+	case 3:
+		return 13;
+	default:
+		return -100;
+	}
+	return 0;
+}
+
+def Sparse : (op : int) -> int
+{
+	switch (op)
+	{
+	case -1000:
+		return 1;
+	case 7:
+		return 2;
+	case 100000:
+		return 3;
+	case -1:
+		return 4;
+	default:
+		return 0;
+	}
+	return -100;
+}
+
+def Main : () -> void
+{
+	for (def i = -2; i <= 4; ++i)
+	{
+		Report(Dense(i));
+	}
+
+	Report(Sparse(-1000));
+	Report(Sparse(7));
+	Report(Sparse(100000));
+	Report(Sparse(-1));
+	Report(Sparse(8));
+	Report(Sparse(-999));
+}
+)";
+
+		REQUIRE(RunScript(u8"InterpreterSwitchDispatch"_nv, testCode) == std::vector<nInt>{ -100, 9, 10, 11, 12, 13, -100, 1, 2, 3, 4, 0, 0 });
+	}
+
+	SECTION("no match, fallthrough and break")
+	{
+		constexpr char testCode[] =
+			u8R"(
+def NoDefault : (op : int) -> int
+{
+	def result = 5;
+	switch (op)
+	{
+	case 1:
+		result = 1;
+		break;
+	case 2:
+		result = 2;
+		break;
+	}
+	return result;
+}
+
+def Fallthrough : (op : int) -> int
+{
+	def result = 0;
+	switch (op)
+	{
+	case 1:
+		result += 1;
+	case 2:
+		result += 10;
+	case 3:
+		result += 100;
+		break;
+	case 4:
+		result += 1000;
+	default:
+		result += 10000;
+	}
+	return result;
+}
+
+def Main : () -> void
+{
+	Report(NoDefault(1));
+	Report(NoDefault(2));
+	Report(NoDefault(3));
+
+	for (def i = 1; i <= 5; ++i)
+	{
+		Report(Fallthrough(i));
+	}
+
+	// switch 中的 break 只结束 switch，不会结束外层的循环
+	def sum = 0;
+	def i = 0;
+	while (i < 4)
+	{
+		switch (i % 2)
+		{
+		case 0:
+			sum += 1;
+			break;
+		default:
+			sum += 10;
+			break;
+		}
+		i += 1;
+	}
+	Report(sum);
+}
+)";
+
+		REQUIRE(RunScript(u8"InterpreterSwitchControlFlow"_nv, testCode) == std::vector<nInt>{ 1, 2, 5, 111, 110, 100, 11000, 10000, 22 });
+	}
+}
+
+TEST_CASE("Interpreter Profiler", "[Interpreter]")
+{
+	constexpr char testCode[] =
+		u8R"(
+def Fact : (n : int) -> int
+{
+	if (n <= 1)
+	{
+		Sleep();
+		return 1;
+	}
+	return n * Fact(n - 1);
+}
+
+def Main : () -> void
+{
+	def result = Fact(4);
+}
+)";
+
+	const auto sourceUri = WriteScript(u8"InterpreterProfiler"_nv, testCode);
+
+	natEventBus eventBus;
+	natLog logger{ eventBus };
+	Interpreter interpreter{ OpenEmptyDiagIdMap(), logger };
+
+	// 使最深的调用栈具有可被观察到的独占时间
+	interpreter.RegisterFunction(u8"Sleep"_nv, interpreter.GetASTContext().GetBuiltinType(Type::BuiltinType::Void), {},
+		[](std::vector<natRefPointer<Declaration::ValueDecl>> const&) -> natRefPointer<Declaration::ValueDecl>
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 2 });
+			return nullptr;
+		});
+
+	auto& profiler = interpreter.GetProfiler();
+	profiler.SetEnabled(true);
+	interpreter.Run(Uri{ sourceUri });
+
+	const auto findRecord = [&profiler](nStrView name) -> Interpreter::InterpreterProfiler::FunctionRecord const*
+	{
+		for (const auto& [func, record] : profiler.GetFunctionRecords())
+		{
+			if (func && func->GetName() == name)
+			{
+				return &record;
+			}
+		}
+
+		return nullptr;
+	};
+
+	const auto mainRecordPtr = findRecord(u8"Main"_nv);
+	const auto factRecordPtr = findRecord(u8"Fact"_nv);
+	const auto sleepRecordPtr = findRecord(u8"Sleep"_nv);
+	REQUIRE(mainRecordPtr);
+	REQUIRE(factRecordPtr);
+	REQUIRE(sleepRecordPtr);
+
+	const auto& mainRecord = *mainRecordPtr;
+	const auto& factRecord = *factRecordPtr;
+	const auto& sleepRecord = *sleepRecordPtr;
+
+	SECTION("call counts")
+	{
+		REQUIRE(mainRecord.CallCount == 1);
+		REQUIRE(factRecord.CallCount == 4);
+		REQUIRE(sleepRecord.CallCount == 1);
+		REQUIRE(mainRecord.ActiveCount == 0);
+		REQUIRE(factRecord.ActiveCount == 0);
+		REQUIRE(sleepRecord.ActiveCount == 0);
+	}
+
+	SECTION("inclusive and exclusive time under recursion")
+	{
+		REQUIRE(sleepRecord.InclusiveTime >= std::chrono::milliseconds{ 2 });
+		REQUIRE(factRecord.ExclusiveTime <= factRecord.InclusiveTime);
+		REQUIRE(mainRecord.ExclusiveTime <= mainRecord.InclusiveTime);
+
+		// 递归调用的包含时间只在最外层计入一次，各层的独占时间之和加上被调用者的包含时间恰好为最外层的耗时
+		REQUIRE(factRecord.InclusiveTime == factRecord.ExclusiveTime + sleepRecord.InclusiveTime);
+		REQUIRE(mainRecord.InclusiveTime == mainRecord.ExclusiveTime + factRecord.InclusiveTime);
+	}
+
+	SECTION("folded stack output")
+	{
+		const auto foldedPath = std::filesystem::absolute("InterpreterProfiler.folded");
+		std::filesystem::remove(foldedPath);
+		{
+			const auto foldedPathString = foldedPath.u8string();
+			profiler.WriteCollapsedStacks(make_ref<natFileStream>(nStrView{ foldedPathString.data(), foldedPathString.data() + foldedPathString.size() }, false, true));
+		}
+
+		// 每行为以分号分隔的调用栈及以微秒为单位的独占时间
+		const std::regex linePattern{ R"(^([A-Za-z]+(;[A-Za-z]+)*) ([0-9]+)$)" };
+		std::ifstream folded{ foldedPath };
+		std::string line;
+		auto sleepStackFound = false;
+		while (std::getline(folded, line))
+		{
+			std::smatch match;
+			REQUIRE(std::regex_match(line, match, linePattern));
+			REQUIRE(std::stoll(match[3].str()) > 0);
+
+			if (match[1].str() == "Main;Fact;Fact;Fact;Fact;Sleep")
+			{
+				REQUIRE(std::stoll(match[3].str()) >= 2000);
+				sleepStackFound = true;
+			}
+		}
+
+		REQUIRE(sleepStackFound);
+	}
+}
+
+TEST_CASE("Interpreter Exception Control Flow", "[Interpreter][.][Benchmark]")
+{
+	constexpr char testCode[] =
+		u8R"(
+def Find : (limit : int, target : int) -> void
+{
+	def i = 0;
+	while (i < limit)
+	{
+		if (i == target)
+		{
+			throw i;
+		}
+		i += 1;
+	}
+}
+
+def Main : () -> void
+{
+	def found = 0;
+	def round = 0;
+	while (round < 100000)
+	{
+		try
+		{
+			Find(16, round % 16);
+		}
+		catch (index : int)
+		{
+			found += index;
+		}
+		round += 1;
+	}
+	Report(found);
+}
+)";
+
+	const auto start = std::chrono::steady_clock::now();
+	const auto reported = RunScript(u8"InterpreterExceptionControlFlow"_nv, testCode);
+	const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+	// 每 16 轮中抛出的值之和为 0 + 1 + ... + 15
+	REQUIRE(reported == std::vector<nInt>{ 100000 / 16 * 120 });
+	WARN("throw/catch: " << static_cast<double>(elapsed.count()) / 100000 << " ns per round");
+}
@@ -0,0 +1,106 @@
+﻿#include "TestClasses.h"
+
+#include <ModuleCache.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace
+{
+	void WriteTestFile(nStrView path, std::string const& content)
+	{
+		std::ofstream stream{ std::string{ path.cbegin(), path.cend() }, std::ios::binary | std::ios::trunc };
+		stream << content;
+	}
+
+	std::string ReadTestFile(nStrView path)
+	{
+		std::ifstream stream{ std::string{ path.cbegin(), path.cend() }, std::ios::binary };
+		return { std::istreambuf_iterator<char>{ stream }, std::istreambuf_iterator<char>{} };
+	}
+}
+
+TEST_CASE("Module Cache Key", "[ModuleCache]")
+{
+	const auto sourcePath = u8"ModuleCacheSource.nat"_nv;
+	const auto precedingPath = u8"ModuleCachePreceding.nat"_nv;
+	const auto metadataPath = u8"ModuleCacheImport.meta"_nv;
+	const auto objectOutputPath = u8"ModuleCacheSource.nat.obj"_nv;
+	const auto metadataOutputPath = u8"ModuleCacheSource.nat.meta"_nv;
+
+	const auto scope = make_scope([&]
+	{
+		for (const auto path : { sourcePath, precedingPath, metadataPath, objectOutputPath, metadataOutputPath })
+		{
+			std::remove(path.data());
+		}
+	});
+
+	WriteTestFile(sourcePath, "def Main : () -> int { return Answer(); }");
+	WriteTestFile(precedingPath, "def Answer : () -> int { return 42; }");
+	WriteTestFile(metadataPath, "Imported declarations");
+
+	Compiler::ModuleCache cache{ u8"ModuleCacheTest"_nv, 1024 * 1024 };
+	const std::vector<nString> metadata{ metadataPath };
+	const auto computeKey = [&](std::vector<nString> const& precedingSources, nStrView options = u8"-O2"_nv)
+	{
+		return cache.ComputeKey(sourcePath, precedingSources, metadata, {}, options);
+	};
+
+	const auto key = computeKey({});
+	REQUIRE(!key.IsEmpty());
+
+	WriteTestFile(objectOutputPath, "Object");
+	WriteTestFile(metadataOutputPath, "Metadata");
+	cache.Store(key, objectOutputPath, metadataOutputPath);
+	std::remove(objectOutputPath.data());
+	std::remove(metadataOutputPath.data());
+
+	SECTION("hit")
+	{
+		REQUIRE(computeKey({}) == key);
+		REQUIRE(cache.Restore(key, objectOutputPath, metadataOutputPath));
+		REQUIRE(ReadTestFile(objectOutputPath) == "Object");
+		REQUIRE(ReadTestFile(metadataOutputPath) == "Metadata");
+	}
+
+	SECTION("miss after editing the source")
+	{
+		WriteTestFile(sourcePath, "def Main : () -> int { return Answer() + 1; }");
+		const auto editedKey = computeKey({});
+		REQUIRE(editedKey != key);
+		REQUIRE(!cache.Restore(editedKey, objectOutputPath, metadataOutputPath));
+	}
+
+	SECTION("miss after changing the metadata")
+	{
+		WriteTestFile(metadataPath, "Changed imported declarations");
+		const auto changedKey = computeKey({});
+		REQUIRE(changedKey != key);
+		REQUIRE(!cache.Restore(changedKey, objectOutputPath, metadataOutputPath));
+	}
+
+	SECTION("miss with state left by earlier sources")
+	{
+		// 先前编译的源码文件的声明仍留在 Sema 中
+		const auto precedingKey = computeKey({ precedingPath });
+		REQUIRE(precedingKey != key);
+		REQUIRE(!cache.Restore(precedingKey, objectOutputPath, metadataOutputPath));
+
+		// 同一个文件作为先前的源码文件或元数据时不应得到相同的键
+		REQUIRE(cache.ComputeKey(sourcePath, { metadataPath }, {}, {}, u8"-O2"_nv) != cache.ComputeKey(sourcePath, {}, { metadataPath }, {}, u8"-O2"_nv));
+	}
+
+	SECTION("miss after changing the options")
+	{
+		REQUIRE(computeKey({}, u8"-O0"_nv) != key);
+	}
+
+	SECTION("unreadable input")
+	{
+		std::remove(metadataPath.data());
+		REQUIRE(computeKey({}).IsEmpty());
+	}
+}
@@ -1,5 +1,9 @@
 ﻿#include "TestClasses.h"
 
+#include <algorithm>
+#include <chrono>
+#include <string>
+
 TEST_CASE("AST Generation", "[Lexer][Parser][Sema]")
 {
 	constexpr char testCode[] =
@@ -77,6 +81,270 @@ def Increase : (arg : int = 1) -> int
 	}
 }
 
+TEST_CASE("Switch Statement", "[Lexer][Parser][Sema]")
+{
+	constexpr char testCode[] =
+		u8R"(
+def Dispatch : (op : int) -> int
+{
+	switch (op)
+	{
+	case 1:
+	case 2:
+		return 10;
+	case 1 + 2:
+		return 30;
+	default:
+		break;
+	}
+	return op;
+}
+)";
+
+	Diag::DiagnosticsEngine diag{ make_ref<IDMap>(), make_ref<TestDiagConsumer>() };
+	FileManager fileManager{};
+	SourceManager sourceManager{ diag, fileManager };
+	Preprocessor pp{ diag, sourceManager };
+	pp.SetLexer(make_ref<Lex::Lexer>(0, testCode, pp));
+	ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+	const auto consumer = make_ref<TestAstConsumer>();
+	ParseAST(pp, context, consumer);
+
+	const auto func = consumer->GetNamedDecl(u8"Dispatch").Cast<Declaration::FunctionDecl>();
+	REQUIRE(func);
+	const auto body = func->GetBody().Cast<Statement::CompoundStmt>();
+	REQUIRE(body);
+
+	auto content{ body->GetChildrenStmt().Cast<std::vector<Statement::StmtPtr>>() };
+	REQUIRE(content.size() == 2);
+
+	const auto switchStmt = content[0].Cast<Statement::SwitchStmt>();
+	REQUIRE(switchStmt);
+	REQUIRE(switchStmt->GetCond());
+
+	std::vector<nuLong> caseValues;
+	std::size_t defaultCount{};
+	for (auto switchCase = switchStmt->GetSwitchCaseList(); switchCase; switchCase = switchCase->GetNextSwitchCase())
+	{
+		if (const auto caseStmt = switchCase.Cast<Statement::CaseStmt>())
+		{
+			nuLong value;
+			REQUIRE(caseStmt->GetExpr()->EvaluateAsInt(value, context));
+			caseValues.emplace_back(value);
+		}
+		else
+		{
+			REQUIRE(switchCase.Cast<Statement::DefaultStmt>());
+			++defaultCount;
+		}
+	}
+
+	std::sort(caseValues.begin(), caseValues.end());
+	REQUIRE(caseValues == std::vector<nuLong>{ 1, 2, 3 });
+	REQUIRE(defaultCount == 1);
+
+	SECTION("case label bypassing initialization")
+	{
+		constexpr char invalidCode[] =
+			u8R"(
+def Bypass : (op : int) -> int
+{
+	switch (op)
+	{
+	case 1:
+		def value = op + 1;
+		return value;
+	case 2:
+		return 2;
+	default:
+		{
+			def scoped = op * 2;
+			return scoped;
+		}
+	}
+	return op;
+}
+)";
+
+		const auto invalidDiagConsumer = make_ref<TestDiagConsumer>();
+		Diag::DiagnosticsEngine invalidDiag{ make_ref<IDMap>(), invalidDiagConsumer };
+		SourceManager invalidSourceManager{ invalidDiag, fileManager };
+		Preprocessor invalidPP{ invalidDiag, invalidSourceManager };
+		invalidPP.SetLexer(make_ref<Lex::Lexer>(0, invalidCode, invalidPP));
+		ASTContext invalidContext{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+		const auto invalidConsumer = make_ref<TestAstConsumer>();
+		ParseAST(invalidPP, invalidContext, invalidConsumer);
+
+		// case 2 及 default 均跳过了 value 的初始化，位于内层作用域中的 scoped 不会被跳过
+		REQUIRE(invalidDiagConsumer->GetErrorCount() == 2);
+	}
+
+	SECTION("case values are compared in the width of the condition")
+	{
+		constexpr char widthCode[] =
+			u8R"(
+enum Color { Red, Green, Blue }
+
+def Narrow : (op : byte) -> int
+{
+	switch (op)
+	{
+	case 1:
+		return 1;
+	case 257:
+		return 2;
+	}
+	return 0;
+}
+
+def Wide : (op : uint128) -> int
+{
+	switch (op)
+	{
+	case 1:
+		return 1;
+	case (1 as uint128) << 64 | 1:
+		return 2;
+	}
+	return 0;
+}
+
+def Paint : (color : Color) -> int
+{
+	switch (color)
+	{
+	case 1:
+		return 1;
+	}
+	return 0;
+}
+)";
+
+		const auto widthDiagConsumer = make_ref<TestDiagConsumer>();
+		Diag::DiagnosticsEngine widthDiag{ make_ref<IDMap>(), widthDiagConsumer };
+		SourceManager widthSourceManager{ widthDiag, fileManager };
+		Preprocessor widthPP{ widthDiag, widthSourceManager };
+		widthPP.SetLexer(make_ref<Lex::Lexer>(0, widthCode, widthPP));
+		ASTContext widthContext{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+		const auto widthConsumer = make_ref<TestAstConsumer>();
+		ParseAST(widthPP, widthContext, widthConsumer);
+
+		// byte 宽度下 257 与 1 重复，uint128 的两个值在高 64 位上不同不应视为重复，枚举条件不接受整数作为 case 的值
+		REQUIRE(widthDiagConsumer->GetErrorCount() == 2);
+	}
+}
+
+TEST_CASE("Try Statement", "[Lexer][Parser][Sema]")
+{
+	constexpr char testCode[] =
+		u8R"(
+def Guard : (op : int) -> int
+{
+	try
+	{
+		if (op == 0)
+		{
+			throw 1;
+		}
+	}
+	catch (e : int)
+	{
+		return e;
+	}
+	catch (...)
+	{
+		throw;
+	}
+	return op;
+}
+)";
+
+	Diag::DiagnosticsEngine diag{ make_ref<IDMap>(), make_ref<TestDiagConsumer>() };
+	FileManager fileManager{};
+	SourceManager sourceManager{ diag, fileManager };
+	Preprocessor pp{ diag, sourceManager };
+	pp.SetLexer(make_ref<Lex::Lexer>(0, testCode, pp));
+	ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+	const auto consumer = make_ref<TestAstConsumer>();
+	ParseAST(pp, context, consumer);
+
+	const auto func = consumer->GetNamedDecl(u8"Guard").Cast<Declaration::FunctionDecl>();
+	REQUIRE(func);
+	const auto body = func->GetBody().Cast<Statement::CompoundStmt>();
+	REQUIRE(body);
+
+	auto content{ body->GetChildrenStmt().Cast<std::vector<Statement::StmtPtr>>() };
+	REQUIRE(content.size() == 2);
+
+	const auto tryStmt = content[0].Cast<Statement::TryStmt>();
+	REQUIRE(tryStmt);
+	REQUIRE(tryStmt->GetTryBlock());
+
+	auto handlers{ tryStmt->GetHandlers().Cast<std::vector<Statement::StmtPtr>>() };
+	REQUIRE(handlers.size() == 2);
+
+	const auto typedHandler = handlers[0].Cast<Statement::CatchStmt>();
+	REQUIRE(typedHandler);
+	const auto exDecl = typedHandler->GetExceptionDecl();
+	REQUIRE(exDecl);
+
+	const auto catchAllHandler = handlers[1].Cast<Statement::CatchStmt>();
+	REQUIRE(catchAllHandler);
+	CHECK(!catchAllHandler->GetExceptionDecl());
+
+	SECTION("throwing objects with destructors")
+	{
+		constexpr char invalidCode[] =
+			u8R"(
+class Resource
+{
+	def ~this : ()
+	{
+	}
+
+	def Handle : int;
+}
+
+class Holder
+{
+	def Inner : Resource;
+}
+
+class Plain
+{
+	def Value : int;
+}
+
+def ThrowResource : (res : Resource) -> void
+{
+	throw res;
+}
+
+def ThrowHolder : (holder : Holder) -> void
+{
+	throw holder;
+}
+
+def ThrowPlain : (plain : Plain) -> void
+{
+	throw plain;
+}
+)";
+
+		const auto invalidDiagConsumer = make_ref<TestDiagConsumer>();
+		Diag::DiagnosticsEngine invalidDiag{ make_ref<IDMap>(), invalidDiagConsumer };
+		SourceManager invalidSourceManager{ invalidDiag, fileManager };
+		Preprocessor invalidPP{ invalidDiag, invalidSourceManager };
+		invalidPP.SetLexer(make_ref<Lex::Lexer>(0, invalidCode, invalidPP));
+		ASTContext invalidContext{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+		const auto invalidConsumer = make_ref<TestAstConsumer>();
+		ParseAST(invalidPP, invalidContext, invalidConsumer);
+
+		// Resource 与成员具有析构函数的 Holder 均不能被抛出，Plain 可以按位复制
+		REQUIRE(invalidDiagConsumer->GetErrorCount() == 2);
+	}
+}
+
 class CodeCompleter
 	: public natRefObjImpl<CodeCompleter, ICodeCompleter>
 {
@@ -121,3 +389,274 @@ def Main : () -> void
 	ParseAST(parser);
 	EndParsingAST(parser);
 }
+
+TEST_CASE("Class Layout Policy", "[ASTContext]")
+{
+	constexpr char testCode[] =
+		u8R"(
+class MixedDeclared
+{
+	def A : byte;
+	def B : double;
+	def C : short;
+	def D : int;
+}
+
+class MixedOptimal
+{
+	def A : byte;
+	def B : double;
+	def C : short;
+	def D : int;
+}
+
+class MixedPacked
+{
+	def A : byte;
+	def B : double;
+	def C : short;
+	def D : int;
+}
+)";
+
+	Diag::DiagnosticsEngine diag{ make_ref<IDMap>(), make_ref<TestDiagConsumer>() };
+	FileManager fileManager{};
+	SourceManager sourceManager{ diag, fileManager };
+	Preprocessor pp{ diag, sourceManager };
+	pp.SetLexer(make_ref<Lex::Lexer>(0, testCode, pp));
+	ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+	const auto consumer = make_ref<TestAstConsumer>();
+	ParseAST(pp, context, consumer);
+
+	// 未指定布局策略的类使用默认策略，指定了的类使用其自身的策略
+	context.UseDefaultClassLayoutBuilder(ClassLayoutPolicy::Optimal);
+
+	const auto getLayout = [&](nStrView className, std::optional<ClassLayoutPolicy> policy)
+	{
+		const auto classDecl = consumer->GetNamedDecl(className).Cast<Declaration::ClassDecl>();
+		REQUIRE(classDecl);
+		if (policy)
+		{
+			classDecl->AttachAttribute(make_ref<ClassLayoutAttribute>(policy.value()));
+		}
+
+		const auto& layout = context.GetClassLayout(classDecl);
+		std::unordered_map<nStrView, std::size_t> offsets;
+		for (const auto& field : classDecl->GetFields())
+		{
+			const auto fieldInfo = layout.GetFieldInfo(field);
+			REQUIRE(fieldInfo);
+			offsets.emplace(field->GetName(), fieldInfo->second);
+		}
+
+		return std::pair{ &layout, std::move(offsets) };
+	};
+
+	SECTION("declared")
+	{
+		const auto [layout, offsets] = getLayout(u8"MixedDeclared"_nv, ClassLayoutPolicy::Declared);
+		REQUIRE(layout->Policy == ClassLayoutPolicy::Declared);
+		REQUIRE(offsets.at(u8"A"_nv) == 0);
+		REQUIRE(offsets.at(u8"B"_nv) == 8);
+		REQUIRE(offsets.at(u8"C"_nv) == 16);
+		REQUIRE(offsets.at(u8"D"_nv) == 20);
+		REQUIRE(layout->Size == 24);
+		REQUIRE(layout->Align == 8);
+		// A 与 B 之间及 C 与 D 之间存在 padding
+		REQUIRE(layout->FieldOffsets.size() == 6);
+	}
+
+	SECTION("optimal")
+	{
+		const auto [layout, offsets] = getLayout(u8"MixedOptimal"_nv, std::nullopt);
+		REQUIRE(layout->Policy == ClassLayoutPolicy::Optimal);
+		REQUIRE(offsets.at(u8"B"_nv) == 0);
+		REQUIRE(offsets.at(u8"D"_nv) == 8);
+		REQUIRE(offsets.at(u8"C"_nv) == 12);
+		REQUIRE(offsets.at(u8"A"_nv) == 14);
+		REQUIRE(layout->Size == 16);
+		REQUIRE(layout->Align == 8);
+		REQUIRE(layout->FieldOffsets.size() == 4);
+	}
+
+	SECTION("packed")
+	{
+		const auto [layout, offsets] = getLayout(u8"MixedPacked"_nv, ClassLayoutPolicy::Packed);
+		REQUIRE(layout->Policy == ClassLayoutPolicy::Packed);
+		REQUIRE(offsets.at(u8"A"_nv) == 0);
+		REQUIRE(offsets.at(u8"B"_nv) == 1);
+		REQUIRE(offsets.at(u8"C"_nv) == 9);
+		REQUIRE(offsets.at(u8"D"_nv) == 11);
+		REQUIRE(layout->Size == 15);
+		REQUIRE(layout->Align == 1);
+		REQUIRE(layout->FieldOffsets.size() == 4);
+	}
+}
+
+TEST_CASE("Class Layout Action", "[Parser][Sema]")
+{
+	constexpr char testCode[] =
+		u8R"(
+$Compiler.Layout(Packed) class PackedPoint
+{
+	def X : byte;
+	def Y : int;
+};
+
+$Compiler.Layout(Sideways) class SidewaysPoint
+{
+	def X : byte;
+	def Y : int;
+};
+)";
+
+	const auto diagConsumer = make_ref<TestDiagConsumer>();
+	Diag::DiagnosticsEngine diag{ make_ref<IDMap>(), diagConsumer };
+	FileManager fileManager{};
+	SourceManager sourceManager{ diag, fileManager };
+	Preprocessor pp{ diag, sourceManager };
+	pp.SetLexer(make_ref<Lex::Lexer>(0, testCode, pp));
+	ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+	context.UseDefaultClassLayoutBuilder();
+	const auto consumer = make_ref<TestAstConsumer>();
+	ParseAST(pp, context, consumer);
+
+	SECTION("valid policy")
+	{
+		const auto classDecl = consumer->GetNamedDecl(u8"PackedPoint"_nv).Cast<Declaration::ClassDecl>();
+		REQUIRE(classDecl);
+		REQUIRE(classDecl->GetAttributeCount(typeid(ClassLayoutAttribute)) == 1);
+
+		const auto& layout = context.GetClassLayout(classDecl);
+		REQUIRE(layout.Policy == ClassLayoutPolicy::Packed);
+		REQUIRE(layout.Size == 5);
+		REQUIRE(layout.Align == 1);
+	}
+
+	SECTION("invalid policy")
+	{
+		// 仍然声明了类，但使用默认的布局策略，错误位于策略的标识符处
+		const auto classDecl = consumer->GetNamedDecl(u8"SidewaysPoint"_nv).Cast<Declaration::ClassDecl>();
+		REQUIRE(classDecl);
+		REQUIRE(classDecl->GetAttributeCount(typeid(ClassLayoutAttribute)) == 0);
+		REQUIRE(context.GetClassLayout(classDecl).Policy == ClassLayoutPolicy::Declared);
+
+		REQUIRE(diagConsumer->GetErrorCount() == 1);
+		const auto errorLoc = diagConsumer->GetErrorLocations().front();
+		REQUIRE(errorLoc.GetPos());
+		REQUIRE(nStrView{ errorLoc.GetPos(), errorLoc.GetPos() + 8 } == u8"Sideways"_nv);
+	}
+}
+
+TEST_CASE("Constant Evaluation Cache", "[ASTContext]")
+{
+	ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+	const auto intType = context.GetBuiltinType(Type::BuiltinType::Int);
+
+	// (1 + 2) * 3
+	const auto lhs = make_ref<Expression::IntegerLiteral>(1, intType, SourceLocation{});
+	const auto sum = make_ref<Expression::BinaryOperator>(lhs, make_ref<Expression::IntegerLiteral>(2, intType, SourceLocation{}), Expression::BinaryOperationType::Add, intType, SourceLocation{}, Expression::ValueCategory::RValue);
+	const auto product = make_ref<Expression::BinaryOperator>(sum, make_ref<Expression::IntegerLiteral>(3, intType, SourceLocation{}), Expression::BinaryOperationType::Mul, intType, SourceLocation{}, Expression::ValueCategory::RValue);
+
+	nuLong value;
+	REQUIRE(product->EvaluateAsInt(value, context));
+	REQUIRE(value == 9);
+
+	SECTION("cache hit")
+	{
+		// 字面量不会被缓存，非字面量表达式的结果会被缓存
+		REQUIRE(!context.GetCachedEvalResult(lhs.Get()));
+		const auto cachedSum = context.GetCachedEvalResult(sum.Get());
+		REQUIRE(cachedSum);
+		REQUIRE(std::get<nuLong>(cachedSum->Result) == 3);
+		REQUIRE(context.GetCachedEvalResult(product.Get()));
+
+		// 未使缓存失效时修改操作数，再次求值将直接使用缓存的结果
+		lhs->SetValue(4);
+		REQUIRE(product->EvaluateAsInt(value, context));
+		REQUIRE(value == 9);
+
+		// 缓存属于 ASTContext，其他 ASTContext 不会观察到该缓存
+		ASTContext otherContext{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+		REQUIRE(!otherContext.GetCachedEvalResult(product.Get()));
+		REQUIRE(product->EvaluateAsInt(value, otherContext));
+		REQUIRE(value == 18);
+	}
+
+	SECTION("invalidation")
+	{
+		lhs->SetValue(4);
+		context.InvalidateEvalResult(sum.Get());
+		context.InvalidateEvalResult(product.Get());
+		REQUIRE(!context.GetCachedEvalResult(product.Get()));
+		REQUIRE(product->EvaluateAsInt(value, context));
+		REQUIRE(value == 18);
+		REQUIRE(std::get<nuLong>(context.GetCachedEvalResult(sum.Get())->Result) == 6);
+	}
+
+	SECTION("destroyed expression")
+	{
+		// 表达式被销毁后，即使地址被重用也不会得到旧的结果
+		auto temp = make_ref<Expression::BinaryOperator>(make_ref<Expression::IntegerLiteral>(5, intType, SourceLocation{}), make_ref<Expression::IntegerLiteral>(6, intType, SourceLocation{}), Expression::BinaryOperationType::Add, intType, SourceLocation{}, Expression::ValueCategory::RValue);
+		const auto tempAddress = temp.Get();
+		REQUIRE(temp->EvaluateAsInt(value, context));
+		REQUIRE(context.GetCachedEvalResult(tempAddress));
+		temp = nullptr;
+		REQUIRE(!context.GetCachedEvalResult(tempAddress));
+	}
+}
+
+TEST_CASE("Class Layout Stress", "[ASTContext][.][Benchmark]")
+{
+	constexpr std::size_t fieldCount = 1000;
+	constexpr std::size_t lookupRounds = 1000;
+	constexpr const char* fieldTypes[] = { "byte", "int", "short", "double" };
+
+	std::string testCode = "class Large\n{\n";
+	for (std::size_t i = 0; i < fieldCount; ++i)
+	{
+		testCode += "\tdef Field" + std::to_string(i) + " : " + fieldTypes[i % std::size(fieldTypes)] + ";\n";
+	}
+	testCode += "}\n";
+
+	Diag::DiagnosticsEngine diag{ make_ref<IDMap>(), make_ref<TestDiagConsumer>() };
+	FileManager fileManager{};
+	SourceManager sourceManager{ diag, fileManager };
+	Preprocessor pp{ diag, sourceManager };
+	pp.SetLexer(make_ref<Lex::Lexer>(0, nStrView{ testCode.data(), testCode.data() + testCode.size() }, pp));
+	ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+	const auto consumer = make_ref<TestAstConsumer>();
+	ParseAST(pp, context, consumer);
+
+	const auto classDecl = consumer->GetNamedDecl(u8"Large").Cast<Declaration::ClassDecl>();
+	REQUIRE(classDecl);
+
+	const auto fieldQuery = classDecl->GetFields();
+	const std::vector<natRefPointer<Declaration::FieldDecl>> fields(fieldQuery.begin(), fieldQuery.end());
+	REQUIRE(fields.size() == fieldCount);
+
+	const auto& layout = context.GetClassLayout(classDecl);
+	REQUIRE(&layout == &context.GetClassLayout(classDecl));
+
+	for (const auto& field : fields)
+	{
+		const auto fieldInfo = layout.GetFieldInfo(field);
+		REQUIRE(fieldInfo);
+		REQUIRE(layout.FieldOffsets[fieldInfo->first].first == field);
+		REQUIRE(layout.FieldOffsets[fieldInfo->first].second == fieldInfo->second);
+	}
+
+	std::size_t offsetSum{};
+	const auto start = std::chrono::steady_clock::now();
+	for (std::size_t round = 0; round < lookupRounds; ++round)
+	{
+		for (const auto& field : fields)
+		{
+			offsetSum += layout.GetFieldInfo(field)->second;
+		}
+	}
+	const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+	REQUIRE(offsetSum);
+	WARN("GetFieldInfo: " << static_cast<double>(elapsed.count()) / (fieldCount * lookupRounds) << " ns per lookup");
+}
@@ -0,0 +1,132 @@
+﻿#include "TestClasses.h"
+
+#include <Allocator.h>
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	NatsuLang_AllocatorStatistics GetStatistics()
+	{
+		NatsuLang_AllocatorStatistics statistics;
+		NatsuLang_GetAllocatorStatistics(&statistics);
+		return statistics;
+	}
+}
+
+TEST_CASE("Runtime Allocator", "[Runtime]")
+{
+	SECTION("alignment")
+	{
+		for (const std::size_t size : { 1, 7, 16, 17, 100, 1024, 1025, 4096 })
+		{
+			const auto ptr = NatsuLang_Allocate(size);
+			REQUIRE(ptr);
+			REQUIRE(reinterpret_cast<std::uintptr_t>(ptr) % 16 == 0);
+			NatsuLang_Deallocate(ptr, size);
+		}
+	}
+
+	SECTION("zero size")
+	{
+		const auto ptr = NatsuLang_Allocate(0);
+		REQUIRE(ptr);
+		*static_cast<unsigned char*>(ptr) = 0xFF;
+		NatsuLang_Deallocate(ptr, 0);
+
+		// 释放空指针不执行任何操作
+		NatsuLang_Deallocate(nullptr, 16);
+	}
+
+	SECTION("reuse")
+	{
+		// 同一线程中释放的块将被同一大小类的下一次分配重用
+		const auto first = NatsuLang_Allocate(24);
+		REQUIRE(first);
+		NatsuLang_Deallocate(first, 24);
+
+		const auto second = NatsuLang_Allocate(32);
+		REQUIRE(second == first);
+		NatsuLang_Deallocate(second, 32);
+	}
+
+	SECTION("statistics")
+	{
+		const auto before = GetStatistics();
+
+		const auto small = NatsuLang_Allocate(8);
+		const auto large = NatsuLang_Allocate(NatsuLang_MaxPooledSize + 1);
+		REQUIRE(small);
+		REQUIRE(large);
+
+		const auto allocated = GetStatistics();
+		REQUIRE(allocated.AllocationCount - before.AllocationCount == 2);
+		REQUIRE(allocated.LargeAllocationCount - before.LargeAllocationCount == 1);
+		REQUIRE(allocated.LiveBytes - before.LiveBytes == 16 + NatsuLang_MaxPooledSize + 1);
+		REQUIRE(allocated.PeakLiveBytes >= allocated.LiveBytes);
+
+		NatsuLang_Deallocate(large, NatsuLang_MaxPooledSize + 1);
+		NatsuLang_Deallocate(small, 8);
+
+		const auto deallocated = GetStatistics();
+		REQUIRE(deallocated.DeallocationCount - before.DeallocationCount == 2);
+		REQUIRE(deallocated.LiveBytes == before.LiveBytes);
+	}
+
+	SECTION("cross-thread deallocation")
+	{
+		std::vector<void*> blocks;
+		for (std::size_t i = 0; i < 64; ++i)
+		{
+			const auto ptr = NatsuLang_Allocate(48);
+			REQUIRE(ptr);
+			blocks.emplace_back(ptr);
+		}
+
+		std::thread{ [&blocks]
+		{
+			for (const auto ptr : blocks)
+			{
+				NatsuLang_Deallocate(ptr, 48);
+			}
+
+			// 线程退出后其空闲链表中的块可被其他线程重用
+		} }.join();
+
+		const auto ptr = NatsuLang_Allocate(48);
+		REQUIRE(ptr);
+		NatsuLang_Deallocate(ptr, 48);
+	}
+
+	SECTION("distinct blocks")
+	{
+		// 分配的数量超过一页所能容纳的块数
+		constexpr std::size_t Count = 8192;
+		constexpr std::size_t Size = 40;
+
+		std::vector<void*> blocks;
+		std::set<void*> distinctBlocks;
+		for (std::size_t i = 0; i < Count; ++i)
+		{
+			const auto ptr = NatsuLang_Allocate(Size);
+			REQUIRE(ptr);
+			std::memset(ptr, static_cast<int>(i & 0xFF), Size);
+			blocks.emplace_back(ptr);
+			distinctBlocks.emplace(ptr);
+		}
+
+		REQUIRE(distinctBlocks.size() == Count);
+
+		for (std::size_t i = 0; i < Count; ++i)
+		{
+			const auto bytes = static_cast<const unsigned char*>(blocks[i]);
+			REQUIRE(bytes[0] == (i & 0xFF));
+			REQUIRE(bytes[Size - 1] == (i & 0xFF));
+			NatsuLang_Deallocate(blocks[i], Size);
+		}
+	}
+}
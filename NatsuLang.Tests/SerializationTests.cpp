@@ -0,0 +1,463 @@
+﻿#include "TestClasses.h"
+
+#include <AST/Metadata.h>
+#include <Serialization.h>
+
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <thread>
+
+namespace
+{
+	constexpr nuLong TestIntegers[] = { 0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0xFFFFFFFF, 0x123456789ABCDEF0, std::numeric_limits<nuLong>::max() };
+
+	// 元素数量足够多以使内容跨越多个块
+	constexpr std::size_t TestElementCount = 8192;
+
+	void WriteTestArchive(nStrView path, Serialization::BinaryMetadataFlags flags, std::size_t elementCount)
+	{
+		std::remove(path.data());
+		const auto writer = make_ref<Serialization::BinarySerializationArchiveWriter>(make_ref<natBinaryWriter>(make_ref<natFileStream>(path, false, true), Environment::Endianness::LittleEndian), flags);
+		writer->StartWritingEntry(u8"Content"_nv, true);
+		for (std::size_t i = 0; i < elementCount; ++i)
+		{
+			writer->MarkIndexEntry(i % 2 ? u8"Odd"_nv : u8"Even"_nv);
+			writer->WriteInteger(u8"Value"_nv, TestIntegers[i % std::size(TestIntegers)], sizeof(nuLong));
+			writer->WriteInteger(u8"Narrow"_nv, static_cast<nuShort>(i), sizeof(nuShort));
+			writer->WriteInteger(u8"Negative"_nv, static_cast<nuLong>(-static_cast<nLong>(i)), sizeof(nInt));
+			writer->WriteFloat(u8"Float"_nv, static_cast<nDouble>(i) / 2, sizeof(nDouble));
+			writer->WriteString(u8"Name"_nv, i % 2 ? u8"Odd"_nv : u8"Even"_nv);
+			writer->StartWritingEntry(u8"Items"_nv, true);
+			for (std::size_t j = 0; j < i % 4; ++j)
+			{
+				writer->WriteInteger(u8"Item"_nv, i + j, sizeof(nuInt));
+				writer->NextWritingElement();
+			}
+			writer->EndWritingEntry();
+			writer->NextWritingElement();
+		}
+		writer->EndWritingEntry();
+		writer->FinishWriting();
+	}
+
+	natRefPointer<Serialization::BinarySerializationArchiveReader> OpenTestArchive(nStrView path, nLen offset = 0, nLen size = std::numeric_limits<nLen>::max())
+	{
+		return make_ref<Serialization::BinarySerializationArchiveReader>(make_ref<natBinaryReader>(make_ref<natFileStream>(path, true, false), Environment::Endianness::LittleEndian), offset, size);
+	}
+
+	void ReadTestElement(Serialization::BinarySerializationArchiveReader& reader, std::size_t i)
+	{
+		nuLong value;
+		REQUIRE(reader.ReadInteger(u8"Value"_nv, value, sizeof(nuLong)));
+		REQUIRE(value == TestIntegers[i % std::size(TestIntegers)]);
+		REQUIRE(reader.ReadInteger(u8"Narrow"_nv, value, sizeof(nuShort)));
+		REQUIRE(value == static_cast<nuShort>(i));
+		// 读取时不进行符号扩展
+		REQUIRE(reader.ReadInteger(u8"Negative"_nv, value, sizeof(nInt)));
+		REQUIRE(value == static_cast<nuInt>(-static_cast<nInt>(i)));
+		nDouble floatValue;
+		REQUIRE(reader.ReadFloat(u8"Float"_nv, floatValue, sizeof(nDouble)));
+		REQUIRE(floatValue == static_cast<nDouble>(i) / 2);
+		nString name;
+		REQUIRE(reader.ReadString(u8"Name"_nv, name));
+		REQUIRE(name == (i % 2 ? u8"Odd"_nv : u8"Even"_nv));
+		REQUIRE(reader.StartReadingEntry(u8"Items"_nv, true));
+		REQUIRE(reader.GetEntryElementCount() == i % 4);
+		for (std::size_t j = 0; j < i % 4; ++j)
+		{
+			REQUIRE(reader.ReadInteger(u8"Item"_nv, value, sizeof(nuInt)));
+			REQUIRE(value == i + j);
+			REQUIRE(reader.NextReadingElement());
+		}
+		reader.EndReadingEntry();
+	}
+
+	void ReadTestArchive(Serialization::BinarySerializationArchiveReader& reader, std::size_t elementCount)
+	{
+		REQUIRE(reader.StartReadingEntry(u8"Content"_nv, true));
+		REQUIRE(reader.GetEntryElementCount() == elementCount);
+		for (std::size_t i = 0; i < elementCount; ++i)
+		{
+			ReadTestElement(reader, i);
+			REQUIRE(reader.NextReadingElement());
+		}
+		reader.EndReadingEntry();
+
+		std::size_t oddCount{};
+		const auto hasOdd = reader.ReadIndexedEntry(u8"Odd"_nv, [&]
+		{
+			nuLong value;
+			REQUIRE(reader.ReadInteger(u8"Value"_nv, value, sizeof(nuLong)));
+			REQUIRE(reader.ReadInteger(u8"Narrow"_nv, value, sizeof(nuShort)));
+			REQUIRE(value % 2 == 1);
+			++oddCount;
+		});
+		REQUIRE(hasOdd == (elementCount > 1));
+		REQUIRE(oddCount == elementCount / 2);
+		REQUIRE(!reader.ReadIndexedEntry(u8"None"_nv, [] {}));
+	}
+}
+
+TEST_CASE("Metadata Encoding Round Trip", "[Serialization]")
+{
+	constexpr Serialization::BinaryMetadataFlags flagCombinations[] = {
+		Serialization::BinaryMetadataFlags::None,
+		Serialization::BinaryMetadataFlags::CompactIntegers,
+		Serialization::BinaryMetadataFlags::Compressed,
+		Serialization::BinaryMetadataFlags::CompactIntegers | Serialization::BinaryMetadataFlags::Compressed
+	};
+
+	const auto path = u8"EncodingTest.meta"_nv;
+	const auto scope = make_scope([path]
+	{
+		std::remove(path.data());
+	});
+
+	std::vector<nLen> sizes;
+	for (const auto flags : flagCombinations)
+	{
+		CAPTURE(static_cast<nuShort>(flags));
+		WriteTestArchive(path, flags, TestElementCount);
+		sizes.emplace_back(make_ref<natFileStream>(path, true, false)->GetSize());
+
+		ReadTestArchive(*OpenTestArchive(path), TestElementCount);
+
+		const auto preloadedReader = OpenTestArchive(path);
+		preloadedReader->Preload();
+		ReadTestArchive(*preloadedReader, TestElementCount);
+
+		// 空的元数据同样可以读取
+		WriteTestArchive(path, flags, 0);
+		ReadTestArchive(*OpenTestArchive(path), 0);
+	}
+
+	// 压缩是否生效取决于 zlib 是否可用，但变长编码的结果总是更小
+	REQUIRE(sizes[1] < sizes[0]);
+}
+
+TEST_CASE("Metadata Parallel Preload", "[Serialization]")
+{
+	constexpr std::size_t archiveCount = 8;
+
+	std::vector<std::string> paths;
+	const auto scope = make_scope([&paths]
+	{
+		for (const auto& path : paths)
+		{
+			std::remove(path.c_str());
+		}
+	});
+
+	for (std::size_t i = 0; i < archiveCount; ++i)
+	{
+		paths.emplace_back("ParallelTest" + std::to_string(i) + ".meta");
+		const auto flags = i % 2 ? Serialization::BinaryMetadataFlags::CompactIntegers | Serialization::BinaryMetadataFlags::Compressed : Serialization::BinaryMetadataFlags::Compressed;
+		WriteTestArchive(nStrView{ paths.back().data(), paths.back().data() + paths.back().size() }, flags, TestElementCount + i);
+	}
+
+	// 各读取器拥有独立的流，Preload 不访问其他共享状态，因此可以同时在多个线程中调用
+	std::vector<natRefPointer<Serialization::BinarySerializationArchiveReader>> readers;
+	for (const auto& path : paths)
+	{
+		readers.emplace_back(OpenTestArchive(nStrView{ path.data(), path.data() + path.size() }));
+	}
+
+	std::vector<std::exception_ptr> exceptions(archiveCount);
+	std::vector<std::thread> threads;
+	for (std::size_t i = 0; i < archiveCount; ++i)
+	{
+		threads.emplace_back([&, i]
+		{
+			try
+			{
+				readers[i]->Preload();
+			}
+			catch (...)
+			{
+				exceptions[i] = std::current_exception();
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	for (std::size_t i = 0; i < archiveCount; ++i)
+	{
+		CAPTURE(i);
+		REQUIRE(!exceptions[i]);
+		ReadTestArchive(*readers[i], TestElementCount + i);
+	}
+}
+
+TEST_CASE("Metadata Bundle Round Trip", "[Serialization]")
+{
+	const auto libraryPath = u8"BundleLibrary.meta"_nv;
+	const auto archivePath = u8"BundleArchive.meta"_nv;
+	const auto bundlePath = u8"Bundle.meta"_nv;
+	const auto nestedBundlePath = u8"NestedBundle.meta"_nv;
+	const auto scope = make_scope([=]
+	{
+		std::remove(libraryPath.data());
+		std::remove(archivePath.data());
+		std::remove(bundlePath.data());
+		std::remove(nestedBundlePath.data());
+	});
+
+	{
+		constexpr char libraryCode[] =
+			u8R"(
+def Increase : (arg : int = 1) -> int
+{
+	return 1 + arg;
+}
+)";
+
+		Diag::DiagnosticsEngine diag{ make_ref<IDMap>(), make_ref<TestDiagConsumer>() };
+		FileManager fileManager{};
+		SourceManager sourceManager{ diag, fileManager };
+		Preprocessor pp{ diag, sourceManager };
+		pp.SetLexer(make_ref<Lex::Lexer>(0, libraryCode, pp));
+		ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+		const auto consumer = make_ref<TestAstConsumer>();
+
+		Semantic::Sema sema{ pp, context, consumer };
+		Syntax::Parser parser{ pp, sema };
+
+		ParseAST(parser);
+		EndParsingAST(parser);
+		parser.ResolveAllFunctionBodies();
+
+		const Declaration::DeclPtr incFunc = consumer->GetNamedDecl(u8"Increase");
+		REQUIRE(incFunc);
+
+		std::remove(libraryPath.data());
+		Serialization::Serializer serializer{ sema };
+		serializer.StartSerialize(make_ref<Serialization::BinarySerializationArchiveWriter>(
+			make_ref<natBinaryWriter>(make_ref<natFileStream>(libraryPath, false, true), Environment::Endianness::LittleEndian),
+			Serialization::BinaryMetadataFlags::CompactIntegers | Serialization::BinaryMetadataFlags::Compressed));
+		serializer.Visit(incFunc);
+		serializer.EndSerialize();
+	}
+
+	WriteTestArchive(archivePath, Serialization::BinaryMetadataFlags::Compressed, TestElementCount);
+
+	{
+		std::remove(bundlePath.data());
+		Serialization::BinaryMetadataBundleWriter bundle{ make_ref<natFileStream>(bundlePath, false, true) };
+		REQUIRE(bundle.AddMetadata(*make_ref<natFileStream>(libraryPath, true, false)) == 1);
+		REQUIRE(bundle.AddMetadata(*make_ref<natFileStream>(archivePath, true, false)) == 1);
+		// 内容相同的元数据只保留一份
+		REQUIRE(bundle.AddMetadata(*make_ref<natFileStream>(libraryPath, true, false)) == 0);
+		bundle.FinishWriting();
+	}
+
+	{
+		// 添加元数据包时将展开其成员，同样会跳过重复的成员
+		std::remove(nestedBundlePath.data());
+		Serialization::BinaryMetadataBundleWriter bundle{ make_ref<natFileStream>(nestedBundlePath, false, true) };
+		REQUIRE(bundle.AddMetadata(*make_ref<natFileStream>(archivePath, true, false)) == 1);
+		REQUIRE(bundle.AddMetadata(*make_ref<natFileStream>(bundlePath, true, false)) == 1);
+		bundle.FinishWriting();
+	}
+
+	REQUIRE(!Serialization::ReadBinaryMetadataBundle(*make_ref<natFileStream>(archivePath, true, false)));
+
+	const auto nestedMembers = Serialization::ReadBinaryMetadataBundle(*make_ref<natFileStream>(nestedBundlePath, true, false));
+	REQUIRE(nestedMembers);
+	REQUIRE(nestedMembers->size() == 2);
+	ReadTestArchive(*OpenTestArchive(nestedBundlePath, (*nestedMembers)[0].Offset, (*nestedMembers)[0].Size), TestElementCount);
+
+	const auto members = Serialization::ReadBinaryMetadataBundle(*make_ref<natFileStream>(bundlePath, true, false));
+	REQUIRE(members);
+	REQUIRE(members->size() == 2);
+	REQUIRE((*members)[0].Size == make_ref<natFileStream>(libraryPath, true, false)->GetSize());
+	REQUIRE((*members)[1].Size == make_ref<natFileStream>(archivePath, true, false)->GetSize());
+
+	{
+		const auto reader = OpenTestArchive(bundlePath, (*members)[1].Offset, (*members)[1].Size);
+		reader->Preload();
+		ReadTestArchive(*reader, TestElementCount);
+	}
+
+	SECTION("import declarations from the bundle")
+	{
+		constexpr char testCode[] =
+			u8R"(
+def Use : () -> int
+{
+	return Increase(2);
+}
+)";
+
+		Diag::DiagnosticsEngine diag{ make_ref<IDMap>(), make_ref<TestDiagConsumer>() };
+		FileManager fileManager{};
+		SourceManager sourceManager{ diag, fileManager };
+		Preprocessor pp{ diag, sourceManager };
+		pp.SetLexer(make_ref<Lex::Lexer>(0, testCode, pp));
+		ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+		const auto consumer = make_ref<TestAstConsumer>();
+
+		Semantic::Sema sema{ pp, context, consumer };
+		Syntax::Parser parser{ pp, sema };
+
+		Serialization::Deserializer deserializer{ parser };
+		const auto size = deserializer.StartDeserialize(OpenTestArchive(bundlePath, (*members)[0].Offset, (*members)[0].Size));
+		REQUIRE(size == 1);
+		std::vector<ASTNodePtr> ast;
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			ast.emplace_back(deserializer.Deserialize());
+		}
+		deserializer.EndDeserialize();
+		deserializer.Finish();
+
+		Metadata metadata;
+		metadata.AddDecls(ast);
+		sema.LoadMetadata(metadata);
+
+		ParseAST(parser);
+		EndParsingAST(parser);
+		parser.ResolveAllFunctionBodies();
+
+		const auto incFunc = consumer->GetNamedDecl(u8"Increase").Cast<Declaration::FunctionDecl>();
+		REQUIRE(incFunc);
+		REQUIRE(incFunc->GetParamCount() == 1);
+		const auto defaultValue = incFunc->GetParams().first()->GetInitializer();
+		REQUIRE(defaultValue);
+		nuLong value;
+		REQUIRE(defaultValue->EvaluateAsInt(value, context));
+		REQUIRE(value == 1);
+		REQUIRE(incFunc->GetBody());
+
+		const auto useFunc = consumer->GetNamedDecl(u8"Use").Cast<Declaration::FunctionDecl>();
+		REQUIRE(useFunc);
+		const auto body = useFunc->GetBody().Cast<Statement::CompoundStmt>();
+		REQUIRE(body);
+		auto content{ body->GetChildrenStmt().Cast<std::vector<Statement::StmtPtr>>() };
+		REQUIRE(content.size() == 1);
+		const auto retStmt = content[0].Cast<Statement::ReturnStmt>();
+		REQUIRE(retStmt);
+		const auto callExpr = retStmt->GetReturnExpr().Cast<Expression::CallExpr>();
+		REQUIRE(callExpr);
+		REQUIRE(callExpr->GetArgCount() == 1);
+	}
+}
+
+TEST_CASE("Metadata Declaration Round Trip", "[Serialization]")
+{
+	// 默认的定宽编码下，声明的 Id 等字段的读写宽度必须一致，否则之后的内容都将错位
+	constexpr Serialization::BinaryMetadataFlags flagCombinations[] = {
+		Serialization::BinaryMetadataFlags::None,
+		Serialization::BinaryMetadataFlags::CompactIntegers,
+		Serialization::BinaryMetadataFlags::Compressed,
+		Serialization::BinaryMetadataFlags::CompactIntegers | Serialization::BinaryMetadataFlags::Compressed
+	};
+
+	constexpr char libraryCode[] =
+		u8R"(
+class Point
+{
+	def X : int;
+	def Y : int;
+}
+
+enum Color { Red, Green, Blue }
+
+def Length : (point : Point, color : Color) -> int
+{
+	return point.X + point.Y;
+}
+)";
+
+	const auto path = u8"DeclarationRoundTrip.meta"_nv;
+	const auto scope = make_scope([path]
+	{
+		std::remove(path.data());
+	});
+
+	for (const auto flags : flagCombinations)
+	{
+		CAPTURE(static_cast<nuShort>(flags));
+
+		{
+			Diag::DiagnosticsEngine diag{ make_ref<IDMap>(), make_ref<TestDiagConsumer>() };
+			FileManager fileManager{};
+			SourceManager sourceManager{ diag, fileManager };
+			Preprocessor pp{ diag, sourceManager };
+			pp.SetLexer(make_ref<Lex::Lexer>(0, libraryCode, pp));
+			ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+			const auto consumer = make_ref<TestAstConsumer>();
+
+			Semantic::Sema sema{ pp, context, consumer };
+			Syntax::Parser parser{ pp, sema };
+
+			ParseAST(parser);
+			EndParsingAST(parser);
+			parser.ResolveAllFunctionBodies();
+
+			std::remove(path.data());
+			Serialization::Serializer serializer{ sema };
+			serializer.StartSerialize(make_ref<Serialization::BinarySerializationArchiveWriter>(
+				make_ref<natBinaryWriter>(make_ref<natFileStream>(path, false, true), Environment::Endianness::LittleEndian), flags));
+			for (const auto name : { u8"Point"_nv, u8"Color"_nv, u8"Length"_nv })
+			{
+				const Declaration::DeclPtr decl = consumer->GetNamedDecl(name);
+				REQUIRE(decl);
+				serializer.Visit(decl);
+			}
+			serializer.EndSerialize();
+		}
+
+		Diag::DiagnosticsEngine diag{ make_ref<IDMap>(), make_ref<TestDiagConsumer>() };
+		FileManager fileManager{};
+		SourceManager sourceManager{ diag, fileManager };
+		Preprocessor pp{ diag, sourceManager };
+		pp.SetLexer(make_ref<Lex::Lexer>(0, u8""_nv, pp));
+		ASTContext context{ TargetInfo{ Environment::GetEndianness(), sizeof(void*), alignof(void*) } };
+		const auto consumer = make_ref<TestAstConsumer>();
+
+		Semantic::Sema sema{ pp, context, consumer };
+		Syntax::Parser parser{ pp, sema };
+
+		Serialization::Deserializer deserializer{ parser };
+		const auto size = deserializer.StartDeserialize(OpenTestArchive(path));
+		REQUIRE(size == 3);
+		std::vector<ASTNodePtr> ast;
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			ast.emplace_back(deserializer.Deserialize());
+		}
+		deserializer.EndDeserialize();
+		deserializer.Finish();
+
+		Metadata metadata;
+		metadata.AddDecls(ast);
+		sema.LoadMetadata(metadata);
+
+		const auto pointDecl = consumer->GetNamedDecl(u8"Point"_nv).Cast<Declaration::ClassDecl>();
+		REQUIRE(pointDecl);
+		REQUIRE(pointDecl->GetFields().Cast<std::vector<natRefPointer<Declaration::FieldDecl>>>().size() == 2);
+
+		const auto colorDecl = consumer->GetNamedDecl(u8"Color"_nv).Cast<Declaration::EnumDecl>();
+		REQUIRE(colorDecl);
+		REQUIRE(colorDecl->GetEnumerators().Cast<std::vector<natRefPointer<Declaration::EnumConstantDecl>>>().size() == 3);
+
+		const auto lengthDecl = consumer->GetNamedDecl(u8"Length"_nv).Cast<Declaration::FunctionDecl>();
+		REQUIRE(lengthDecl);
+		REQUIRE(lengthDecl->GetParamCount() == 2);
+		REQUIRE(lengthDecl->GetBody());
+
+		// 参数类型引用的声明由 TagDeclId 解析为同一元数据中的声明
+		const auto params = lengthDecl->GetParams().Cast<std::vector<natRefPointer<Declaration::ParmVarDecl>>>();
+		const auto pointType = Type::Type::GetUnderlyingType(params[0]->GetValueType()).Cast<Type::ClassType>();
+		REQUIRE(pointType);
+		REQUIRE(pointType->GetDecl() == pointDecl);
+		const auto colorType = Type::Type::GetUnderlyingType(params[1]->GetValueType()).Cast<Type::EnumType>();
+		REQUIRE(colorType);
+		REQUIRE(colorType->GetDecl() == colorDecl);
+	}
+}
@@ -45,6 +45,8 @@ public:
 	{
 		if (level >= Diag::DiagnosticsEngine::Level::Error)
 		{
+			++m_ErrorCount;
+			m_ErrorLocations.emplace_back(diag.GetSourceRange().GetBegin());
 			INFO(diag.GetDiagMessage().data());
 		}
 		else if (level == Diag::DiagnosticsEngine::Level::Warning)
@@ -56,6 +58,20 @@ public:
 			INFO(diag.GetDiagMessage().data());
 		}
 	}
+
+	std::size_t GetErrorCount() const noexcept
+	{
+		return m_ErrorCount;
+	}
+
+	std::vector<SourceLocation> const& GetErrorLocations() const noexcept
+	{
+		return m_ErrorLocations;
+	}
+
+private:
+	std::size_t m_ErrorCount{};
+	std::vector<SourceLocation> m_ErrorLocations;
 };
 
 class TestAstConsumer
@@ -2,12 +2,37 @@
 #include <unordered_set>
 #include <unordered_map>
 #include "Declaration.h"
+#include "Expression.h"
 #include "Type.h"
 #include "NestedNameSpecifier.h"
 #include "Basic/TargetInfo.h"
 
 namespace NatsuLang
 {
+	///	@brief	类的布局策略
+	enum class ClassLayoutPolicy
+	{
+		Declared,	///< @brief	按声明顺序排列字段，按需插入 padding
+		Optimal,	///< @brief	按对齐由大到小重排字段以减少 padding
+		Packed,		///< @brief	按声明顺序紧密排列字段，不插入 padding，类的对齐为 1
+	};
+
+	///	@brief	为类指定布局策略的属性，由 $Compiler.Layout 附加
+	class ClassLayoutAttribute
+		: public NatsuLib::natRefObjImpl<ClassLayoutAttribute, Declaration::IAttribute>
+	{
+	public:
+		explicit ClassLayoutAttribute(ClassLayoutPolicy policy) noexcept;
+		~ClassLayoutAttribute();
+
+		nStrView GetName() const noexcept override;
+
+		ClassLayoutPolicy GetPolicy() const noexcept;
+
+	private:
+		ClassLayoutPolicy m_Policy;
+	};
+
 	class ASTContext
 		: public NatsuLib::natRefObjImpl<ASTContext>
 	{
@@ -22,8 +47,11 @@ namespace NatsuLang
 		{
 			std::size_t Size;
 			std::size_t Align;
+			ClassLayoutPolicy Policy;
 			// 若 first 是 null 则表示的是 padding
 			std::vector<std::pair<NatsuLib::natRefPointer<Declaration::FieldDecl>, std::size_t>> FieldOffsets;
+			// 字段在 FieldOffsets 中的索引，由 ASTContext 在构建布局后填充，布局构建器无需处理
+			std::unordered_map<NatsuLib::natRefPointer<Declaration::FieldDecl>, std::size_t> FieldIndices;
 
 			// 返回值：字段索引，字段偏移
 			std::optional<std::pair<std::size_t, std::size_t>> GetFieldInfo(NatsuLib::natRefPointer<Declaration::FieldDecl> const& field) const noexcept;
@@ -67,10 +95,20 @@ namespace NatsuLang
 		///	@remark	由使用者保证 type 已经经过 Type::GetUnderlyingType
 		TypeInfo GetTypeInfo(Type::TypePtr const& type);
 
-		void UseDefaultClassLayoutBuilder();
+		///	@brief	使用默认的类布局构建器
+		///	@param	defaultPolicy	未通过 ClassLayoutAttribute 指定布局策略的类所使用的策略
+		void UseDefaultClassLayoutBuilder(ClassLayoutPolicy defaultPolicy = ClassLayoutPolicy::Declared);
 		void UseCustomClassLayoutBuilder(NatsuLib::natRefPointer<IClassLayoutBuilder> classLayoutBuilder);
 		ClassLayout const& GetClassLayout(NatsuLib::natRefPointer<Declaration::ClassDecl> const& classDecl);
 
+		///	@brief	获得表达式的常量求值缓存
+		///	@remark	仅缓存成功求值且无副作用的结果，表达式被销毁后其缓存随之失效
+		///	@return	不存在缓存时返回 nullptr
+		Expression::Expr::EvalResult const* GetCachedEvalResult(Expression::Expr const* expr) const noexcept;
+		void CacheEvalResult(NatsuLib::natRefPointer<Expression::Expr> const& expr, Expression::Expr::EvalResult const& result);
+		///	@brief	使表达式的求值缓存失效，修改已被求值的表达式后需要调用
+		void InvalidateEvalResult(Expression::Expr const* expr) noexcept;
+
 	private:
 		NatsuLib::UncheckedLazyInit<TargetInfo> m_TargetInfo;
 
@@ -94,6 +132,15 @@ namespace NatsuLang
 		std::unordered_map<Type::BuiltinType::BuiltinClass, NatsuLib::natRefPointer<Type::BuiltinType>> m_BuiltinTypeMap;
 		NatsuLib::natRefPointer<Type::BuiltinType> m_SizeType, m_PtrDiffType;
 
+		// 以弱引用确认表达式仍然存活，避免地址被重用的表达式得到已销毁的表达式的结果
+		struct CachedEvalResult
+		{
+			NatsuLib::natWeakRefPointer<Expression::Expr> Target;
+			Expression::Expr::EvalResult Result;
+		};
+
+		std::unordered_map<Expression::Expr const*, CachedEvalResult> m_CachedEvalResults;
+
 		TypeInfo getTypeInfoImpl(Type::TypePtr const& type);
 	};
 }
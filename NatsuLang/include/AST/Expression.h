@@ -2,7 +2,9 @@
 #include "Declaration.h"
 #include "Statement.h"
 #include "OperationTypes.h"
+#include "Basic/NumericTypes.h"
 #include <variant>
+#include <optional>
 
 namespace NatsuLang
 {
@@ -55,7 +57,8 @@ namespace NatsuLang::Expression
 		{
 			nBool HasSideEffects = false;
 			nBool HasUndefinedBehavior = false;
-			std::variant<nuLong, nDouble> Result;
+			// 0 与 1 分别用于 64 位以内的整数及浮点数，2 与 3 分别用于 128 位整数及扩展精度浮点数
+			std::variant<nuLong, nDouble, nuWideInteger, nWideFloat> Result;
 
 			nBool GetResultAsSignedInteger(nLong& result) const noexcept;
 			nBool GetResultAsBoolean(nBool& result) const noexcept;
@@ -63,6 +66,8 @@ namespace NatsuLang::Expression
 
 		nBool Evaluate(EvalResult& result, ASTContext& context);
 		nBool EvaluateAsInt(nuLong& result, ASTContext& context);
+		///	@brief	以 128 位整数求值，有符号类型的结果将被符号扩展，不会截断 128 位整数的值
+		nBool EvaluateAsWideInt(nuWideInteger& result, ASTContext& context);
 		nBool EvaluateAsFloat(nDouble& result, ASTContext& context);
 
 	private:
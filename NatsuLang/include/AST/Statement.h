@@ -111,13 +111,23 @@ namespace NatsuLang::Statement
 		: public Stmt
 	{
 	public:
-		explicit SwitchStmt(Expression::ExprPtr cond)
-			: Stmt{ SwitchStmtClass }, m_Cond{ std::move(cond) }
+		SwitchStmt(SourceLocation loc, Expression::ExprPtr cond)
+			: Stmt{ SwitchStmtClass, loc, loc }, m_Cond{ std::move(cond) }
 		{
 		}
 
 		~SwitchStmt();
 
+		Expression::ExprPtr GetCond() const noexcept
+		{
+			return m_Cond;
+		}
+
+		void SetCond(Expression::ExprPtr value) noexcept
+		{
+			m_Cond = std::move(value);
+		}
+
 		StmtPtr GetBody() const noexcept
 		{
 			return m_Body;
@@ -185,6 +195,8 @@ namespace NatsuLang::Statement
 			m_SubStmt = std::move(stmt);
 		}
 
+		StmtEnumerable GetChildrenStmt() override;
+
 	private:
 		Expression::ExprPtr m_Expr;
 		StmtPtr m_SubStmt;
@@ -211,6 +223,8 @@ namespace NatsuLang::Statement
 			m_SubStmt = std::move(stmt);
 		}
 
+		StmtEnumerable GetChildrenStmt() override;
+
 	private:
 		StmtPtr m_SubStmt;
 	};
@@ -553,8 +567,25 @@ namespace NatsuLang::Statement
 		TryStmt(SourceLocation loc, StmtPtr tryBlock, NatsuLib::Linq<NatsuLib::Valued<StmtPtr>> const& handlers);
 		~TryStmt();
 
-	private:
+		StmtPtr GetTryBlock() const noexcept
+		{
+			return m_TryBlock;
+		}
+
+		void SetTryBlock(StmtPtr value) noexcept
+		{
+			m_TryBlock = std::move(value);
+		}
 
+		///	@brief	获得按声明顺序排列的异常处理器，每一项均为 CatchStmt
+		StmtEnumerable GetHandlers();
+		void SetHandlers(StmtEnumerable const& handlers);
+
+		StmtEnumerable GetChildrenStmt() override;
+
+	private:
+		StmtPtr m_TryBlock;
+		std::vector<StmtPtr> m_Handlers;
 	};
 
 	class CatchStmt
@@ -588,6 +619,8 @@ namespace NatsuLang::Statement
 			m_HandlerBlock = std::move(value);
 		}
 
+		StmtEnumerable GetChildrenStmt() override;
+
 	private:
 		NatsuLib::natRefPointer<Declaration::VarDecl> m_ExceptionDecl;
 		StmtPtr m_HandlerBlock;
@@ -18,6 +18,8 @@ DIAG(ErrDuplicateDeclaration, Level::Error, 1)
 DIAG(ErrExpressionCannotEvaluateAsConstant, Level::Error, 0)
 DIAG(ErrConvertFromToNeedExplicitAs, Level::Error, 2)
 DIAG(ErrInvalidConvertFromTo, Level::Error, 2)
+DIAG(ErrJumpBypassesInitialization, Level::Error, 1)
+DIAG(ErrThrowOperandHasDestructor, Level::Error, 1)
 
 DIAG(WarnOverflowed, Level::Warning, 0)
 
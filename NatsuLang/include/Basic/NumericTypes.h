@@ -0,0 +1,28 @@
+﻿#pragma once
+#include <natType.h>
+
+namespace NatsuLang
+{
+	// 128 位整数与扩展精度浮点数，供常量求值器与解释器使用
+	// 若编译器不支持 __int128（如 MSVC），128 位整数将退化为 64 位整数，此时运算结果仍会被截断
+#ifdef __SIZEOF_INT128__
+	typedef __int128 nInt128;
+	typedef unsigned __int128 nuInt128;
+#else
+	typedef nLong nInt128;
+	typedef nuLong nuInt128;
+#endif
+
+	typedef long double nLongDouble;
+
+	// 若编译器不支持 __float128，Float128 将退化为 long double
+#ifdef __SIZEOF_FLOAT128__
+	typedef __float128 nFloat128;
+#else
+	typedef long double nFloat128;
+#endif
+
+	// 常量求值器中使用的最宽的整数及浮点数类型
+	typedef nuInt128 nuWideInteger;
+	typedef nFloat128 nWideFloat;
+}
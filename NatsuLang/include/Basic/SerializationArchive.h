@@ -2,6 +2,7 @@
 #include <natRefObj.h>
 #include <natString.h>
 #include "SourceLocation.h"
+#include <functional>
 
 namespace NatsuLang
 {
@@ -40,6 +41,12 @@ namespace NatsuLang
 		virtual nBool NextReadingElement() = 0;
 		virtual std::size_t GetEntryElementCount() = 0;
 		virtual void EndReadingEntry() = 0;
+
+		// 随机访问，若存档包含名为 name 的索引项，则依次以各索引项对应的元素为当前元素调用 callback，完成后恢复原先的读取位置
+		// 不支持索引的存档可不覆盖此方法
+		virtual nBool ReadIndexedEntry(nStrView name, std::function<void()> const& callback);
+		// 以各索引项的名称调用 callback，同名的索引项仅调用一次，不支持索引的存档可不覆盖此方法
+		virtual nBool EnumerateIndexedNames(std::function<void(nStrView)> const& callback);
 	};
 
 	struct ISerializationArchiveWriter
@@ -70,5 +77,10 @@ namespace NatsuLang
 		virtual void StartWritingEntry(nStrView key, nBool isArray = false) = 0;
 		virtual void NextWritingElement() = 0;
 		virtual void EndWritingEntry() = 0;
+
+		// 为接下来写入的元素添加名为 name 的索引项，不支持索引的存档可不覆盖此方法
+		virtual void MarkIndexEntry(nStrView name);
+		// 完成写入，存档可在此写出索引等额外的信息
+		virtual void FinishWriting();
 	};
 }
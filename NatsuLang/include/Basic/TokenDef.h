@@ -74,6 +74,9 @@ KEYWORD(if)
 KEYWORD(else)
 KEYWORD(for)
 KEYWORD(while)
+KEYWORD(switch)
+KEYWORD(case)
+KEYWORD(default)
 KEYWORD(alias)
 KEYWORD(def)
 KEYWORD(auto)
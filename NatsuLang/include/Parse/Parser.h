@@ -4,6 +4,7 @@
 #include "Basic/Config.h"
 #include "Sema/Declarator.h"
 #include <unordered_set>
+#include <unordered_map>
 #include "Sema/CompilerAction.h"
 
 namespace NatsuLang
@@ -150,6 +151,12 @@ namespace NatsuLang::Syntax
 			return m_CurrentToken;
 		}
 
+		// 仅在临时切换词法分析器后恢复状态时使用，不应该在其他地方使用
+		void SetCurrentToken(Lex::Token token) noexcept
+		{
+			m_CurrentToken = std::move(token);
+		}
+
 		void ConsumeParen()
 		{
 			assert(IsParen(m_CurrentToken.GetType()));
@@ -261,11 +268,17 @@ namespace NatsuLang::Syntax
 		Statement::StmtPtr ParseIfStatement();
 		Statement::StmtPtr ParseWhileStatement();
 		Statement::StmtPtr ParseForStatement();
+		Statement::StmtPtr ParseSwitchStatement();
+		Statement::StmtPtr ParseCaseStatement();
+		Statement::StmtPtr ParseDefaultStatement();
 
 		Statement::StmtPtr ParseContinueStatement();
 		Statement::StmtPtr ParseBreakStatement();
 		Statement::StmtPtr ParseReturnStatement();
 
+		Statement::StmtPtr ParseTryStatement();
+		Statement::StmtPtr ParseCatchStatement();
+
 		Statement::StmtPtr ParseExprStatement(nBool mayBeExpr = false);
 
 		Expression::ExprPtr ParseExpression();
@@ -333,6 +346,16 @@ namespace NatsuLang::Syntax
 
 		Declaration::DeclPtr ResolveDeclarator(const Declaration::DeclaratorPtr& decl);
 
+		///	@brief	解析被延迟分析的函数体
+		///	@param	funcDecl	要解析函数体的函数声明
+		///	@return	函数体是否可用，若该函数不存在被延迟的函数体则仅检查其是否已有函数体
+		nBool ResolveFunctionBody(Declaration::DeclPtr const& funcDecl);
+
+		///	@brief	解析所有被延迟分析的函数体，用于需要完整检查的场合
+		void ResolveAllFunctionBodies();
+
+		nBool HasPendingFunctionBody(Declaration::DeclPtr const& funcDecl) const noexcept;
+
 	private:
 		Preprocessor& m_Preprocessor;
 		Diag::DiagnosticsEngine& m_Diag;
@@ -354,6 +377,17 @@ namespace NatsuLang::Syntax
 
 		std::vector<CachedCompilerAction> m_CachedCompilerActions;
 
+		// 2 阶段中非局部函数的函数体将只进行括号匹配并缓存 Token，直到首次被需要时才进行分析
+		struct CachedFunctionBody
+		{
+			NatsuLib::natRefPointer<Semantic::Scope> Scope;
+			Declaration::DeclPtr DeclContext;
+			nBool InUnsafeScope;
+			std::vector<Lex::Token> Tokens;
+		};
+
+		std::unordered_map<Declaration::DeclPtr, CachedFunctionBody> m_CachedFunctionBodies;
+
 		void pushCachedTokens(std::vector<Lex::Token> tokens);
 		void popCachedTokens();
 
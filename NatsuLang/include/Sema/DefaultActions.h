@@ -272,4 +272,36 @@ namespace NatsuLang
 			Expression::ExprPtr Ptr;
 		};
 	};
+
+	// $Compiler.Layout(Declared | Optimal | Packed) class-declaration
+	class ActionLayout
+		: public NatsuLib::natRefObjImpl<ActionLayout, ICompilerAction>
+	{
+	public:
+		ActionLayout();
+		~ActionLayout();
+
+		nStrView GetName() const noexcept override;
+
+		NatsuLib::natRefPointer<IActionContext> StartAction(CompilerActionContext const& context) override;
+		void EndAction(NatsuLib::natRefPointer<IActionContext> const& context, std::function<nBool(NatsuLib::natRefPointer<ASTNode>)> const& output) override;
+
+	private:
+		struct ActionLayoutContext
+			: natRefObjImpl<ActionLayoutContext, IActionContext>
+		{
+			ActionLayoutContext();
+			~ActionLayoutContext();
+
+			NatsuLib::natRefPointer<IArgumentRequirement> GetArgumentRequirement() override;
+			void AddArgument(NatsuLib::natRefPointer<ASTNode> const& arg) override;
+
+			Diag::DiagnosticsEngine* Diag;
+			nBool AssignedPolicy;
+			// 匹配参数期间诊断被禁用，参数的错误在 EndAction 中报告
+			NatsuLib::natRefPointer<Declaration::UnresolvedDecl> PolicyId;
+			std::optional<ClassLayoutPolicy> Policy;
+			Declaration::DeclPtr Decl;
+		};
+	};
 }
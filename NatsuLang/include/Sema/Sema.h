@@ -114,6 +114,21 @@ namespace NatsuLang
 		virtual nString GetQualifiedName(NatsuLib::natRefPointer<Declaration::NamedDecl> const& namedDecl) = 0;
 		virtual nString GetTypeName(Type::TypePtr const& type) = 0;
 	};
+
+	///	@brief	外部声明来源，用于在名称查找到达翻译单元时按需加载声明
+	///	@remark	加载的声明应通过 Sema::LoadMetadata 加入翻译单元，对同一名称的重复请求应被忽略
+	struct IExternalDeclSource
+		: NatsuLib::natRefObj
+	{
+		~IExternalDeclSource();
+
+		///	@brief	加载具有指定名称的所有顶层声明
+		///	@param	id	要加载的声明的名称
+		virtual void LoadDecls(Identifier::IdPtr const& id) = 0;
+
+		///	@brief	加载所有尚未加载的顶层声明，用于代码补全或导出完整元数据等需要全部声明的场合
+		virtual void LoadAllDecls() = 0;
+	};
 }
 
 namespace NatsuLang::Semantic
@@ -241,6 +256,11 @@ namespace NatsuLang::Semantic
 
 		Metadata CreateMetadata(nBool includeImported = false) const;
 		void LoadMetadata(Metadata const& metadata, nBool feedAstConsumer = true);
+
+		///	@brief	添加外部声明来源，其中的声明将在首次被查找时才加载
+		void AddExternalDeclSource(NatsuLib::natRefPointer<IExternalDeclSource> source);
+		///	@brief	从所有外部声明来源加载全部剩余的声明
+		void LoadAllExternalDecls() const;
 		void MarkAsImported(Declaration::DeclPtr const& decl) const;
 		void UnmarkImported(Declaration::DeclPtr const& decl) const;
 		nBool IsImported(Declaration::DeclPtr const& decl) const;
@@ -349,7 +369,7 @@ namespace NatsuLang::Semantic
 			Identifier::IdPtr asId = nullptr);
 		NatsuLib::natRefPointer<Declaration::UnresolvedDecl> ActOnUnresolvedDeclarator(
 			NatsuLib::natRefPointer<Scope> const& scope, Declaration::DeclaratorPtr decl, Declaration::DeclContext* dc);
-		NatsuLib::natRefPointer<Declaration::UnresolvedDecl> ActOnCompilerActionIdentifierArgument(Identifier::IdPtr id);
+		NatsuLib::natRefPointer<Declaration::UnresolvedDecl> ActOnCompilerActionIdentifierArgument(Identifier::IdPtr id, SourceLocation loc = {});
 		void RemoveOldUnresolvedDecl(const Declaration::DeclaratorPtr& decl,
 		                             Declaration::DeclPtr const& oldUnresolvedDeclPtr);
 		NatsuLib::natRefPointer<Declaration::NamedDecl> HandleDeclarator(NatsuLib::natRefPointer<Scope> scope,
@@ -371,6 +391,12 @@ namespace NatsuLang::Semantic
 		Statement::StmtPtr ActOnIfStmt(SourceLocation ifLoc, Expression::ExprPtr condExpr, Statement::StmtPtr thenStmt,
 		                               SourceLocation elseLoc, Statement::StmtPtr elseStmt);
 		Statement::StmtPtr ActOnWhileStmt(SourceLocation loc, Expression::ExprPtr cond, Statement::StmtPtr body);
+		NatsuLib::natRefPointer<Statement::SwitchStmt> ActOnStartOfSwitchStmt(SourceLocation loc, Expression::ExprPtr cond);
+		Statement::StmtPtr ActOnFinishSwitchStmt(NatsuLib::natRefPointer<Statement::SwitchStmt> switchStmt,
+		                                         Statement::StmtPtr body);
+		Statement::StmtPtr ActOnCaseStmt(SourceLocation caseLoc, Expression::ExprPtr expr, SourceLocation colonLoc,
+		                                 Statement::StmtPtr subStmt);
+		Statement::StmtPtr ActOnDefaultStmt(SourceLocation defaultLoc, SourceLocation colonLoc, Statement::StmtPtr subStmt);
 		Statement::StmtPtr ActOnForStmt(SourceLocation forLoc, SourceLocation leftParenLoc, Statement::StmtPtr init,
 		                                Expression::ExprPtr cond, Expression::ExprPtr third, SourceLocation rightParenLoc,
 		                                Statement::StmtPtr body);
@@ -380,6 +406,13 @@ namespace NatsuLang::Semantic
 		Statement::StmtPtr ActOnReturnStmt(SourceLocation loc, Expression::ExprPtr returnedExpr,
 		                                   NatsuLib::natRefPointer<Scope> const& scope);
 
+		NatsuLib::natRefPointer<Declaration::VarDecl> ActOnExceptionDecl(NatsuLib::natRefPointer<Scope> const& scope,
+		                                                                 Declaration::DeclaratorPtr const& decl);
+		Statement::StmtPtr ActOnCatchStmt(SourceLocation catchLoc, NatsuLib::natRefPointer<Declaration::VarDecl> exDecl,
+		                                  Statement::StmtPtr handlerBlock);
+		Statement::StmtPtr ActOnTryStmt(SourceLocation tryLoc, Statement::StmtPtr tryBlock,
+		                                NatsuLib::Linq<NatsuLib::Valued<Statement::StmtPtr>> const& handlers);
+
 		Statement::StmtPtr ActOnExprStmt(Expression::ExprPtr expr);
 
 		Expression::ExprPtr ActOnBooleanLiteral(Lex::Token const& token) const;
@@ -463,6 +496,10 @@ namespace NatsuLang::Semantic
 
 		Expression::ExprPtr ImpCastExprToType(Expression::ExprPtr expr, Type::TypePtr type, Expression::CastType castType);
 
+		///	@brief	尝试将可常量求值的内建类型表达式折叠为字面量
+		///	@return	折叠得到的字面量，若无法折叠则返回原表达式
+		Expression::ExprPtr FoldConstantExpr(Expression::ExprPtr expr);
+
 		nBool CheckFunctionReturn(Statement::StmtEnumerable const& funcBody);
 		nBool CheckFunctionOverload(NatsuLib::natRefPointer<Type::FunctionType> const& func, NatsuLib::Linq<NatsuLib::Valued<NatsuLib::natRefPointer<Declaration::NamedDecl>>> const& overloadSet);
 
@@ -501,6 +538,7 @@ namespace NatsuLang::Semantic
 		NatsuLib::natRefPointer<ImportedAttribute> m_ImportedAttribute;
 
 		std::unordered_map<nString, NatsuLib::natRefPointer<IAttributeSerializer>> m_AttributeSerializerMap;
+		std::vector<NatsuLib::natRefPointer<IExternalDeclSource>> m_ExternalDeclSources;
 
 		NatsuLib::natRefPointer<CompilerActionNamespace> m_TopLevelActionNamespace;
 
@@ -514,8 +552,13 @@ namespace NatsuLang::Semantic
 		// m_CurrentDeclContext必须为nullptr或者可以转换到DeclContext*，不保存DeclContext*是为了保留对Decl的强引用
 		Declaration::DeclPtr m_CurrentDeclContext;
 
+		// 正在分析的 switch 语句，用于关联 case 及 default 语句
+		std::vector<NatsuLib::natRefPointer<Statement::SwitchStmt>> m_SwitchStack;
+
 		void prewarming();
 
+		void loadExternalDecls(Identifier::IdPtr const& id) const;
+
 		Expression::CastType getCastType(Expression::ExprPtr const& operand, Type::TypePtr toType, nBool isImplicit);
 
 		Type::TypePtr handleIntegerConversion(Expression::ExprPtr& leftOperand, Type::TypePtr leftOperandType,
@@ -60,13 +60,50 @@ namespace
 		: public natRefObjImpl<DefaultClassLayoutBuilder, ASTContext::IClassLayoutBuilder>
 	{
 	public:
+		explicit DefaultClassLayoutBuilder(ClassLayoutPolicy defaultPolicy) noexcept
+			: m_DefaultPolicy{ defaultPolicy }
+		{
+		}
+
 		ASTContext::ClassLayout BuildLayout(ASTContext& context, natRefPointer<Declaration::ClassDecl> const& classDecl) override
 		{
+			auto policy = m_DefaultPolicy;
+			if (const auto query = classDecl->GetAttributes<ClassLayoutAttribute>(); !query.empty())
+			{
+				policy = query.first()->GetPolicy();
+			}
+
+			std::vector<std::pair<natRefPointer<Declaration::FieldDecl>, ASTContext::TypeInfo>> fields;
+			for (auto const& field : classDecl->GetFields())
+			{
+				fields.emplace_back(field, context.GetTypeInfo(field->GetValueType()));
+			}
+
+			switch (policy)
+			{
+			case ClassLayoutPolicy::Optimal:
+				// 字段大小总是其对齐的整数倍，因此按对齐降序排列后字段之间不再需要 padding，相同对齐的字段保持声明顺序
+				std::stable_sort(fields.begin(), fields.end(), [](auto const& a, auto const& b)
+				{
+					return a.second.Align > b.second.Align;
+				});
+				break;
+			case ClassLayoutPolicy::Packed:
+				for (auto& field : fields)
+				{
+					field.second.Align = 1;
+				}
+				break;
+			case ClassLayoutPolicy::Declared:
+			default:
+				break;
+			}
+
 			// 允许 0 大小对象将会允许对象具有相同的地址
 			ASTContext::ClassLayout info{};
-			for (auto const& field : classDecl->GetFields())
+			info.Policy = policy;
+			for (auto const& [field, fieldInfo] : fields)
 			{
-				const auto fieldInfo = context.GetTypeInfo(field->GetValueType());
 				info.Align = std::max(fieldInfo.Align, info.Align);
 				const auto fieldOffset = AlignTo(info.Size, fieldInfo.Align);
 				if (fieldOffset != info.Size)
@@ -85,22 +122,41 @@ namespace
 
 			return info;
 		}
+
+	private:
+		ClassLayoutPolicy m_DefaultPolicy;
 	};
 }
 
-std::optional<std::pair<std::size_t, std::size_t>> ASTContext::ClassLayout::GetFieldInfo(natRefPointer<Declaration::FieldDecl> const& field) const noexcept
+ClassLayoutAttribute::ClassLayoutAttribute(ClassLayoutPolicy policy) noexcept
+	: m_Policy{ policy }
 {
-	const auto iter = std::find_if(FieldOffsets.cbegin(), FieldOffsets.cend(), [&field](std::pair<natRefPointer<Declaration::FieldDecl>, std::size_t> const& pair)
-	{
-		return pair.first == field;
-	});
+}
+
+ClassLayoutAttribute::~ClassLayoutAttribute()
+{
+}
+
+nStrView ClassLayoutAttribute::GetName() const noexcept
+{
+	return u8"ClassLayout"_nv;
+}
 
-	if (iter == FieldOffsets.cend())
+ClassLayoutPolicy ClassLayoutAttribute::GetPolicy() const noexcept
+{
+	return m_Policy;
+}
+
+std::optional<std::pair<std::size_t, std::size_t>> ASTContext::ClassLayout::GetFieldInfo(natRefPointer<Declaration::FieldDecl> const& field) const noexcept
+{
+	const auto iter = FieldIndices.find(field);
+	if (iter == FieldIndices.cend())
 	{
 		return {};
 	}
 
-	return std::optional<std::pair<std::size_t, std::size_t>>{ std::in_place, std::distance(FieldOffsets.cbegin(), iter), iter->second };
+	const auto index = iter->second;
+	return std::optional<std::pair<std::size_t, std::size_t>>{ std::in_place, index, FieldOffsets[index].second };
 }
 
 ASTContext::IClassLayoutBuilder::~IClassLayoutBuilder()
@@ -321,9 +377,9 @@ ASTContext::TypeInfo ASTContext::GetTypeInfo(Type::TypePtr const& type)
 	return info;
 }
 
-void ASTContext::UseDefaultClassLayoutBuilder()
+void ASTContext::UseDefaultClassLayoutBuilder(ClassLayoutPolicy defaultPolicy)
 {
-	m_ClassLayoutBuilder = make_ref<DefaultClassLayoutBuilder>();
+	m_ClassLayoutBuilder = make_ref<DefaultClassLayoutBuilder>(defaultPolicy);
 }
 
 void ASTContext::UseCustomClassLayoutBuilder(natRefPointer<IClassLayoutBuilder> classLayoutBuilder)
@@ -346,7 +402,17 @@ ASTContext::ClassLayout const& ASTContext::GetClassLayout(natRefPointer<Declarat
 		UseDefaultClassLayoutBuilder();
 	}
 
-	const auto ret = m_CachedClassLayout.emplace(classDecl, m_ClassLayoutBuilder->BuildLayout(*this, classDecl));
+	auto layout = m_ClassLayoutBuilder->BuildLayout(*this, classDecl);
+	layout.FieldIndices.reserve(layout.FieldOffsets.size());
+	for (std::size_t i = 0; i < layout.FieldOffsets.size(); ++i)
+	{
+		if (const auto& field = layout.FieldOffsets[i].first)
+		{
+			layout.FieldIndices.emplace(field, i);
+		}
+	}
+
+	const auto ret = m_CachedClassLayout.emplace(classDecl, std::move(layout));
 	if (!ret.second)
 	{
 		nat_Throw(natErrException, NatErr::NatErr_InternalErr, u8"Cannot insert class layout"_nv);
@@ -356,6 +422,28 @@ ASTContext::ClassLayout const& ASTContext::GetClassLayout(natRefPointer<Declarat
 }
 
 // TODO: 使用编译目标的值
+Expression::Expr::EvalResult const* ASTContext::GetCachedEvalResult(Expression::Expr const* expr) const noexcept
+{
+	const auto iter = m_CachedEvalResults.find(expr);
+	if (iter == m_CachedEvalResults.cend() || iter->second.Target.Lock().Get() != expr)
+	{
+		return nullptr;
+	}
+
+	return &iter->second.Result;
+}
+
+void ASTContext::CacheEvalResult(natRefPointer<Expression::Expr> const& expr, Expression::Expr::EvalResult const& result)
+{
+	assert(expr);
+	m_CachedEvalResults.insert_or_assign(expr.Get(), CachedEvalResult{ expr, result });
+}
+
+void ASTContext::InvalidateEvalResult(Expression::Expr const* expr) noexcept
+{
+	m_CachedEvalResults.erase(expr);
+}
+
 ASTContext::TypeInfo ASTContext::getTypeInfoImpl(Type::TypePtr const& type)
 {
 	switch (type->GetType())
@@ -375,7 +463,7 @@ ASTContext::TypeInfo ASTContext::getTypeInfoImpl(Type::TypePtr const& type)
 		return { 0, 0 };
 	case Type::Type::Class:
 	{
-		const auto classLayout = GetClassLayout(type.UnsafeCast<Type::ClassType>()->GetDecl());
+		const auto& classLayout = GetClassLayout(type.UnsafeCast<Type::ClassType>()->GetDecl());
 		return { classLayout.Size, classLayout.Align };
 	}
 	case Type::Type::Enum:
@@ -1,9 +1,12 @@
 ﻿#include "AST/Expression.h"
+#include "AST/ASTContext.h"
 #include "AST/Statement.h"
 #include "AST/StmtVisitor.h"
 #include "AST/NestedNameSpecifier.h"
 #include "Basic/Identifier.h"
 
+#include <unordered_set>
+
 #undef max
 #undef min
 
@@ -14,301 +17,566 @@ using namespace Expression;
 
 namespace
 {
-	nBool Evaluate(natRefPointer<Expr> const& expr, ASTContext& context, Expr::EvalResult& result);
-	nBool EvaluateInteger(natRefPointer<Expr> const& expr, ASTContext& context, Expr::EvalResult& result);
-	nBool EvaluateFloat(natRefPointer<Expr> const& expr, ASTContext& context, Expr::EvalResult& result);
+	// 与 Expr::EvalResult::Result 的索引一一对应
+	enum class EvalKind
+	{
+		Integer,
+		Float,
+		WideInteger,
+		WideFloat
+	};
 
-	template <typename T>
-	class ExprEvaluatorBase
-		: public StmtVisitor<T, nBool>
+	constexpr std::size_t GetResultIndex(EvalKind kind) noexcept
 	{
-	public:
-		ExprEvaluatorBase(ASTContext& context, Expr::EvalResult& result)
-			: m_Context{ context }, m_Result{ result }
+		return static_cast<std::size_t>(kind);
+	}
+
+	constexpr nBool IsIntegerKind(EvalKind kind) noexcept
+	{
+		return kind == EvalKind::Integer || kind == EvalKind::WideInteger;
+	}
+
+	constexpr nBool IsWideBuiltinClass(Type::BuiltinType::BuiltinClass builtinClass) noexcept
+	{
+		switch (builtinClass)
 		{
+		case Type::BuiltinType::Int128:
+		case Type::BuiltinType::UInt128:
+		case Type::BuiltinType::LongDouble:
+		case Type::BuiltinType::Float128:
+			return true;
+		default:
+			return false;
 		}
+	}
 
-		nBool VisitStmt(natRefPointer<Stmt> const&)
+	nBool GetEvalKind(Type::TypePtr const& type, EvalKind& kind) noexcept
+	{
+		if (!type)
 		{
 			return false;
 		}
 
-		nBool VisitParenExpr(natRefPointer<ParenExpr> const& expr)
+		if (const auto builtinType = type.Cast<Type::BuiltinType>())
+		{
+			// 仅有 128 位整数及扩展精度浮点数使用宽类型求值，其余类型仍使用 64 位求值
+			const auto isWide = IsWideBuiltinClass(builtinType->GetBuiltinClass());
+
+			if (builtinType->IsIntegerType())
+			{
+				kind = isWide ? EvalKind::WideInteger : EvalKind::Integer;
+				return true;
+			}
+
+			if (builtinType->IsFloatingType())
+			{
+				kind = isWide ? EvalKind::WideFloat : EvalKind::Float;
+				return true;
+			}
+
+			return false;
+		}
+
+		if (type->GetType() == Type::Type::Enum)
 		{
-			return this->Visit(expr->GetInnerExpr());
+			kind = EvalKind::Integer;
+			return true;
 		}
 
-	protected:
-		ASTContext& m_Context;
-		Expr::EvalResult& m_Result;
-	};
+		return false;
+	}
 
-	// TODO: 未对不同位数的整数类型进行特别处理，可能在溢出后会得到意料不到的值
-	class IntExprEvaluator
-		: public ExprEvaluatorBase<IntExprEvaluator>
+	nBool IsSignedType(Type::TypePtr const& type) noexcept
 	{
-	public:
-		IntExprEvaluator(ASTContext& context, Expr::EvalResult& result)
-			: ExprEvaluatorBase{ context, result }
+		const auto builtinType = type.Cast<Type::BuiltinType>();
+		return builtinType && builtinType->IsSigned();
+	}
+
+	template <typename T>
+	void StoreEvalResult(Expr::EvalResult& result, EvalKind kind, T value)
+	{
+		switch (kind)
 		{
+		case EvalKind::Integer:
+			result.Result.emplace<0>(static_cast<nuLong>(value));
+			break;
+		case EvalKind::Float:
+			result.Result.emplace<1>(static_cast<nDouble>(value));
+			break;
+		case EvalKind::WideInteger:
+			result.Result.emplace<2>(static_cast<nuWideInteger>(value));
+			break;
+		case EvalKind::WideFloat:
+			result.Result.emplace<3>(static_cast<nWideFloat>(value));
+			break;
+		default:
+			assert(!"Invalid kind");
+			break;
 		}
+	}
 
-		nBool VisitCharacterLiteral(natRefPointer<CharacterLiteral> const& expr)
+	template <typename Float>
+	void StoreFloatEvalResult(Expr::EvalResult& result, EvalKind kind, Float value)
+	{
+		// 负数直接转换为无符号整数是未定义行为，需要先转换为有符号整数
+		switch (kind)
 		{
-			m_Result.Result.emplace<0>(expr->GetCodePoint());
-			return true;
+		case EvalKind::Integer:
+			result.Result.emplace<0>(value < 0 ? static_cast<nuLong>(static_cast<nLong>(value)) : static_cast<nuLong>(value));
+			break;
+		case EvalKind::WideInteger:
+			result.Result.emplace<2>(value < 0 ? static_cast<nuWideInteger>(static_cast<nInt128>(value)) : static_cast<nuWideInteger>(value));
+			break;
+		default:
+			StoreEvalResult(result, kind, value);
+			break;
 		}
+	}
 
-		nBool VisitIntegerLiteral(natRefPointer<IntegerLiteral> const& expr)
+	// 将求值结果转换为 kind 对应的种类，isSourceSigned 表示结果原本的类型是否是有符号的，用于决定整数的扩展方式
+	nBool ConvertEvalResult(Expr::EvalResult& result, EvalKind kind, nBool isSourceSigned)
+	{
+		switch (result.Result.index())
+		{
+		case 0:
 		{
-			m_Result.Result.emplace<0>(expr->GetValue());
+			const auto value = std::get<0>(result.Result);
+			if (isSourceSigned)
+			{
+				StoreEvalResult(result, kind, static_cast<nLong>(value));
+			}
+			else
+			{
+				StoreEvalResult(result, kind, value);
+			}
 			return true;
 		}
-
-		nBool VisitBooleanLiteral(natRefPointer<BooleanLiteral> const& expr)
+		case 1:
+			StoreFloatEvalResult(result, kind, std::get<1>(result.Result));
+			return true;
+		case 2:
 		{
-			m_Result.Result.emplace<0>(static_cast<nuLong>(expr->GetValue()));
+			const auto value = std::get<2>(result.Result);
+			if (isSourceSigned)
+			{
+				StoreEvalResult(result, kind, static_cast<nInt128>(value));
+			}
+			else
+			{
+				StoreEvalResult(result, kind, value);
+			}
+			return true;
+		}
+		case 3:
+			StoreFloatEvalResult(result, kind, std::get<3>(result.Result));
 			return true;
+		default:
+			return false;
 		}
+	}
 
-		nBool VisitCastExpr(natRefPointer<CastExpr> const& expr)
-		{
-			const auto operand = expr->GetOperand();
-			/*auto destType = expr->GetType();
-			auto srcType = operand->GetType();*/
+	// 比较操作的结果总是存储为 64 位以内的整数
+	// TODO: 未对不同位数的整数类型进行特别处理，可能在溢出后会得到意料不到的值
+	template <std::size_t Index, typename Unsigned, typename Signed>
+	nBool EvaluateIntegerBinaryOperation(BinaryOperationType opcode, Unsigned leftValue, Unsigned rightValue, nBool isSigned, Expr::EvalResult& result)
+	{
+		constexpr auto bitCount = sizeof(Unsigned) * 8;
+		constexpr auto signedMin = static_cast<Signed>(Unsigned{ 1 } << (bitCount - 1));
 
-			switch (expr->GetCastType())
+		const auto signedLeft = static_cast<Signed>(leftValue), signedRight = static_cast<Signed>(rightValue);
+
+		// 无需判断逻辑操作符的情况
+		switch (opcode)
+		{
+		case BinaryOperationType::Mul:
+			result.Result.template emplace<Index>(leftValue * rightValue);
+			return true;
+		case BinaryOperationType::Add:
+			result.Result.template emplace<Index>(leftValue + rightValue);
+			return true;
+		case BinaryOperationType::Sub:
+			result.Result.template emplace<Index>(leftValue - rightValue);
+			return true;
+		case BinaryOperationType::Div:
+		case BinaryOperationType::Rem:
+			if (rightValue == 0)
 			{
-			case CastType::NoOp:
-			case CastType::IntegralCast:
-				return Visit(operand);
-			case CastType::FloatingToIntegral:
+				return false;
+			}
+
+			if (isSigned)
 			{
-				Expr::EvalResult result;
-				if (!EvaluateFloat(expr, m_Context, result) || result.Result.index() != 1)
+				// 溢出
+				if (signedLeft == signedMin && signedRight == -1)
 				{
 					return false;
 				}
 
-				m_Result.Result.emplace<0>(static_cast<nuLong>(std::get<1>(result.Result)));
-				return true;
+				result.Result.template emplace<Index>(static_cast<Unsigned>(opcode == BinaryOperationType::Div ? signedLeft / signedRight : signedLeft % signedRight));
 			}
-			case CastType::IntegralToBoolean:
-			case CastType::FloatingToBoolean:
+			else
 			{
-				Expr::EvalResult result;
-				if (!Evaluate(expr, m_Context, result))
-				{
-					return false;
-				}
-
-				if (result.Result.index() == 0)
-				{
-					m_Result.Result.emplace<0>(static_cast<nBool>(std::get<0>(result.Result)));
-				}
-				else
-				{
-					m_Result.Result.emplace<0>(static_cast<nBool>(std::get<1>(result.Result)));
-				}
-
-				return true;
+				result.Result.template emplace<Index>(opcode == BinaryOperationType::Div ? leftValue / rightValue : leftValue % rightValue);
 			}
-			case CastType::IntegralToFloating:
-			case CastType::FloatingCast:
-			case CastType::Invalid:
-			default:
+			return true;
+		case BinaryOperationType::Shl:
+			// 溢出
+			if (rightValue >= bitCount)
+			{
 				return false;
 			}
-		}
-
-		// 当此操作数无法决定整个表达式的值的时候返回true
-		static nBool VisitLogicalBinaryOperatorOperand(Expr::EvalResult& result, natRefPointer<BinaryOperator> const& expr)
-		{
-			const auto opcode = expr->GetOpcode();
-			if (IsBinLogicalOp(opcode))
+			result.Result.template emplace<Index>(leftValue << rightValue);
+			return true;
+		case BinaryOperationType::Shr:
+			if (rightValue >= bitCount)
 			{
-				nBool value;
-				if (result.GetResultAsBoolean(value))
-				{
-					if (value == (opcode == BinaryOperationType::LOr))
-					{
-						result.Result.emplace<0>(value);
-						return false;
-					}
-				}
+				return false;
 			}
+			result.Result.template emplace<Index>(isSigned ? static_cast<Unsigned>(signedLeft >> rightValue) : leftValue >> rightValue);
+			return true;
+		// TODO: 对于比较操作符，若其一操作数曾经溢出，则结果可能出现异常
+		case BinaryOperationType::LT:
+			result.Result.emplace<0>(isSigned ? signedLeft < signedRight : leftValue < rightValue);
+			return true;
+		case BinaryOperationType::GT:
+			result.Result.emplace<0>(isSigned ? signedLeft > signedRight : leftValue > rightValue);
+			return true;
+		case BinaryOperationType::LE:
+			result.Result.emplace<0>(isSigned ? signedLeft <= signedRight : leftValue <= rightValue);
+			return true;
+		case BinaryOperationType::GE:
+			result.Result.emplace<0>(isSigned ? signedLeft >= signedRight : leftValue >= rightValue);
+			return true;
+		case BinaryOperationType::EQ:
+			result.Result.emplace<0>(leftValue == rightValue);
+			return true;
+		case BinaryOperationType::NE:
+			result.Result.emplace<0>(leftValue != rightValue);
+			return true;
+		case BinaryOperationType::And:
+			result.Result.template emplace<Index>(leftValue & rightValue);
+			return true;
+		case BinaryOperationType::Xor:
+			result.Result.template emplace<Index>(leftValue ^ rightValue);
+			return true;
+		case BinaryOperationType::Or:
+			result.Result.template emplace<Index>(leftValue | rightValue);
+			return true;
+		case BinaryOperationType::Assign:
+		case BinaryOperationType::MulAssign:
+		case BinaryOperationType::DivAssign:
+		case BinaryOperationType::RemAssign:
+		case BinaryOperationType::AddAssign:
+		case BinaryOperationType::SubAssign:
+		case BinaryOperationType::ShlAssign:
+		case BinaryOperationType::ShrAssign:
+		case BinaryOperationType::AndAssign:
+		case BinaryOperationType::XorAssign:
+		case BinaryOperationType::OrAssign:
+			// 不能常量折叠
+		case BinaryOperationType::Invalid:
+		default:
+			return false;
+		}
+	}
 
+	template <std::size_t Index, typename Float>
+	nBool EvaluateFloatBinaryOperation(BinaryOperationType opcode, Float leftValue, Float rightValue, Expr::EvalResult& result)
+	{
+		switch (opcode)
+		{
+		case BinaryOperationType::Mul:
+			result.Result.template emplace<Index>(leftValue * rightValue);
+			return true;
+		case BinaryOperationType::Div:
+			result.Result.template emplace<Index>(leftValue / rightValue);
+			return true;
+		case BinaryOperationType::Add:
+			result.Result.template emplace<Index>(leftValue + rightValue);
+			return true;
+		case BinaryOperationType::Sub:
+			result.Result.template emplace<Index>(leftValue - rightValue);
+			return true;
+		case BinaryOperationType::LT:
+			result.Result.emplace<0>(leftValue < rightValue);
+			return true;
+		case BinaryOperationType::GT:
+			result.Result.emplace<0>(leftValue > rightValue);
 			return true;
+		case BinaryOperationType::LE:
+			result.Result.emplace<0>(leftValue <= rightValue);
+			return true;
+		case BinaryOperationType::GE:
+			result.Result.emplace<0>(leftValue >= rightValue);
+			return true;
+		case BinaryOperationType::EQ:
+			result.Result.emplace<0>(leftValue == rightValue);
+			return true;
+		case BinaryOperationType::NE:
+			result.Result.emplace<0>(leftValue != rightValue);
+			return true;
+		default:
+			return false;
 		}
+	}
 
-		// TODO: 处理浮点类型的比较操作
-		nBool VisitBinaryOperator(natRefPointer<BinaryOperator> const& expr)
+	// 常量求值器，使用显式的工作栈代替递归，以免过深的表达式树耗尽调用栈
+	// 每次 Visit 只处理栈顶表达式的一个阶段：要么压入需要先行求值的操作数，要么完成求值并将结果压入值栈
+	// 成功求值的非字面量表达式会将结果缓存在 ASTContext 中，之后的求值将直接使用缓存的结果
+	// 64 位以内的类型使用 nuLong 及 nDouble 求值，仅 128 位整数及扩展精度浮点数使用宽类型求值
+	class ExprEvaluator
+		: public StmtVisitor<ExprEvaluator, nBool>
+	{
+	public:
+		explicit ExprEvaluator(ASTContext& context)
+			: m_Context{ context }
 		{
-			const auto opcode = expr->GetOpcode();
-			const auto leftOperand = expr->GetLeftOperand();
-			const auto rightOperand = expr->GetRightOperand();
+		}
 
-			Expr::EvalResult leftResult, rightResult;
+		nBool Evaluate(ExprPtr const& expr, Expr::EvalResult& result)
+		{
+			EvalKind kind;
+			return expr && GetEvalKind(expr->GetExprType(), kind) && Evaluate(expr, kind, result);
+		}
 
-			if (!Evaluate(leftOperand, m_Context, leftResult))
+		nBool Evaluate(ExprPtr const& expr, EvalKind kind, Expr::EvalResult& result)
+		{
+			if (!pushOperand(expr, kind))
 			{
 				return false;
 			}
 
-			// 如果是逻辑操作符，判断是否可以短路求值
-			if (IsBinLogicalOp(opcode))
+			while (!m_WorkStack.empty())
 			{
-				nBool value;
-				if (VisitLogicalBinaryOperatorOperand(leftResult, expr) && Evaluate(rightOperand, m_Context, rightResult) && rightResult.GetResultAsBoolean(value))
+				// Visit 可能会使工作栈扩张，因此需要复制一份
+				const auto current = m_WorkStack.back().Target;
+				if (!Visit(current))
 				{
-					m_Result.Result.emplace<0>(value);
-					return true;
+					m_WorkStack.clear();
+					m_ValueStack.clear();
+					m_EvaluatingVars.clear();
+					return false;
 				}
-
-				return false;
 			}
 
-			// 右操作数需要求值，因为如果已经进行了求值操作则不会到达此处
-			if (!Evaluate(rightOperand, m_Context, rightResult))
+			assert(m_ValueStack.size() == 1);
+			result = popValue();
+			return true;
+		}
+
+		nBool VisitStmt(natRefPointer<Stmt> const&)
+		{
+			return false;
+		}
+
+		nBool VisitParenExpr(natRefPointer<ParenExpr> const& expr)
+		{
+			auto& frame = currentFrame();
+			if (frame.Stage == 0)
 			{
-				return false;
+				frame.Stage = 1;
+				return pushOperand(expr->GetInnerExpr(), frame.Kind);
 			}
 
-			if (leftResult.Result.index() != 0 || rightResult.Result.index() != 0)
+			return complete(popValue());
+		}
+
+		nBool VisitCharacterLiteral(natRefPointer<CharacterLiteral> const& expr)
+		{
+			return completeInteger(expr->GetCodePoint());
+		}
+
+		nBool VisitIntegerLiteral(natRefPointer<IntegerLiteral> const& expr)
+		{
+			return completeInteger(expr->GetValue());
+		}
+
+		nBool VisitBooleanLiteral(natRefPointer<BooleanLiteral> const& expr)
+		{
+			return completeInteger(static_cast<nuLong>(expr->GetValue()));
+		}
+
+		nBool VisitFloatingLiteral(natRefPointer<FloatingLiteral> const& expr)
+		{
+			const auto kind = currentFrame().Kind;
+			if (IsIntegerKind(kind))
 			{
 				return false;
 			}
 
-			auto leftValue = std::get<0>(leftResult.Result), rightValue = std::get<0>(rightResult.Result);
+			Expr::EvalResult result;
+			StoreEvalResult(result, kind, expr->GetValue());
+			return complete(std::move(result), false);
+		}
 
-			// 无需判断逻辑操作符的情况
-			switch (opcode)
+		nBool VisitCastExpr(natRefPointer<CastExpr> const& expr)
+		{
+			auto& frame = currentFrame();
+			const auto operand = expr->GetOperand();
+
+			switch (expr->GetCastType())
 			{
-			case BinaryOperationType::Mul:
-				m_Result.Result.emplace<0>(leftValue * rightValue);
-				return true;
-			case BinaryOperationType::Add:
-				m_Result.Result.emplace<0>(leftValue + rightValue);
-				return true;
-			case BinaryOperationType::Sub:
-				m_Result.Result.emplace<0>(leftValue - rightValue);
-				return true;
-			case BinaryOperationType::Div:
-				if (rightValue == 0)
+			case CastType::NoOp:
+				if (frame.Stage == 0)
+				{
+					frame.Stage = 1;
+					return pushOperand(operand, frame.Kind);
+				}
+				return complete(popValue());
+			case CastType::IntegralCast:
+			case CastType::FloatingToIntegral:
+				if (!IsIntegerKind(frame.Kind))
 				{
 					return false;
 				}
-				m_Result.Result.emplace<0>(leftValue / rightValue);
-				return true;
-			case BinaryOperationType::Rem:
-				if (rightValue == 0)
+				break;
+			case CastType::IntegralToFloating:
+			case CastType::FloatingCast:
+				if (IsIntegerKind(frame.Kind))
 				{
 					return false;
 				}
-				m_Result.Result.emplace<0>(leftValue % rightValue);
-				return true;
-			case BinaryOperationType::Shl:
-				// 溢出
-				if (rightValue >= sizeof(nuLong) * 8)
+				break;
+			case CastType::IntegralToBoolean:
+			case CastType::FloatingToBoolean:
+			{
+				if (!IsIntegerKind(frame.Kind))
 				{
 					return false;
 				}
-				m_Result.Result.emplace<0>(leftValue << rightValue);
-				return true;
-			case BinaryOperationType::Shr:
-				m_Result.Result.emplace<0>(leftValue >> rightValue);
-				return true;
-			// TODO: 对于比较操作符，若其一操作数曾经溢出，则结果可能出现异常
-			case BinaryOperationType::LT:
-				m_Result.Result.emplace<0>(leftValue < rightValue);
-				return true;
-			case BinaryOperationType::GT:
-				m_Result.Result.emplace<0>(leftValue > rightValue);
-				return true;
-			case BinaryOperationType::LE:
-				m_Result.Result.emplace<0>(leftValue <= rightValue);
-				return true;
-			case BinaryOperationType::GE:
-				m_Result.Result.emplace<0>(leftValue >= rightValue);
-				return true;
-			case BinaryOperationType::EQ:
-				m_Result.Result.emplace<0>(leftValue == rightValue);
-				return true;
-			case BinaryOperationType::NE:
-				m_Result.Result.emplace<0>(leftValue != rightValue);
-				return true;
-			case BinaryOperationType::And:
-				m_Result.Result.emplace<0>(leftValue & rightValue);
-				return true;
-			case BinaryOperationType::Xor:
-				m_Result.Result.emplace<0>(leftValue ^ rightValue);
-				return true;
-			case BinaryOperationType::Or:
-				m_Result.Result.emplace<0>(leftValue | rightValue);
-				return true;
-			case BinaryOperationType::Assign:
-			case BinaryOperationType::MulAssign:
-			case BinaryOperationType::DivAssign:
-			case BinaryOperationType::RemAssign:
-			case BinaryOperationType::AddAssign:
-			case BinaryOperationType::SubAssign:
-			case BinaryOperationType::ShlAssign:
-			case BinaryOperationType::ShrAssign:
-			case BinaryOperationType::AndAssign:
-			case BinaryOperationType::XorAssign:
-			case BinaryOperationType::OrAssign:
-				// 不能常量折叠
-			case BinaryOperationType::Invalid:
+
+				if (frame.Stage == 0)
+				{
+					frame.Stage = 1;
+					return pushOperandByType(operand);
+				}
+
+				nBool value;
+				if (!popValue().GetResultAsBoolean(value))
+				{
+					return false;
+				}
+
+				Expr::EvalResult result;
+				StoreEvalResult(result, frame.Kind, value);
+				return complete(std::move(result));
+			}
+			case CastType::Invalid:
 			default:
 				return false;
 			}
+
+			if (frame.Stage == 0)
+			{
+				frame.Stage = 1;
+				return pushOperandByType(operand);
+			}
+
+			auto result = popValue();
+			return ConvertEvalResult(result, frame.Kind, IsSignedType(operand->GetExprType())) && complete(std::move(result));
 		}
 
-		nBool VisitUnaryOperator(natRefPointer<UnaryOperator> const& expr)
+		nBool VisitBinaryOperator(natRefPointer<BinaryOperator> const& expr)
 		{
-			switch (expr->GetOpcode())
+			auto& frame = currentFrame();
+			const auto opcode = expr->GetOpcode();
+
+			switch (frame.Stage)
 			{
-			case UnaryOperationType::Plus:
-				return Visit(expr->GetOperand());
-			case UnaryOperationType::Minus:
-				if (!Visit(expr->GetOperand()))
-				{
-					return false;
-				}
+			case 0:
+				frame.Stage = 1;
+				return pushOperandByType(expr->GetLeftOperand());
+			case 1:
+			{
+				auto leftResult = popValue();
 
-				if (m_Result.Result.index() != 0)
+				// 如果是逻辑操作符，判断是否可以短路求值
+				if (IsBinLogicalOp(opcode))
 				{
-					return false;
+					nBool value;
+					if (!IsIntegerKind(frame.Kind) || !leftResult.GetResultAsBoolean(value))
+					{
+						return false;
+					}
+
+					if (value == (opcode == BinaryOperationType::LOr))
+					{
+						Expr::EvalResult result;
+						StoreEvalResult(result, frame.Kind, value);
+						return complete(std::move(result));
+					}
 				}
 
-				m_Result.Result.emplace<0>(std::numeric_limits<nuLong>::max() - std::get<0>(m_Result.Result));
-				return true;
-			case UnaryOperationType::Not:
-				if (!Visit(expr->GetOperand()))
+				frame.Stage = 2;
+				frame.SavedResult = std::move(leftResult);
+				return pushOperandByType(expr->GetRightOperand());
+			}
+			default:
+			{
+				const auto rightResult = popValue();
+				Expr::EvalResult result;
+
+				if (IsBinLogicalOp(opcode))
 				{
-					return false;
+					nBool value;
+					if (!rightResult.GetResultAsBoolean(value))
+					{
+						return false;
+					}
+
+					StoreEvalResult(result, frame.Kind, value);
+					return complete(std::move(result));
 				}
 
-				if (m_Result.Result.index() != 0)
+				const auto& leftResult = frame.SavedResult;
+				if (rightResult.Result.index() != leftResult.Result.index())
 				{
 					return false;
 				}
 
-				m_Result.Result.emplace<0>(~std::get<0>(m_Result.Result));
-				return true;
-			case UnaryOperationType::LNot:
-				if (!Visit(expr->GetOperand()))
+				// 操作数的类型决定了运算方式，比较操作的结果种类将与操作数不同，由 complete 检查结果是否符合预期
+				const auto isSigned = IsSignedType(expr->GetLeftOperand()->GetExprType());
+				nBool succeeded;
+				switch (leftResult.Result.index())
 				{
+				case 0:
+					succeeded = EvaluateIntegerBinaryOperation<0, nuLong, nLong>(opcode, std::get<0>(leftResult.Result), std::get<0>(rightResult.Result), isSigned, result);
+					break;
+				case 1:
+					succeeded = EvaluateFloatBinaryOperation<1>(opcode, std::get<1>(leftResult.Result), std::get<1>(rightResult.Result), result);
+					break;
+				case 2:
+					succeeded = EvaluateIntegerBinaryOperation<2, nuWideInteger, nInt128>(opcode, std::get<2>(leftResult.Result), std::get<2>(rightResult.Result), isSigned, result);
+					break;
+				case 3:
+					succeeded = EvaluateFloatBinaryOperation<3>(opcode, std::get<3>(leftResult.Result), std::get<3>(rightResult.Result), result);
+					break;
+				default:
 					return false;
 				}
 
-				if (m_Result.Result.index() != 0)
+				return succeeded && complete(std::move(result));
+			}
+			}
+		}
+
+		nBool VisitUnaryOperator(natRefPointer<UnaryOperator> const& expr)
+		{
+			auto& frame = currentFrame();
+			const auto opcode = expr->GetOpcode();
+
+			switch (opcode)
+			{
+			case UnaryOperationType::Plus:
+			case UnaryOperationType::Minus:
+				break;
+			case UnaryOperationType::Not:
+			case UnaryOperationType::LNot:
+				if (IsIntegerKind(frame.Kind))
 				{
-					return false;
+					break;
 				}
-
-				m_Result.Result.emplace<0>(!std::get<0>(m_Result.Result));
-				return true;
+				[[fallthrough]];
 			case UnaryOperationType::Invalid:
 			case UnaryOperationType::PostInc:
 			case UnaryOperationType::PostDec:
@@ -317,238 +585,205 @@ namespace
 			default:
 				return false;
 			}
-		}
 
-		nBool VisitConditionalOperator(natRefPointer<ConditionalOperator> const& expr)
-		{
-			if (!Visit(expr->GetCondition()))
+			if (frame.Stage == 0)
 			{
-				return false;
+				frame.Stage = 1;
+				return pushOperand(expr->GetOperand(), frame.Kind);
 			}
 
-			if (m_Result.Result.index() != 0)
+			auto result = popValue();
+
+			switch (frame.Kind)
 			{
+			case EvalKind::Integer:
+				evaluateIntegerUnaryOperation<0>(opcode, result);
+				break;
+			case EvalKind::Float:
+				if (opcode == UnaryOperationType::Minus)
+				{
+					result.Result.emplace<1>(-std::get<1>(result.Result));
+				}
+				break;
+			case EvalKind::WideInteger:
+				evaluateIntegerUnaryOperation<2>(opcode, result);
+				break;
+			case EvalKind::WideFloat:
+				if (opcode == UnaryOperationType::Minus)
+				{
+					result.Result.emplace<3>(-std::get<3>(result.Result));
+				}
+				break;
+			default:
 				return false;
 			}
 
-			return Visit(std::get<0>(m_Result.Result) ? expr->GetLeftOperand() : expr->GetRightOperand());
+			return complete(std::move(result));
+		}
+
+		nBool VisitConditionalOperator(natRefPointer<ConditionalOperator> const& expr)
+		{
+			auto& frame = currentFrame();
+
+			switch (frame.Stage)
+			{
+			case 0:
+				frame.Stage = 1;
+				return pushOperandByType(expr->GetCondition());
+			case 1:
+			{
+				nBool condition;
+				if (!popValue().GetResultAsBoolean(condition))
+				{
+					return false;
+				}
+
+				frame.Stage = 2;
+				return pushOperand(condition ? expr->GetLeftOperand() : expr->GetRightOperand(), frame.Kind);
+			}
+			default:
+				return complete(popValue());
+			}
 		}
 
 		nBool VisitDeclRefExpr(natRefPointer<DeclRefExpr> const& expr)
 		{
+			auto& frame = currentFrame();
 			const auto decl = expr->GetDecl();
 
 			if (const auto enumeratorDecl = decl.Cast<Declaration::EnumConstantDecl>())
 			{
-				m_Result.Result.emplace<0>(enumeratorDecl->GetValue());
-				return true;
+				Expr::EvalResult result;
+				StoreEvalResult(result, frame.Kind, enumeratorDecl->GetValue());
+				return complete(std::move(result), false);
 			}
 
 			if (const auto varDecl = decl.Cast<Declaration::VarDecl>(); varDecl && varDecl->GetStorageClass() == Specifier::StorageClass::Const)
 			{
-				return Visit(varDecl->GetInitializer());
+				if (frame.Stage == 0)
+				{
+					// 常量的初始化器直接或间接引用了自身
+					if (!m_EvaluatingVars.emplace(varDecl.Get()).second)
+					{
+						return false;
+					}
+
+					frame.Stage = 1;
+					return pushOperand(varDecl->GetInitializer(), frame.Kind);
+				}
+
+				m_EvaluatingVars.erase(varDecl.Get());
+				return complete(popValue());
 			}
 
 			return false;
 		}
-	};
 
-	class FloatExprEvaluator
-		: public ExprEvaluatorBase<FloatExprEvaluator>
-	{
-	public:
-		FloatExprEvaluator(ASTContext& context, Expr::EvalResult& result)
-			: ExprEvaluatorBase{ context, result }
+	private:
+		struct Frame
 		{
-		}
+			ExprPtr Target;
+			EvalKind Kind;
+			nuInt Stage;
+			Expr::EvalResult SavedResult;
+		};
 
-		nBool VisitFloatingLiteral(natRefPointer<FloatingLiteral> const& expr)
+		ASTContext& m_Context;
+		std::vector<Frame> m_WorkStack;
+		std::vector<Expr::EvalResult> m_ValueStack;
+		std::unordered_set<Declaration::VarDecl*> m_EvaluatingVars;
+
+		Frame& currentFrame() noexcept
 		{
-			m_Result.Result.emplace<1>(expr->GetValue());
-			return true;
+			assert(!m_WorkStack.empty());
+			return m_WorkStack.back();
 		}
 
-		nBool VisitCastExpr(natRefPointer<CastExpr> const& expr)
+		Expr::EvalResult popValue()
 		{
-			const auto operand = expr->GetOperand();
-
-			switch (expr->GetCastType())
-			{
-			case CastType::NoOp:
-			case CastType::FloatingCast:
-				return Visit(operand);
-			case CastType::IntegralToFloating:
-			{
-				Expr::EvalResult result;
-				if (!EvaluateInteger(operand, m_Context, result) || result.Result.index() != 0)
-				{
-					return false;
-				}
-
-				m_Result.Result.emplace<1>(static_cast<nDouble>(std::get<0>(result.Result)));
-				return true;
-			}
-			case CastType::Invalid:
-			case CastType::IntegralCast:
-			case CastType::IntegralToBoolean:
-			case CastType::FloatingToIntegral:
-			case CastType::FloatingToBoolean:
-			default:
-				return false;
-			}
+			assert(!m_ValueStack.empty());
+			auto value = std::move(m_ValueStack.back());
+			m_ValueStack.pop_back();
+			return value;
 		}
 
-		nBool VisitBinaryOperator(natRefPointer<BinaryOperator> const& expr)
+		nBool pushOperand(ExprPtr const& expr, EvalKind kind)
 		{
-			const auto opcode = expr->GetOpcode();
-			const auto leftOperand = expr->GetLeftOperand();
-			const auto rightOperand = expr->GetRightOperand();
-
-			Expr::EvalResult leftResult, rightResult;
-
-			if (!Evaluate(leftOperand, m_Context, leftResult) || leftResult.Result.index() != 1 ||
-				!Evaluate(rightOperand, m_Context, rightResult) || rightResult.Result.index() != 1)
+			if (!expr)
 			{
 				return false;
 			}
 
-			const auto leftValue = std::get<1>(leftResult.Result), rightValue = std::get<1>(rightResult.Result);
-			switch (opcode)
+			if (const auto cachedResult = m_Context.GetCachedEvalResult(expr.Get()); cachedResult && cachedResult->Result.index() == GetResultIndex(kind))
 			{
-			case BinaryOperationType::Mul:
-				m_Result.Result.emplace<1>(leftValue * rightValue);
-				return true;
-			case BinaryOperationType::Div:
-				m_Result.Result.emplace<1>(leftValue / rightValue);
-				return true;
-			case BinaryOperationType::Add:
-				m_Result.Result.emplace<1>(leftValue + rightValue);
+				m_ValueStack.emplace_back(*cachedResult);
 				return true;
-			case BinaryOperationType::Sub:
-				m_Result.Result.emplace<1>(leftValue - rightValue);
-				return true;
-			case BinaryOperationType::Invalid:
-			case BinaryOperationType::Rem:
-			case BinaryOperationType::Shl:
-			case BinaryOperationType::Shr:
-			case BinaryOperationType::LT:
-			case BinaryOperationType::GT:
-			case BinaryOperationType::LE:
-			case BinaryOperationType::GE:
-			case BinaryOperationType::EQ:
-			case BinaryOperationType::NE:
-			case BinaryOperationType::And:
-			case BinaryOperationType::Xor:
-			case BinaryOperationType::Or:
-			case BinaryOperationType::LAnd:
-			case BinaryOperationType::LOr:
-			case BinaryOperationType::Assign:
-			case BinaryOperationType::MulAssign:
-			case BinaryOperationType::DivAssign:
-			case BinaryOperationType::RemAssign:
-			case BinaryOperationType::AddAssign:
-			case BinaryOperationType::SubAssign:
-			case BinaryOperationType::ShlAssign:
-			case BinaryOperationType::ShrAssign:
-			case BinaryOperationType::AndAssign:
-			case BinaryOperationType::XorAssign:
-			case BinaryOperationType::OrAssign:
-			default:
-				return false;
 			}
+
+			m_WorkStack.push_back(Frame{ expr, kind, 0, {} });
+			return true;
 		}
 
-		nBool VisitUnaryOperator(natRefPointer<UnaryOperator> const& expr)
+		nBool pushOperandByType(ExprPtr const& expr)
 		{
-			switch (expr->GetOpcode())
-			{
-			case UnaryOperationType::Plus:
-				return EvaluateFloat(expr->GetOperand(), m_Context, m_Result);
-			case UnaryOperationType::Minus:
-				if (!EvaluateFloat(expr->GetOperand(), m_Context, m_Result) || m_Result.Result.index() != 1)
-				{
-					return false;
-				}
-
-				m_Result.Result.emplace<1>(-std::get<1>(m_Result.Result));
-				return true;
-			default:
-				return false;
-			}
+			EvalKind kind;
+			return expr && GetEvalKind(expr->GetExprType(), kind) && pushOperand(expr, kind);
 		}
 
-		nBool VisitConditionalOperator(natRefPointer<ConditionalOperator> const& expr)
+		// 完成栈顶表达式的求值，字面量无需缓存
+		nBool complete(Expr::EvalResult result, nBool cacheResult = true)
 		{
-			if (!Visit(expr->GetCondition()))
+			auto const& frame = currentFrame();
+			if (result.Result.index() != GetResultIndex(frame.Kind))
 			{
 				return false;
 			}
 
-			if (m_Result.Result.index() != 0)
+			if (cacheResult && !result.HasSideEffects)
 			{
-				return false;
+				m_Context.CacheEvalResult(frame.Target, result);
 			}
 
-			return Visit(std::get<0>(m_Result.Result) ? expr->GetLeftOperand() : expr->GetRightOperand());
+			m_WorkStack.pop_back();
+			m_ValueStack.emplace_back(std::move(result));
+			return true;
 		}
 
-		nBool VisitDeclRefExpr(natRefPointer<DeclRefExpr> const& expr)
+		nBool completeInteger(nuLong value)
 		{
-			const auto decl = expr->GetDecl();
-
-			if (const auto enumeratorDecl = decl.Cast<Declaration::EnumConstantDecl>())
-			{
-				m_Result.Result.emplace<1>(static_cast<nDouble>(enumeratorDecl->GetValue()));
-				return true;
-			}
-
-			if (const auto varDecl = decl.Cast<Declaration::VarDecl>(); varDecl && varDecl->GetStorageClass() == Specifier::StorageClass::Const)
+			const auto kind = currentFrame().Kind;
+			if (!IsIntegerKind(kind))
 			{
-				return Visit(varDecl->GetInitializer());
+				return false;
 			}
 
-			return false;
+			Expr::EvalResult result;
+			StoreEvalResult(result, kind, value);
+			return complete(std::move(result), false);
 		}
-	};
 
-	nBool Evaluate(natRefPointer<Expr> const& expr, ASTContext& context, Expr::EvalResult& result)
-	{
-		const auto type = expr->GetExprType();
-
-		if (const auto builtinType = type.Cast<Type::BuiltinType>())
+		template <std::size_t Index>
+		static void evaluateIntegerUnaryOperation(UnaryOperationType opcode, Expr::EvalResult& result)
 		{
-			if (builtinType->IsIntegerType())
-			{
-				return EvaluateInteger(expr, context, result);
-			}
+			const auto value = std::get<Index>(result.Result);
+			using ValueType = std::remove_cv_t<decltype(value)>;
 
-			if (builtinType->IsFloatingType())
+			switch (opcode)
 			{
-				return EvaluateFloat(expr, context, result);
+			case UnaryOperationType::Minus:
+				result.Result.template emplace<Index>(ValueType{} - value);
+				break;
+			case UnaryOperationType::Not:
+				result.Result.template emplace<Index>(~value);
+				break;
+			case UnaryOperationType::LNot:
+				result.Result.template emplace<Index>(!value);
+				break;
+			default:
+				break;
 			}
-
-			return false;
-		}
-
-		if (type->GetType() == Type::Type::Enum)
-		{
-			return EvaluateInteger(expr, context, result);
 		}
-
-		return false;
-	}
-
-	nBool EvaluateInteger(natRefPointer<Expr> const& expr, ASTContext& context, Expr::EvalResult& result)
-	{
-		IntExprEvaluator evaluator{ context, result };
-		return evaluator.Visit(expr);
-	}
-
-	nBool EvaluateFloat(natRefPointer<Expr> const& expr, ASTContext& context, Expr::EvalResult& result)
-	{
-		FloatExprEvaluator evaluator{ context, result };
-		return evaluator.Visit(expr);
-	}
+	};
 }
 
 Expr::Expr(StmtType stmtType, Type::TypePtr exprType, ValueCategory valueCategory, SourceLocation start, SourceLocation end)
@@ -579,43 +814,54 @@ ExprPtr Expr::IgnoreParens() noexcept
 
 nBool Expr::EvalResult::GetResultAsSignedInteger(nLong& result) const noexcept
 {
-	if (Result.index() != 0)
+	switch (Result.index())
 	{
+	case 0:
+		result = static_cast<nLong>(std::get<0>(Result));
+		return true;
+	case 2:
+	{
+		const auto value = static_cast<nInt128>(std::get<2>(Result));
+		if (value < std::numeric_limits<nLong>::min() || value > std::numeric_limits<nLong>::max())
+		{
+			return false;
+		}
+
+		result = static_cast<nLong>(value);
+		return true;
+	}
+	default:
 		return false;
 	}
-
-	constexpr auto longMax = static_cast<nuLong>(std::numeric_limits<nLong>::max());
-	const auto storedValue = std::get<0>(Result);
-	result = storedValue > longMax ?
-		-static_cast<nLong>(storedValue - longMax) :
-		static_cast<nLong>(storedValue);
-
-	return true;
 }
 
 nBool Expr::EvalResult::GetResultAsBoolean(nBool& result) const noexcept
 {
-	if (Result.index() == 0)
-	{
-		result = !!std::get<0>(Result);
-	}
-	else
+	std::visit([&result](auto value)
 	{
-		result = !!std::get<1>(Result);
-	}
+		result = !!value;
+	}, Result);
 
 	return true;
 }
 
 nBool Expr::Evaluate(EvalResult& result, ASTContext& context)
 {
-	return ::Evaluate(ForkRef<Expr>(), context, result);
+	return ExprEvaluator{ context }.Evaluate(ForkRef<Expr>(), result);
 }
 
 nBool Expr::EvaluateAsInt(nuLong& result, ASTContext& context)
 {
+	// 128 位整数需要先以宽类型求值再截断，否则运算过程中的溢出将会导致错误的结果
+	EvalKind kind;
+	if (!GetEvalKind(m_ExprType, kind) || kind != EvalKind::WideInteger)
+	{
+		kind = EvalKind::Integer;
+	}
+
 	EvalResult evalResult;
-	if (!EvaluateInteger(ForkRef<Expr>(), context, evalResult) || evalResult.Result.index() != 0)
+	if (!ExprEvaluator{ context }.Evaluate(ForkRef<Expr>(), kind, evalResult) ||
+		!ConvertEvalResult(evalResult, EvalKind::Integer, false))
 	{
 		return false;
 	}
@@ -624,10 +870,36 @@ nBool Expr::EvaluateAsInt(nuLong& result, ASTContext& context)
 	return true;
 }
 
+nBool Expr::EvaluateAsWideInt(nuWideInteger& result, ASTContext& context)
+{
+	EvalKind kind;
+	if (!GetEvalKind(m_ExprType, kind) || kind != EvalKind::WideInteger)
+	{
+		kind = EvalKind::Integer;
+	}
+
+	EvalResult evalResult;
+	if (!ExprEvaluator{ context }.Evaluate(ForkRef<Expr>(), kind, evalResult) ||
+		!ConvertEvalResult(evalResult, EvalKind::WideInteger, IsSignedType(m_ExprType)))
+	{
+		return false;
+	}
+
+	result = std::get<2>(evalResult.Result);
+	return true;
+}
+
 nBool Expr::EvaluateAsFloat(nDouble& result, ASTContext& context)
 {
+	EvalKind kind;
+	if (!GetEvalKind(m_ExprType, kind) || kind != EvalKind::WideFloat)
+	{
+		kind = EvalKind::Float;
+	}
+
 	EvalResult evalResult;
-	if (!EvaluateFloat(ForkRef<Expr>(), context, evalResult) || evalResult.Result.index() != 1)
+	if (!ExprEvaluator{ context }.Evaluate(ForkRef<Expr>(), kind, evalResult) ||
+		!ConvertEvalResult(evalResult, EvalKind::Float, false))
 	{
 		return false;
 	}
@@ -60,10 +60,20 @@ CaseStmt::~CaseStmt()
 {
 }
 
+StmtEnumerable CaseStmt::GetChildrenStmt()
+{
+	return from_values({ static_cast<StmtPtr>(m_Expr), m_SubStmt });
+}
+
 DefaultStmt::~DefaultStmt()
 {
 }
 
+StmtEnumerable DefaultStmt::GetChildrenStmt()
+{
+	return from_values({ m_SubStmt });
+}
+
 LabelStmt::~LabelStmt()
 {
 }
@@ -151,10 +161,43 @@ StmtEnumerable ReturnStmt::GetChildrenStmt()
 	return Stmt::GetChildrenStmt();
 }
 
+TryStmt::TryStmt(SourceLocation loc, StmtPtr tryBlock, Linq<Valued<StmtPtr>> const& handlers)
+	: Stmt{ TryStmtClass, loc, loc }, m_TryBlock{ std::move(tryBlock) }, m_Handlers{ std::begin(handlers), std::end(handlers) }
+{
+	if (!m_Handlers.empty())
+	{
+		SetEndLoc(m_Handlers.back()->GetEndLoc());
+	}
+	else if (m_TryBlock)
+	{
+		SetEndLoc(m_TryBlock->GetEndLoc());
+	}
+}
+
 TryStmt::~TryStmt()
 {
 }
 
+StmtEnumerable TryStmt::GetHandlers()
+{
+	return from(m_Handlers);
+}
+
+void TryStmt::SetHandlers(StmtEnumerable const& handlers)
+{
+	m_Handlers.assign(std::cbegin(handlers), std::cend(handlers));
+}
+
+StmtEnumerable TryStmt::GetChildrenStmt()
+{
+	return from_values({ m_TryBlock }).concat(from(m_Handlers));
+}
+
 CatchStmt::~CatchStmt()
 {
 }
+
+StmtEnumerable CatchStmt::GetChildrenStmt()
+{
+	return from_values({ m_HandlerBlock });
+}
@@ -15,6 +15,16 @@ nBool ISerializationArchiveReader::ReadBool(nStrView key, nBool& out)
 	return ret;
 }
 
+nBool ISerializationArchiveReader::ReadIndexedEntry(nStrView /*name*/, std::function<void()> const& /*callback*/)
+{
+	return false;
+}
+
+nBool ISerializationArchiveReader::EnumerateIndexedNames(std::function<void(nStrView)> const& /*callback*/)
+{
+	return false;
+}
+
 ISerializationArchiveWriter::~ISerializationArchiveWriter()
 {
 }
@@ -23,3 +33,11 @@ void ISerializationArchiveWriter::WriteBool(nStrView key, nBool value)
 {
 	WriteInteger(key, value, 1);
 }
+
+void ISerializationArchiveWriter::MarkIndexEntry(nStrView /*name*/)
+{
+}
+
+void ISerializationArchiveWriter::FinishWriting()
+{
+}
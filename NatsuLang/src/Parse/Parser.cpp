@@ -405,7 +405,7 @@ nBool Parser::ParseCompilerActionArgument(const natRefPointer<IActionContext>& a
 	// 如果标识符后面有非分隔符或者结束符的 Token 的话，将由调用者报告错误
 	if (HasAnyFlags(argType, CompilerActionArgumentType::Identifier) && m_CurrentToken.Is(TokenType::Identifier))
 	{
-		actionContext->AddArgument(m_Sema.ActOnCompilerActionIdentifierArgument(m_CurrentToken.GetIdentifierInfo()));
+		actionContext->AddArgument(m_Sema.ActOnCompilerActionIdentifierArgument(m_CurrentToken.GetIdentifierInfo(), m_CurrentToken.GetLocation()));
 		ConsumeToken();
 		return true;
 	}
@@ -447,7 +447,8 @@ nBool Parser::ParseCompilerActionArgument(const natRefPointer<IActionContext>& a
 			m_Sema.SetCurrentPhase(Semantic::Sema::Phase::Phase2);
 		}
 
-		const auto decl = ParseDeclaration(context, end);
+		// 类声明不经过 ParseDeclaration，需要单独处理以便作为 $Compiler.Layout 等的参数
+		const auto decl = m_CurrentToken.Is(TokenType::Kw_class) ? ParseClassDeclaration() : ParseDeclaration(context, end);
 		if (decl)
 		{
 			actionContext->AddArgument(decl);
@@ -1202,6 +1203,12 @@ Statement::StmtPtr Parser::ParseStatement(Declaration::Context context, nBool ma
 		return ParseWhileStatement();
 	case TokenType::Kw_for:
 		return ParseForStatement();
+	case TokenType::Kw_switch:
+		return ParseSwitchStatement();
+	case TokenType::Kw_case:
+		return ParseCaseStatement();
+	case TokenType::Kw_default:
+		return ParseDefaultStatement();
 	case TokenType::Kw_goto:
 		break;
 	case TokenType::Kw_continue:
@@ -1211,9 +1218,12 @@ Statement::StmtPtr Parser::ParseStatement(Declaration::Context context, nBool ma
 	case TokenType::Kw_return:
 		return ParseReturnStatement();
 	case TokenType::Kw_try:
-		break;
+		return ParseTryStatement();
 	case TokenType::Kw_catch:
-		break;
+		// catch 只能紧跟在 try 块或其他 catch 块之后
+		m_Diag.Report(DiagnosticsEngine::DiagID::ErrUnexpect, m_CurrentToken.GetLocation())
+			.AddArgument(TokenType::Kw_catch);
+		return ParseStmtError();
 	case TokenType::Dollar:
 		ParseCompilerAction(context, [this, &result](natRefPointer<ASTNode> const& node)
 		{
@@ -1529,6 +1539,105 @@ Statement::StmtPtr Parser::ParseForStatement()
 							   rightParenLoc, std::move(body));
 }
 
+// switch-statement:
+//	'switch' '(' expression ')' statement
+Statement::StmtPtr Parser::ParseSwitchStatement()
+{
+	assert(m_CurrentToken.Is(TokenType::Kw_switch));
+	const auto switchLoc = m_CurrentToken.GetLocation();
+	ConsumeToken();
+
+	if (!m_CurrentToken.Is(TokenType::LeftParen))
+	{
+		m_Diag.Report(DiagnosticsEngine::DiagID::ErrExpectedGot, m_CurrentToken.GetLocation())
+			  .AddArgument(TokenType::LeftParen)
+			  .AddArgument(m_CurrentToken.GetType());
+		return ParseStmtError();
+	}
+
+	ParseScope switchScope{ this, Semantic::ScopeFlags::BreakableScope | Semantic::ScopeFlags::SwitchScope };
+
+	auto cond = ParseParenExpression();
+	if (!cond)
+	{
+		return ParseStmtError();
+	}
+
+	auto switchStmt = m_Sema.ActOnStartOfSwitchStmt(switchLoc, std::move(cond));
+
+	Statement::StmtPtr body;
+	{
+		ParseScope innerScope{ this, Semantic::ScopeFlags::DeclarableScope };
+		body = ParseStatement();
+	}
+
+	switchScope.ExplicitExit();
+
+	return m_Sema.ActOnFinishSwitchStmt(std::move(switchStmt), std::move(body));
+}
+
+// case-statement:
+//	'case' constant-expression ':' statement
+Statement::StmtPtr Parser::ParseCaseStatement()
+{
+	assert(m_CurrentToken.Is(TokenType::Kw_case));
+	const auto caseLoc = m_CurrentToken.GetLocation();
+	ConsumeToken();
+
+	auto expr = ParseConstantExpression();
+	if (!expr)
+	{
+		return ParseStmtError();
+	}
+
+	if (!m_CurrentToken.Is(TokenType::Colon))
+	{
+		m_Diag.Report(DiagnosticsEngine::DiagID::ErrExpectedGot, m_CurrentToken.GetLocation())
+			  .AddArgument(TokenType::Colon)
+			  .AddArgument(m_CurrentToken.GetType());
+		return ParseStmtError();
+	}
+
+	const auto colonLoc = m_CurrentToken.GetLocation();
+	ConsumeToken();
+
+	auto subStmt = ParseStatement();
+	if (!subStmt)
+	{
+		subStmt = m_Sema.ActOnNullStmt(colonLoc);
+	}
+
+	return m_Sema.ActOnCaseStmt(caseLoc, std::move(expr), colonLoc, std::move(subStmt));
+}
+
+// default-statement:
+//	'default' ':' statement
+Statement::StmtPtr Parser::ParseDefaultStatement()
+{
+	assert(m_CurrentToken.Is(TokenType::Kw_default));
+	const auto defaultLoc = m_CurrentToken.GetLocation();
+	ConsumeToken();
+
+	if (!m_CurrentToken.Is(TokenType::Colon))
+	{
+		m_Diag.Report(DiagnosticsEngine::DiagID::ErrExpectedGot, m_CurrentToken.GetLocation())
+			  .AddArgument(TokenType::Colon)
+			  .AddArgument(m_CurrentToken.GetType());
+		return ParseStmtError();
+	}
+
+	const auto colonLoc = m_CurrentToken.GetLocation();
+	ConsumeToken();
+
+	auto subStmt = ParseStatement();
+	if (!subStmt)
+	{
+		subStmt = m_Sema.ActOnNullStmt(colonLoc);
+	}
+
+	return m_Sema.ActOnDefaultStmt(defaultLoc, colonLoc, std::move(subStmt));
+}
+
 Statement::StmtPtr Parser::ParseContinueStatement()
 {
 	assert(m_CurrentToken.Is(TokenType::Kw_continue));
@@ -1602,6 +1711,127 @@ Statement::StmtPtr Parser::ParseReturnStatement()
 	return nullptr;
 }
 
+// try-statement:
+//	'try' compound-statement handler-seq
+// handler-seq:
+//	catch-statement [handler-seq]
+Statement::StmtPtr Parser::ParseTryStatement()
+{
+	assert(m_CurrentToken.Is(TokenType::Kw_try));
+	const auto tryLoc = m_CurrentToken.GetLocation();
+	ConsumeToken();
+
+	if (!m_CurrentToken.Is(TokenType::LeftBrace))
+	{
+		m_Diag.Report(DiagnosticsEngine::DiagID::ErrExpectedGot, m_CurrentToken.GetLocation())
+			  .AddArgument(TokenType::LeftBrace)
+			  .AddArgument(m_CurrentToken.GetType());
+		return ParseStmtError();
+	}
+
+	auto tryBlock = ParseCompoundStatement(Semantic::ScopeFlags::DeclarableScope | Semantic::ScopeFlags::CompoundStmtScope | Semantic::ScopeFlags::TryScope);
+	if (!tryBlock)
+	{
+		return ParseStmtError();
+	}
+
+	if (!m_CurrentToken.Is(TokenType::Kw_catch))
+	{
+		m_Diag.Report(DiagnosticsEngine::DiagID::ErrExpectedGot, m_CurrentToken.GetLocation())
+			  .AddArgument(TokenType::Kw_catch)
+			  .AddArgument(m_CurrentToken.GetType());
+		return ParseStmtError();
+	}
+
+	std::vector<Statement::StmtPtr> handlers;
+	while (m_CurrentToken.Is(TokenType::Kw_catch))
+	{
+		auto handler = ParseCatchStatement();
+		if (!handler)
+		{
+			return ParseStmtError();
+		}
+
+		handlers.emplace_back(std::move(handler));
+	}
+
+	return m_Sema.ActOnTryStmt(tryLoc, std::move(tryBlock), from(handlers));
+}
+
+// catch-statement:
+//	'catch' '(' exception-declaration ')' compound-statement
+// exception-declaration:
+//	declarator
+//	'...'
+Statement::StmtPtr Parser::ParseCatchStatement()
+{
+	assert(m_CurrentToken.Is(TokenType::Kw_catch));
+	const auto catchLoc = m_CurrentToken.GetLocation();
+	ConsumeToken();
+
+	if (!m_CurrentToken.Is(TokenType::LeftParen))
+	{
+		m_Diag.Report(DiagnosticsEngine::DiagID::ErrExpectedGot, m_CurrentToken.GetLocation())
+			  .AddArgument(TokenType::LeftParen)
+			  .AddArgument(m_CurrentToken.GetType());
+		return ParseStmtError();
+	}
+
+	ConsumeParen();
+
+	// 异常声明的作用域包含处理块
+	ParseScope catchScope{ this, Semantic::ScopeFlags::DeclarableScope | Semantic::ScopeFlags::ControlScope };
+
+	natRefPointer<Declaration::VarDecl> exDecl;
+	if (m_CurrentToken.Is(TokenType::Ellipsis))
+	{
+		// catch (...) 捕获所有异常，不声明异常对象
+		ConsumeToken();
+	}
+	else
+	{
+		const auto decl = make_ref<Declaration::Declarator>(Declaration::Context::Catch);
+		if (!ParseDeclarator(decl))
+		{
+			return ParseStmtError();
+		}
+
+		exDecl = m_Sema.ActOnExceptionDecl(m_Sema.GetCurrentScope(), decl);
+		if (!exDecl)
+		{
+			return ParseStmtError();
+		}
+	}
+
+	if (!m_CurrentToken.Is(TokenType::RightParen))
+	{
+		m_Diag.Report(DiagnosticsEngine::DiagID::ErrExpectedGot, m_CurrentToken.GetLocation())
+			  .AddArgument(TokenType::RightParen)
+			  .AddArgument(m_CurrentToken.GetType());
+		return ParseStmtError();
+	}
+
+	ConsumeParen();
+
+	if (!m_CurrentToken.Is(TokenType::LeftBrace))
+	{
+		m_Diag.Report(DiagnosticsEngine::DiagID::ErrExpectedGot, m_CurrentToken.GetLocation())
+			  .AddArgument(TokenType::LeftBrace)
+			  .AddArgument(m_CurrentToken.GetType());
+		return ParseStmtError();
+	}
+
+	auto handlerBlock = ParseCompoundStatement();
+	if (!handlerBlock)
+	{
+		return ParseStmtError();
+	}
+
+	catchScope.ExplicitExit();
+
+	return m_Sema.ActOnCatchStmt(catchLoc, std::move(exDecl), std::move(handlerBlock));
+}
+
 Statement::StmtPtr Parser::ParseExprStatement(nBool mayBeExpr)
 {
 	auto expr = ParseExpression();
@@ -2739,6 +2969,28 @@ nBool Parser::ParseInitializer(Declaration::DeclaratorPtr const& decl)
 			return false;
 		}
 
+		// 解析顶层声明符时，非局部函数的函数体只进行括号匹配，直到首次被需要时才进行分析
+		// 代码补全需要分析函数体，此时不进行延迟
+		if (m_ResolveContext && !m_Sema.GetCodeCompleter() && !m_Sema.GetDeclContext().Cast<Declaration::FunctionDecl>())
+		{
+			const auto curScope = m_Sema.GetCurrentScope();
+			auto funcDecl = m_Sema.HandleDeclarator(curScope, decl, decl->GetDecl());
+
+			std::vector<Token> bodyTokens;
+			skipToken(&bodyTokens);
+			SkipUntil({ TokenType::RightBrace }, false, &bodyTokens);
+
+			if (funcDecl)
+			{
+				m_CachedFunctionBodies.emplace(funcDecl, CachedFunctionBody{
+					curScope, m_Sema.GetDeclContext(), curScope->HasFlags(Semantic::ScopeFlags::UnsafeScope), move(bodyTokens)
+				});
+			}
+
+			decl->SetDecl(std::move(funcDecl));
+			return true;
+		}
+
 		ParseScope bodyScope{
 			this,
 			Semantic::ScopeFlags::FunctionScope | Semantic::ScopeFlags::DeclarableScope | Semantic::ScopeFlags::CompoundStmtScope
@@ -2928,6 +3180,77 @@ Declaration::DeclPtr Parser::ResolveDeclarator(const Declaration::DeclaratorPtr&
 	return ret;
 }
 
+nBool Parser::ResolveFunctionBody(Declaration::DeclPtr const& funcDecl)
+{
+	const auto iter = m_CachedFunctionBodies.find(funcDecl);
+	if (iter == m_CachedFunctionBodies.end())
+	{
+		const auto fd = funcDecl.Cast<Declaration::FunctionDecl>();
+		return fd && fd->GetBody();
+	}
+
+	// 先从缓存中移除，即使分析失败也不会重复报告错误
+	auto cachedBody = std::move(iter->second);
+	m_CachedFunctionBodies.erase(iter);
+
+	auto curToken = m_CurrentToken;
+	pushCachedTokens(move(cachedBody.Tokens));
+	const auto tokensScope = make_scope([this, curToken = std::move(curToken)]
+	{
+		popCachedTokens();
+		m_CurrentToken = curToken;
+	});
+
+	const auto restorePhase = m_Sema.GetCurrentPhase();
+	const auto phaseScope = make_scope([this, restorePhase]
+	{
+		m_Sema.SetCurrentPhase(restorePhase);
+	});
+	m_Sema.SetCurrentPhase(Semantic::Sema::Phase::Phase2);
+
+	const auto cachedScope = cachedBody.Scope;
+	const auto tempUnsafe = cachedBody.InUnsafeScope && !cachedScope->HasFlags(Semantic::ScopeFlags::UnsafeScope);
+	const auto recoveryScope = make_scope(
+		[this, curScope = m_Sema.GetCurrentScope(), curDeclContext = m_Sema.GetDeclContext(), tempUnsafe]
+	{
+		if (tempUnsafe)
+		{
+			m_Sema.GetCurrentScope()->RemoveFlags(Semantic::ScopeFlags::UnsafeScope);
+		}
+		m_Sema.SetDeclContext(curDeclContext);
+		m_Sema.SetCurrentScope(curScope);
+	});
+	m_Sema.SetCurrentScope(cachedScope);
+	m_Sema.SetDeclContext(cachedBody.DeclContext);
+	if (tempUnsafe)
+	{
+		cachedScope->AddFlags(Semantic::ScopeFlags::UnsafeScope);
+	}
+
+	ParseScope bodyScope{
+		this,
+		Semantic::ScopeFlags::FunctionScope | Semantic::ScopeFlags::DeclarableScope | Semantic::ScopeFlags::CompoundStmtScope
+	};
+	auto startedDecl = m_Sema.ActOnStartOfFunctionDef(m_Sema.GetCurrentScope(), funcDecl);
+	const auto fd = ParseFunctionBody(std::move(startedDecl), bodyScope).Cast<Declaration::FunctionDecl>();
+
+	return fd && fd->GetBody();
+}
+
+void Parser::ResolveAllFunctionBodies()
+{
+	while (!m_CachedFunctionBodies.empty())
+	{
+		const auto funcDecl = m_CachedFunctionBodies.begin()->first;
+		ResolveFunctionBody(funcDecl);
+	}
+}
+
+nBool Parser::HasPendingFunctionBody(Declaration::DeclPtr const& funcDecl) const noexcept
+{
+	return m_CachedFunctionBodies.find(funcDecl) != m_CachedFunctionBodies.end();
+}
+
 IUnknownTokenHandler::~IUnknownTokenHandler()
 {
 }
@@ -2961,6 +3284,9 @@ void NatsuLang::ParseAST(Preprocessor& pp, ASTContext& astContext, natRefPointer
 
 	ParseAST(parser);
 	EndParsingAST(parser);
+
+	// parser 在此处即将析构，之后无法再按需分析函数体
+	parser.ResolveAllFunctionBodies();
 }
 
 void NatsuLang::ParseAST(Parser& parser)
@@ -620,3 +620,103 @@ void ActionDestroyAt::ActionDestroyAtContext::AddArgument(natRefPointer<ASTNode>
 		// TODO: 报告错误：希望获得指针表达式
 	}
 }
+
+ActionLayout::ActionLayout()
+{
+}
+
+ActionLayout::~ActionLayout()
+{
+}
+
+nStrView ActionLayout::GetName() const noexcept
+{
+	return u8"Layout"_nv;
+}
+
+natRefPointer<IActionContext> ActionLayout::StartAction(CompilerActionContext const& context)
+{
+	auto actionContext = make_ref<ActionLayoutContext>();
+	actionContext->Diag = &context.GetParser().GetDiagnosticsEngine();
+	return actionContext;
+}
+
+void ActionLayout::EndAction(natRefPointer<IActionContext> const& context, std::function<nBool(natRefPointer<ASTNode>)> const& output)
+{
+	const auto actionContext = context.UnsafeCast<ActionLayoutContext>();
+	const auto diag = actionContext->Diag;
+
+	if (!actionContext->PolicyId)
+	{
+		diag->Report(Diag::DiagnosticsEngine::DiagID::ErrExpectedIdentifier);
+	}
+	else if (!actionContext->Policy)
+	{
+		// 仍然输出之后的声明，但不改变其布局策略
+		diag->Report(Diag::DiagnosticsEngine::DiagID::ErrExpected, actionContext->PolicyId->GetLocation()).AddArgument("Declared, Optimal or Packed");
+	}
+
+	const auto classDecl = actionContext->Decl.Cast<Declaration::ClassDecl>();
+	if (actionContext->Decl && !classDecl)
+	{
+		diag->Report(Diag::DiagnosticsEngine::DiagID::ErrExpected, actionContext->Decl->GetLocation()).AddArgument("class declaration");
+	}
+
+	if (classDecl && actionContext->Policy)
+	{
+		// 类只能有一种布局策略，后指定的覆盖先指定的
+		classDecl->DetachAttributes(typeid(ClassLayoutAttribute));
+		classDecl->AttachAttribute(make_ref<ClassLayoutAttribute>(actionContext->Policy.value()));
+	}
+
+	if (output)
+	{
+		output(actionContext->Decl);
+	}
+}
+
+ActionLayout::ActionLayoutContext::ActionLayoutContext()
+	: Diag{}, AssignedPolicy{}
+{
+}
+
+ActionLayout::ActionLayoutContext::~ActionLayoutContext()
+{
+}
+
+natRefPointer<IArgumentRequirement> ActionLayout::ActionLayoutContext::GetArgumentRequirement()
+{
+	return make_ref<SimpleArgumentRequirement>(std::initializer_list<CompilerActionArgumentType>{ CompilerActionArgumentType::Identifier, CompilerActionArgumentType::Declaration | CompilerActionArgumentType::MayBeSingle });
+}
+
+void ActionLayout::ActionLayoutContext::AddArgument(natRefPointer<ASTNode> const& arg)
+{
+	if (!AssignedPolicy)
+	{
+		AssignedPolicy = true;
+
+		PolicyId = arg.Cast<Declaration::UnresolvedDecl>();
+		if (!PolicyId)
+		{
+			return;
+		}
+
+		const auto id = PolicyId->GetName();
+		if (id == "Declared")
+		{
+			Policy.emplace(ClassLayoutPolicy::Declared);
+		}
+		else if (id == "Optimal")
+		{
+			Policy.emplace(ClassLayoutPolicy::Optimal);
+		}
+		else if (id == "Packed")
+		{
+			Policy.emplace(ClassLayoutPolicy::Packed);
+		}
+	}
+	else
+	{
+		Decl = arg;
+	}
+}
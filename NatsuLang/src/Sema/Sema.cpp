@@ -10,6 +10,8 @@
 #include "AST/Expression.h"
 #include "Parse/Parser.h"
 
+#include <map>
+
 #undef max
 #undef min
 
@@ -248,6 +250,34 @@ namespace
 		return opCode == Expression::UnaryOperationType::AddrOf || opCode == Expression::UnaryOperationType::Deref;
 	}
 
+	// 类或类的数组在离开作用域时需要调用析构函数，成员具有析构函数的类同样视为具有析构函数
+	nBool HasDestructor(Type::TypePtr type)
+	{
+		type = Type::Type::GetUnderlyingType(type);
+		while (const auto arrayType = type.Cast<Type::ArrayType>())
+		{
+			type = Type::Type::GetUnderlyingType(arrayType->GetElementType());
+		}
+
+		const auto classType = type.Cast<Type::ClassType>();
+		if (!classType)
+		{
+			return false;
+		}
+
+		const auto classDecl = classType->GetDecl().Cast<Declaration::ClassDecl>();
+		return classDecl && !classDecl->GetDecls().where([](Declaration::DeclPtr const& decl) -> nBool
+		{
+			if (decl.Cast<Declaration::DestructorDecl>())
+			{
+				return true;
+			}
+
+			const auto fieldDecl = decl.Cast<Declaration::FieldDecl>();
+			return fieldDecl && HasDestructor(fieldDecl->GetValueType());
+		}).empty();
+	}
+
 	class DefaultNameBuilder
 		: public natRefObjImpl<DefaultNameBuilder, INameBuilder>
 	{
@@ -346,6 +376,10 @@ namespace NatsuLang
 	{
 	}
 
+	IExternalDeclSource::~IExternalDeclSource()
+	{
+	}
+
 	class ImportedAttribute
 		: public natRefObjImpl<ImportedAttribute, Declaration::IAttribute>
 	{
@@ -378,6 +412,30 @@ namespace NatsuLang
 	private:
 		Sema& m_Sema;
 	};
+
+	class ClassLayoutAttributeSerializer
+		: public natRefObjImpl<ClassLayoutAttributeSerializer, IAttributeSerializer>
+	{
+	public:
+		void Serialize(natRefPointer<Declaration::IAttribute> const& attribute,
+		               natRefPointer<ISerializationArchiveWriter> const& writer) override
+		{
+			const auto classLayout = attribute.Cast<ClassLayoutAttribute>();
+			assert(classLayout);
+			writer->WriteNumType(u8"Policy"_nv, classLayout->GetPolicy());
+		}
+
+		natRefPointer<Declaration::IAttribute> Deserialize(natRefPointer<ISerializationArchiveReader> const& reader) override
+		{
+			ClassLayoutPolicy policy;
+			if (!reader->ReadNumType(u8"Policy"_nv, policy))
+			{
+				nat_Throw(natErrException, NatErr::NatErr_InternalErr, u8"Cannot read class layout policy"_nv);
+			}
+
+			return make_ref<ClassLayoutAttribute>(policy);
+		}
+	};
 }
 
 Sema::Sema(Preprocessor& preprocessor, ASTContext& astContext, natRefPointer<ASTConsumer> astConsumer)
@@ -465,6 +523,13 @@ Metadata Sema::CreateMetadata(nBool includeImported) const
 
 void Sema::LoadMetadata(Metadata const& metadata, nBool feedAstConsumer)
 {
+	// 按需加载时可能处于任意声明上下文中，声明总是加入翻译单元
+	const auto declContextScope = make_scope([this, curDeclContext = std::move(m_CurrentDeclContext)]() mutable
+	{
+		m_CurrentDeclContext = std::move(curDeclContext);
+	});
+	m_CurrentDeclContext = m_Context.GetTranslationUnit();
+
 	for (const auto& decl : metadata.GetDecls())
 	{
 		if (auto namedDecl = decl.Cast<Declaration::NamedDecl>())
@@ -480,6 +545,17 @@ void Sema::LoadMetadata(Metadata const& metadata, nBool feedAstConsumer)
 	}
 }
 
+void Sema::AddExternalDeclSource(natRefPointer<IExternalDeclSource> source)
+{
+	assert(source);
+	m_ExternalDeclSources.emplace_back(std::move(source));
+}
+
+void Sema::LoadAllExternalDecls() const
+{
+	loadExternalDecls(nullptr);
+}
+
 void Sema::MarkAsImported(Declaration::DeclPtr const& decl) const
 {
 	decl->AttachAttribute(m_ImportedAttribute);
@@ -933,6 +1009,12 @@ nBool Sema::LookupName(LookupResult& result, natRefPointer<Scope> scope) const
 
 	for (; scope; scope = scope->GetParent())
 	{
+		if (scope == m_TranslationUnitScope && (id || result.IsCodeCompletion()))
+		{
+			// 代码补全需要列出所有候选，因此加载全部声明
+			loadExternalDecls(result.IsCodeCompletion() ? nullptr : id);
+		}
+
 		Linq<Valued<natRefPointer<Declaration::NamedDecl>>> query = scope->GetDecls().select(
 			[](natRefPointer<Declaration::NamedDecl> const& namedDecl)
 			{
@@ -1004,6 +1086,11 @@ nBool Sema::LookupQualifiedName(LookupResult& result, Declaration::DeclContext*
 	const auto lookupType = result.GetLookupType();
 	auto found = false;
 
+	if (id && context == m_Context.GetTranslationUnit().Get())
+	{
+		loadExternalDecls(id);
+	}
+
 	auto query = context->Lookup(id);
 	switch (lookupType)
 	{
@@ -1202,6 +1289,12 @@ natRefPointer<Declaration::VarDecl> Sema::ActOnVariableDeclarator(
 		initExpr = ImpCastExprToType(std::move(initExpr), type, castType);
 	}
 
+	// 常量的初始化器只需求值一次，之后对该常量的引用无需再分析整个初始化器
+	if (initExpr && decl->GetStorageClass() == Specifier::StorageClass::Const)
+	{
+		initExpr = FoldConstantExpr(std::move(initExpr));
+	}
+
 	auto varDecl = make_ref<Declaration::VarDecl>(Declaration::Decl::Var, dc, decl->GetRange().GetBegin(),
 	                                              decl->GetIdentifierLocation(), std::move(id), std::move(type),
 	                                              decl->GetStorageClass());
@@ -1304,10 +1397,10 @@ natRefPointer<Declaration::UnresolvedDecl> Sema::ActOnUnresolvedDeclarator(
 	return unresolvedDecl;
 }
 
-natRefPointer<Declaration::UnresolvedDecl> Sema::ActOnCompilerActionIdentifierArgument(Identifier::IdPtr id)
+natRefPointer<Declaration::UnresolvedDecl> Sema::ActOnCompilerActionIdentifierArgument(Identifier::IdPtr id, SourceLocation loc)
 {
 	assert(id);
-	return make_ref<Declaration::UnresolvedDecl>(nullptr, SourceLocation{}, std::move(id), nullptr, SourceLocation{},
+	return make_ref<Declaration::UnresolvedDecl>(nullptr, loc, std::move(id), nullptr, loc,
 	                                             nullptr);
 }
 
@@ -1542,6 +1635,233 @@ Statement::StmtPtr Sema::ActOnWhileStmt(SourceLocation loc, Expression::ExprPtr
 	return make_ref<Statement::WhileStmt>(loc, ActOnConditionExpr(std::move(cond)), std::move(body));
 }
 
+natRefPointer<Statement::SwitchStmt> Sema::ActOnStartOfSwitchStmt(SourceLocation loc, Expression::ExprPtr cond)
+{
+	if (cond)
+	{
+		const auto condType = Type::Type::GetUnderlyingType(cond->GetExprType());
+		const auto builtinType = condType.Cast<Type::BuiltinType>();
+		if (condType->GetType() != Type::Type::Enum && !(builtinType && builtinType->IsIntegerType()))
+		{
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrInvalidConvertFromTo, cond->GetStartLoc())
+				.AddArgument(GetTypeName(cond->GetExprType()))
+				.AddArgument(GetTypeName(m_Context.GetBuiltinType(Type::BuiltinType::Int)));
+			cond = nullptr;
+		}
+	}
+
+	// 即使条件无效也需要入栈，以便其中的 case 及 default 语句可以正确关联
+	auto switchStmt = make_ref<Statement::SwitchStmt>(loc, std::move(cond));
+	m_SwitchStack.emplace_back(switchStmt);
+	return switchStmt;
+}
+
+Statement::StmtPtr Sema::ActOnFinishSwitchStmt(natRefPointer<Statement::SwitchStmt> switchStmt, Statement::StmtPtr body)
+{
+	assert(!m_SwitchStack.empty() && m_SwitchStack.back() == switchStmt);
+	m_SwitchStack.pop_back();
+
+	if (!body)
+	{
+		return nullptr;
+	}
+
+	switchStmt->SetBody(body, body->GetEndLoc());
+
+	// case 及 default 语句只能直接位于 switch 的语句体中，且语句体必须以其中之一开始
+	// 这样所有跳转目标都处于同一词法作用域内，不会跳过其他作用域中变量的初始化及清理
+	// 同一作用域中位于之前的 case 之后的变量声明仍可能被跳过，因此与 C++ 相同，不允许跳过具有初始化器或需要析构的变量
+	auto valid = true;
+	auto isFirst = true;
+	std::unordered_set<natRefPointer<Statement::SwitchCase>> directCases;
+	natRefPointer<Declaration::VarDecl> bypassedVar;
+	const auto collectCases = [&](Statement::StmtPtr stmt)
+	{
+		if (isFirst)
+		{
+			isFirst = false;
+			if (!stmt.Cast<Statement::SwitchCase>())
+			{
+				m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrExpected, stmt->GetStartLoc())
+					.AddArgument(Lex::TokenType::Kw_case);
+				valid = false;
+			}
+		}
+
+		while (const auto switchCase = stmt.Cast<Statement::SwitchCase>())
+		{
+			directCases.emplace(switchCase);
+			if (bypassedVar)
+			{
+				m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrJumpBypassesInitialization, switchCase->GetStartLoc())
+					.AddArgument(bypassedVar->GetIdentifierInfo());
+				m_Diag.Report(Diag::DiagnosticsEngine::DiagID::NoteSee, bypassedVar->GetLocation());
+				valid = false;
+			}
+			stmt = switchCase->GetSubStmt();
+		}
+
+		if (const auto declStmt = stmt.Cast<Statement::DeclStmt>(); declStmt && !bypassedVar)
+		{
+			// 外部及静态变量不在此处初始化，跳过其声明是安全的
+			if (auto varDecl = declStmt->GetDecl().Cast<Declaration::VarDecl>();
+				varDecl && !varDecl->IsFunction() &&
+				!HasAnyFlags(varDecl->GetStorageClass(), Specifier::StorageClass::Extern | Specifier::StorageClass::Static) &&
+				(varDecl->GetInitializer() || HasDestructor(varDecl->GetValueType())))
+			{
+				bypassedVar = std::move(varDecl);
+			}
+		}
+	};
+
+	if (body->GetType() == Statement::Stmt::CompoundStmtClass)
+	{
+		for (auto&& stmt : body->GetChildrenStmt())
+		{
+			collectCases(stmt);
+		}
+	}
+	else
+	{
+		collectCases(body);
+	}
+
+	// 链表中的顺序与源码顺序相反
+	std::vector<natRefPointer<Statement::SwitchCase>> switchCases;
+	for (auto switchCase = switchStmt->GetSwitchCaseList(); switchCase; switchCase = switchCase->GetNextSwitchCase())
+	{
+		switchCases.emplace_back(switchCase);
+	}
+
+	// case 的值以条件的宽度比较，超出宽度的位将被忽略，因此不同的字面量可能表示相同的值
+	std::size_t condWidth = sizeof(nuWideInteger) * 8;
+	if (const auto cond = switchStmt->GetCond())
+	{
+		condWidth = std::min(condWidth, m_Context.GetTypeInfo(Type::Type::GetUnderlyingType(cond->GetExprType())).Size * 8);
+	}
+	const auto condMask = condWidth < sizeof(nuWideInteger) * 8 ? (nuWideInteger{ 1 } << condWidth) - 1 : ~nuWideInteger{};
+
+	std::map<nuWideInteger, natRefPointer<Statement::CaseStmt>> caseValues;
+	natRefPointer<Statement::DefaultStmt> defaultStmt;
+	for (auto iter = switchCases.crbegin(); iter != switchCases.crend(); ++iter)
+	{
+		const auto& switchCase = *iter;
+		const auto caseStmt = switchCase.Cast<Statement::CaseStmt>();
+		const auto tokenType = caseStmt ? Lex::TokenType::Kw_case : Lex::TokenType::Kw_default;
+
+		if (directCases.find(switchCase) == directCases.cend())
+		{
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrUnexpect, switchCase->GetStartLoc())
+				.AddArgument(tokenType);
+			valid = false;
+			continue;
+		}
+
+		Statement::StmtPtr previous;
+		if (caseStmt)
+		{
+			nuWideInteger value;
+			const auto evaluated = caseStmt->GetExpr()->EvaluateAsWideInt(value, m_Context);
+			assert(evaluated && "case value should have been checked in ActOnCaseStmt");
+			static_cast<void>(evaluated);
+
+			const auto [caseIter, inserted] = caseValues.emplace(value & condMask, caseStmt);
+			if (!inserted)
+			{
+				previous = caseIter->second;
+			}
+		}
+		else if (defaultStmt)
+		{
+			previous = defaultStmt;
+		}
+		else
+		{
+			defaultStmt = switchCase.UnsafeCast<Statement::DefaultStmt>();
+		}
+
+		if (previous)
+		{
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrUnexpect, switchCase->GetStartLoc())
+				.AddArgument(tokenType);
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::NoteSee, previous->GetStartLoc());
+			valid = false;
+		}
+	}
+
+	if (!valid || !switchStmt->GetCond())
+	{
+		return nullptr;
+	}
+
+	return switchStmt;
+}
+
+Statement::StmtPtr Sema::ActOnCaseStmt(SourceLocation caseLoc, Expression::ExprPtr expr, SourceLocation colonLoc,
+                                       Statement::StmtPtr subStmt)
+{
+	if (m_SwitchStack.empty())
+	{
+		m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrUnexpect, caseLoc)
+			.AddArgument(Lex::TokenType::Kw_case);
+		return subStmt;
+	}
+
+	const auto& switchStmt = m_SwitchStack.back();
+	if (const auto cond = switchStmt->GetCond())
+	{
+		auto condType = cond->GetExprType();
+		const auto underlyingCondType = Type::Type::GetUnderlyingType(condType);
+		if (underlyingCondType->GetType() == Type::Type::Builtin)
+		{
+			const auto castType = getCastType(expr, condType, true);
+			if (castType == Expression::CastType::Invalid)
+			{
+				m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrInvalidConvertFromTo, expr->GetStartLoc())
+					.AddArgument(GetTypeName(expr->GetExprType()))
+					.AddArgument(GetTypeName(condType));
+				return subStmt;
+			}
+
+			expr = ImpCastExprToType(std::move(expr), std::move(condType), castType);
+		}
+		else if (!Type::Type::GetUnderlyingType(expr->GetExprType())->EqualTo(underlyingCondType))
+		{
+			// 条件为枚举类型时 case 的值必须是同一枚举的值
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrInvalidConvertFromTo, expr->GetStartLoc())
+				.AddArgument(GetTypeName(expr->GetExprType()))
+				.AddArgument(GetTypeName(condType));
+			return subStmt;
+		}
+	}
+
+	nuWideInteger value;
+	if (!expr->EvaluateAsWideInt(value, m_Context))
+	{
+		m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrExpressionCannotEvaluateAsConstant, expr->GetStartLoc());
+		return subStmt;
+	}
+
+	auto caseStmt = make_ref<Statement::CaseStmt>(FoldConstantExpr(std::move(expr)), caseLoc, colonLoc);
+	caseStmt->SetSubStmt(std::move(subStmt));
+	switchStmt->AddSwitchCase(caseStmt);
+	return caseStmt;
+}
+
+Statement::StmtPtr Sema::ActOnDefaultStmt(SourceLocation defaultLoc, SourceLocation colonLoc, Statement::StmtPtr subStmt)
+{
+	if (m_SwitchStack.empty())
+	{
+		m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrUnexpect, defaultLoc)
+			.AddArgument(Lex::TokenType::Kw_default);
+		return subStmt;
+	}
+
+	auto defaultStmt = make_ref<Statement::DefaultStmt>(defaultLoc, colonLoc, std::move(subStmt));
+	m_SwitchStack.back()->AddSwitchCase(defaultStmt);
+	return defaultStmt;
+}
+
 Statement::StmtPtr Sema::ActOnForStmt(SourceLocation forLoc, SourceLocation leftParenLoc, Statement::StmtPtr init,
                                       Expression::ExprPtr cond, Expression::ExprPtr third, SourceLocation rightParenLoc,
                                       Statement::StmtPtr body)
@@ -1604,6 +1924,83 @@ Statement::StmtPtr Sema::ActOnReturnStmt(SourceLocation loc, Expression::ExprPtr
 	return nullptr;
 }
 
+natRefPointer<Declaration::VarDecl> Sema::ActOnExceptionDecl(natRefPointer<Scope> const& scope,
+                                                             Declaration::DeclaratorPtr const& decl)
+{
+	// 异常声明必须显式指定类型，且不能具有初始化器
+	if (!decl->GetType())
+	{
+		m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrExpected, decl->GetRange().GetEnd())
+			.AddArgument(Lex::TokenType::Colon);
+		return nullptr;
+	}
+
+	if (decl->GetInitializer())
+	{
+		m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrUnexpect, decl->GetInitializer()->GetStartLoc())
+			.AddArgument(Lex::TokenType::Equal);
+		return nullptr;
+	}
+
+	return HandleDeclarator(scope, decl).Cast<Declaration::VarDecl>();
+}
+
+Statement::StmtPtr Sema::ActOnCatchStmt(SourceLocation catchLoc, natRefPointer<Declaration::VarDecl> exDecl,
+                                        Statement::StmtPtr handlerBlock)
+{
+	auto catchStmt = make_ref<Statement::CatchStmt>(catchLoc, std::move(exDecl), std::move(handlerBlock));
+	catchStmt->SetEndLoc(catchStmt->GetHandlerBlcok()->GetEndLoc());
+	return catchStmt;
+}
+
+Statement::StmtPtr Sema::ActOnTryStmt(SourceLocation tryLoc, Statement::StmtPtr tryBlock,
+                                      Linq<Valued<Statement::StmtPtr>> const& handlers)
+{
+	// 检查是否存在永远不会被执行的异常处理器
+	std::unordered_map<Type::TypePtr, natRefPointer<Statement::CatchStmt>> handledTypes;
+	natRefPointer<Statement::CatchStmt> catchAllHandler;
+	auto succeed = true;
+
+	for (const auto& handler : handlers)
+	{
+		const auto catchStmt = handler.UnsafeCast<Statement::CatchStmt>();
+		assert(catchStmt);
+
+		if (catchAllHandler)
+		{
+			// catch (...) 必须是最后一个异常处理器
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrUnexpect, catchStmt->GetStartLoc())
+				.AddArgument(Lex::TokenType::Kw_catch);
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::NoteSee, catchAllHandler->GetStartLoc());
+			succeed = false;
+			continue;
+		}
+
+		const auto exDecl = catchStmt->GetExceptionDecl();
+		if (!exDecl)
+		{
+			catchAllHandler = catchStmt;
+			continue;
+		}
+
+		const auto [iter, inserted] = handledTypes.emplace(Type::Type::GetUnderlyingType(exDecl->GetValueType()), catchStmt);
+		if (!inserted)
+		{
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrUnexpect, catchStmt->GetStartLoc())
+				.AddArgument(Lex::TokenType::Kw_catch);
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::NoteSee, iter->second->GetStartLoc());
+			succeed = false;
+		}
+	}
+
+	if (!succeed)
+	{
+		return nullptr;
+	}
+
+	return make_ref<Statement::TryStmt>(tryLoc, std::move(tryBlock), handlers);
+}
+
 Statement::StmtPtr Sema::ActOnExprStmt(Expression::ExprPtr expr)
 {
 	return expr;
@@ -1740,12 +2137,27 @@ Expression::ExprPtr Sema::ActOnConditionExpr(Expression::ExprPtr expr)
 
 Expression::ExprPtr Sema::ActOnThrow(natRefPointer<Scope> const& scope, SourceLocation loc, Expression::ExprPtr expr)
 {
-	// TODO
+	// 不带操作数的 throw 表示重新抛出当前正在处理的异常
 	if (expr)
 	{
+		const auto exprType = Type::Type::GetUnderlyingType(expr->GetExprType());
+		if (!exprType || exprType->IsVoid())
+		{
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrUnexpect, expr->GetStartLoc())
+				.AddArgument(Lex::TokenType::Kw_void);
+			return nullptr;
+		}
+
+		// 异常对象由操作数按位复制得到，若类型具有析构函数，操作数与异常对象将各自析构一次
+		if (HasDestructor(exprType))
+		{
+			m_Diag.Report(Diag::DiagnosticsEngine::DiagID::ErrThrowOperandHasDestructor, expr->GetStartLoc())
+				.AddArgument(GetTypeName(exprType));
+			return nullptr;
+		}
 	}
 
-	nat_Throw(NotImplementedException);
+	return make_ref<Expression::ThrowExpr>(std::move(expr), m_Context.GetBuiltinType(Type::BuiltinType::Void), loc);
 }
 
 Expression::ExprPtr Sema::ActOnInitExpr(Type::TypePtr initType, SourceLocation leftBraceLoc,
@@ -2668,6 +3080,56 @@ Expression::ExprPtr Sema::ImpCastExprToType(Expression::ExprPtr expr, Type::Type
 	return make_ref<Expression::ImplicitCastExpr>(std::move(type), castType, std::move(expr));
 }
 
+Expression::ExprPtr Sema::FoldConstantExpr(Expression::ExprPtr expr)
+{
+	assert(expr);
+
+	switch (expr->GetType())
+	{
+	case Statement::Stmt::IntegerLiteralClass:
+	case Statement::Stmt::FloatingLiteralClass:
+	case Statement::Stmt::BooleanLiteralClass:
+	case Statement::Stmt::CharacterLiteralClass:
+		return expr;
+	default:
+		break;
+	}
+
+	auto type = expr->GetExprType();
+	const auto builtinType = Type::Type::GetUnderlyingType(type).Cast<Type::BuiltinType>();
+	if (!builtinType)
+	{
+		return expr;
+	}
+
+	Expression::Expr::EvalResult result;
+	if (!expr->Evaluate(result, m_Context) || result.HasSideEffects)
+	{
+		return expr;
+	}
+
+	const auto loc = expr->GetStartLoc();
+
+	switch (result.Result.index())
+	{
+	case 0:
+	{
+		const auto value = std::get<0>(result.Result);
+		if (builtinType->GetBuiltinClass() == Type::BuiltinType::Bool)
+		{
+			return make_ref<Expression::BooleanLiteral>(value != 0, std::move(type), loc);
+		}
+
+		return make_ref<Expression::IntegerLiteral>(value, std::move(type), loc);
+	}
+	case 1:
+		return make_ref<Expression::FloatingLiteral>(std::get<1>(result.Result), std::move(type), loc);
+	default:
+		// 字面量只能存储 64 位的值，宽类型的结果不进行折叠，求值结果已缓存在表达式上
+		return expr;
+	}
+}
+
 nBool Sema::CheckFunctionReturn(Statement::StmtEnumerable const& funcBody)
 {
 	for (auto&& stmt : funcBody)
@@ -2875,9 +3337,26 @@ void Sema::prewarming()
 	compilerNamespace->RegisterAction(make_ref<ActionAlignOf>());
 	compilerNamespace->RegisterAction(make_ref<ActionCreateAt>());
 	compilerNamespace->RegisterAction(make_ref<ActionDestroyAt>());
+	compilerNamespace->RegisterAction(make_ref<ActionLayout>());
 
 	m_ImportedAttribute = make_ref<ImportedAttribute>();
 	RegisterAttributeSerializer(u8"Imported"_nv, make_ref<ImportedAttributeSerializer>(*this));
+	RegisterAttributeSerializer(u8"ClassLayout"_nv, make_ref<ClassLayoutAttributeSerializer>());
+}
+
+void Sema::loadExternalDecls(Identifier::IdPtr const& id) const
+{
+	for (const auto& source : m_ExternalDeclSources)
+	{
+		if (id)
+		{
+			source->LoadDecls(id);
+		}
+		else
+		{
+			source->LoadAllDecls();
+		}
+	}
 }
 
 Expression::CastType Sema::getCastType(Expression::ExprPtr const& operand, Type::TypePtr toType, nBool isImplicit)